@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+
+#include "utils/enums.hpp"
+
+namespace tcs {
+namespace bench {
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace json = boost::json;
+using tcp = net::ip::tcp;
+
+// 准备阶段用的同步HTTP客户端，每个请求一条连接
+// 接口返回非Success时抛异常，返回值为响应中的data
+class HttpClient {
+public:
+    HttpClient(std::string host, unsigned short port) : host_(std::move(host)), port_(port) {}
+
+    json::value post(std::string_view target, const json::value& body,
+                     const std::string& token = {}) {
+        net::io_context ioc;
+        tcp::resolver resolver(ioc);
+        beast::tcp_stream stream(ioc);
+        stream.connect(resolver.resolve(host_, std::to_string(port_)));
+
+        http::request<http::string_body> req{http::verb::post,
+                                             beast::string_view(target.data(), target.size()), 11};
+        req.set(http::field::host, host_);
+        req.set(http::field::content_type, "application/json");
+        if (!token.empty()) {
+            req.set(http::field::authorization, token);
+        }
+        req.body() = json::serialize(body);
+        req.prepare_payload();
+        http::write(stream, req);
+
+        beast::flat_buffer buffer;
+        http::response<http::string_body> res;
+        http::read(stream, buffer, res);
+
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+
+        json::value jv = json::parse(res.body());
+        const json::object& obj = jv.as_object();
+        if (res.result() != http::status::ok ||
+            obj.at("code").to_number<int>() != static_cast<int>(utils::StatusCode::Success)) {
+            throw std::runtime_error(std::string(target) + " failed: " + res.body());
+        }
+        return obj.at("data");
+    }
+
+private:
+    std::string host_;
+    unsigned short port_;
+};
+}  // namespace bench
+}  // namespace tcs
@@ -0,0 +1,338 @@
+// 核心热点路径的微基准测试，默认以JSON格式输出，便于在版本之间对比
+//
+// 用法示例：
+//   tinychat_microbench --config ../../doc/config.ini --benchmark_out=v0.2.json
+//   tinychat_microbench --benchmark_filter=FanOut --benchmark_format=console
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "core/request_handler.hpp"
+#include "core/websocket_session.hpp"
+#include "core/ws_codec.hpp"
+#include "core/ws_session_mgr.hpp"
+#include "model/ws_models.hpp"
+#include "pool/thread_pool.hpp"
+#include "utils/config.hpp"
+#include "utils/json_writer.hpp"
+#include "utils/metrics.hpp"
+#include "utils/snowflake.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+using AppConfig = tcs::utils::AppConfig;
+using SnowFlake = tcs::utils::SnowFlake;
+using ThreadPool = tcs::pool::ThreadPool;
+using RequestHandler = tcs::core::RequestHandler;
+using WSSessionMgr = tcs::core::WSSessionMgr;
+using WebsocketSession = tcs::core::WebsocketSession;
+using WsCodec = tcs::core::WsCodec;
+using WsPayload = tcs::core::WsPayload;
+using ServerRespType = tcs::utils::ServerRespType;
+template <typename T>
+using ServerRespMsg = tcs::model::ServerRespMsg<T>;
+using GroupMsgToSend = tcs::model::GroupMsgToSend;
+
+namespace {
+constexpr u64 BENCH_USER_BASE = 900000000;
+constexpr std::size_t MAX_SESSIONS = 256;
+// 发送队列积压超过该值时暂停计时，等IO线程写完
+constexpr i64 OUTBOUND_HIGH_WATER = 64 << 20;
+
+// 本机回环上的真实WebSocket连接，服务端是WebsocketSession，客户端只读不写
+class LoopbackSessions {
+public:
+    // 不析构：会话析构时要访问WSSessionMgr和Metrics，它们可能先于这里被销毁
+    static LoopbackSessions& get() {
+        static LoopbackSessions* instance = new LoopbackSessions;
+        return *instance;
+    }
+
+    // 第一次使用时建立连接，之后复用
+    const std::vector<u64>& users(std::size_t n) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        while (users_.size() < n) {
+            connect(BENCH_USER_BASE + users_.size());
+        }
+        return users_;
+    }
+
+    void shutdown() {
+        ioc_.stop();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+private:
+    struct Client : std::enable_shared_from_this<Client> {
+        explicit Client(net::io_context& ioc) : ws(ioc) {}
+
+        void read() {
+            ws.async_read(buffer, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return;
+                }
+                self->buffer.consume(self->buffer.size());
+                self->read();
+            });
+        }
+
+        websocket::stream<beast::tcp_stream> ws;
+        beast::flat_buffer buffer;
+    };
+
+    LoopbackSessions()
+        : work_(net::make_work_guard(ioc_)), acceptor_(ioc_, {net::ip::make_address("127.0.0.1"), 0}) {
+        for (int i = 0; i < 2; i++) {
+            threads_.emplace_back([this] { ioc_.run(); });
+        }
+    }
+
+    void connect(u64 user_id) {
+        auto client = std::make_shared<Client>(ioc_);
+        client->ws.next_layer().connect(acceptor_.local_endpoint());
+        tcp::socket server = acceptor_.accept();
+
+        std::string token = RequestHandler::generate_login_token("bench", user_id);
+        std::thread handshake([&] {
+            client->ws.set_option(
+                websocket::stream_base::decorator([&](websocket::request_type& req) {
+                    req.set(http::field::authorization, token);
+                }));
+            client->ws.handshake("127.0.0.1", "/ws");
+        });
+
+        beast::flat_buffer buffer;
+        http::request<http::string_body> req;
+        http::read(server, buffer, req);
+        std::make_shared<WebsocketSession>(std::move(server))->do_accept(std::move(req));
+        handshake.join();
+
+        client->read();
+        clients_.push_back(client);
+        users_.push_back(user_id);
+    }
+
+    net::io_context ioc_;
+    net::executor_work_guard<net::io_context::executor_type> work_;
+    tcp::acceptor acceptor_;
+    std::vector<std::thread> threads_;
+    std::mutex mtx_;
+    std::vector<std::shared_ptr<Client>> clients_;
+    std::vector<u64> users_;
+};
+
+// 等待IO线程把积压的帧写出去，不计入耗时
+void drain_outbound(benchmark::State& state) {
+    tcs::utils::Gauge& outbound = tcs::utils::Metrics::get().ws_outbound_bytes;
+    if (outbound.value() < OUTBOUND_HIGH_WATER) {
+        return;
+    }
+    state.PauseTiming();
+    while (outbound.value() > OUTBOUND_HIGH_WATER / 4) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    state.ResumeTiming();
+}
+
+WsPayload group_payload(std::size_t content_size) {
+    GroupMsgToSend msg{.room_id = 1, .sender_id = 2, .content = std::string(content_size, 'x')};
+    return WsPayload{
+        .json = std::make_shared<const std::string>(tcs::utils::to_json(
+            ServerRespMsg<GroupMsgToSend>{.type = ServerRespType::GMsgToSend, .data = msg})),
+        .binary = std::make_shared<const std::string>(WsCodec::encode(msg))};
+}
+
+// ---- SnowFlake ----
+
+void BM_SnowFlakeNextId(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SnowFlake::next_id());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SnowFlakeNextId)->ThreadRange(1, 16)->UseRealTime();
+
+// ---- ThreadPool ----
+
+// 只计入队耗时，任务本身为空
+void BM_ThreadPoolAddTask(benchmark::State& state) {
+    ThreadPool& pool = ThreadPool::get();
+    for (auto _ : state) {
+        pool.addTask([] {});
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolAddTask)->ThreadRange(1, 8)->UseRealTime();
+
+// 从入队到工作线程执行完毕再通知调用方的往返延迟
+void BM_ThreadPoolRoundTrip(benchmark::State& state) {
+    ThreadPool& pool = ThreadPool::get();
+    for (auto _ : state) {
+        pool.addTask([] { return 0; }).get();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPoolRoundTrip)->ThreadRange(1, 8)->UseRealTime();
+
+// ---- WSSessionMgr ----
+
+// 查找在线会话并投递到它的IO线程
+void BM_WSSessionMgrWriteTo(benchmark::State& state) {
+    const std::vector<u64>& users = LoopbackSessions::get().users(MAX_SESSIONS);
+    WsPayload payload = group_payload(64);
+    WSSessionMgr& mgr = WSSessionMgr::get();
+    std::size_t i = static_cast<std::size_t>(state.thread_index());
+    for (auto _ : state) {
+        mgr.write_to(users[i++ % users.size()], payload);
+        drain_outbound(state);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WSSessionMgrWriteTo)->ThreadRange(1, 8)->UseRealTime();
+
+// 不在线的用户只做查找
+void BM_WSSessionMgrWriteToOffline(benchmark::State& state) {
+    WsPayload payload = group_payload(64);
+    WSSessionMgr& mgr = WSSessionMgr::get();
+    u64 user_id = BENCH_USER_BASE + MAX_SESSIONS + 1;
+    for (auto _ : state) {
+        mgr.write_to(user_id, payload);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WSSessionMgrWriteToOffline)->ThreadRange(1, 8)->UseRealTime();
+
+// write_to_room查出成员之后的部分，参数为群人数
+void BM_WSSessionMgrFanOut(benchmark::State& state) {
+    const std::vector<u64>& online = LoopbackSessions::get().users(MAX_SESSIONS);
+    std::vector<u64> users(online.begin(), online.begin() + state.range(0));
+    WsPayload payload = group_payload(64);
+    WSSessionMgr& mgr = WSSessionMgr::get();
+    for (auto _ : state) {
+        mgr.fan_out(users, payload);
+        drain_outbound(state);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WSSessionMgrFanOut)->RangeMultiplier(4)->Range(4, MAX_SESSIONS)->UseRealTime();
+
+// ---- 序列化 ----
+
+void BM_SerializeServerRespMsg(benchmark::State& state) {
+    ServerRespMsg<GroupMsgToSend> msg{
+        .type = ServerRespType::GMsgToSend,
+        .data = {.room_id = 7346129401234567ULL,
+                 .sender_id = 7346129401234568ULL,
+                 .content = std::string(static_cast<std::size_t>(state.range(0)), 'x')}};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(boost::json::serialize(boost::json::value_from(msg)));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SerializeServerRespMsg)->Arg(16)->Arg(256)->Arg(4096);
+
+// 现在发送路径使用的直接序列化
+void BM_ToJsonServerRespMsg(benchmark::State& state) {
+    ServerRespMsg<GroupMsgToSend> msg{
+        .type = ServerRespType::GMsgToSend,
+        .data = {.room_id = 7346129401234567ULL,
+                 .sender_id = 7346129401234568ULL,
+                 .content = std::string(static_cast<std::size_t>(state.range(0)), 'x')}};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tcs::utils::to_json(msg));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ToJsonServerRespMsg)->Arg(16)->Arg(256)->Arg(4096);
+
+// ---- RequestHandler ----
+
+void BM_ExtractUserClaims(benchmark::State& state) {
+    std::string token = RequestHandler::generate_login_token("bench_user", 7346129401234567ULL);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(RequestHandler::extract_user_claims(token));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractUserClaims);
+
+void BM_ExtractTargetParam(benchmark::State& state) {
+    constexpr std::string_view target = "/api/rooms/7346129401234567/messages";
+    std::size_t index = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(RequestHandler::extract_target_param(target, index));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractTargetParam)->Arg(0)->Arg(2)->Arg(3);
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    // --config由本程序处理，其余参数交给Google Benchmark
+    std::string config_path = "../../doc/config.ini";
+    bool has_format = false;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; i++) {
+        if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config_path = argv[++i];
+            continue;
+        }
+        if (std::strncmp(argv[i], "--benchmark_format", 18) == 0) {
+            has_format = true;
+        }
+        args.push_back(argv[i]);
+    }
+    char json_format[] = "--benchmark_format=json";
+    if (!has_format) {
+        args.push_back(json_format);
+    }
+    int bench_argc = static_cast<int>(args.size());
+
+    try {
+        AppConfig::init(config_path);
+        const AppConfig::Server& server = AppConfig::get().server();
+        SnowFlake::init(server.service_id(), server.custom_epoch(),
+                        server.snowflake_clock() == "system" ? SnowFlake::ClockMode::System
+                                                             : SnowFlake::ClockMode::Monotonic,
+                        server.snowflake_max_borrow_ms());
+        ThreadPool::init(server.worker_threads());
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to initialize: " << e.what() << std::endl;
+        return 1;
+    }
+    // 会话的连接、断开日志会干扰结果
+    spdlog::set_level(spdlog::level::off);
+
+    benchmark::Initialize(&bench_argc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(bench_argc, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    LoopbackSessions::get().shutdown();
+    ThreadPool::shutdown();
+    return 0;
+}
@@ -0,0 +1,574 @@
+// 端到端压测：N个模拟客户端经/api/login登录，加入房间后按配置的私聊/群聊比例发消息
+// 统计服务器投递吞吐、投递延迟分位数和服务器进程CPU占用
+//
+// 用法示例：
+//   tinychat_bench --host 127.0.0.1 --port 8080 --clients 200 --group-size 20 \
+//                  --rate 5 --duration 60 --private-ratio 0.3 --server-pid $(pidof tinychat_server)
+//   tinychat_bench --in-process bench.ini --clients 200
+//   tinychat_bench --port 8080 --ws-ports 8080,8081 --clients 200
+//
+// --in-process在本进程内启动服务器，配合Database.engine = memory可以不依赖MySQL运行
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/json.hpp>
+
+#include "bench_http.hpp"
+#include "tinychat_server.hpp"
+#include "core/ws_codec.hpp"
+#include "utils/enums.hpp"
+#include "utils/metrics.hpp"
+#include "utils/config.hpp"
+#include "utils/types.hpp"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace json = boost::json;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+using HttpClient = tcs::bench::HttpClient;
+using WsCodec = tcs::core::WsCodec;
+
+namespace {
+struct Options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 8080;
+    // 多节点时客户端轮流连到这些端口，为空时都连port
+    std::vector<unsigned short> ws_ports;
+    int clients = 100;
+    // 每个群的人数，0表示只发私聊
+    int group_size = 10;
+    // 每个客户端每秒发送的消息数
+    double rate = 2;
+    double private_ratio = 0.3;
+    std::size_t size = 64;
+    int duration = 30;
+    int warmup = 5;
+    // 停止发送后继续接收的秒数
+    int drain = 2;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool binary = false;
+    std::string user_prefix;
+    std::string password = "bench_password";
+    int server_pid = 0;
+    // 非空时在本进程内用该配置启动服务器
+    std::string in_process;
+};
+
+struct BenchUser {
+    std::string username;
+    std::string token;
+    u64 id = 0;
+    // 私聊对象，成对分配，落单的用户只发群聊
+    u64 peer_id = 0;
+    u64 private_room_id = 0;
+    u64 group_room_id = 0;
+};
+
+struct Stats {
+    tcs::utils::Counter sent;
+    tcs::utils::Counter received;
+    tcs::utils::Counter errors;
+    // 发送到对方收到的时间(ns)，只统计预热之后的消息
+    tcs::utils::Histogram latency;
+    std::atomic<bool> measuring{false};
+    std::atomic<int> connected{0};
+};
+
+void usage() {
+    std::cout
+        << "Usage: tinychat_bench [options]\n"
+           "  --host HOST            server address (127.0.0.1)\n"
+           "  --port PORT            server port (8080)\n"
+           "  --ws-ports P1,P2,...   spread WebSocket clients over these ports\n"
+           "                         (cluster nodes on HOST); setup still uses --port\n"
+           "  --clients N            simulated WebSocket clients (100)\n"
+           "  --group-size N         members per group room, 0 for private only (10)\n"
+           "  --rate R               messages per second per client (2)\n"
+           "  --private-ratio P      share of private messages, 0..1 (0.3)\n"
+           "  --size BYTES           message content size (64)\n"
+           "  --duration S           measured seconds (30)\n"
+           "  --warmup S             seconds before measuring (5)\n"
+           "  --drain S              seconds to keep receiving after sending stops (2)\n"
+           "  --threads N            client io threads (hardware concurrency)\n"
+           "  --binary               use the tinychat.bin.v1 subprotocol\n"
+           "  --user-prefix STR      reuse accounts STR0..STRn instead of fresh ones\n"
+           "  --password STR         password of the bench accounts\n"
+           "  --server-pid PID       report CPU used by this process\n"
+           "  --in-process CONFIG    start the server in this process with CONFIG;\n"
+           "                         host and port come from CONFIG\n";
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--host") {
+            opts.host = next();
+        } else if (arg == "--port") {
+            opts.port = static_cast<unsigned short>(std::stoi(next()));
+        } else if (arg == "--ws-ports") {
+            std::stringstream list(next());
+            std::string port;
+            while (std::getline(list, port, ',')) {
+                opts.ws_ports.push_back(static_cast<unsigned short>(std::stoi(port)));
+            }
+        } else if (arg == "--clients") {
+            opts.clients = std::stoi(next());
+        } else if (arg == "--group-size") {
+            opts.group_size = std::stoi(next());
+        } else if (arg == "--rate") {
+            opts.rate = std::stod(next());
+        } else if (arg == "--private-ratio") {
+            opts.private_ratio = std::stod(next());
+        } else if (arg == "--size") {
+            opts.size = std::stoul(next());
+        } else if (arg == "--duration") {
+            opts.duration = std::stoi(next());
+        } else if (arg == "--warmup") {
+            opts.warmup = std::stoi(next());
+        } else if (arg == "--drain") {
+            opts.drain = std::stoi(next());
+        } else if (arg == "--threads") {
+            opts.threads = std::stoi(next());
+        } else if (arg == "--binary") {
+            opts.binary = true;
+        } else if (arg == "--user-prefix") {
+            opts.user_prefix = next();
+        } else if (arg == "--password") {
+            opts.password = next();
+        } else if (arg == "--server-pid") {
+            opts.server_pid = std::stoi(next());
+        } else if (arg == "--in-process") {
+            opts.in_process = next();
+        } else if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        } else {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+    if (opts.clients <= 0 || opts.rate <= 0 || opts.duration <= 0 || opts.threads <= 0) {
+        throw std::invalid_argument("clients, rate, duration and threads must be positive");
+    }
+    if (opts.user_prefix.empty()) {
+        // 默认每次使用新账号，避免与上次运行的房间混在一起
+        opts.user_prefix = "bench" + std::to_string(std::time(nullptr)) + "_";
+    }
+    return opts;
+}
+
+// 把[0, count)分给多个线程执行，准备阶段的注册和建房间都是同步HTTP请求
+template <typename F>
+void parallel_for(int count, int threads, F&& f) {
+    std::atomic<int> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min(threads, count); t++) {
+        workers.emplace_back([&] {
+            for (int i = next++; i < count; i = next++) {
+                f(i);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+u64 id_of(const json::value& jv) { return std::stoull(std::string(jv.as_string())); }
+
+std::vector<BenchUser> setup_users(const Options& opts) {
+    std::vector<BenchUser> users(opts.clients);
+    HttpClient client(opts.host, opts.port);
+
+    parallel_for(opts.clients, opts.threads, [&](int i) {
+        BenchUser& user = users[i];
+        user.username = opts.user_prefix + std::to_string(i);
+        try {
+            client.post("/api/register", json::object{{"username", user.username},
+                                                      {"password", opts.password},
+                                                      {"email", user.username + "@bench.local"},
+                                                      {"nickname", user.username}});
+        } catch (const std::exception&) {
+            // 复用账号时注册会失败，直接登录
+        }
+        json::value data = client.post(
+            "/api/login",
+            json::object{{"username", user.username}, {"password", opts.password}});
+        user.token = std::string(data.at("token").as_string());
+        user.id = id_of(data.at("user").at("id"));
+    });
+
+    // 私聊成对：(0,1) (2,3) ...
+    parallel_for(opts.clients / 2, opts.threads, [&](int pair) {
+        BenchUser& a = users[pair * 2];
+        BenchUser& b = users[pair * 2 + 1];
+        json::value data = client.post(
+            "/api/private_room", json::object{{"other_id", std::to_string(b.id)}}, a.token);
+        a.peer_id = b.id;
+        b.peer_id = a.id;
+        a.private_room_id = b.private_room_id = id_of(data.at("room_id"));
+    });
+
+    if (opts.group_size > 0) {
+        int groups = (opts.clients + opts.group_size - 1) / opts.group_size;
+        parallel_for(groups, opts.threads, [&](int g) {
+            int first = g * opts.group_size;
+            int last = std::min(opts.clients, first + opts.group_size);
+            const BenchUser& owner = users[first];
+            json::value data = client.post(
+                "/api/group_room",
+                json::object{{"name", opts.user_prefix + "group" + std::to_string(g)}},
+                owner.token);
+            u64 room_id = id_of(data.at("room_id"));
+            for (int i = first; i < last; i++) {
+                if (i != first) {
+                    client.post("/api/rooms/" + std::to_string(room_id) + "/member",
+                                json::object{{"invitee_id", std::to_string(users[i].id)}},
+                                owner.token);
+                }
+                users[i].group_room_id = room_id;
+            }
+        });
+    }
+    return users;
+}
+
+u64 now_ns() {
+    return static_cast<u64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+            .count());
+}
+
+// content以发送时间开头，接收方据此计算延迟，剩余部分填充到指定大小
+std::string make_content(std::size_t size) {
+    std::string content = std::to_string(now_ns()) + " ";
+    if (content.size() < size) {
+        content.append(size - content.size(), 'x');
+    }
+    return content;
+}
+
+void record_delivery(Stats& stats, std::string_view content) {
+    u64 sent_ns = 0;
+    auto [ptr, ec] = std::from_chars(content.data(), content.data() + content.size(), sent_ns);
+    if (ec != std::errc() || sent_ns == 0) {
+        return;
+    }
+    if (stats.measuring.load(std::memory_order_relaxed)) {
+        stats.received.add();
+        u64 now = now_ns();
+        stats.latency.record(now > sent_ns ? now - sent_ns : 0);
+    }
+}
+
+// 只统计别人发来的聊天消息，自己群发的回显和送达通知不计
+void on_frame(Stats& stats, const BenchUser& user, bool binary, std::string_view frame) {
+    if (binary) {
+        if (frame.empty()) {
+            return;
+        }
+        auto type = static_cast<tcs::utils::ServerRespType>(frame[0]);
+        if (type == tcs::utils::ServerRespType::PMsgToSend && frame.size() >= 9) {
+            record_delivery(stats, frame.substr(9));
+        } else if (type == tcs::utils::ServerRespType::GMsgToSend && frame.size() >= 17) {
+            u64 sender_id;
+            std::memcpy(&sender_id, frame.data() + 9, sizeof(sender_id));
+            if (boost::endian::little_to_native(sender_id) != user.id) {
+                record_delivery(stats, frame.substr(17));
+            }
+        }
+        return;
+    }
+
+    boost::system::error_code ec;
+    json::value jv = json::parse(frame, ec);
+    if (ec || !jv.is_object()) {
+        return;
+    }
+    const json::object& obj = jv.as_object();
+    const json::value* type = obj.if_contains("type");
+    const json::value* data = obj.if_contains("data");
+    if (!type || !data || !data->is_object()) {
+        return;
+    }
+    auto resp_type = static_cast<tcs::utils::ServerRespType>(type->to_number<int>());
+    const json::object& msg = data->as_object();
+    if (resp_type == tcs::utils::ServerRespType::GMsgToSend &&
+        id_of(msg.at("sender_id")) == user.id) {
+        return;
+    }
+    if (resp_type == tcs::utils::ServerRespType::PMsgToSend ||
+        resp_type == tcs::utils::ServerRespType::GMsgToSend) {
+        record_delivery(stats, msg.at("content").as_string());
+    }
+}
+
+std::string encode_message(const Options& opts, const BenchUser& user, bool private_msg) {
+    std::string content = make_content(opts.size);
+    if (opts.binary) {
+        if (private_msg) {
+            return WsCodec::encode_client(tcs::model::ClientPrivateMsg{
+                .room_id = user.private_room_id, .other_user_id = user.peer_id, .content = content});
+        }
+        return WsCodec::encode_client(
+            tcs::model::ClientGroupMsg{.room_id = user.group_room_id, .content = content});
+    }
+    if (private_msg) {
+        return json::serialize(json::object{
+            {"type", "private_message"},
+            {"data", json::object{{"room_id", std::to_string(user.private_room_id)},
+                                  {"other_user_id", std::to_string(user.peer_id)},
+                                  {"content", content}}}});
+    }
+    return json::serialize(
+        json::object{{"type", "group_message"},
+                     {"data", json::object{{"room_id", std::to_string(user.group_room_id)},
+                                           {"content", content}}}});
+}
+
+using Ws = websocket::stream<beast::tcp_stream>;
+
+net::awaitable<void> read_loop(std::shared_ptr<Ws> ws, const BenchUser& user, Stats& stats) {
+    beast::flat_buffer buffer;
+    try {
+        for (;;) {
+            co_await ws->async_read(buffer, net::use_awaitable);
+            std::string_view frame(static_cast<const char*>(buffer.data().data()),
+                                   buffer.size());
+            on_frame(stats, user, ws->got_binary(), frame);
+            buffer.consume(buffer.size());
+        }
+    } catch (const boost::system::system_error& e) {
+        if (e.code() != websocket::error::closed && e.code() != net::error::operation_aborted) {
+            stats.errors.add();
+        }
+    }
+}
+
+net::awaitable<void> run_client(const Options& opts, const BenchUser& user, std::size_t index,
+                                Stats& stats, Clock::time_point send_until,
+                                Clock::time_point close_at) {
+    auto executor = co_await net::this_coro::executor;
+    auto ws = std::make_shared<Ws>(executor);
+    unsigned short port =
+        opts.ws_ports.empty() ? opts.port : opts.ws_ports[index % opts.ws_ports.size()];
+    try {
+        tcp::resolver resolver(executor);
+        auto endpoints =
+            co_await resolver.async_resolve(opts.host, std::to_string(port), net::use_awaitable);
+        co_await beast::get_lowest_layer(*ws).async_connect(endpoints, net::use_awaitable);
+        beast::get_lowest_layer(*ws).expires_never();
+
+        ws->set_option(websocket::stream_base::decorator([&](websocket::request_type& req) {
+            req.set(http::field::authorization, user.token);
+            if (opts.binary) {
+                req.set(http::field::sec_websocket_protocol,
+                        std::string(WsCodec::BINARY_PROTOCOL));
+            }
+        }));
+        co_await ws->async_handshake(opts.host + ":" + std::to_string(port), "/ws",
+                                     net::use_awaitable);
+        ws->binary(opts.binary);
+        stats.connected++;
+    } catch (const std::exception& e) {
+        stats.errors.add();
+        std::cerr << "Client " << user.username << " failed to connect: " << e.what() << std::endl;
+        co_return;
+    }
+
+    net::co_spawn(executor, read_loop(ws, user, stats), net::detached);
+
+    bool can_private = user.peer_id != 0;
+    bool can_group = user.group_room_id != 0;
+    std::mt19937 rng(static_cast<unsigned>(index));
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+    // 客户端之间错开发送时间，避免整齐的突发
+    auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / opts.rate));
+    Clock::time_point next =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(interval * dist(rng));
+    net::steady_timer timer(executor);
+    try {
+        while (next < send_until && (can_private || can_group)) {
+            timer.expires_at(next);
+            co_await timer.async_wait(net::use_awaitable);
+            next += interval;
+
+            bool private_msg = can_private && (!can_group || dist(rng) < opts.private_ratio);
+            co_await ws->async_write(net::buffer(encode_message(opts, user, private_msg)),
+                                     net::use_awaitable);
+            if (stats.measuring.load(std::memory_order_relaxed)) {
+                stats.sent.add();
+            }
+        }
+        timer.expires_at(close_at);
+        co_await timer.async_wait(net::use_awaitable);
+        co_await ws->async_close(websocket::close_code::normal, net::use_awaitable);
+    } catch (const std::exception&) {
+        stats.errors.add();
+    }
+}
+
+// /proc/<pid>/stat 中的 utime + stime，单位为秒
+double process_cpu_seconds(int pid) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    // 第二个字段(进程名)可能带空格，从最后一个')'之后开始数
+    std::size_t pos = stat.rfind(')');
+    if (pos == std::string::npos) {
+        return 0;
+    }
+    std::istringstream fields(stat.substr(pos + 2));
+    std::string field;
+    double utime = 0;
+    double stime = 0;
+    // ')'之后第一个是第3个字段state，utime和stime是第14、15个
+    for (int i = 3; i <= 15 && fields >> field; i++) {
+        if (i == 14) utime = std::stod(field);
+        if (i == 15) stime = std::stod(field);
+    }
+    return (utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+double ms(u64 ns) { return static_cast<double>(ns) / 1e6; }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    try {
+        opts = parse_options(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        usage();
+        return 2;
+    }
+
+    std::unique_ptr<tcs::TinychatServer> server;
+    std::thread server_thread;
+    if (!opts.in_process.empty()) {
+        try {
+            tcs::utils::AppConfig::init(opts.in_process);
+            server = std::make_unique<tcs::TinychatServer>();
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to start in-process server: " << e.what() << std::endl;
+            return 1;
+        }
+        server_thread = std::thread([&server] { server->run(); });
+        const tcs::utils::AppConfig& config = tcs::utils::AppConfig::get();
+        opts.host = config.server().host();
+        opts.port = config.server().port();
+        // 服务器和客户端在同一进程，CPU占用包含客户端
+        opts.server_pid = static_cast<int>(getpid());
+        std::cout << "In-process server on " << opts.host << ":" << opts.port << ", "
+                  << config.database().engine() << " storage" << std::endl;
+    }
+    // 准备失败和正常结束都要停止内嵌的服务器
+    auto stop_server = [&] {
+        if (server) {
+            server->stop();
+            server_thread.join();
+        }
+    };
+
+    std::vector<BenchUser> users;
+    try {
+        auto start = Clock::now();
+        users = setup_users(opts);
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        std::cout << "Prepared " << users.size() << " users in " << elapsed.count() << " s"
+                  << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Setup failed: " << e.what() << std::endl;
+        stop_server();
+        return 1;
+    }
+
+    Stats stats;
+    net::io_context ioc(opts.threads);
+    auto measure_at = Clock::now() + std::chrono::seconds(opts.warmup);
+    auto send_until = measure_at + std::chrono::seconds(opts.duration);
+    auto close_at = send_until + std::chrono::seconds(opts.drain);
+
+    for (std::size_t i = 0; i < users.size(); i++) {
+        net::co_spawn(net::make_strand(ioc),
+                      run_client(opts, users[i], i, stats, send_until, close_at), net::detached);
+    }
+
+    // 预热结束开始计数，发送结束后停止计数CPU
+    double cpu_before = 0;
+    double cpu_after = 0;
+    net::steady_timer measure_timer(ioc, measure_at);
+    measure_timer.async_wait([&](beast::error_code) {
+        stats.measuring = true;
+        if (opts.server_pid) cpu_before = process_cpu_seconds(opts.server_pid);
+    });
+    net::steady_timer cpu_timer(ioc, send_until);
+    cpu_timer.async_wait([&](beast::error_code) {
+        if (opts.server_pid) cpu_after = process_cpu_seconds(opts.server_pid);
+    });
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < opts.threads; t++) {
+        threads.emplace_back([&ioc] { ioc.run(); });
+    }
+    ioc.run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    stop_server();
+
+    tcs::utils::Histogram::Snapshot latency = stats.latency.snapshot();
+    double seconds = opts.duration;
+    std::printf("tinychat_bench: %d clients (%d connected), %s, group size %d, %.0f%% private, %zu B\n",
+                opts.clients, stats.connected.load(), opts.binary ? "binary" : "json",
+                opts.group_size, opts.private_ratio * 100, opts.size);
+    std::printf("  sent        %llu msgs (%.1f/s)\n",
+                static_cast<unsigned long long>(stats.sent.value()), stats.sent.value() / seconds);
+    std::printf("  delivered   %llu msgs (%.1f/s)\n",
+                static_cast<unsigned long long>(stats.received.value()),
+                stats.received.value() / seconds);
+    std::printf("  latency     p50 %.3f ms  p99 %.3f ms  p999 %.3f ms  max %.3f ms\n",
+                ms(latency.quantile(0.5)), ms(latency.quantile(0.99)), ms(latency.quantile(0.999)),
+                ms(latency.quantile(1.0)));
+    if (opts.server_pid) {
+        double cores = (cpu_after - cpu_before) / seconds;
+        std::printf("  server CPU  %.2f cores (%.0f%%)%s\n", cores, cores * 100,
+                    server ? ", including clients" : "");
+    }
+    std::printf("  errors      %llu\n", static_cast<unsigned long long>(stats.errors.value()));
+    return stats.errors.value() == 0 ? 0 : 1;
+}
@@ -25,6 +25,8 @@ class MyProjectConan(ConanFile):
         self.requires("spdlog/1.15.3")
         self.requires("jwt-cpp/0.7.1")
         self.requires("libsodium/1.0.20")
+        self.requires("zlib/1.3.1")
+        self.requires("zstd/1.5.7")
         #self.requires("soci/4.0.3")
         #self.requires("mysql-connector-cpp/9.2.0")
 
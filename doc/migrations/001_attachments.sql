@@ -0,0 +1,12 @@
+-- 附件上传(POST /api/uploads)
+-- 同一用户的同一内容只有一条记录，文件按hash存放在doc_root/uploads/<hash前两位>/下，多个用户共享
+CREATE TABLE IF NOT EXISTS attachments (
+    id           BIGINT UNSIGNED NOT NULL PRIMARY KEY,
+    user_id      BIGINT UNSIGNED NOT NULL,
+    hash         CHAR(64)        NOT NULL,
+    size         BIGINT UNSIGNED NOT NULL,
+    content_type VARCHAR(128)    NOT NULL,
+    created_at   TIMESTAMP       NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    UNIQUE KEY uk_user_hash (user_id, hash),
+    KEY idx_hash (hash)
+);
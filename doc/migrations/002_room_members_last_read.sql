@@ -0,0 +1,9 @@
+-- 房间列表的未读数(GET /users/me/rooms)和标记已读(POST /api/rooms/{id}/read)
+-- 未读数统计 messages 中 room_id 相同且 id > last_read_message_id 的消息，依赖 messages(room_id, id) 上的索引
+ALTER TABLE room_members
+    ADD COLUMN last_read_message_id BIGINT UNSIGNED NOT NULL DEFAULT 0;
+
+-- 已有成员视为读到了当前最后一条消息，避免上线后所有历史消息都显示为未读
+UPDATE room_members rm
+JOIN rooms r ON r.id = rm.room_id
+SET rm.last_read_message_id = COALESCE(r.last_message_id, 0);
@@ -0,0 +1,39 @@
+#include "core/arena.hpp"
+
+namespace tcs {
+namespace core {
+ArenaPtr ArenaPool::acquire() {
+    RequestArena* arena = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!free_.empty()) {
+            arena = free_.back();
+            free_.pop_back();
+        }
+    }
+    if (arena == nullptr) {
+        arena = new RequestArena();
+    }
+    return ArenaPtr(arena);
+}
+
+void ArenaPool::recycle(RequestArena* arena) {
+    arena->reset();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_.size() < MAX_IDLE) {
+            free_.push_back(arena);
+            return;
+        }
+    }
+    delete arena;
+}
+
+ArenaPool::~ArenaPool() {
+    for (RequestArena* arena : free_) {
+        delete arena;
+    }
+}
+
+}  // namespace core
+}  // namespace tcs
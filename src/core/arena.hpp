@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <boost/intrusive_ptr.hpp>
+#include <boost/json.hpp>
+
+#include "utils/net_utils.hpp"
+
+namespace tcs {
+namespace core {
+// HTTP请求头(basic_fields)使用的分配器，指向请求所在的RequestArena
+using ArenaAllocator = std::pmr::polymorphic_allocator<char>;
+
+// 把std::pmr资源包装成boost::json的memory_resource，JSON DOM也分配在请求内存区上
+// 释放为空操作，内存随RequestArena整体回收
+class JsonArenaResource : public boost::json::memory_resource {
+public:
+    explicit JsonArenaResource(std::pmr::memory_resource* upstream) : upstream_(upstream) {}
+
+    std::pmr::memory_resource* upstream() const { return upstream_; }
+
+private:
+    std::pmr::memory_resource* upstream_;
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        return upstream_->allocate(bytes, align);
+    }
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const boost::json::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// 单个HTTP请求或WS消息使用的内存区
+// 请求头、JSON DOM、消息文本都从这里顺序分配，处理结束后整体归还ArenaPool
+class RequestArena {
+public:
+    // 首块缓冲区大小，覆盖绝大多数请求，超出部分才向堆申请
+    static constexpr std::size_t INITIAL_SIZE = 8 * 1024;
+
+    RequestArena()
+        : buffer_(std::make_unique<std::byte[]>(INITIAL_SIZE)),
+          resource_(buffer_.get(), INITIAL_SIZE, std::pmr::new_delete_resource()),
+          json_resource_(&resource_) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &resource_; }
+    ArenaAllocator allocator() { return ArenaAllocator(&resource_); }
+    boost::json::storage_ptr json_storage() { return boost::json::storage_ptr(&json_resource_); }
+
+    // 把缓冲序列拷贝进内存区，返回的视图在归还前有效
+    template <typename ConstBufferSequence>
+    std::string_view copy(const ConstBufferSequence& buffers) {
+        std::size_t size = net::buffer_size(buffers);
+        char* dst = static_cast<char*>(resource_.allocate(size, alignof(char)));
+        net::buffer_copy(net::buffer(dst, size), buffers);
+        return std::string_view(dst, size);
+    }
+
+    // 释放本次的全部分配，首块缓冲区保留复用
+    void reset() { resource_.release(); }
+
+private:
+    friend class ArenaPool;
+    friend void intrusive_ptr_add_ref(RequestArena* arena);
+    friend void intrusive_ptr_release(RequestArena* arena);
+
+    std::unique_ptr<std::byte[]> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+    JsonArenaResource json_resource_;
+    // 引用计数归零时归还ArenaPool，跨线程传递时不需要额外分配控制块
+    std::atomic<std::size_t> refs_{0};
+};
+
+using ArenaPtr = boost::intrusive_ptr<RequestArena>;
+
+// 空闲RequestArena的复用池，IO线程领取，工作线程处理完后归还
+class ArenaPool {
+public:
+    static ArenaPool& get() {
+        static ArenaPool instance;
+        return instance;
+    }
+
+    ArenaPtr acquire();
+
+    std::size_t idle() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return free_.size();
+    }
+
+private:
+    // 最多保留的空闲内存区，超出的直接释放
+    static constexpr std::size_t MAX_IDLE = 256;
+
+    ArenaPool() { free_.reserve(MAX_IDLE); }
+    ~ArenaPool();
+
+    friend void intrusive_ptr_release(RequestArena* arena);
+    void recycle(RequestArena* arena);
+
+    std::mutex mtx_;
+    std::vector<RequestArena*> free_;
+};
+
+inline void intrusive_ptr_add_ref(RequestArena* arena) {
+    arena->refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void intrusive_ptr_release(RequestArena* arena) {
+    if (arena->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ArenaPool::get().recycle(arena);
+    }
+}
+
+// 使用调用方提供的存储解析JSON，解析器的临时栈放在栈上
+inline boost::json::value parse_json(std::string_view text, boost::json::storage_ptr sp,
+                                     beast::error_code& ec) {
+    unsigned char parser_buf[512];
+    boost::json::stream_parser parser(boost::json::storage_ptr(), boost::json::parse_options(),
+                                      parser_buf, sizeof(parser_buf));
+    parser.reset(std::move(sp));
+    parser.write(text, ec);
+    if (!ec) {
+        parser.finish(ec);
+    }
+    if (ec) {
+        return nullptr;
+    }
+    return parser.release();
+}
+
+}  // namespace core
+}  // namespace tcs
+
+namespace boost {
+namespace json {
+template <>
+struct is_deallocate_trivial<tcs::core::JsonArenaResource> : std::true_type {};
+}  // namespace json
+}  // namespace boost
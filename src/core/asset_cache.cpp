@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/core/ignore_unused.hpp>
+#include <zlib.h>
+#include "spdlog/spdlog.h"
+
+#ifdef PLATFORM_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "core/asset_cache.hpp"
+#include "utils/compression.hpp"
+
+namespace fs = std::filesystem;
+
+namespace tcs {
+namespace core {
+// 扩展名 -> MIME类型
+static constexpr std::array<std::pair<std::string_view, std::string_view>, 25> MIME_TYPES = {{
+    {".htm", "text/html"},
+    {".html", "text/html"},
+    {".php", "text/html"},
+    {".css", "text/css"},
+    {".txt", "text/plain"},
+    {".js", "application/javascript"},
+    {".json", "application/json"},
+    {".xml", "application/xml"},
+    {".swf", "application/x-shockwave-flash"},
+    {".flv", "video/x-flv"},
+    {".png", "image/png"},
+    {".jpe", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".jpg", "image/jpeg"},
+    {".gif", "image/gif"},
+    {".bmp", "image/bmp"},
+    {".ico", "image/vnd.microsoft.icon"},
+    {".tiff", "image/tiff"},
+    {".tif", "image/tiff"},
+    {".svg", "image/svg+xml"},
+    {".svgz", "image/svg+xml"},
+    {".wasm", "application/wasm"},
+    {".webp", "image/webp"},
+    {".pdf", "application/pdf"},
+    {".zip", "application/zip"},
+}};
+
+static bool iequals(std::string_view a, std::string_view b) {
+    return beast::iequals(beast::string_view(a.data(), a.size()),
+                          beast::string_view(b.data(), b.size()));
+}
+
+// 已经压缩过的格式(图片、视频)再压缩没有收益
+static bool compressible(std::string_view mime) {
+    return mime.starts_with("text/") || mime == "application/javascript" ||
+           mime == "application/json" || mime == "application/xml" || mime == "image/svg+xml";
+}
+
+// 例：Thu, 01 Jan 1970 00:00:00 GMT
+static std::string http_date(std::chrono::system_clock::time_point tp) {
+    static constexpr const char* DAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static constexpr const char* MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                             "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    using namespace std::chrono;
+    auto secs = floor<seconds>(tp);
+    auto day = floor<days>(secs);
+    year_month_day ymd{day};
+    hh_mm_ss hms{secs - day};
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%s, %02u %s %04d %02d:%02d:%02d GMT",
+                  DAYS[weekday{day}.c_encoding()], unsigned(ymd.day()),
+                  MONTHS[unsigned(ymd.month()) - 1], int(ymd.year()), int(hms.hours().count()),
+                  int(hms.minutes().count()), int(hms.seconds().count()));
+    return buf;
+}
+
+static i64 now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static bool read_file(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    out.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(in);
+}
+
+static std::string gzip_compress(std::string_view data) {
+    z_stream zs{};
+    // 15 + 16: 带gzip头
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+    std::string out(deflateBound(&zs, static_cast<uLong>(data.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed");
+    }
+    return out;
+}
+
+Asset::~Asset() {
+#ifdef PLATFORM_LINUX
+    if (mapped != nullptr) {
+        munmap(mapped, mapped_size);
+    }
+#endif
+}
+
+std::string_view AssetCache::mime_type(std::string_view path) {
+    std::size_t pos = path.rfind('.');
+    if (pos == std::string_view::npos) {
+        return "application/octet-stream";
+    }
+    std::string_view ext = path.substr(pos);
+    for (const auto& [suffix, mime] : MIME_TYPES) {
+        if (iequals(ext, suffix)) {
+            return mime;
+        }
+    }
+    return "application/octet-stream";  // 默认的二进制流类型
+}
+
+std::string_view AssetCache::select(const Asset& asset, std::string_view accept_encoding,
+                                    std::string_view& encoding) {
+    if (!asset.br.empty() && utils::accepts_encoding(accept_encoding, "br")) {
+        encoding = "br";
+        return asset.br;
+    }
+    if (!asset.gzip.empty() && utils::accepts_encoding(accept_encoding, "gzip")) {
+        encoding = "gzip";
+        return asset.gzip;
+    }
+    encoding = {};
+    return asset.data;
+}
+
+void AssetCache::configure(const std::string& doc_root, std::size_t budget_bytes,
+                           std::size_t mmap_threshold, std::size_t stream_threshold) {
+    {
+        std::unique_lock lock(mtx_);
+        doc_root_ = doc_root;
+        budget_bytes_ = budget_bytes;
+        mmap_threshold_ = mmap_threshold;
+        stream_threshold_ = stream_threshold;
+        assets_.clear();
+        total_bytes_ = 0;
+    }
+
+#ifdef PLATFORM_LINUX
+    if (inotify_fd_ < 0) {
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0) {
+            spdlog::warn("inotify_init1 failed, asset cache will not be invalidated");
+            return;
+        }
+        watcher_ = std::thread(&AssetCache::watch_loop, this);
+    }
+#endif
+}
+
+std::shared_ptr<const Asset> AssetCache::find(std::string_view rel_path) {
+    {
+        std::shared_lock lock(mtx_);
+        auto it = assets_.find(rel_path);
+        if (it != assets_.end()) {
+            i64 now = now_ms();
+            if (now - it->second.last_used.load(std::memory_order_relaxed) >= TOUCH_INTERVAL_MS) {
+                it->second.last_used.store(now, std::memory_order_relaxed);
+            }
+            return it->second.asset;
+        }
+    }
+
+    std::string key(rel_path);
+    // 先监视目录再读文件，读取期间的修改一定会产生失效事件
+    watch(key);
+    u64 generation = generation_.load(std::memory_order_acquire);
+    std::shared_ptr<const Asset> asset = load(key);
+    if (!asset) {
+        return nullptr;
+    }
+
+    if (asset->memory_bytes() > budget_bytes_) {
+        // 怎么淘汰都放不下，只缓存元数据，之后从磁盘发送，不再每次读入和压缩
+        auto streamed = std::make_shared<Asset>();
+        streamed->mime = asset->mime;
+        streamed->etag = asset->etag;
+        streamed->last_modified = asset->last_modified;
+        streamed->size = asset->size;
+        streamed->path = asset->path;
+        streamed->streamed = true;
+        spdlog::debug("Asset {} exceeds the cache budget, will be streamed from disk", key);
+        asset = std::move(streamed);
+    }
+
+    std::unique_lock lock(mtx_);
+    if (generation_.load(std::memory_order_relaxed) != generation) {
+        spdlog::debug("Asset {} changed while loading, serving it uncached", key);
+        return asset;
+    }
+    auto [it, inserted] = assets_.try_emplace(key);
+    if (!inserted) {
+        // 其他线程已经加载过
+        return it->second.asset;
+    }
+    std::size_t bytes = asset->memory_bytes();
+    if (total_bytes_ + bytes > budget_bytes_) {
+        evict(bytes);
+    }
+    it->second.asset = asset;
+    it->second.last_used.store(now_ms(), std::memory_order_relaxed);
+    total_bytes_ += bytes;
+    return asset;
+}
+
+std::shared_ptr<const Asset> AssetCache::load(const std::string& rel_path) {
+    fs::path full_path = fs::path(doc_root_) / fs::path(rel_path);
+
+    std::error_code ec;
+    if (!fs::is_regular_file(full_path, ec)) {
+        return nullptr;
+    }
+    std::size_t size = fs::file_size(full_path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    auto mtime = std::chrono::file_clock::to_sys(fs::last_write_time(full_path, ec));
+    if (ec) {
+        return nullptr;
+    }
+
+    auto asset = std::make_shared<Asset>();
+    asset->mime = mime_type(rel_path);
+    auto mtime_secs =
+        std::chrono::duration_cast<std::chrono::seconds>(mtime.time_since_epoch()).count();
+    char etag[48];
+    std::snprintf(etag, sizeof(etag), "\"%llx-%zx\"", static_cast<unsigned long long>(mtime_secs),
+                  size);
+    asset->etag = etag;
+    asset->last_modified = http_date(mtime);
+    asset->size = size;
+    asset->path = full_path.string();
+
+    if (size >= stream_threshold_) {
+        asset->streamed = true;
+        spdlog::debug("Asset {} ({} bytes) will be streamed from disk", rel_path, size);
+        return asset;
+    }
+
+#ifdef PLATFORM_LINUX
+    if (size >= mmap_threshold_) {
+        int fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open asset file: " + full_path.string());
+        }
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Failed to mmap asset file: " + full_path.string());
+        }
+        asset->mapped = addr;
+        asset->mapped_size = size;
+        asset->data = std::string_view(static_cast<const char*>(addr), size);
+    }
+#endif
+    if (asset->mapped == nullptr) {
+        if (!read_file(full_path, asset->memory)) {
+            throw std::runtime_error("Failed to read asset file: " + full_path.string());
+        }
+        asset->data = asset->memory;
+    }
+
+    // 构建时生成的.br/.gz优先，否则按需gzip
+    fs::path br_path = full_path;
+    br_path += ".br";
+    if (fs::is_regular_file(br_path, ec)) {
+        read_file(br_path, asset->br);
+    }
+    fs::path gz_path = full_path;
+    gz_path += ".gz";
+    if (fs::is_regular_file(gz_path, ec)) {
+        read_file(gz_path, asset->gzip);
+    } else if (compressible(asset->mime) && size >= GZIP_MIN_BYTES) {
+        asset->gzip = gzip_compress(asset->data);
+        // 压缩率不到10%不值得
+        if (asset->gzip.size() * 10 > size * 9) {
+            asset->gzip.clear();
+            asset->gzip.shrink_to_fit();
+        }
+    }
+
+    spdlog::debug("Loaded asset {} ({} bytes, gzip {}, br {}, {})", rel_path, size,
+                  asset->gzip.size(), asset->br.size(), asset->mapped ? "mmap" : "memory");
+    return asset;
+}
+
+void AssetCache::evict(std::size_t need) {
+    // 多腾出1/8的预算，避免接下来每次插入都要排序
+    std::size_t target = budget_bytes_ - std::min(budget_bytes_, need + budget_bytes_ / 8);
+    std::vector<std::pair<i64, decltype(assets_)::iterator>> candidates;
+    for (auto it = assets_.begin(); it != assets_.end(); ++it) {
+        // 正在插入的条目还没有内容，元数据条目不占预算
+        if (it->second.asset && it->second.asset->memory_bytes() > 0) {
+            candidates.emplace_back(it->second.last_used.load(std::memory_order_relaxed), it);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::size_t evicted = 0;
+    for (const auto& [last_used, it] : candidates) {
+        if (total_bytes_ <= target) {
+            break;
+        }
+        total_bytes_ -= it->second.asset->memory_bytes();
+        assets_.erase(it);
+        evicted++;
+    }
+    spdlog::debug("Asset cache evicted {} assets, {} bytes in use", evicted, total_bytes_);
+}
+
+void AssetCache::invalidate(const std::string& rel_path) {
+    std::unique_lock lock(mtx_);
+    // 文件可能正在被加载，还不在表中
+    generation_.fetch_add(1, std::memory_order_release);
+    auto it = assets_.find(rel_path);
+    if (it == assets_.end()) {
+        return;
+    }
+    total_bytes_ -= it->second.asset->memory_bytes();
+    assets_.erase(it);
+    spdlog::debug("Asset {} invalidated", rel_path);
+}
+
+void AssetCache::clear() {
+    std::unique_lock lock(mtx_);
+    generation_.fetch_add(1, std::memory_order_release);
+    assets_.clear();
+    total_bytes_ = 0;
+}
+
+void AssetCache::watch(const std::string& rel_path) {
+#ifdef PLATFORM_LINUX
+    if (inotify_fd_ < 0) {
+        return;
+    }
+    std::size_t slash = rel_path.rfind('/');
+    std::string dir = slash == std::string::npos ? std::string() : rel_path.substr(0, slash + 1);
+
+    std::unique_lock lock(mtx_);
+    for (const auto& [wd, watched] : watched_dirs_) {
+        if (watched == dir) {
+            return;
+        }
+    }
+    fs::path full_dir = fs::path(doc_root_) / fs::path(dir);
+    // 在文件加载之前调用，目录不存在时请求本身就是404
+    std::error_code ec;
+    if (!fs::is_directory(full_dir, ec)) {
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd_, full_dir.c_str(),
+                               IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                   IN_MOVED_FROM | IN_MOVED_TO);
+    if (wd < 0) {
+        spdlog::warn("Failed to watch asset directory {}", full_dir.string());
+        return;
+    }
+    watched_dirs_[wd] = dir;
+#else
+    boost::ignore_unused(rel_path);
+#endif
+}
+
+void AssetCache::watch_loop() {
+#ifdef PLATFORM_LINUX
+    alignas(inotify_event) char buf[4096];
+    while (!stop_.load(std::memory_order_relaxed)) {
+        pollfd pfd{.fd = inotify_fd_, .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+        ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+        if (len <= 0) {
+            continue;
+        }
+        for (char* p = buf; p < buf + len;) {
+            auto* event = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                spdlog::warn("inotify queue overflow, dropping all cached assets");
+                clear();
+                continue;
+            }
+
+            std::string dir;
+            {
+                std::unique_lock lock(mtx_);
+                auto it = watched_dirs_.find(event->wd);
+                if (it == watched_dirs_.end()) {
+                    continue;
+                }
+                dir = it->second;
+                if (event->mask & IN_IGNORED) {
+                    watched_dirs_.erase(it);
+                }
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            std::string rel_path = dir + event->name;
+            invalidate(rel_path);
+            // 预压缩文件变化时，原文件的缓存也要失效
+            if (rel_path.ends_with(".gz") || rel_path.ends_with(".br")) {
+                invalidate(rel_path.substr(0, rel_path.size() - 3));
+            }
+        }
+    }
+#endif
+}
+
+AssetCache::~AssetCache() {
+#ifdef PLATFORM_LINUX
+    stop_.store(true, std::memory_order_relaxed);
+    if (watcher_.joinable()) {
+        watcher_.join();
+    }
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+    }
+#endif
+}
+
+}  // namespace core
+}  // namespace tcs
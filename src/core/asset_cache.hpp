@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/optional.hpp>
+
+#include "utils/net_utils.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 缓存中的一个静态文件，加载后只读
+// 小文件读入内存，大文件mmap，另外保存预压缩版本和校验头
+// 超大文件(streamed)只缓存元数据，正文每次从磁盘发送
+struct Asset {
+    std::string_view mime;
+    std::string etag;
+    std::string last_modified;
+    std::size_t size = 0;
+    bool streamed = false;
+    // 完整路径，streamed时用于打开文件
+    std::string path;
+
+    // 原始内容，指向memory或映射区域
+    std::string_view data;
+    std::string memory;
+    // 预压缩版本，为空表示不提供
+    std::string gzip;
+    std::string br;
+
+    void* mapped = nullptr;
+    std::size_t mapped_size = 0;
+
+    Asset() = default;
+    Asset(const Asset&) = delete;
+    Asset& operator=(const Asset&) = delete;
+    ~Asset();
+
+    // 加载后在内存中的字节数，用于预算统计(mmap部分不计)
+    std::size_t memory_bytes() const { return memory.size() + gzip.size() + br.size(); }
+};
+
+// 直接发送缓存内容的响应体，持有Asset保证发送期间内容有效
+struct AssetBody {
+    struct value_type {
+        std::shared_ptr<const Asset> asset;
+        std::string_view data;
+    };
+
+    static std::uint64_t size(const value_type& body) { return body.data.size(); }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body) : body_(body) {}
+
+        void init(beast::error_code& ec) { ec = {}; }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            return {{net::const_buffer(body_.data.data(), body_.data.size()), false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+// /assets 下静态文件的缓存
+// 命中时只查一次哈希表，不访问文件系统；Linux上由inotify负责失效
+// 超出预算时按最近使用时间淘汰，单个超过整个预算的文件退化为streamed只缓存元数据
+class AssetCache {
+public:
+    static AssetCache& get() {
+        static AssetCache instance;
+        return instance;
+    }
+
+    void configure(const std::string& doc_root, std::size_t budget_bytes,
+                   std::size_t mmap_threshold, std::size_t stream_threshold);
+
+    // rel_path为doc_root下的相对路径，文件不存在时返回nullptr
+    std::shared_ptr<const Asset> find(std::string_view rel_path);
+
+    // 按Accept-Encoding选择要发送的版本，encoding为空表示原始内容
+    static std::string_view select(const Asset& asset, std::string_view accept_encoding,
+                                   std::string_view& encoding);
+
+    static std::string_view mime_type(std::string_view path);
+
+    void invalidate(const std::string& rel_path);
+    void clear();
+
+private:
+    AssetCache() {}
+    ~AssetCache();
+
+    // 小于该值或压缩后不够小的文件不保存gzip版本
+    static constexpr std::size_t GZIP_MIN_BYTES = 1024;
+
+    std::shared_ptr<const Asset> load(const std::string& rel_path);
+    // 持有写锁时调用，淘汰最久未使用的条目直到能放下need字节
+    void evict(std::size_t need);
+    void watch(const std::string& rel_path);
+    void watch_loop();
+
+    std::string doc_root_;
+    std::size_t budget_bytes_ = 32 * 1024 * 1024;
+    std::size_t mmap_threshold_ = 256 * 1024;
+    std::size_t stream_threshold_ = 8 * 1024 * 1024;
+
+    // 支持用string_view直接查找，命中时不构造std::string
+    struct PathHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view path) const {
+            return std::hash<std::string_view>{}(path);
+        }
+    };
+
+    struct Entry {
+        std::shared_ptr<const Asset> asset;
+        // 最近一次命中的时间(毫秒)，读锁下更新，只用于淘汰时排序
+        std::atomic<i64> last_used{0};
+    };
+
+    // 命中时按秒粒度更新last_used，避免热点文件每次命中都写同一缓存行
+    static constexpr i64 TOUCH_INTERVAL_MS = 1000;
+
+    std::shared_mutex mtx_;
+    std::unordered_map<std::string, Entry, PathHash, std::equal_to<>> assets_;
+    std::size_t total_bytes_ = 0;
+    // 每次失效加一；加载期间变化过的结果不放入缓存，避免失效事件早于插入而留下旧内容
+    std::atomic<u64> generation_{0};
+
+#ifdef PLATFORM_LINUX
+    int inotify_fd_ = -1;
+    // 监视描述符 -> 目录的相对路径(以'/'结尾，根目录为空)
+    std::unordered_map<int, std::string> watched_dirs_;
+    std::thread watcher_;
+    std::atomic<bool> stop_{false};
+#endif
+};
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,22 @@
+#include <spdlog/spdlog.h>
+
+#include "core/cluster_bus.hpp"
+#include "core/tcp_cluster_bus.hpp"
+
+namespace tcs {
+namespace core {
+std::unique_ptr<ClusterBus> ClusterBus::instance_ptr_ = nullptr;
+
+void ClusterBus::init(u64 node_id, const std::string& host, unsigned short port,
+                      const std::string& peers, Handlers handlers) {
+    if (instance_ptr_) {
+        throw std::runtime_error("ClusterBus has already been initialized.");
+    }
+    std::vector<tcp::endpoint> endpoints = TcpClusterBus::parse_peers(peers);
+    instance_ptr_ = std::make_unique<TcpClusterBus>(
+        node_id, tcp::endpoint(net::ip::make_address(host), port), endpoints, std::move(handlers));
+    spdlog::info("Cluster bus of node {} listening on {}:{}, {} peers", node_id, host, port,
+                 endpoints.size());
+}
+}  // namespace core
+}  // namespace tcs
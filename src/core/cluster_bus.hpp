@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/ws_codec.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 一个用户在某个节点上的上线或下线
+// 版本号是节点产生变化时取的雪花id，同一节点的变化版本号递增
+struct PresenceUpdate {
+    u64 user_id;
+    u64 version;
+    bool online;
+};
+
+// 需要同步到其他节点房间缓存(RoomCache、RoomSummaryCache)的变化，见RoomEvents
+struct RoomEvent {
+    enum class Type : std::uint8_t {
+        // user_id发送的message_id，带content
+        Message = 1,
+        // user_id加入房间
+        MemberAdded = 2,
+        RoomDeleted = 3,
+        // user_id的房间列表变化(创建了房间)，room_id不用
+        RoomsChanged = 4,
+        // user_id读到message_id
+        Read = 5,
+        // 房间中一条已写入缓存的消息被撤回
+        MessageRetracted = 6,
+    };
+
+    Type type;
+    u64 room_id = 0;
+    u64 user_id = 0;
+    u64 message_id = 0;
+    std::string content;
+};
+
+// 节点间的投递总线：一个节点上找不到的会话，交给它所在的节点投递给本地的会话
+// 节点id即雪花id的service_id
+class ClusterBus {
+public:
+    // 回调都在总线线程上调用
+    struct Handlers {
+        // 收到对端的投递，只投递给本节点的会话
+        std::function<void(const std::vector<u64>& user_ids, const WsPayload& payload,
+                           u64 msg_id)>
+            deliver;
+        // 对端的在线状态变化，replace为true时替换该节点之前的全部条目
+        std::function<void(u64 node_id, const std::vector<PresenceUpdate>& updates,
+                           bool replace)>
+            presence;
+        // 对端的房间缓存变化
+        std::function<void(const RoomEvent& event)> room_event;
+        // 对端连进来，之前断开期间它的变化可能没有收到
+        std::function<void(u64 node_id)> node_up;
+        // 对端连进来的连接断开，它的在线状态不再可信
+        std::function<void(u64 node_id)> node_down;
+        // 连上对端时先发给它的全量在线状态
+        std::function<std::vector<PresenceUpdate>()> snapshot;
+    };
+
+    static bool enabled() { return instance_ptr_ != nullptr; }
+
+    static ClusterBus& get() {
+        if (!instance_ptr_) {
+            throw std::runtime_error("ClusterBus has not been initialized. Call init() first.");
+        }
+        return *instance_ptr_;
+    }
+
+    // 在本节点的port上监听，并连接peers中的每个对端("host:port,host:port")
+    static void init(u64 node_id, const std::string& host, unsigned short port,
+                     const std::string& peers, Handlers handlers);
+
+    static void shutdown() { instance_ptr_.reset(); }
+
+    virtual ~ClusterBus() = default;
+
+    // 发给node_id节点上的用户，同一时间发往同一节点的多次发送合并成一次写
+    // 该节点未连接或积压过多时丢弃并返回false
+    virtual bool send(u64 node_id, const std::vector<u64>& user_ids, const WsPayload& payload,
+                      u64 msg_id) = 0;
+
+    // 本节点的在线状态变化，发给所有已连接的对端
+    virtual void publish_presence(const std::vector<PresenceUpdate>& updates) = 0;
+
+    // 本节点的房间缓存变化，发给所有已连接的对端
+    virtual void publish_room_event(const RoomEvent& event) = 0;
+
+private:
+    static std::unique_ptr<ClusterBus> instance_ptr_;
+};
+}  // namespace core
+}  // namespace tcs
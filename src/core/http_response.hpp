@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+
+#ifdef PLATFORM_LINUX
+#include <unistd.h>
+#endif
+
+#include "utils/net_utils.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 响应头之后由HttpSession用sendfile直接从文件发送的区间
+struct FileTransfer {
+    int fd = -1;
+    u64 offset = 0;
+    u64 remaining = 0;
+
+    FileTransfer() = default;
+    FileTransfer(const FileTransfer&) = delete;
+    FileTransfer& operator=(const FileTransfer&) = delete;
+
+    ~FileTransfer() {
+#ifdef PLATFORM_LINUX
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+};
+
+// 工作线程交回IO线程的响应
+// file不为空时，msg只包含响应头(Content-Length已设置)，正文由sendfile发送
+struct HttpResponse {
+    http::message_generator msg;
+    std::unique_ptr<FileTransfer> file;
+
+    HttpResponse(http::message_generator&& m) : msg(std::move(m)) {}
+    HttpResponse(http::message_generator&& m, std::unique_ptr<FileTransfer> f)
+        : msg(std::move(m)), file(std::move(f)) {}
+};
+}  // namespace core
+}  // namespace tcs
@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <memory>
 
+#ifdef PLATFORM_LINUX
+#include <cerrno>
+#include <sys/sendfile.h>
+#endif
+
 #include <boost/beast/websocket.hpp>
 #include "core/http_session.hpp"
 #include "spdlog/spdlog.h"
@@ -9,6 +16,7 @@
 #include "core/websocket_session.hpp"
 #include "pool/thread_pool.hpp"
 #include "utils/config.hpp"
+#include "utils/metrics.hpp"
 
 namespace websocket = boost::beast::websocket;
 
@@ -19,11 +27,21 @@ namespace tcs {
 namespace core {
 HttpSession::HttpSession(tcp::socket socket, std::shared_ptr<std::string const> const& doc_root)
     : stream_(std::move(socket)), doc_root_(doc_root) {
+    utils::Metrics::get().http_sessions.add(1);
     spdlog::debug("Session created on {}:{}",
                   stream_.socket().remote_endpoint().address().to_string(),
                   stream_.socket().remote_endpoint().port());
 }
 
+HttpSession::~HttpSession() {
+    utils::Metrics::get().http_sessions.add(-1);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - created_at_)
+                       .count();
+    spdlog::debug("HttpSession closed after {} ms: {} bytes in, {} bytes out ({} via sendfile)",
+                  elapsed, bytes_read_, bytes_written_, bytes_sendfile_);
+}
+
 void HttpSession::run() {
     net::dispatch(stream_.get_executor(),
                   beast::bind_front_handler(&HttpSession::do_read, shared_from_this()));
@@ -32,8 +50,14 @@ void HttpSession::run() {
 void HttpSession::do_read() {
     // Make the request empty before reading,
     // otherwise the operation behavior is undefined.
-    parser_.emplace();
-    parser_->body_limit(10000);
+    // 解析器的请求头分配在旧内存区上，必须先于arena_替换销毁
+    upload_parser_.reset();
+    parser_.reset();
+    header_parser_.reset();
+    // 上一个请求的内存区已随任务交给工作线程，这里换一块新的
+    arena_ = ArenaPool::get().acquire();
+    header_parser_.emplace(std::piecewise_construct, std::make_tuple(),
+                           std::make_tuple(arena_->allocator()));
 
     // Set the timeout.
     stream_.expires_after(std::chrono::seconds(30));
@@ -44,12 +68,49 @@ void HttpSession::do_read() {
         return;
     }
 
+    http::async_read_header(
+        stream_, buffer_, *header_parser_,
+        beast::bind_front_handler(&HttpSession::on_read_header, shared_from_this()));
+}
+
+void HttpSession::on_read_header(beast::error_code ec, std::size_t bytes_transferred) {
+    bytes_read_ += bytes_transferred;
+    utils::Metrics::get().http_bytes_in.add(bytes_transferred);
+
+    if (ec == http::error::end_of_stream) {
+        return do_close();
+    }
+
+    if (ec) {
+        spdlog::error("Failed on_read_header: {}", ec.message());
+        return;
+    }
+
+    auto& header = header_parser_->get();
+    if (websocket::is_upgrade(header)) {
+        // HTTP IO循环结束，开始Websocket IO循环
+        auto ws_session_ptr = std::make_shared<WebsocketSession>(stream_.release_socket());
+        ws_session_ptr->do_accept(header_parser_->release());
+
+        return;
+    }
+
+    if (UploadHandler::is_upload(header.method(),
+                                 std::string_view(header.target().data(), header.target().size()))) {
+        return start_upload();
+    }
+
+    // 普通请求，正文整体读入内存
+    parser_.emplace(std::move(*header_parser_));
+    parser_->body_limit(AppConfig::get().server().http_body_limit_kb() * 1024);
+
     http::async_read(stream_, buffer_, *parser_,
                      beast::bind_front_handler(&HttpSession::on_read, shared_from_this()));
 }
 
 void HttpSession::on_read(beast::error_code ec, std::size_t bytes_transferred) {
-    boost::ignore_unused(bytes_transferred);
+    bytes_read_ += bytes_transferred;
+    utils::Metrics::get().http_bytes_in.add(bytes_transferred);
 
     if (ec == http::error::end_of_stream) {
         return do_close();
@@ -60,32 +121,150 @@ void HttpSession::on_read(beast::error_code ec, std::size_t bytes_transferred) {
         return;
     }
 
-    if (websocket::is_upgrade(parser_->get())) {
-        // HTTP IO循环结束，开始Websocket IO循环
-        auto ws_session_ptr = std::make_shared<WebsocketSession>(stream_.release_socket());
-        ws_session_ptr->do_accept(parser_->release());
+    ++inflight_requests_;
+
+    // 2. 将“处理这个请求”作为一个任务，提交给工作线程池。
+    //    我们使用 lambda 来捕获所有需要的信息。
+    //    请求直接移动进任务，内存区随任务一起销毁后整体归还
+    pool::ThreadPool::get().addTask(
+        [this, self = shared_from_this(),
+         pending = PendingRequest{std::move(arena_), parser_->release()}]() mutable {
+            HttpResponse response =
+                RequestHandler::handle_request(*doc_root_, std::move(pending.req));
+
+            // c. 【关键】业务处理完成，但我们不能在这里直接发送响应！
+            //    因为网络写操作必须在属于这个 session 的 I/O 线程 (strand) 上执行。
+            //    所以，我们需要把生成的响应再“投递”回 I/O 线程。
+            this->queue_response_from_worker(std::move(response));
+        });
+}
+
+void HttpSession::start_upload() {
+    auto& header = header_parser_->get();
+    u64 max_size = AppConfig::get().server().upload_max_mb() * 1024 * 1024;
+
+    // 正文开始读取之前完成鉴权和大小检查，被拒绝的上传不会写盘
+    auto authorization = header[http::field::authorization];
+    std::optional<UserClaims> claims =
+        UploadHandler::authenticate(std::string_view(authorization.data(), authorization.size()));
+    if (!claims) {
+        return reject_upload(http::status::unauthorized, StatusCode::Unauthorized,
+                             " Missing or invalid authorization token");
+    }
+    if (header_parser_->content_length() && *header_parser_->content_length() > max_size) {
+        return reject_upload(http::status::payload_too_large, StatusCode::PayloadTooLarge,
+                             " Upload too large");
+    }
+
+    try {
+        auto content_type = header[http::field::content_type];
+        upload_sink_ = std::make_shared<UploadSink>(
+            claims->id, std::string_view(content_type.data(), content_type.size()),
+            AppConfig::get().server().doc_root());
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to start upload: {}", e.what());
+        return reject_upload(http::status::internal_server_error, StatusCode::UploadFailed,
+                             " Upload failed");
+    }
+
+    bool expect_continue = beast::iequals(header[http::field::expect], "100-continue");
+
+    upload_parser_.emplace(std::move(*header_parser_));
+    // 没有Content-Length的chunked上传由body_limit兜底
+    upload_parser_->body_limit(max_size);
+    upload_buf_ = std::make_unique<char[]>(UPLOAD_CHUNK);
 
+    if (!expect_continue) {
+        return do_read_upload();
+    }
+
+    // 客户端在等100 Continue，收到后才发送正文
+    auto res = std::make_shared<http::response<http::empty_body>>(
+        http::status::continue_, upload_parser_->get().version());
+    http::async_write(stream_, *res,
+                      [self = shared_from_this(), res](beast::error_code ec, std::size_t bytes) {
+                          self->bytes_written_ += bytes;
+                          utils::Metrics::get().http_bytes_out.add(bytes);
+                          if (ec) {
+                              spdlog::error("Failed to send 100 Continue: {}", ec.message());
+                              return;
+                          }
+                          self->do_read_upload();
+                      });
+}
+
+void HttpSession::do_read_upload() {
+    auto& body = upload_parser_->get().body();
+    body.data = upload_buf_.get();
+    body.size = UPLOAD_CHUNK;
+
+    stream_.expires_after(std::chrono::seconds(30));
+
+    http::async_read(stream_, buffer_, *upload_parser_,
+                     beast::bind_front_handler(&HttpSession::on_read_upload, shared_from_this()));
+}
+
+void HttpSession::on_read_upload(beast::error_code ec, std::size_t bytes_transferred) {
+    bytes_read_ += bytes_transferred;
+    utils::Metrics::get().http_bytes_in.add(bytes_transferred);
+
+    // 缓冲区已满，写盘后继续读
+    if (ec == http::error::need_buffer) {
+        ec = {};
+    }
+
+    if (ec == http::error::body_limit) {
+        return reject_upload(http::status::payload_too_large, StatusCode::PayloadTooLarge,
+                             " Upload too large");
+    }
+
+    if (ec) {
+        spdlog::error("Failed on_read_upload: {}", ec.message());
+        upload_sink_.reset();
+        upload_buf_.reset();
         return;
     }
 
+    std::size_t chunk = UPLOAD_CHUNK - upload_parser_->get().body().size;
+    if (chunk > 0) {
+        try {
+            upload_sink_->write(upload_buf_.get(), chunk);
+        } catch (const std::exception& e) {
+            spdlog::error("Failed to write upload chunk: {}", e.what());
+            return reject_upload(http::status::internal_server_error, StatusCode::UploadFailed,
+                                 " Upload failed");
+        }
+    }
+
+    if (!upload_parser_->is_done()) {
+        return do_read_upload();
+    }
+
     ++inflight_requests_;
+    upload_buf_.reset();
 
-    auto req_ptr = std::make_shared<http::request<http::string_body>>(parser_->release());
+    unsigned version = upload_parser_->get().version();
+    bool keep_alive = upload_parser_->get().keep_alive();
 
-    // 2. 将“处理这个请求”作为一个任务，提交给工作线程池。
-    //    我们使用 lambda 来捕获所有需要的信息。
-    pool::ThreadPool::get().addTask([this, self = shared_from_this(), req_ptr] {
-        http::message_generator response =
-            RequestHandler::handle_request(*doc_root_, std::move(*req_ptr));
+    // 查重、配额和数据库写入在工作线程中完成
+    pool::ThreadPool::get().addTask(
+        [this, self = shared_from_this(), sink = std::move(upload_sink_), version, keep_alive] {
+            this->queue_response_from_worker(UploadHandler::finish(*sink, version, keep_alive));
+        });
+}
 
-        // c. 【关键】业务处理完成，但我们不能在这里直接发送响应！
-        //    因为网络写操作必须在属于这个 session 的 I/O 线程 (strand) 上执行。
-        //    所以，我们需要把生成的响应再“投递”回 I/O 线程。
-        this->queue_response_from_worker(std::move(response));
-    });
+void HttpSession::reject_upload(http::status status, StatusCode code, const std::string& msg) {
+    unsigned version = upload_parser_ ? upload_parser_->get().version()
+                                      : header_parser_->get().version();
+    upload_sink_.reset();
+    upload_buf_.reset();
+
+    ++inflight_requests_;
+    queue_write(HttpResponse(
+        http::message_generator(UploadHandler::error(version, false, status, code, msg))));
 }
 
-void HttpSession::queue_write(http::message_generator&& response) {
+void HttpSession::queue_write(HttpResponse&& response) {
     response_queue_.push(std::move(response));
     if (response_queue_.size() == 1) {
         do_write();
@@ -105,9 +284,9 @@ void HttpSession::do_close() {
 
 void HttpSession::do_write() {
     if (!response_queue_.empty()) {
-        bool keep_alive = response_queue_.front().keep_alive();
+        bool keep_alive = response_queue_.front().msg.keep_alive();
         beast::async_write(
-            stream_, std::move(response_queue_.front()),
+            stream_, std::move(response_queue_.front().msg),
             beast::bind_front_handler(&HttpSession::on_write, shared_from_this(), keep_alive));
     }
 }
@@ -121,7 +300,7 @@ void HttpSession::send_response(http::message_generator&& msg) {
         beast::bind_front_handler(&HttpSession::on_write, shared_from_this(), keep_alive));
 }
 
-void HttpSession::queue_response_from_worker(http::message_generator&& response) {
+void HttpSession::queue_response_from_worker(HttpResponse&& response) {
     net::post(
         stream_.get_executor(),
         beast::bind_front_handler(&HttpSession::queue_write,  // 调用我们已有的 queue_write 方法
@@ -129,13 +308,85 @@ void HttpSession::queue_response_from_worker(http::message_generator&& response)
 }
 
 void HttpSession::on_write(bool keep_alive, beast::error_code ec, std::size_t bytes_transferred) {
-    boost::ignore_unused(bytes_transferred);
+    bytes_written_ += bytes_transferred;
+    utils::Metrics::get().http_bytes_out.add(bytes_transferred);
 
     if (ec) {
         spdlog::error("Failed on_write: {}", ec.message());
         return;
     }
 
+    if (response_queue_.front().file) {
+        return do_sendfile(keep_alive);
+    }
+
+    finish_write(keep_alive);
+}
+
+void HttpSession::do_sendfile(bool keep_alive) {
+#ifdef PLATFORM_LINUX
+    FileTransfer& file = *response_queue_.front().file;
+    tcp::socket& socket = stream_.socket();
+
+    beast::error_code ec;
+    if (!socket.native_non_blocking()) {
+        socket.native_non_blocking(true, ec);
+        if (ec) {
+            spdlog::error("Failed to set socket non-blocking for sendfile: {}", ec.message());
+            return do_close();
+        }
+    }
+
+    std::size_t turn_bytes = 0;
+    while (file.remaining > 0) {
+        if (turn_bytes >= SENDFILE_TURN_BYTES) {
+            // 让出IO线程，稍后继续
+            return net::post(stream_.get_executor(),
+                             beast::bind_front_handler(&HttpSession::do_sendfile,
+                                                       shared_from_this(), keep_alive));
+        }
+
+        off_t offset = static_cast<off_t>(file.offset);
+        std::size_t count = std::min<u64>(file.remaining, SENDFILE_CHUNK);
+        ssize_t n = ::sendfile(socket.native_handle(), file.fd, &offset, count);
+        if (n > 0) {
+            file.offset += static_cast<u64>(n);
+            file.remaining -= static_cast<u64>(n);
+            turn_bytes += static_cast<std::size_t>(n);
+            bytes_written_ += static_cast<u64>(n);
+            bytes_sendfile_ += static_cast<u64>(n);
+            utils::Metrics::get().http_bytes_out.add(static_cast<u64>(n));
+            utils::Metrics::get().http_bytes_sendfile.add(static_cast<u64>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // socket发送缓冲区已满，等可写后继续
+            return socket.async_wait(
+                tcp::socket::wait_write,
+                [self = shared_from_this(), keep_alive](beast::error_code wait_ec) {
+                    if (wait_ec) {
+                        spdlog::error("Failed waiting for sendfile: {}", wait_ec.message());
+                        return;
+                    }
+                    self->do_sendfile(keep_alive);
+                });
+        }
+        // n == 0: 文件在发送过程中被截断，已经发出的Content-Length无法兑现，只能断开
+        spdlog::error("sendfile failed after {} bytes: {}", file.offset,
+                      n == 0 ? "unexpected end of file" : std::strerror(errno));
+        return do_close();
+    }
+
+    finish_write(keep_alive);
+#else
+    boost::ignore_unused(keep_alive);
+#endif
+}
+
+void HttpSession::finish_write(bool keep_alive) {
     if (!keep_alive) {
         // This means we should close the connection, usually because
         // the response indicated the "Connection: close" semantic.
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 
 #include "utils/net_utils.hpp"
+#include "core/arena.hpp"
+#include "core/http_response.hpp"
+#include "core/upload_handler.hpp"
+#include "utils/types.hpp"
 #include <optional>
 #include <boost/json.hpp>
 #include <memory>
@@ -13,26 +18,67 @@ namespace core {
 class HttpSession : public std::enable_shared_from_this<HttpSession> {
 public:
     explicit HttpSession(tcp::socket socket, std::shared_ptr<std::string const> const& doc_root);
+    ~HttpSession();
     void run();
 
 private:
+    using ArenaRequest = http::request<http::string_body, http::basic_fields<ArenaAllocator>>;
+
+    // 交给工作线程的请求，成员顺序保证请求先于内存区析构
+    struct PendingRequest {
+        ArenaPtr arena;
+        ArenaRequest req;
+    };
+
     beast::tcp_stream stream_;
     beast::flat_buffer buffer_;
     std::shared_ptr<std::string const> doc_root_;
-    boost::optional<http::request_parser<http::string_body>> parser_;
-    std::queue<http::message_generator> response_queue_;
+    // 当前正在读取的请求所用的内存区，请求头直接分配在上面
+    ArenaPtr arena_;
+    // 先只读请求头，再根据请求类型决定正文的读法
+    boost::optional<http::request_parser<http::empty_body, ArenaAllocator>> header_parser_;
+    boost::optional<http::request_parser<http::string_body, ArenaAllocator>> parser_;
+    // 上传请求的正文按块读入upload_buf_，随即写入upload_sink_
+    boost::optional<http::request_parser<http::buffer_body, ArenaAllocator>> upload_parser_;
+    std::shared_ptr<UploadSink> upload_sink_;
+    std::unique_ptr<char[]> upload_buf_;
+    std::queue<HttpResponse> response_queue_;
+
+    // 本连接的流量统计
+    std::chrono::steady_clock::time_point created_at_ = std::chrono::steady_clock::now();
+    u64 bytes_read_ = 0;
+    u64 bytes_written_ = 0;
+    // bytes_written_中经sendfile发送的部分
+    u64 bytes_sendfile_ = 0;
+
+    // 每次sendfile调用的最大字节数
+    static constexpr std::size_t SENDFILE_CHUNK = 1024 * 1024;
+    // 每轮最多发送的字节数，超过后让出IO线程给其他连接
+    static constexpr std::size_t SENDFILE_TURN_BYTES = 8 * SENDFILE_CHUNK;
+    // 上传正文每次读取的块大小，也是一个上传占用的全部正文内存
+    static constexpr std::size_t UPLOAD_CHUNK = 64 * 1024;
 
     // 原子地追踪正在后台处理的请求数量
     std::atomic<std::size_t> inflight_requests_{0};
 
     void do_read();
+    void on_read_header(beast::error_code ec, std::size_t bytes_transferred);
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
-    void queue_write(http::message_generator&& response);
+    void start_upload();
+    void do_read_upload();
+    void on_read_upload(beast::error_code ec, std::size_t bytes_transferred);
+    // 上传被拒绝时正文没有读完，回复后关闭连接
+    void reject_upload(http::status status, utils::StatusCode code, const std::string& msg);
+    void queue_write(HttpResponse&& response);
     void do_close();
     void do_write();
     void on_write(bool keep_alive, beast::error_code ec, std::size_t bytes_transferred);
+    // 一个响应完整发送后，继续读循环和写队列
+    void finish_write(bool keep_alive);
+    // 响应头发出后，用sendfile发送队首响应的文件正文
+    void do_sendfile(bool keep_alive);
     void send_response(http::message_generator&& msg);
-    void queue_response_from_worker(http::message_generator&& response);
+    void queue_response_from_worker(HttpResponse&& response);
 };
 }  // namespace core
 }  // namespace tcs
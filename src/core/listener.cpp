@@ -1,6 +1,7 @@
 #include "core/listener.hpp"
 #include "spdlog/spdlog.h"
 #include "core/http_session.hpp"
+#include "utils/metrics.hpp"
 
 namespace tcs {
 namespace core {
@@ -50,6 +51,7 @@ void Listener::on_accept(beast::error_code ec, tcp::socket socket) {
         spdlog::error("Failed to accept connection: {}", ec.message());
         return;
     } else {
+        utils::Metrics::get().accepted_connections.add();
         std::make_shared<HttpSession>(std::move(socket),
                                       std::make_shared<const std::string>(doc_root_))
             ->run();
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <spdlog/spdlog.h>
+
+#include "core/msg_trace.hpp"
+#include "utils/metrics.hpp"
+
+namespace tcs {
+namespace core {
+// Chrome trace中的两个进程：服务器内的阶段按消息分行，投递按接收者分行
+static constexpr int SERVER_PID = 1;
+static constexpr int DELIVERY_PID = 2;
+
+void MsgTracer::configure(const std::string& file, u64 sample_rate, u64 slow_ms) {
+    std::lock_guard<std::mutex> write_lock(write_mtx_);
+    std::lock_guard<std::mutex> lock(mtx_);
+    sample_rate_ = sample_rate;
+    slow_ = std::chrono::milliseconds(slow_ms);
+    if (sample_rate_ == 0 && slow_ms == 0) {
+        return;
+    }
+
+    out_.open(file, std::ios::binary | std::ios::app);
+    if (!out_) {
+        spdlog::error("Failed to open message trace file {}, tracing disabled", file);
+        sample_rate_ = 0;
+        slow_ = Clock::duration::zero();
+        return;
+    }
+    if (!writer_.joinable()) {
+        writer_ = std::thread([this] { write_loop(); });
+    }
+    // JSON数组格式允许省略结尾的']'，每次启动只追加事件
+    if (out_.tellp() == 0) {
+        pending_ +=
+            "[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"server\"}},\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"delivery\"}},\n";
+    }
+    spdlog::info("Tracing messages to {} (1/{} sampled, slow threshold {} ms)", file, sample_rate,
+                 slow_ms);
+}
+
+bool MsgTracer::sampled(u64 msg_id) const {
+    if (sample_rate_ == 0) {
+        return false;
+    }
+    // 雪花id的低位是序列号，打散后再取模
+    return (msg_id * 0x9E3779B97F4A7C15ULL >> 32) % sample_rate_ == 0;
+}
+
+bool MsgTracer::dumped(u64 msg_id, Clock::duration elapsed) const {
+    return sampled(msg_id) || (slow_ != Clock::duration::zero() && elapsed >= slow_);
+}
+
+void MsgTracer::finish(const MsgTrace& trace) {
+    utils::Metrics& metrics = utils::Metrics::get();
+    metrics.msg_queue.record(trace.dequeued - trace.received);
+    metrics.msg_handle.record(trace.committed - trace.dequeued);
+    metrics.msg_fanout.record(trace.fanned_out - trace.committed);
+
+    if (!dumped(trace.msg_id, trace.fanned_out - trace.received)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    append_span("queue", SERVER_PID, trace.msg_id, trace.msg_id, trace.received, trace.dequeued);
+    append_span("handle", SERVER_PID, trace.msg_id, trace.msg_id, trace.dequeued,
+                trace.committed);
+    append_span("fanout", SERVER_PID, trace.msg_id, trace.msg_id, trace.committed,
+                trace.fanned_out);
+}
+
+void MsgTracer::delivered(u64 msg_id, u64 recipient_id, Clock::time_point queued,
+                          Clock::time_point written) {
+    utils::Metrics::get().msg_deliver.record(written - queued);
+
+    if (!dumped(msg_id, written - queued)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    append_span("deliver", DELIVERY_PID, recipient_id, msg_id, queued, written);
+}
+
+void MsgTracer::append_span(std::string_view name, int pid, u64 tid, u64 msg_id,
+                            Clock::time_point begin, Clock::time_point end) {
+    using Micros = std::chrono::duration<double, std::micro>;
+    char buf[256];
+    // tid取低32位，trace查看器按double解析数字，完整的u64会丢精度
+    int len = std::snprintf(
+        buf, sizeof(buf),
+        "{\"name\":\"%.*s\",\"cat\":\"msg\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,"
+        "\"tid\":%u,\"args\":{\"msg_id\":\"%llu\"}},\n",
+        static_cast<int>(name.size()), name.data(), Micros(begin - epoch_).count(),
+        Micros(end - begin).count(), pid, static_cast<unsigned>(tid & 0xFFFFFFFF),
+        static_cast<unsigned long long>(msg_id));
+    if (len <= 0 || pending_.size() >= MAX_PENDING_BYTES) {
+        return;
+    }
+    pending_.append(buf, std::min<std::size_t>(len, sizeof(buf) - 1));
+    if (pending_.size() >= FLUSH_BYTES) {
+        cv_.notify_one();
+    }
+}
+
+void MsgTracer::write_loop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait_for(lock, std::chrono::seconds(1),
+                         [this] { return stop_ || pending_.size() >= FLUSH_BYTES; });
+            if (stop_) {
+                return;
+            }
+        }
+        flush();
+    }
+}
+
+void MsgTracer::flush() {
+    // 先取得写文件的锁再取出缓冲，保证写入顺序，flush返回时之前的记录都已写入
+    std::lock_guard<std::mutex> write_lock(write_mtx_);
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        data.swap(pending_);
+    }
+    if (data.empty() || !out_.is_open()) {
+        return;
+    }
+    out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out_.flush();
+}
+
+MsgTracer::~MsgTracer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    flush();
+}
+}  // namespace core
+}  // namespace tcs
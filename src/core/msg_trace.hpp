@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 一条聊天消息在服务器内各阶段的时间点，随消息在线程间传递
+//   queue:   on_read读完整帧 -> 工作线程开始处理
+//   handle:  解析、权限检查和数据库事务，到提交为止
+//   fanout:  查询房间成员并放入所有在线接收者的发送队列
+//   deliver: 每个接收者的帧在发送队列中等待并写入socket，见MsgTracer::delivered
+struct MsgTrace {
+    using Clock = std::chrono::steady_clock;
+
+    u64 msg_id = 0;
+    Clock::time_point received;
+    Clock::time_point dequeued;
+    Clock::time_point committed;
+    Clock::time_point fanned_out;
+};
+
+// 各阶段耗时都记录到Metrics中的直方图
+// 按msg_id采样的消息和超过慢阈值的消息另外以Chrome trace格式追加到文件，
+// 可以直接用chrome://tracing或Perfetto打开
+// 记录只追加到内存缓冲，由后台线程写文件，IO线程上的delivered不会阻塞在磁盘上
+class MsgTracer {
+public:
+    using Clock = MsgTrace::Clock;
+
+    static MsgTracer& get() {
+        static MsgTracer instance;
+        return instance;
+    }
+
+    // sample_rate为N时约每N条消息采样一条，0表示不采样
+    // slow_ms为0表示不单独记录慢消息
+    void configure(const std::string& file, u64 sample_rate, u64 slow_ms);
+
+    // 消息已放入所有在线接收者的发送队列
+    void finish(const MsgTrace& trace);
+
+    // 发给recipient_id的帧写完
+    void delivered(u64 msg_id, u64 recipient_id, Clock::time_point queued,
+                   Clock::time_point written);
+
+    // 同一条消息在各个阶段得到相同的采样结果
+    bool sampled(u64 msg_id) const;
+
+    // 把缓冲中的记录立即写入文件
+    void flush();
+
+    ~MsgTracer();
+
+private:
+    MsgTracer() = default;
+
+    bool dumped(u64 msg_id, Clock::duration elapsed) const;
+    void append_span(std::string_view name, int pid, u64 tid, u64 msg_id, Clock::time_point begin,
+                     Clock::time_point end);
+    void write_loop();
+
+    // 缓冲超过该大小或距上次写入超过1秒时写文件
+    static constexpr std::size_t FLUSH_BYTES = 64 * 1024;
+    // 写文件跟不上时丢弃新的记录，保证内存有界
+    static constexpr std::size_t MAX_PENDING_BYTES = 64 * FLUSH_BYTES;
+
+    u64 sample_rate_ = 0;
+    Clock::duration slow_{0};
+    Clock::time_point epoch_ = Clock::now();
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::string pending_;
+    bool stop_ = false;
+
+    // 串行化后台线程和flush对文件的写入，在mtx_之前获取
+    std::mutex write_mtx_;
+    std::ofstream out_;
+
+    std::thread writer_;
+};
+}  // namespace core
+}  // namespace tcs
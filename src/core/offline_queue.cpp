@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+
+#include "core/offline_queue.hpp"
+#include "pool/thread_pool.hpp"
+
+namespace tcs {
+namespace core {
+void OfflineQueue::configure(std::size_t per_user_limit, std::size_t spill_limit,
+                             const std::string& spill_dir) {
+    std::lock_guard<std::mutex> file_lock(file_mtx_);
+    std::lock_guard<std::mutex> lock(mtx_);
+    per_user_limit_ = per_user_limit;
+    spill_limit_ = spill_limit;
+    spilled_.clear();
+    spill_dir_ = spill_dir;
+
+    std::error_code ec;
+    std::filesystem::create_directories(spill_dir_, ec);
+    if (ec) {
+        spdlog::error("Failed to create offline spill directory {}: {}", spill_dir, ec.message());
+    }
+}
+
+std::filesystem::path OfflineQueue::spill_path(u64 user_id) const {
+    return spill_dir_ / (std::to_string(user_id) + ".queue");
+}
+
+void OfflineQueue::push(u64 user_id, u64 msg_id,
+                        const std::shared_ptr<const std::string>& payload) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        UserQueue& queue = queues_[user_id];
+        queue.pending.push_back(Entry{.msg_id = msg_id, .payload = payload});
+        if (queue.pending.size() < per_user_limit_) {
+            return;
+        }
+        // 已有溢写任务时由它一并写入
+        schedule = queue.spilling.empty();
+        queue.spilling.insert(queue.spilling.end(), std::make_move_iterator(queue.pending.begin()),
+                              std::make_move_iterator(queue.pending.end()));
+        queue.pending.clear();
+    }
+    if (schedule) {
+        pool::ThreadPool::get().addTask([this, user_id] { spill(user_id); });
+    }
+}
+
+// 每行一条：<msg_id> <payload>
+// payload是序列化后的JSON，不含换行
+void OfflineQueue::spill(u64 user_id) {
+    std::lock_guard<std::mutex> file_lock(file_mtx_);
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = queues_.find(user_id);
+        // 已经被drain取走
+        if (it == queues_.end() || it->second.spilling.empty()) {
+            return;
+        }
+        entries.swap(it->second.spilling);
+    }
+
+    auto count = spilled_.find(user_id);
+    if (count == spilled_.end()) {
+        // 重启前留下的文件
+        std::vector<Entry> existing;
+        read_spilled(spill_path(user_id), user_id, existing);
+        count = spilled_.emplace(user_id, existing.size()).first;
+    }
+    if (count->second + entries.size() > spill_limit_) {
+        return rewrite_spilled(user_id, std::move(entries));
+    }
+
+    std::ofstream out(spill_path(user_id), std::ios::app);
+    if (out) {
+        for (const auto& entry : entries) {
+            out << entry.msg_id << ' ' << *entry.payload << '\n';
+        }
+        count->second += entries.size();
+        spdlog::debug("Spilled {} offline messages of user {} to disk", entries.size(), user_id);
+        return;
+    }
+
+    // 写不了文件时放回内存，丢弃最旧的消息保证有界
+    spdlog::error("Failed to open offline spill file for user {}", user_id);
+    std::lock_guard<std::mutex> lock(mtx_);
+    UserQueue& queue = queues_[user_id];
+    queue.pending.insert(queue.pending.begin(), std::make_move_iterator(entries.begin()),
+                         std::make_move_iterator(entries.end()));
+    while (!queue.pending.empty() && queue.pending.size() >= per_user_limit_) {
+        queue.pending.pop_front();
+    }
+}
+
+void OfflineQueue::rewrite_spilled(u64 user_id, std::vector<Entry>&& entries) {
+    std::filesystem::path path = spill_path(user_id);
+    std::vector<Entry> all;
+    read_spilled(path, user_id, all);
+    all.insert(all.end(), std::make_move_iterator(entries.begin()),
+               std::make_move_iterator(entries.end()));
+    std::sort(all.begin(), all.end(),
+              [](const Entry& a, const Entry& b) { return a.msg_id < b.msg_id; });
+    std::size_t dropped = all.size() > spill_limit_ ? all.size() - spill_limit_ : 0;
+
+    // 先写临时文件再替换，中途失败时原文件不受影响
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (std::size_t i = dropped; i < all.size(); i++) {
+            out << all[i].msg_id << ' ' << *all[i].payload << '\n';
+        }
+        if (!out) {
+            spdlog::error("Failed to rewrite offline spill file for user {}", user_id);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::error("Failed to replace offline spill file for user {}: {}", user_id,
+                      ec.message());
+        return;
+    }
+    spilled_[user_id] = all.size() - dropped;
+    spdlog::warn("Offline spill file of user {} is full, dropped {} oldest messages", user_id,
+                 dropped);
+}
+
+void OfflineQueue::read_spilled(const std::filesystem::path& path, u64 user_id,
+                                std::vector<Entry>& out) {
+    std::ifstream in(path);
+    if (!in) {
+        return;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        try {
+            out.push_back(
+                Entry{.msg_id = std::stoull(line.substr(0, space)),
+                      .payload = std::make_shared<const std::string>(line.substr(space + 1))});
+        } catch (const std::exception& e) {
+            spdlog::warn("Skipped corrupted offline record of user {}: {}", user_id, e.what());
+        }
+    }
+}
+
+void OfflineQueue::load_spilled(u64 user_id, std::vector<Entry>& out) {
+    std::filesystem::path path = spill_path(user_id);
+    read_spilled(path, user_id, out);
+    spilled_.erase(user_id);
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+std::vector<OfflineQueue::Entry> OfflineQueue::drain(u64 user_id) {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> file_lock(file_mtx_);
+        // 溢写的消息更旧，先读文件(重启前留下的文件也在这里补发)
+        load_spilled(user_id, entries);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = queues_.find(user_id);
+        if (it != queues_.end()) {
+            UserQueue& queue = it->second;
+            entries.insert(entries.end(), std::make_move_iterator(queue.spilling.begin()),
+                           std::make_move_iterator(queue.spilling.end()));
+            entries.insert(entries.end(), std::make_move_iterator(queue.pending.begin()),
+                           std::make_move_iterator(queue.pending.end()));
+            queues_.erase(it);
+        }
+    }
+
+    // 并发提交可能乱序入队，同一条消息也可能重复入队
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.msg_id < b.msg_id; });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const Entry& a, const Entry& b) { return a.msg_id == b.msg_id; }),
+                  entries.end());
+    return entries;
+}
+
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 离线消息队列
+// 用户不在线时消息暂存在内存中，超过上限后整体交给线程池溢写到本地文件
+// 每个用户的文件也有上限，超过时丢弃最旧的消息
+// 用户重新连接后一次性取出补发
+// push只在内存中入队，可以在WSSessionMgr的锁内调用；文件读写都不持有队列的锁
+class OfflineQueue {
+public:
+    struct Entry {
+        u64 msg_id;
+        // 群消息的所有离线成员共享同一份序列化结果
+        std::shared_ptr<const std::string> payload;
+    };
+
+    static OfflineQueue& get() {
+        static OfflineQueue instance;
+        return instance;
+    }
+
+    void configure(std::size_t per_user_limit, std::size_t spill_limit,
+                   const std::string& spill_dir);
+
+    void push(u64 user_id, u64 msg_id, const std::shared_ptr<const std::string>& payload);
+
+    // 取出该用户所有待投递的消息，按msg_id升序，会读取溢写文件
+    std::vector<Entry> drain(u64 user_id);
+
+private:
+    OfflineQueue() {}
+
+    struct UserQueue {
+        std::deque<Entry> pending;
+        // 已超过上限、等待溢写线程写入文件的消息
+        std::vector<Entry> spilling;
+    };
+
+    std::filesystem::path spill_path(u64 user_id) const;
+    // 在线程池中执行
+    void spill(u64 user_id);
+    static void read_spilled(const std::filesystem::path& path, u64 user_id,
+                             std::vector<Entry>& out);
+    // 读出并删除溢写文件
+    void load_spilled(u64 user_id, std::vector<Entry>& out);
+    // 超过spill_limit_时重写文件，只保留最新的消息
+    void rewrite_spilled(u64 user_id, std::vector<Entry>&& entries);
+
+    std::mutex mtx_;
+    // 只保存有待投递消息的用户
+    std::unordered_map<u64, UserQueue> queues_;
+    // 串行化溢写文件的读写，持有期间才从队列中取出spilling，
+    // 所以drain不会错过已经离开内存、还没写入文件的消息
+    std::mutex file_mtx_;
+    // 各用户溢写文件中的记录数，由file_mtx_保护；不在表中的在第一次溢写时数一遍文件
+    std::unordered_map<u64, std::size_t> spilled_;
+    std::size_t per_user_limit_ = 256;
+    std::size_t spill_limit_ = 10000;
+    std::filesystem::path spill_dir_ = "offline";
+};
+}  // namespace core
+}  // namespace tcs
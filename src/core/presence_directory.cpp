@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include "core/presence_directory.hpp"
+#include "utils/metrics.hpp"
+#include "utils/snowflake.hpp"
+
+namespace tcs {
+namespace core {
+std::optional<PresenceUpdate> PresenceDirectory::set_local(u64 user_id, bool online) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // 在锁内取版本号，同一用户先后两次变化的版本号与发生顺序一致
+    u64 version = utils::SnowFlake::next_id();
+    if (online) {
+        local_[user_id] = version;
+    } else if (local_.erase(user_id) == 0) {
+        return std::nullopt;
+    }
+    return PresenceUpdate{.user_id = user_id, .version = version, .online = online};
+}
+
+std::vector<PresenceUpdate> PresenceDirectory::snapshot() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<PresenceUpdate> updates;
+    updates.reserve(local_.size());
+    for (const auto& [user_id, version] : local_) {
+        updates.push_back(PresenceUpdate{.user_id = user_id, .version = version, .online = true});
+    }
+    return updates;
+}
+
+void PresenceDirectory::apply(u64 node_id, const std::vector<PresenceUpdate>& updates,
+                              bool replace) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (replace) {
+        drop_locked(node_id);
+    }
+
+    for (const PresenceUpdate& update : updates) {
+        auto& entries = remote_[update.user_id];
+        auto entry = std::find_if(entries.begin(), entries.end(),
+                                  [node_id](const auto& entry) { return entry.first == node_id; });
+        if (update.online) {
+            if (entry == entries.end()) {
+                entries.emplace_back(node_id, update.version);
+                nodes_[node_id].insert(update.user_id);
+                utils::Metrics::get().presence_remote.add(1);
+            } else if (update.version > entry->second) {
+                entry->second = update.version;
+            }
+        } else if (entry != entries.end() && update.version >= entry->second) {
+            erase_remote(update.user_id, node_id);
+            nodes_[node_id].erase(update.user_id);
+        } else if (entries.empty()) {
+            remote_.erase(update.user_id);
+        }
+    }
+}
+
+void PresenceDirectory::drop_node(u64 node_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    drop_locked(node_id);
+}
+
+void PresenceDirectory::drop_locked(u64 node_id) {
+    auto it = nodes_.find(node_id);
+    if (it == nodes_.end()) {
+        return;
+    }
+    for (u64 user_id : it->second) {
+        erase_remote(user_id, node_id);
+    }
+    nodes_.erase(it);
+}
+
+void PresenceDirectory::erase_remote(u64 user_id, u64 node_id) {
+    auto it = remote_.find(user_id);
+    if (it == remote_.end()) {
+        return;
+    }
+    auto& entries = it->second;
+    auto entry = std::find_if(entries.begin(), entries.end(),
+                              [node_id](const auto& entry) { return entry.first == node_id; });
+    if (entry != entries.end()) {
+        entries.erase(entry);
+        utils::Metrics::get().presence_remote.add(-1);
+    }
+    if (entries.empty()) {
+        remote_.erase(it);
+    }
+}
+
+std::unordered_map<u64, std::vector<u64>> PresenceDirectory::route(
+    const std::vector<u64>& user_ids, std::vector<u64>& offline) {
+    std::unordered_map<u64, std::vector<u64>> by_node;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (u64 user_id : user_ids) {
+        auto it = remote_.find(user_id);
+        if (it == remote_.end()) {
+            offline.push_back(user_id);
+            continue;
+        }
+        for (const auto& [node_id, version] : it->second) {
+            by_node[node_id].push_back(user_id);
+        }
+    }
+    return by_node;
+}
+
+std::vector<u64> PresenceDirectory::nodes_of(u64 user_id) {
+    std::vector<u64> nodes;
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = remote_.find(user_id);
+    if (it != remote_.end()) {
+        for (const auto& [node_id, version] : it->second) {
+            nodes.push_back(node_id);
+        }
+    }
+    return nodes;
+}
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "core/cluster_bus.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 集群在线状态：每个用户的会话连在哪些节点上
+// 本节点的变化由WSSessionMgr写入，经集群总线增量发给对端；对端连上时先收到一份全量快照
+// 对端的条目只由该对端的消息更新，按版本号丢弃过期的变化，对端断开时整体删除
+class PresenceDirectory {
+public:
+    static PresenceDirectory& get() {
+        static PresenceDirectory instance;
+        return instance;
+    }
+
+    // 本节点上用户上线或下线，返回要发给对端的变化
+    // 下线的用户本来就不在本节点上时返回空
+    std::optional<PresenceUpdate> set_local(u64 user_id, bool online);
+
+    // 本节点所有在线用户，发给刚连上的对端
+    std::vector<PresenceUpdate> snapshot();
+
+    // 对端节点的变化，replace为true时先删除该节点原有的条目
+    void apply(u64 node_id, const std::vector<PresenceUpdate>& updates, bool replace);
+
+    void drop_node(u64 node_id);
+
+    // 把不在本节点上的用户按所在节点分组，哪个节点都不在的放入offline
+    // 同一用户连在多个节点上时每个节点都会收到
+    std::unordered_map<u64, std::vector<u64>> route(const std::vector<u64>& user_ids,
+                                                    std::vector<u64>& offline);
+
+    // 用户所在的其他节点
+    std::vector<u64> nodes_of(u64 user_id);
+
+private:
+    PresenceDirectory() {}
+
+    // 以下调用者持有mtx_
+    void drop_locked(u64 node_id);
+    // 删除user_id在node_id上的条目，不修改nodes_
+    void erase_remote(u64 user_id, u64 node_id);
+
+    std::mutex mtx_;
+    // 本节点上的用户到上线时的版本号
+    std::unordered_map<u64, u64> local_;
+    // 其他节点上的用户到(节点, 版本号)，通常只有一项
+    std::unordered_map<u64, std::vector<std::pair<u64, u64>>> remote_;
+    // 节点到它上面的用户，用于整体删除
+    std::unordered_map<u64, std::unordered_set<u64>> nodes_;
+};
+}  // namespace core
+}  // namespace tcs
@@ -1,13 +1,20 @@
+#include <cerrno>
 #include <string>
 #include <chrono>
-#include <filesystem>
+
+#ifdef PLATFORM_LINUX
+#include <fcntl.h>
+#endif
 
 #include <boost/json.hpp>
 #include "jwt-cpp/jwt.h"
 #include "jwt-cpp/traits/boost-json/traits.h"
 
 #include "core/request_handler.hpp"
-#include "db/sql_conn_RAII.hpp"
+#include "core/asset_cache.hpp"
+#include "utils/compression.hpp"
+#include "utils/http_range.hpp"
+#include "utils/metrics.hpp"
 #include "utils/config.hpp"
 
 using AppConfig = tcs::utils::AppConfig;
@@ -93,6 +100,22 @@ std::string_view RequestHandler::extract_target_param(std::string_view target, s
     return std::string_view();
 }
 
+std::string_view RequestHandler::query_param(std::string_view query, std::string_view key) {
+    while (!query.empty()) {
+        std::size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        std::size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == key) {
+            return eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+        }
+        if (amp == std::string_view::npos) {
+            break;
+        }
+        query.remove_prefix(amp + 1);
+    }
+    return {};
+}
+
 std::string RequestHandler::bytes_to_hex(const unsigned char* bytes, std::size_t len) {
     std::stringstream ss;
     ss << std::hex << std::setfill('0');
@@ -161,81 +184,206 @@ http::response<http::string_body> RequestHandler::error_resp(const ReqContext& c
     return res;
 }
 
-std::string_view RequestHandler::mime_type(std::string_view path) {
-    using boost::beast::iequals;
-    auto const ext = [&path] {
-        auto const pos = path.rfind(".");
-        if (pos == std::string_view::npos) return std::string_view{};
-        return path.substr(pos);
-    }();
-
-    if (iequals(ext, ".htm")) return "text/html";
-    if (iequals(ext, ".html")) return "text/html";
-    if (iequals(ext, ".php")) return "text/html";
-    if (iequals(ext, ".css")) return "text/css";
-    if (iequals(ext, ".txt")) return "text/plain";
-    if (iequals(ext, ".js")) return "application/javascript";
-    if (iequals(ext, ".json")) return "application/json";
-    if (iequals(ext, ".xml")) return "application/xml";
-    if (iequals(ext, ".swf")) return "application/x-shockwave-flash";
-    if (iequals(ext, ".flv")) return "video/x-flv";
-    if (iequals(ext, ".png")) return "image/png";
-    if (iequals(ext, ".jpe")) return "image/jpeg";
-    if (iequals(ext, ".jpeg")) return "image/jpeg";
-    if (iequals(ext, ".jpg")) return "image/jpeg";
-    if (iequals(ext, ".gif")) return "image/gif";
-    if (iequals(ext, ".bmp")) return "image/bmp";
-    if (iequals(ext, ".ico")) return "image/vnd.microsoft.icon";
-    if (iequals(ext, ".tiff")) return "image/tiff";
-    if (iequals(ext, ".tif")) return "image/tiff";
-    if (iequals(ext, ".svg")) return "image/svg+xml";
-    if (iequals(ext, ".svgz")) return "image/svg+xml";
-    return "application/octet-stream";  // 默认的二进制流类型
+http::response<http::string_body> RequestHandler::create_json_response(const ReqContext& ctx,
+                                                                       http::status status,
+                                                                       std::string body) {
+    http::response<http::string_body> res{status, ctx.version};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, "application/json");
+    res.keep_alive(ctx.keep_alive);
+    res.body() = std::move(body);
+
+    if (res.body().size() >= AppConfig::get().server().http_compress_min_bytes()) {
+        // 是否压缩取决于Accept-Encoding，缓存需要区分
+        res.set(http::field::vary, "Accept-Encoding");
+        utils::ContentEncoding encoding = utils::negotiate_encoding(ctx.accept_encoding);
+        if (utils::compress(encoding, res.body())) {
+            res.set(http::field::content_encoding, utils::encoding_name(encoding));
+        }
+    }
+
+    res.prepare_payload();
+    return res;
 }
 
-http::message_generator RequestHandler::handle_assets(const ReqContext& ctx) {
-    try {
-        if (ctx.method != http::verb::get) {
-            return error_resp(ctx, StatusCode::BadRequest, " Method Not Allowed");
+// If-None-Match可能是逗号分隔的列表或*
+static bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    if (if_none_match == "*") {
+        return true;
+    }
+    while (!if_none_match.empty()) {
+        std::size_t comma = if_none_match.find(',');
+        std::string_view item = if_none_match.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        // 弱比较，忽略W/前缀
+        if (item.starts_with("W/")) item.remove_prefix(2);
+        if (item == etag) {
+            return true;
         }
-        std::string_view asset_path = ctx.target;          // 先创建一个副本或引用
-        asset_path.remove_prefix(sizeof("/assets/") - 1);  // -1 是为了去掉字符串末尾的 '\0'
-
-        if (asset_path.empty() || asset_path.find("..") != std::string_view::npos) {
-            return error_resp(ctx, StatusCode::BadRequest, " Invalid asset path");
+        if (comma == std::string_view::npos) {
+            break;
         }
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
 
-        std::string utf8_path_str = AppConfig::get().server().doc_root() + std::string(asset_path);
+template <typename Body>
+static void set_asset_headers(http::response<Body>& res, const Asset& asset, bool keep_alive) {
+    res.set(http::field::server, "TinyChatServer");
+    res.set(http::field::content_type, asset.mime);
+    res.set(http::field::etag, asset.etag);
+    res.set(http::field::last_modified, asset.last_modified);
+    res.keep_alive(keep_alive);
+}
 
-        std::filesystem::path asset_file_path(asset_path);
-        std::filesystem::path doc_root_path(AppConfig::get().server().doc_root());
-        std::filesystem::path full_path = doc_root_path / asset_file_path;
+static std::string content_range(u64 first, u64 length, u64 size) {
+    return "bytes " + std::to_string(first) + "-" + std::to_string(first + length - 1) + "/" +
+           std::to_string(size);
+}
 
-        http::file_body::value_type body;
-        beast::error_code ec;
+http::message_generator RequestHandler::handle_metrics(const ReqContext& ctx) {
+    http::response<http::string_body> res{http::status::ok, ctx.version};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, "text/plain; version=0.0.4");
+    res.set(http::field::cache_control, "no-store");
+    res.keep_alive(ctx.keep_alive);
+    res.body() = utils::Metrics::get().render();
+    res.prepare_payload();
+    return res;
+}
 
-        std::u8string path_for_beast = full_path.u8string();
+http::message_generator RequestHandler::handle_assets(ReqContext& ctx,
+                                                      const AssetRequest& asset_req) {
+    try {
+        if (ctx.method != http::verb::get) {
+            return error_resp(ctx, StatusCode::BadRequest, " Method Not Allowed");
+        }
 
-        body.open(reinterpret_cast<const char*>(path_for_beast.data()), beast::file_mode::scan, ec);
+        std::string_view asset_path = asset_req.path;
+        // '.'开头的路径段(包括上传临时目录)不对外提供
+        if (asset_path.empty() || asset_path.starts_with('.') ||
+            asset_path.find("/.") != std::string_view::npos) {
+            return error_resp(ctx, StatusCode::BadRequest, " Invalid asset path");
+        }
 
-        if (ec == beast::errc::no_such_file_or_directory) {
-            spdlog::warn("Asset file not found: {}", utf8_path_str);
+        std::shared_ptr<const Asset> asset = AssetCache::get().find(asset_path);
+        if (!asset) {
+            spdlog::warn("Asset file not found: {}", asset_path);
             return error_resp(ctx, StatusCode::NotFound, " Asset not found");
         }
 
-        if (ec) {
-            throw std::runtime_error("Failed to open asset file: " + ec.message());
+        // If-None-Match优先于If-Modified-Since
+        bool not_modified = !asset_req.if_none_match.empty()
+                                ? etag_matches(asset_req.if_none_match, asset->etag)
+                                : (!asset_req.if_modified_since.empty() &&
+                                   asset_req.if_modified_since == asset->last_modified);
+        if (not_modified) {
+            http::response<http::empty_body> res{http::status::not_modified, ctx.version};
+            res.set(http::field::server, "TinyChatServer");
+            res.set(http::field::etag, asset->etag);
+            res.set(http::field::last_modified, asset->last_modified);
+            res.keep_alive(ctx.keep_alive);
+            return res;
         }
 
-        auto const size = body.size();
+        // If-Range与当前版本不一致时忽略Range，返回完整内容
+        utils::ByteRange range;
+        if (!asset_req.range.empty() &&
+            (asset_req.if_range.empty() || asset_req.if_range == asset->etag ||
+             asset_req.if_range == asset->last_modified)) {
+            range = utils::parse_byte_range(asset_req.range, asset->size);
+        }
+#ifndef PLATFORM_LINUX
+        // 没有sendfile时超大文件用file_body整体发送，不支持Range
+        if (asset->streamed) {
+            range = utils::ByteRange{};
+        }
+#endif
+
+        if (range.kind == utils::ByteRange::Kind::Unsatisfiable) {
+            http::response<http::empty_body> res{http::status::range_not_satisfiable,
+                                                 ctx.version};
+            res.set(http::field::server, "TinyChatServer");
+            res.set(http::field::content_range, "bytes */" + std::to_string(asset->size));
+            res.content_length(0);
+            res.keep_alive(ctx.keep_alive);
+            return res;
+        }
 
-        http::response<http::file_body> res{std::piecewise_construct,
-                                            std::make_tuple(std::move(body)),
-                                            std::make_tuple(http::status::ok, ctx.version)};
-        res.set(http::field::server, "TinyChatServer");
-        res.set(http::field::content_type, mime_type(utf8_path_str));
-        res.set(http::field::content_length, std::to_string(size));
-        res.keep_alive(ctx.keep_alive);
+        bool partial = range.kind == utils::ByteRange::Kind::Satisfiable;
+        http::status status = partial ? http::status::partial_content : http::status::ok;
+        u64 first = partial ? range.first : 0;
+        u64 length = partial ? range.length() : asset->size;
+
+        if (asset->streamed) {
+#ifdef PLATFORM_LINUX
+            // 只发响应头，正文由HttpSession用sendfile从文件直接写入socket
+            int fd = ::open(asset->path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                if (errno == ENOENT) {
+                    AssetCache::get().invalidate(std::string(asset_path));
+                    return error_resp(ctx, StatusCode::NotFound, " Asset not found");
+                }
+                throw std::runtime_error("Failed to open asset file: " + asset->path);
+            }
+            ctx.file = std::make_unique<FileTransfer>();
+            ctx.file->fd = fd;
+            ctx.file->offset = first;
+            ctx.file->remaining = length;
+
+            http::response<http::empty_body> res{status, ctx.version};
+            set_asset_headers(res, *asset, ctx.keep_alive);
+            res.set(http::field::accept_ranges, "bytes");
+            if (partial) {
+                res.set(http::field::content_range, content_range(first, length, asset->size));
+            }
+            res.content_length(length);
+            return res;
+#else
+            http::file_body::value_type body;
+            beast::error_code ec;
+            body.open(asset->path.c_str(), beast::file_mode::scan, ec);
+            if (ec == beast::errc::no_such_file_or_directory) {
+                AssetCache::get().invalidate(std::string(asset_path));
+                return error_resp(ctx, StatusCode::NotFound, " Asset not found");
+            }
+            if (ec) {
+                throw std::runtime_error("Failed to open asset file: " + ec.message());
+            }
+            auto const size = body.size();
+
+            http::response<http::file_body> res{std::piecewise_construct,
+                                                std::make_tuple(std::move(body)),
+                                                std::make_tuple(http::status::ok, ctx.version)};
+            set_asset_headers(res, *asset, ctx.keep_alive);
+            res.content_length(size);
+            return res;
+#endif
+        }
+
+        // 区间请求只针对原始内容，不使用压缩版本
+        std::string_view encoding;
+        std::string_view data =
+            partial ? asset->data.substr(first, length)
+                    : AssetCache::select(*asset, asset_req.accept_encoding, encoding);
+
+        http::response<AssetBody> res{std::piecewise_construct,
+                                      std::make_tuple(AssetBody::value_type{asset, data}),
+                                      std::make_tuple(status, ctx.version)};
+        set_asset_headers(res, *asset, ctx.keep_alive);
+        res.set(http::field::accept_ranges, "bytes");
+        if (partial) {
+            res.set(http::field::content_range, content_range(first, length, asset->size));
+        }
+        if (!encoding.empty()) {
+            res.set(http::field::content_encoding, encoding);
+        }
+        if (!asset->gzip.empty() || !asset->br.empty()) {
+            res.set(http::field::vary, "Accept-Encoding");
+        }
+        res.content_length(data.size());
 
         return res;
     } catch (const std::exception& e) {
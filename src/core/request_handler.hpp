@@ -3,6 +3,8 @@
 #include <string>
 #include <optional>
 #include <vector>
+#include <limits>
+#include <algorithm>
 
 #include <cstddef>
 #include <boost/json.hpp>
@@ -15,11 +17,20 @@
 
 #include "utils/net_utils.hpp"
 #include "utils/enums.hpp"
-#include "db/sql_conn_RAII.hpp"
+#include "db/message_journal.hpp"
+#include "db/storage.hpp"
 #include "model/auth_models.hpp"
 #include "model/chat_models.hpp"
 #include "model/user.hpp"
 #include "model/room.hpp"
+#include "model/message.hpp"
+#include "core/arena.hpp"
+#include "core/http_response.hpp"
+#include "core/room_cache.hpp"
+#include "core/room_events.hpp"
+#include "core/room_summary_cache.hpp"
+#include "core/router.hpp"
+#include "utils/json_writer.hpp"
 #include "utils/types.hpp"
 #include "utils/snowflake.hpp"
 
@@ -33,13 +44,16 @@ using SnowFlake = tcs::utils::SnowFlake;
 template <typename Allocator>
 using api_request = http::request<http::string_body, http::basic_fields<Allocator>>;
 
-using SqlConnPool = tcs::db::SqlConnPool;
-using SqlConnRAII = tcs::db::SqlConnRAII;
+using Storage = tcs::db::Storage;
+using MessageJournal = tcs::db::MessageJournal;
 
 using User = tcs::model::User;
 using UserClaims = tcs::model::UserClaims;
 using LoginResp = tcs::model::LoginResp;
 using Room = model::Room;
+using RoomCache = tcs::core::RoomCache;
+using RoomSummaryCache = tcs::core::RoomSummaryCache;
+using RoomEvents = tcs::core::RoomEvents;
 
 namespace tcs {
 namespace core {
@@ -49,6 +63,12 @@ struct ApiResponse {
     std::string message;
     T data;
 };
+template <typename T>
+constexpr auto json_fields(utils::JsonFieldsTag<ApiResponse<T>>) {
+    return std::make_tuple(utils::json_field("code", &ApiResponse<T>::code),
+                           utils::json_field("message", &ApiResponse<T>::message),
+                           utils::json_field("data", &ApiResponse<T>::data));
+}
 
 // 准备重构
 
@@ -57,52 +77,92 @@ struct ReqContext {
     unsigned version;
     bool keep_alive;
     http::verb method;
-    std::string target;
+    // 指向请求本身，请求在处理期间一直有效
+    std::string_view target;
+    // 用于协商JSON响应的压缩格式
+    std::string_view accept_encoding;
     std::optional<json::value> jv_opt;
     std::optional<UserClaims> user_claims_opt;
+    // 由接口设置，响应头发出后用sendfile发送文件正文
+    std::unique_ptr<FileTransfer> file;
+};
+
+// /assets 请求用到的路径和请求头
+struct AssetRequest {
+    std::string_view path;
+    std::string_view if_none_match;
+    std::string_view if_modified_since;
+    std::string_view accept_encoding;
+    std::string_view range;
+    std::string_view if_range;
 };
 
 class RequestHandler {
 public:
     template <typename Allocator>
-    static http::message_generator handle_request(std::string_view doc_root,
-                                                  api_request<Allocator>&& req) {
+    static HttpResponse handle_request(std::string_view doc_root, api_request<Allocator>&& req) {
+        // 请求体只解析一次，各接口从ctx绑定到模型
+        // 请求头分配在RequestArena上时，JSON DOM也放在同一块内存区，否则放在栈上的缓冲区里
+        // 必须在ctx之前构造，保证ctx.jv_opt先于存储析构
+        unsigned char json_buf[JSON_STACK_SIZE];
+        json::monotonic_resource json_mr(json_buf, sizeof(json_buf));
+        std::optional<JsonArenaResource> json_arena;
+        if constexpr (std::is_same_v<Allocator, ArenaAllocator>) {
+            json_arena.emplace(req.get_allocator().resource());
+        }
+
         ReqContext ctx{.version = req.version(),
                        .keep_alive = req.keep_alive(),
                        .method = req.method(),
-                       .target = std::string(req.target()),
+                       .target = std::string_view(req.target().data(), req.target().size()),
+                       .accept_encoding = header_value(req, http::field::accept_encoding),
                        .jv_opt = std::nullopt,
-                       .user_claims_opt = std::nullopt};
+                       .user_claims_opt = std::nullopt,
+                       .file = nullptr};
 
         if (req.find(http::field::authorization) != req.end()) {
-            ctx.user_claims_opt = extract_user_claims(req[http::field::authorization]);
+            try {
+                ctx.user_claims_opt = extract_user_claims(req[http::field::authorization]);
+            } catch (const std::exception& e) {
+                // 令牌无效时不直接拒绝，由需要鉴权的接口返回错误
+                spdlog::debug("Invalid token for {}: {}", req.target(), e.what());
+            }
         }
 
         if (!req.body().empty()) {
-            ctx.jv_opt = json::parse(req.body());
+            json::storage_ptr sp =
+                json_arena ? json::storage_ptr(&*json_arena) : json::storage_ptr(&json_mr);
+            beast::error_code ec;
+            json::value jv = parse_json(req.body(), std::move(sp), ec);
+            if (ec) {
+                spdlog::warn("JSON parsed fail for {}: {}", req.target(), ec.message());
+                return bad_request(std::move(req), " Invalid JSON format");
+            }
+            ctx.jv_opt = std::move(jv);
         }
 
-        if (req.target() == "/api/login") {
-            return handle_login(std::move(req));
-        } else if (req.target() == "/api/register") {
-            return handle_register(std::move(req));
-        } else if (req.target() == "/api/group_room") {
-            return create_g_room(std::move(req));
-        } else if (req.target() == "/api/private_room") {
-            return create_p_room(std::move(req));
-        } else if (req.target().starts_with("/api/rooms/")) {
-            return handle_chat_room(std::move(req));
-        } else if (req.target() == "/users/me/rooms") {
-            return query_rooms(ctx);
-        } else if (req.target().starts_with("/assets")) {
-            return handle_assets(ctx);
-        } else {
-            spdlog::warn("Unhandled request: {}", req.target());
-            return bad_request(std::move(req), " Not Found");
+        RouteParams params;
+        auto match = router<Allocator>().match(req.method(), req.target(), params);
+        switch (match.status) {
+            case RouteStatus::Found: {
+                http::message_generator msg = (*match.handler)(std::move(req), ctx, params);
+                return HttpResponse(std::move(msg), std::move(ctx.file));
+            }
+            case RouteStatus::MethodNotAllowed:
+                return bad_request(std::move(req), " Method Not Allowed");
+            default:
+                spdlog::warn("Unhandled request: {}", req.target());
+                return bad_request(std::move(req), " Not Found");
         }
     }
 
     static UserClaims extract_user_claims(const std::string& token);
+    static std::string generate_login_token(const std::string& username, u64 id);
+
+    // 提取请求路径参数
+    // 例：/api/rooms/some_room_uuid/members
+    // -----0----1----------2----------3---
+    static std::string_view extract_target_param(std::string_view target, std::size_t index);
 
     static std::string generate_private_room_uuid(std::string u1, std::string u2);
     static std::string generate_uuid() {
@@ -111,291 +171,377 @@ public:
     }
 
 private:
-    // 提取请求路径参数
-    // 例：/api/rooms/some_room_uuid/members
-    // -----0----1----------2----------3---
-    static std::string_view extract_target_param(std::string_view target, std::size_t index);
+    // 请求不带RequestArena时，JSON DOM使用的栈上缓冲区大小
+    static constexpr std::size_t JSON_STACK_SIZE = 4096;
+
+    template <typename Allocator>
+    using RouteHandler = http::message_generator (*)(api_request<Allocator>&&, ReqContext&,
+                                                     const RouteParams&);
+
+    // 路由表在第一次请求时构建一次，之后只读
+    template <typename Allocator>
+    static const Router<RouteHandler<Allocator>>& router() {
+        static const Router<RouteHandler<Allocator>> instance = build_router<Allocator>();
+        return instance;
+    }
+
+    template <typename Allocator>
+    static Router<RouteHandler<Allocator>> build_router() {
+        using Req = api_request<Allocator>;
+        Router<RouteHandler<Allocator>> r;
+        r.add(http::verb::post, "/api/login",
+              [](Req&& req, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                  return handle_login(std::move(req), ctx);
+              })
+            .add(http::verb::post, "/api/register",
+                 [](Req&& req, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                     return handle_register(std::move(req), ctx);
+                 })
+            .add(http::verb::post, "/api/group_room",
+                 [](Req&& req, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                     return create_g_room(std::move(req), ctx);
+                 })
+            .add(http::verb::post, "/api/private_room",
+                 [](Req&& req, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                     return create_p_room(std::move(req), ctx);
+                 })
+            .add(http::verb::delete_, "/api/rooms/{id:u64}",
+                 [](Req&& req, ReqContext& ctx,
+                    const RouteParams& params) -> http::message_generator {
+                     return delete_room(std::move(req), ctx, params.id(0));
+                 })
+            .add(http::verb::post, "/api/rooms/{id:u64}/member",
+                 [](Req&& req, ReqContext& ctx,
+                    const RouteParams& params) -> http::message_generator {
+                     return invite_member(std::move(req), ctx, params.id(0));
+                 })
+            .add(http::verb::get, "/api/rooms/{id:u64}/messages",
+                 [](Req&& req, ReqContext& ctx,
+                    const RouteParams& params) -> http::message_generator {
+                     return get_messages(std::move(req), ctx, params.id(0), params.query);
+                 })
+            .add(http::verb::post, "/api/rooms/{id:u64}/read",
+                 [](Req&&, ReqContext& ctx, const RouteParams& params) -> http::message_generator {
+                     return mark_read(ctx, params.id(0));
+                 })
+            .add(http::verb::get, "/users/me/rooms",
+                 [](Req&&, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                     return query_rooms(ctx);
+                 })
+            .add(http::verb::get, "/metrics",
+                 [](Req&&, ReqContext& ctx, const RouteParams&) -> http::message_generator {
+                     return handle_metrics(ctx);
+                 })
+            .add(http::verb::get, "/assets/{*}",
+                 [](Req&& req, ReqContext& ctx,
+                    const RouteParams& params) -> http::message_generator {
+                     return handle_assets(
+                         ctx, AssetRequest{
+                                  .path = params.tail,
+                                  .if_none_match = header_value(req, http::field::if_none_match),
+                                  .if_modified_since =
+                                      header_value(req, http::field::if_modified_since),
+                                  .accept_encoding =
+                                      header_value(req, http::field::accept_encoding),
+                                  .range = header_value(req, http::field::range),
+                                  .if_range = header_value(req, http::field::if_range)});
+                 });
+        return r;
+    }
+
+    // 从路由拆出的查询字符串中提取参数，不存在时返回空
+    // 例：before=123&limit=20
+    static std::string_view query_param(std::string_view query, std::string_view key);
+
+    static constexpr std::size_t DEFAULT_HISTORY_LIMIT = 50;
+    static constexpr std::size_t MAX_HISTORY_LIMIT = 100;
 
     static std::string bytes_to_hex(const unsigned char* bytes, std::size_t len);
 
     static std::string hash_password(const std::string& plain_password);
     static bool verify_password(const std::string& plain_password, const std::string& stored_hash);
 
-    static std::string generate_login_token(const std::string& username, u64 id);
 
-    static std::string_view mime_type(std::string_view path);
+    template <typename Allocator>
+    static std::string_view header_value(const api_request<Allocator>& req, http::field field) {
+        auto it = req.find(field);
+        if (it == req.end()) {
+            return {};
+        }
+        return std::string_view(it->value().data(), it->value().size());
+    }
 
-    static http::response<http::string_body> create_json_response(http::status status,
-                                                                  unsigned version, bool keep_alive,
+    // 把handle_request中解析好的请求体绑定到模型，请求体缺失或字段不匹配时返回空
+    template <typename T>
+    static std::optional<T> bind_body(const ReqContext& ctx) {
+        if (!ctx.jv_opt) {
+            return std::nullopt;
+        }
+        try {
+            return json::value_to<T>(*ctx.jv_opt);
+        } catch (const std::exception& e) {
+            spdlog::debug("Failed to bind request body for {}: {}", ctx.target, e.what());
+            return std::nullopt;
+        }
+    }
+
+    // 需要登录的接口使用，令牌在handle_request中已解码
+    static const UserClaims& require_claims(const ReqContext& ctx) {
+        if (!ctx.user_claims_opt) {
+            throw std::runtime_error("Missing or invalid authorization token");
+        }
+        return *ctx.user_claims_opt;
+    }
+
+    // 超过http_compress_min_bytes的响应按Accept-Encoding压缩，在工作线程上完成
+    // body为已经序列化好的JSON
+    static http::response<http::string_body> create_json_response(const ReqContext& ctx,
+                                                                  http::status status,
+                                                                  std::string body);
+
+    static http::response<http::string_body> create_json_response(const ReqContext& ctx,
+                                                                  http::status status,
                                                                   const json::value& jv) {
-        http::response<http::string_body> res{status, version};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, "application/json");
-        res.keep_alive(keep_alive);
-        res.body() = json::serialize(jv);
-        res.prepare_payload();
-        return res;
+        return create_json_response(ctx, status, json::serialize(jv));
     }
 
+    // 直接序列化到响应体，不构造json::value
     template <typename T>
-    static http::response<http::string_body> create_json_response(http::status status,
-                                                                  unsigned version, bool keep_alive,
-                                                                  ApiResponse<T> api_resp) {
-        http::response<http::string_body> res{status, version};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, "application/json");
-        res.keep_alive(keep_alive);
-        res.body() = json::serialize(json::value_from(api_resp));
-        res.prepare_payload();
-        return res;
+    static http::response<http::string_body> create_json_response(const ReqContext& ctx,
+                                                                  http::status status,
+                                                                  const ApiResponse<T>& api_resp) {
+        return create_json_response(ctx, status, utils::to_json(api_resp));
     }
 
     // 默认建群者是群主
     template <typename Allocator>
-    static http::message_generator create_g_room(api_request<Allocator>&& req) {
+    static http::message_generator create_g_room(api_request<Allocator>&& req,
+                                                 const ReqContext& ctx) {
         if (req.method() != http::verb::post) {
             return bad_request(std::move(req));
         }
 
-        SqlConnRAII conn;
-        try {
-            json::value jv = json::parse(req.body());
-            model::CreateGRoomReq create_g_room_req = json::value_to<model::CreateGRoomReq>(jv);
-
-            //-----事务开始-----
-            conn.begin_transaction();
+        std::optional<model::CreateGRoomReq> body = bind_body<model::CreateGRoomReq>(ctx);
+        if (!body) {
+            return bad_request(std::move(req), " Invalid request body");
+        }
+        const model::CreateGRoomReq& create_g_room_req = *body;
 
+        try {
             u64 room_id = SnowFlake::next_id();
 
-            UserClaims user_claims =
-                extract_user_claims(std::string(req[http::field::authorization]));
+            const UserClaims& user_claims = require_claims(ctx);
 
-            // 1.创建房间
-            int updated_row1 = conn.execute_update(
-                "INSERT INTO rooms (id, name, type, owner_id) VALUES (?, ?, ?, ?)", room_id,
-                create_g_room_req.name, static_cast<int>(RoomType::GROUP), user_claims.id);
-
-            if (updated_row1 != 1) {
-                throw std::runtime_error("Failed to create group room");
-            }
+            // 创建房间并添加创建者为群主
+            Storage::get().create_group_room(room_id, create_g_room_req.name, user_claims.id);
 
             spdlog::info("Created group room: {}, owner: {}", room_id, user_claims.username);
 
-            // 2.添加创建者为群主
-            int updated_row2 = conn.execute_update(
-                "INSERT INTO room_members (room_id, user_id, role) VALUES (?, ?, ?)", room_id,
-                user_claims.id, static_cast<int>(utils::GroupRole::OWNER));
-
-            if (updated_row2 != 1) {
-                throw std::runtime_error("Failed to add owner to group room");
-            }
-
-            spdlog::info("Added owner {} to group room {}", user_claims.username, room_id);
+            RoomEvents::on_rooms_changed(user_claims.id);
 
             return create_json_response(
-                http::status::ok, req.version(), req.keep_alive(),
-                json::value_from(ApiResponse<model::CreateGRoomResp>{
+                ctx, http::status::ok,
+                ApiResponse<model::CreateGRoomResp>{
                     StatusCode::Success, "Room created success, creator will be the owner.",
-                    model::CreateGRoomResp{.room_id = room_id}}));
+                    model::CreateGRoomResp{.room_id = room_id}});
 
         } catch (const std::exception& e) {
             spdlog::error("Exception during group room creation: {}", e.what());
 
-            conn.rollback();
-
             return bad_request(std::move(req), " Server Error");
         }
     }
 
     // 默认建群者是群主
     template <typename Allocator>
-    static http::message_generator create_p_room(api_request<Allocator>&& req) {
+    static http::message_generator create_p_room(api_request<Allocator>&& req,
+                                                 const ReqContext& ctx) {
         if (req.method() != http::verb::post) {
             return bad_request(std::move(req));
         }
 
-        SqlConnRAII conn;
-        try {
-            json::value jv = json::parse(req.body());
-            model::CreatePRoomReq create_p_room_req = json::value_to<model::CreatePRoomReq>(jv);
-
-            //-----事务开始-----
-            conn.begin_transaction();
+        std::optional<model::CreatePRoomReq> body = bind_body<model::CreatePRoomReq>(ctx);
+        if (!body) {
+            return bad_request(std::move(req), " Invalid request body");
+        }
+        const model::CreatePRoomReq& create_p_room_req = *body;
 
+        try {
             u64 room_id = SnowFlake::next_id();
 
-            UserClaims user_claims =
-                extract_user_claims(std::string(req[http::field::authorization]));
+            const UserClaims& user_claims = require_claims(ctx);
 
-            // 1.创建房间
-            int updated_row1 = conn.execute_update("INSERT INTO rooms (id, type) VALUES (?, ?)",
-                                                   room_id, static_cast<int>(RoomType::PRIVATE));
+            // 创建房间并添加双方
+            Storage::get().create_private_room(room_id, user_claims.id,
+                                               create_p_room_req.other_id);
 
-            if (updated_row1 != 1) {
-                throw std::runtime_error("Failed to create group room");
-            }
-
-            spdlog::info("Created private room: {}", room_id);
-
-            // 2.添加创建者为群主
-            int updated_row2 = conn.execute_update(
-                "INSERT INTO room_members (room_id, user_id, role)"
-                "VALUES (?, ?, ?), (?, ?, ?)",
-                room_id, user_claims.id, static_cast<int>(utils::GroupRole::PRIVATE_MEMBER),
-                room_id, create_p_room_req.other_id,
-                static_cast<int>(utils::GroupRole::PRIVATE_MEMBER));
-
-            if (updated_row2 != 2) {
-                throw std::runtime_error("Failed to add owner to group room");
-            }
+            spdlog::info("Created private room \"{}\" for user \"{}\" and \"{}\"", room_id,
+                         user_claims.id, create_p_room_req.other_id);
 
-            spdlog::info("Added user\"{}\" and \"{}\" to private room \"{}\"", user_claims.id,
-                         create_p_room_req.other_id, room_id);
+            RoomEvents::on_rooms_changed(user_claims.id);
+            RoomEvents::on_rooms_changed(create_p_room_req.other_id);
 
-            conn.commit();
-            spdlog::info("Transaction committed for private room {}", room_id);
-
-            return create_json_response(http::status::ok, req.version(), req.keep_alive(),
-                                        json::value_from(ApiResponse<model::CreatePRoomResp>{
-                                            StatusCode::Success, "Private room created success.",
-                                            model::CreatePRoomResp{.room_id = room_id}}));
+            return create_json_response(
+                ctx, http::status::ok,
+                ApiResponse<model::CreatePRoomResp>{StatusCode::Success,
+                                                    "Private room created success.",
+                                                    model::CreatePRoomResp{.room_id = room_id}});
 
         } catch (const std::exception& e) {
-            conn.rollback();
-
-            spdlog::error("Exception during group room creation: {}. Database rolled back",
-                          e.what());
+            spdlog::error("Exception during private room creation: {}", e.what());
 
             return bad_request(std::move(req), " Server Error");
         }
     }
 
+    // GET /api/rooms/{id}/messages?before=&limit=
+    // 以雪花id做键集分页，优先从RoomCache读取
     template <typename Allocator>
-    static http::message_generator handle_chat_room(api_request<Allocator>&& req) {
+    static http::message_generator get_messages(api_request<Allocator>&& req,
+                                                const ReqContext& ctx, u64 room_id,
+                                                std::string_view query) {
+        if (req.method() != http::verb::get) {
+            return bad_request(std::move(req), " Method Not Allowed");
+        }
+
         try {
-            std::string_view target = req.target();
-            u64 room_id = std::stoull(std::string(extract_target_param(target, 2)));
-            std::string room_verb = std::string(extract_target_param(target, 3));
+            const UserClaims& user_claims = require_claims(ctx);
+
+            u64 before = std::numeric_limits<u64>::max();
+            std::string_view before_str = query_param(query, "before");
+            if (!before_str.empty()) {
+                before = std::stoull(std::string(before_str));
+            }
+            std::size_t limit = DEFAULT_HISTORY_LIMIT;
+            std::string_view limit_str = query_param(query, "limit");
+            if (!limit_str.empty()) {
+                limit = std::clamp<std::size_t>(std::stoull(std::string(limit_str)), 1,
+                                                MAX_HISTORY_LIMIT);
+            }
 
-            if (room_verb.empty()) {
-                if (req.method() == http::verb::delete_) {
-                    return delete_room(std::move(req), room_id);
+            // 只有缓存未命中时才访问存储
+            std::optional<bool> is_member = RoomCache::get().is_member(room_id, user_claims.id);
+            if (!is_member) {
+                std::vector<u64> members = Storage::get().room_members(room_id);
+                RoomCache::get().set_members(room_id, members);
+                is_member = std::find(members.begin(), members.end(), user_claims.id) !=
+                            members.end();
+            }
+            if (!*is_member) {
+                return error_resp(std::move(req), StatusCode::Forbidden, " Permission denied");
+            }
+
+            std::optional<model::MessagePage> page =
+                RoomCache::get().query(room_id, before, limit);
+            if (!page) {
+                // 日志中还有没写入存储的消息时，查询结果可能缺少其中的消息，不能回填缓存
+                // 之后追加的消息在日志落盘后写入RoomCache，不受影响
+                bool fillable =
+                    !MessageJournal::enabled() || MessageJournal::get().pending() == 0;
+                // 多取一条用于判断是否还有更早的消息
+                page.emplace();
+                page->messages = Storage::get().messages_before(room_id, before, limit + 1);
+                page->has_more = page->messages.size() > limit;
+                if (page->has_more) {
+                    page->messages.pop_back();
+                }
+                if (fillable) {
+                    RoomCache::get().fill(room_id, before, page->messages, !page->has_more);
                 }
-            } else if (room_verb == "member") {
-                return invite_member(std::move(req), room_id);
-            } else {
-                return bad_request(std::move(req), " target not found");
             }
+
+            return create_json_response(
+                ctx, http::status::ok,
+                ApiResponse<model::MessagePage>{StatusCode::Success, "Query messages success",
+                                                std::move(*page)});
         } catch (const std::exception& e) {
-            spdlog::error("Exception in handle_chat_room: {}", e.what());
+            spdlog::error("Exception in get_messages: {}", e.what());
             return bad_request(std::move(req), " Server Error");
         }
     }
 
     // 已确认方法为delete
     template <typename Allocator>
-    static http::message_generator delete_room(api_request<Allocator>&& req, u64 room_id) {
-        SqlConnRAII conn;
-        conn.begin_transaction();
-
+    static http::message_generator delete_room(api_request<Allocator>&& req,
+                                               const ReqContext& ctx, u64 room_id) {
         try {
             // 权限检查
-            UserClaims user_claims =
-                extract_user_claims(std::string(req[http::field::authorization]));
-
-            std::unique_ptr<sql::ResultSet> role_set(conn.execute_query(
-                "SELECT role FROM room_members WHERE room_id = ? AND user_id = ?", room_id,
-                user_claims.id));
-            if (role_set->next()) {
-                int role = role_set->getInt("role");
-                if (role != static_cast<int>(utils::GroupRole::OWNER)) {
-                    return error_resp(std::move(req), StatusCode::Forbidden, " Permission denied");
-                }
-            } else {
+            const UserClaims& user_claims = require_claims(ctx);
+
+            std::optional<utils::GroupRole> role =
+                Storage::get().member_role(room_id, user_claims.id);
+            if (!role) {
                 return error_resp(std::move(req), StatusCode::BadRequest,
                                   " You are not a member in the group");
             }
-            // 权限检查通过
-
-            // 不检查群是否存在，正常情况应该存在
-
-            // 首先删除群成员
-            int deleted_member =
-                conn.execute_update("DELETE FROM room_members WHERE room_id = ?", room_id);
-
-            // 存在没有成员的群属于服务器错误
-            if (deleted_member == 0) {
-                throw std::runtime_error(std::string("There is a room \"") +
-                                         std::to_string(room_id) + "\" which has no member");
+            if (*role != utils::GroupRole::OWNER) {
+                return error_resp(std::move(req), StatusCode::Forbidden, " Permission denied");
             }
-            spdlog::info("Deleted {} members from room {}", deleted_member, room_id);
-
-            int deleted_room = conn.execute_update("DELETE FROM rooms WHERE id = ?", room_id);
+            // 权限检查通过
 
-            // 删除了群成员，但却没有删除群，属于服务器错误
-            if (deleted_room == 0) {
+            // 群主是成员，房间应该存在，删除失败属于服务器错误
+            if (!Storage::get().delete_room(room_id)) {
                 throw std::runtime_error("Failed to delete room");
             }
 
-            conn.commit();
+            RoomEvents::on_room_deleted(room_id);
 
             spdlog::info("Room {} deleted successfully", room_id);
 
             return create_json_response(
-                http::status::ok, req.version(), req.keep_alive(),
+                ctx, http::status::ok,
                 ApiResponse<std::nullptr_t>{StatusCode::Success, "Room deleted successfully",
                                             nullptr});
 
         } catch (const std::exception& e) {
-            conn.rollback();
-            spdlog::error("Exception during room deletion: {}. Database rolled back", e.what());
+            spdlog::error("Exception during room deletion: {}", e.what());
             return error_resp(std::move(req), StatusCode::BadRequest, " Server error");
         }
     }
 
     template <typename Allocator>
-    static http::message_generator invite_member(api_request<Allocator>&& req, u64 room_id) {
+    static http::message_generator invite_member(api_request<Allocator>&& req,
+                                                 const ReqContext& ctx, u64 room_id) {
         if (req.method() != http::verb::post) {
             return bad_request(std::move(req), " Method Not Allowed");
         }
         // todo: 邀请处理
-        model::GRoomInvtReq invt_req = json::value_to<model::GRoomInvtReq>(json::parse(req.body()));
-
-        SqlConnRAII conn;
-        UserClaims user_claims = extract_user_claims(std::string(req[http::field::authorization]));
+        std::optional<model::GRoomInvtReq> body = bind_body<model::GRoomInvtReq>(ctx);
+        if (!body || !ctx.user_claims_opt) {
+            return bad_request(std::move(req), " Invalid request body");
+        }
+        const model::GRoomInvtReq& invt_req = *body;
+        const UserClaims& user_claims = *ctx.user_claims_opt;
 
-        std::unique_ptr<sql::ResultSet> result_set(
-            conn.execute_query("SELECT type FROM rooms WHERE id = ?", room_id));
+        std::optional<RoomType> room_type = Storage::get().room_type(room_id);
 
-        if (!result_set->next()) {
+        if (!room_type) {
             spdlog::error("user {} trying to invited {} to a not found room {}", user_claims.id,
                           invt_req.invitee_id, room_id);
             return error_resp(std::move(req), StatusCode::BadRequest, " Room not found");
         }
 
-        if (result_set->getInt("type") != static_cast<int>(RoomType::GROUP)) {
+        if (*room_type != RoomType::GROUP) {
             spdlog::error("user {} trying to invited {} to a private room {}", user_claims.id,
                           invt_req.invitee_id, room_id);
             return error_resp(std::move(req), StatusCode::BadRequest, " Illegal request");
         }
 
-        // 此处数据库约束会帮我们确保不会重复添加同一个成员
-        int update_row = conn.execute_update(
-            "INSERT INTO room_members (room_id, user_id, role) VALUE (?, ?, ?)", room_id,
-            invt_req.invitee_id, static_cast<int>(utils::GroupRole::MEMBER));
-
-        if (update_row != 1) {
+        // 已经是成员时返回false，不会重复添加
+        if (!Storage::get().add_member(room_id, invt_req.invitee_id, utils::GroupRole::MEMBER)) {
             spdlog::error("Failed to invite user {} to room {}", invt_req.invitee_id, room_id);
             return bad_request(std::move(req), " Invite failed");
         }
 
+        RoomEvents::on_member_added(room_id, invt_req.invitee_id);
+
         spdlog::info("User {} invited {} to group room {} and added to group success",
                      user_claims.id, invt_req.invitee_id, room_id);
 
         return create_json_response(
-            http::status::ok, req.version(), req.keep_alive(),
-            json::value_from(ApiResponse<std::nullptr_t>{
-                StatusCode::Success, "Invitee successfully added to the group", nullptr}));
+            ctx, http::status::ok,
+            ApiResponse<std::nullptr_t>{StatusCode::Success,
+                                        "Invitee successfully added to the group", nullptr});
     }
 
     template <typename Allocator>
@@ -458,46 +604,28 @@ private:
                                                         const std::string& msg = std::string(""));
 
     template <typename Allocator>
-    static http::message_generator handle_login(api_request<Allocator>&& req) {
+    static http::message_generator handle_login(api_request<Allocator>&& req,
+                                                const ReqContext& ctx) {
         if (req.method() == http::verb::post) {
             // Handle login logic here
-            json::value parsed_json;
-            beast::error_code ec;
-
-            parsed_json = json::parse(req.body(), ec);
-            if (ec) {
-                spdlog::warn("JSON parsed fail for /login: {}", ec.message());
-                return bad_request(std::move(req), "Invalid JSON format");
+            std::optional<model::LoginRequest> body = bind_body<model::LoginRequest>(ctx);
+            if (!body) {
+                return bad_request(std::move(req), " Invalid request body");
             }
+            const model::LoginRequest& login_request = *body;
 
-            model::LoginRequest login_request = json::value_to<model::LoginRequest>(parsed_json);
-
-            SqlConnRAII conn;
+            std::optional<Storage::UserRecord> record =
+                Storage::get().find_user(login_request.username);
 
-            std::unique_ptr<sql::ResultSet> result_set(conn.execute_query(
-                "SELECT id, password_hash, nickname, email, avatar_url, created_at FROM "
-                "users WHERE username = ?",
-                login_request.username));
-
-            if (result_set->next()) {
-                std::string hasd_pwd = result_set->getString("password_hash");
-
-                if (!verify_password(login_request.password, hasd_pwd)) {
+            if (record) {
+                if (!verify_password(login_request.password, record->password_hash)) {
                     spdlog::debug("Login failed for username: {}, password incorrect.",
                                   login_request.username);
                     ApiResponse resp{StatusCode::IncorrectPwd, "Password incorrect", nullptr};
-                    return create_json_response(http::status::unauthorized, req.version(),
-                                                req.keep_alive(), json::value_from(resp));
+                    return create_json_response(ctx, http::status::unauthorized, resp);
                 }
 
-                User user{
-                    .id = result_set->getUInt64("id"),
-                    .username = login_request.username,
-                    .nickname = result_set->getString("nickname"),
-                    .email = result_set->getString("email"),
-                    .avatar_url = result_set->getString("avatar_url"),
-                    .created_at = result_set->getString("created_at"),
-                };
+                const User& user = record->user;
 
                 std::string token = generate_login_token(login_request.username, user.id);
 
@@ -505,15 +633,13 @@ private:
 
                 ApiResponse resp{StatusCode::Success, "Login successful", login_resp};
 
-                return create_json_response(http::status::ok, req.version(), req.keep_alive(),
-                                            json::value_from(resp));
+                return create_json_response(ctx, http::status::ok, resp);
             } else {
                 spdlog::debug("Login failed for username: {}, user not found.",
                               login_request.username);
                 ApiResponse resp{StatusCode::UserNotFound, "User not found", nullptr};
 
-                return create_json_response(http::status::not_found, req.version(),
-                                            req.keep_alive(), json::value_from(resp));
+                return create_json_response(ctx, http::status::not_found, resp);
             }
 
         } else {
@@ -521,69 +647,104 @@ private:
         }
     }
 
+    // GET /users/me/rooms
+    // 一次联表查询得到房间信息、最后一条消息预览和未读数，结果按用户缓存
     static http::message_generator query_rooms(const ReqContext& ctx) {
         try {
             if (ctx.method != http::verb::get) {
                 return error_resp(ctx, StatusCode::BadRequest, " Method Not Allowed");
             }
+            const UserClaims& user_claims = require_claims(ctx);
 
-            std::vector<Room> rooms;
-            SqlConnRAII conn;
+            if (auto cached = RoomSummaryCache::get().query(user_claims.id)) {
+                return create_json_response(
+                    ctx, http::status::ok,
+                    ApiResponse<std::vector<model::RoomSummary>>{
+                        StatusCode::Success, "Query rooms success", std::move(*cached)});
+            }
 
-            // std::unique_ptr<sql::ResultSet> result_set(
-            //     conn.execute_query("SELECT id, name, type, description, avatar_url, "
-            //                        "last_message_id, memeber_cout, created_at FROM users WHERE"
-            //                        ));
-            std::unique_ptr<sql::ResultSet> room_ids(conn.execute_query(
-                "SELECT room_id FROM room_members WHERE user_id = ?", ctx.user_claims_opt->id));
+            // 与get_messages相同，日志中还有没写入存储的消息时预览和未读数可能不全，不能缓存
+            bool cacheable = !MessageJournal::enabled() || MessageJournal::get().pending() == 0;
+            RoomSummaryCache::get().begin_load(user_claims.id);
+            std::vector<model::RoomSummary> rooms;
+            try {
+                rooms = Storage::get().room_summaries(user_claims.id,
+                                                      RoomSummaryCache::PREVIEW_CHARS);
+            } catch (...) {
+                RoomSummaryCache::get().cancel_load(user_claims.id);
+                throw;
+            }
+            if (cacheable) {
+                RoomSummaryCache::get().put(user_claims.id, rooms);
+            } else {
+                RoomSummaryCache::get().cancel_load(user_claims.id);
+            }
 
+            return create_json_response(ctx, http::status::ok,
+                                        ApiResponse<std::vector<model::RoomSummary>>{
+                                            StatusCode::Success, "Query rooms success",
+                                            std::move(rooms)});
         } catch (const std::exception& e) {
             spdlog::error("Exception in query_rooms: {}", e.what());
             return error_resp(ctx, StatusCode::InternalServerError, " Server Error");
         }
     }
 
+    // POST /api/rooms/{id}/read
+    // 已读位置只前进不后退
+    static http::message_generator mark_read(const ReqContext& ctx, u64 room_id) {
+        try {
+            const UserClaims& user_claims = require_claims(ctx);
+            std::optional<model::MarkReadReq> body = bind_body<model::MarkReadReq>(ctx);
+            if (!body) {
+                return error_resp(ctx, StatusCode::BadRequest, " Invalid request body");
+            }
+
+            if (!Storage::get().mark_read(room_id, user_claims.id, body->message_id)) {
+                return error_resp(ctx, StatusCode::Forbidden, " Permission denied");
+            }
+
+            RoomEvents::on_read(user_claims.id, room_id, body->message_id);
+
+            return create_json_response(
+                ctx, http::status::ok,
+                ApiResponse<std::nullptr_t>{StatusCode::Success, "Mark read success", nullptr});
+        } catch (const std::exception& e) {
+            spdlog::error("Exception in mark_read: {}", e.what());
+            return error_resp(ctx, StatusCode::InternalServerError, " Server Error");
+        }
+    }
+
     template <typename Allocator>
-    static http::message_generator handle_register(api_request<Allocator>&& req) {
+    static http::message_generator handle_register(api_request<Allocator>&& req,
+                                                   const ReqContext& ctx) {
         if (req.method() == http::verb::post) {
             try {
-                beast::error_code ec;
-                json::value jv = json::parse(req.body(), ec);
-                if (ec) {
-                    spdlog::warn("JSON parsed fail for /register: {}", ec.message());
-                    return bad_request(std::move(req), "Invalid JSON format");
+                std::optional<model::RegisterRequest> body = bind_body<model::RegisterRequest>(ctx);
+                if (!body) {
+                    return bad_request(std::move(req), " Invalid request body");
                 }
-                model::RegisterRequest register_request =
-                    json::value_to<model::RegisterRequest>(jv);
-                SqlConnRAII conn;
+                const model::RegisterRequest& register_request = *body;
                 std::string hashed_pwd = hash_password(register_request.password);
-                u64 id = SnowFlake::next_id();
-                int updated_row = conn.execute_update(
-                    "INSERT INTO users (id, username, password_hash, email, nickname) "
-                    "VALUES (?, ?, ?, ?, ?)",
-                    id, register_request.username, hashed_pwd, register_request.email,
-                    register_request.nickname);
-
-                if (updated_row == 1) {
+                User user{.id = SnowFlake::next_id(),
+                          .username = register_request.username,
+                          .nickname = register_request.nickname,
+                          .email = register_request.email};
+
+                if (Storage::get().create_user(user, hashed_pwd)) {
                     ApiResponse resp{StatusCode::Success, "Registration successful", nullptr};
-                    json::value resp_json = json::value_from(resp);
 
                     spdlog::debug("User registered successfully: {}", register_request.username);
 
-                    return create_json_response(http::status::ok, req.version(), req.keep_alive(),
-                                                resp_json);
-                } else if (updated_row == 0) {
+                    return create_json_response(ctx, http::status::ok, resp);
+                } else {
+                    // 用户名已存在
                     spdlog::debug("Registration failed for username: {}",
                                   register_request.username);
 
                     ApiResponse resp{StatusCode::RegFailed, "Register Failed", nullptr};
 
-                    return create_json_response(http::status::bad_request, req.version(),
-                                                req.keep_alive(), json::value_from(resp));
-                } else {
-                    spdlog::error("Unexpected error during registration for username: {}",
-                                  register_request.username);
-                    return bad_request(std::move(req), "Server Error");
+                    return create_json_response(ctx, http::status::bad_request, resp);
                 }
 
             } catch (const std::exception& e) {
@@ -596,7 +757,12 @@ private:
         }
     }
 
-    static http::message_generator handle_assets(const ReqContext& ctx);
+    // 静态文件走AssetCache，支持条件请求、预压缩版本和单区间Range
+    // 超大文件在Linux上设置ctx.file，由HttpSession用sendfile发送
+    static http::message_generator handle_assets(ReqContext& ctx, const AssetRequest& asset_req);
+
+    // Prometheus文本格式的运行指标
+    static http::message_generator handle_metrics(const ReqContext& ctx);
 };
 
 template <typename T>
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "core/room_cache.hpp"
+
+namespace tcs {
+namespace core {
+// 成员集合每项的近似开销
+static constexpr std::size_t MEMBER_BYTES = 2 * sizeof(u64);
+
+void RoomCache::configure(std::size_t budget_bytes, std::size_t room_capacity) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    budget_bytes_ = budget_bytes;
+    room_capacity_ = room_capacity;
+}
+
+RoomCache::RoomEntry& RoomCache::touch(u64 room_id) {
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        lru_.push_front(room_id);
+        it = rooms_.emplace(room_id, RoomEntry{}).first;
+        it->second.lru_it = lru_.begin();
+    } else {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+    }
+    return it->second;
+}
+
+void RoomCache::pop_oldest(RoomEntry& entry) {
+    std::size_t bytes = message_bytes(entry.messages.front());
+    entry.bytes -= bytes;
+    total_bytes_ -= bytes;
+    entry.messages.pop_front();
+    entry.complete = false;
+}
+
+void RoomCache::evict_over_budget(u64 keep_room_id) {
+    while (total_bytes_ > budget_bytes_ && !lru_.empty()) {
+        u64 victim = lru_.back();
+        if (victim == keep_room_id) {
+            break;
+        }
+        auto it = rooms_.find(victim);
+        total_bytes_ -= it->second.bytes;
+        lru_.pop_back();
+        rooms_.erase(it);
+    }
+}
+
+void RoomCache::append(const model::Message& msg) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    RoomEntry& entry = touch(msg.room_id);
+    auto& messages = entry.messages;
+
+    if (messages.empty() || messages.back().id < msg.id) {
+        messages.push_back(msg);
+    } else {
+        // 并发提交可能乱序到达，插入到对应位置
+        // 比最旧一条还旧的消息无法保证连续性，只留在数据库中
+        if (msg.id < messages.front().id) {
+            return;
+        }
+        auto pos = std::lower_bound(
+            messages.begin(), messages.end(), msg.id,
+            [](const model::Message& m, u64 id) { return m.id < id; });
+        if (pos != messages.end() && pos->id == msg.id) {
+            return;
+        }
+        messages.insert(pos, msg);
+    }
+
+    std::size_t bytes = message_bytes(msg);
+    entry.bytes += bytes;
+    total_bytes_ += bytes;
+
+    if (messages.size() > room_capacity_) {
+        pop_oldest(entry);
+    }
+    evict_over_budget(msg.room_id);
+}
+
+std::optional<model::MessagePage> RoomCache::query(u64 room_id, u64 before, std::size_t limit) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return std::nullopt;
+    }
+    RoomEntry& entry = touch(room_id);
+    const auto& messages = entry.messages;
+
+    auto end = std::lower_bound(messages.begin(), messages.end(), before,
+                                [](const model::Message& m, u64 id) { return m.id < id; });
+    std::size_t available = std::distance(messages.begin(), end);
+
+    // 缓存中不足limit条且不确定更早的消息是否存在
+    if (available < limit && !entry.complete) {
+        return std::nullopt;
+    }
+
+    model::MessagePage page;
+    std::size_t count = std::min(available, limit);
+    page.messages.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        --end;
+        page.messages.push_back(*end);
+    }
+    page.has_more = available > limit || !entry.complete;
+    return page;
+}
+
+void RoomCache::fill(u64 room_id, u64 before, const std::vector<model::Message>& page,
+                     bool reached_start) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    bool empty = it == rooms_.end() || it->second.messages.empty();
+
+    // 只有与缓存衔接(或缓存为空且是最新一页)时才能保证连续
+    if (empty) {
+        if (before != std::numeric_limits<u64>::max()) {
+            return;
+        }
+    } else if (before < it->second.messages.front().id) {
+        return;
+    }
+
+    RoomEntry& entry = touch(room_id);
+    auto& messages = entry.messages;
+    // page为降序，只需把比缓存最旧一条更早的消息依次插到前面
+    for (const auto& msg : page) {
+        if (!messages.empty() && msg.id >= messages.front().id) {
+            continue;
+        }
+        messages.push_front(msg);
+        std::size_t bytes = message_bytes(msg);
+        entry.bytes += bytes;
+        total_bytes_ += bytes;
+    }
+    entry.complete = reached_start;
+
+    while (messages.size() > room_capacity_) {
+        pop_oldest(entry);
+    }
+    evict_over_budget(room_id);
+}
+
+std::optional<bool> RoomCache::is_member(u64 room_id, u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end() || !it->second.members) {
+        return std::nullopt;
+    }
+    return it->second.members->contains(user_id);
+}
+
+std::optional<std::vector<u64>> RoomCache::members(u64 room_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end() || !it->second.members) {
+        return std::nullopt;
+    }
+    return std::vector<u64>(it->second.members->begin(), it->second.members->end());
+}
+
+void RoomCache::set_members(u64 room_id, const std::vector<u64>& members) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    RoomEntry& entry = touch(room_id);
+    std::size_t old_bytes = entry.members ? entry.members->size() * MEMBER_BYTES : 0;
+    entry.members.emplace(members.begin(), members.end());
+    std::size_t new_bytes = entry.members->size() * MEMBER_BYTES;
+    entry.bytes = entry.bytes - old_bytes + new_bytes;
+    total_bytes_ = total_bytes_ - old_bytes + new_bytes;
+    evict_over_budget(room_id);
+}
+
+void RoomCache::add_member(u64 room_id, u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    // 未缓存成员时不需要处理，下次查询会从数据库加载
+    if (it == rooms_.end() || !it->second.members) {
+        return;
+    }
+    if (it->second.members->insert(user_id).second) {
+        it->second.bytes += MEMBER_BYTES;
+        total_bytes_ += MEMBER_BYTES;
+    }
+}
+
+void RoomCache::erase_room(u64 room_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return;
+    }
+    total_bytes_ -= it->second.bytes;
+    lru_.erase(it->second.lru_it);
+    rooms_.erase(it);
+}
+
+void RoomCache::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    rooms_.clear();
+    lru_.clear();
+    total_bytes_ = 0;
+}
+
+}  // namespace core
+}  // namespace tcs
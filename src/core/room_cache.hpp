@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "model/message.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 每个房间最近消息的内存缓存，同时缓存房间成员
+// 历史消息读取命中时不访问MySQL
+class RoomCache {
+public:
+    static RoomCache& get() {
+        static RoomCache instance;
+        return instance;
+    }
+
+    void configure(std::size_t budget_bytes, std::size_t room_capacity);
+
+    // 事务提交后写入新消息
+    void append(const model::Message& msg);
+
+    // 返回id < before的最新limit条消息(id降序)
+    // 缓存无法保证结果完整时返回nullopt，调用方应回退到数据库
+    std::optional<model::MessagePage> query(u64 room_id, u64 before, std::size_t limit);
+
+    // 用数据库查询结果(id降序，id均小于before)回填缓存
+    // reached_start表示该房间不存在更早的消息
+    void fill(u64 room_id, u64 before, const std::vector<model::Message>& page,
+              bool reached_start);
+
+    // 成员缓存，未缓存时返回nullopt
+    std::optional<bool> is_member(u64 room_id, u64 user_id);
+    std::optional<std::vector<u64>> members(u64 room_id);
+    void set_members(u64 room_id, const std::vector<u64>& members);
+    void add_member(u64 room_id, u64 user_id);
+
+    void erase_room(u64 room_id);
+
+    // 丢掉全部缓存，集群中可能漏掉了其他节点的变化时调用
+    void clear();
+
+private:
+    RoomCache() {}
+
+    struct RoomEntry {
+        // 按id升序，覆盖从最旧一条开始的连续历史
+        std::deque<model::Message> messages;
+        // 最旧一条之前已没有消息
+        bool complete = false;
+        std::optional<std::unordered_set<u64>> members;
+        std::size_t bytes = 0;
+        std::list<u64>::iterator lru_it;
+    };
+
+    static std::size_t message_bytes(const model::Message& msg) {
+        return sizeof(model::Message) + msg.content.size();
+    }
+
+    RoomEntry& touch(u64 room_id);
+    void pop_oldest(RoomEntry& entry);
+    void evict_over_budget(u64 keep_room_id);
+
+    std::mutex mtx_;
+    std::unordered_map<u64, RoomEntry> rooms_;
+    // 最近使用的房间在前
+    std::list<u64> lru_;
+    std::size_t budget_bytes_ = 64 * 1024 * 1024;
+    std::size_t room_capacity_ = 256;
+    std::size_t total_bytes_ = 0;
+};
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,88 @@
+#include <spdlog/spdlog.h>
+
+#include "core/room_cache.hpp"
+#include "core/room_events.hpp"
+#include "core/room_summary_cache.hpp"
+
+namespace tcs {
+namespace core {
+void RoomEvents::on_message(const model::Message& msg) {
+    RoomCache::get().append(msg);
+    RoomSummaryCache::get().on_message(msg);
+    if (ClusterBus::enabled()) {
+        ClusterBus::get().publish_room_event(RoomEvent{.type = RoomEvent::Type::Message,
+                                                       .room_id = msg.room_id,
+                                                       .user_id = msg.sender_id,
+                                                       .message_id = msg.id,
+                                                       .content = msg.content});
+    }
+}
+
+void RoomEvents::on_member_added(u64 room_id, u64 user_id) {
+    publish(RoomEvent{.type = RoomEvent::Type::MemberAdded, .room_id = room_id, .user_id = user_id});
+}
+
+void RoomEvents::on_room_deleted(u64 room_id) {
+    publish(RoomEvent{.type = RoomEvent::Type::RoomDeleted, .room_id = room_id});
+}
+
+void RoomEvents::on_message_retracted(u64 room_id) {
+    publish(RoomEvent{.type = RoomEvent::Type::MessageRetracted, .room_id = room_id});
+}
+
+void RoomEvents::on_rooms_changed(u64 user_id) {
+    publish(RoomEvent{.type = RoomEvent::Type::RoomsChanged, .user_id = user_id});
+}
+
+void RoomEvents::on_read(u64 user_id, u64 room_id, u64 message_id) {
+    publish(RoomEvent{.type = RoomEvent::Type::Read,
+                      .room_id = room_id,
+                      .user_id = user_id,
+                      .message_id = message_id});
+}
+
+void RoomEvents::publish(const RoomEvent& event) {
+    apply(event);
+    if (ClusterBus::enabled()) {
+        ClusterBus::get().publish_room_event(event);
+    }
+}
+
+void RoomEvents::apply(const RoomEvent& event) {
+    switch (event.type) {
+        case RoomEvent::Type::Message: {
+            model::Message msg{.id = event.message_id,
+                               .room_id = event.room_id,
+                               .sender_id = event.user_id,
+                               .content = event.content};
+            RoomCache::get().append(msg);
+            RoomSummaryCache::get().on_message(msg);
+            break;
+        }
+        case RoomEvent::Type::MemberAdded:
+            RoomCache::get().add_member(event.room_id, event.user_id);
+            // 其他成员看到的成员数也变了
+            RoomSummaryCache::get().invalidate_room(event.room_id);
+            RoomSummaryCache::get().invalidate_user(event.user_id);
+            break;
+        case RoomEvent::Type::RoomDeleted:
+        case RoomEvent::Type::MessageRetracted:
+            RoomCache::get().erase_room(event.room_id);
+            RoomSummaryCache::get().invalidate_room(event.room_id);
+            break;
+        case RoomEvent::Type::RoomsChanged:
+            RoomSummaryCache::get().invalidate_user(event.user_id);
+            break;
+        case RoomEvent::Type::Read:
+            RoomSummaryCache::get().mark_read(event.user_id, event.room_id, event.message_id);
+            break;
+    }
+}
+
+void RoomEvents::reset() {
+    RoomCache::get().clear();
+    RoomSummaryCache::get().clear();
+    spdlog::info("Room caches reset after cluster membership change");
+}
+}  // namespace core
+}  // namespace tcs
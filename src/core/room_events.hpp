@@ -0,0 +1,33 @@
+#pragma once
+
+#include "core/cluster_bus.hpp"
+#include "model/message.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 房间缓存(RoomCache、RoomSummaryCache)的写入入口
+// 本节点的变化先写入本地缓存，开启集群时再经ClusterBus发给所有对端，对端用apply写入它的缓存
+// 与对端断开或重连期间可能漏掉变化，此时reset丢掉全部缓存，之后从数据库重新加载
+class RoomEvents {
+public:
+    // 消息事务提交(或写入日志)后调用
+    static void on_message(const model::Message& msg);
+    static void on_member_added(u64 room_id, u64 user_id);
+    static void on_room_deleted(u64 room_id);
+    // 已写入缓存的消息被撤回
+    static void on_message_retracted(u64 room_id);
+    // 用户创建了房间
+    static void on_rooms_changed(u64 user_id);
+    static void on_read(u64 user_id, u64 room_id, u64 message_id);
+
+    // 对端发来的变化
+    static void apply(const RoomEvent& event);
+
+    static void reset();
+
+private:
+    static void publish(const RoomEvent& event);
+};
+}  // namespace core
+}  // namespace tcs
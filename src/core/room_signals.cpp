@@ -0,0 +1,199 @@
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
+#include "core/cluster_bus.hpp"
+#include "core/presence_directory.hpp"
+#include "core/room_cache.hpp"
+#include "core/room_signals.hpp"
+#include "core/room_summary_cache.hpp"
+#include "core/ws_session_mgr.hpp"
+#include "db/storage.hpp"
+#include "utils/enums.hpp"
+#include "utils/metrics.hpp"
+
+namespace tcs {
+namespace core {
+std::unique_ptr<RoomSignals> RoomSignals::instance_ptr_ = nullptr;
+
+void RoomSignals::init(std::chrono::milliseconds window, unsigned int user_limit) {
+    if (instance_ptr_) {
+        throw std::runtime_error("RoomSignals has already been initialized.");
+    }
+    instance_ptr_ = std::make_unique<RoomSignals>(window, user_limit);
+    RoomSignals* signals = instance_ptr_.get();
+    signals->thread_ = std::thread([signals] { signals->run(); });
+    spdlog::info("Room signals coalesced every {}ms, {} rooms per user", window.count(),
+                 user_limit);
+}
+
+RoomSignals::RoomSignals(std::chrono::milliseconds window, unsigned int user_limit)
+    : window_(window), user_limit_(user_limit) {}
+
+RoomSignals::~RoomSignals() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool RoomSignals::typing(u64 user_id, u64 room_id, bool typing) {
+    utils::Metrics& metrics = utils::Metrics::get();
+    metrics.signals_in.add();
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto& users = typing_[room_id];
+    auto it = users.find(user_id);
+    if (it != users.end()) {
+        // 同一房间内的重复通知直接覆盖，不计入限速
+        it->second = typing;
+        return true;
+    }
+    unsigned int& count = counts_[user_id];
+    if (count >= user_limit_) {
+        if (users.empty()) {
+            typing_.erase(room_id);
+        }
+        metrics.signals_dropped.add();
+        return false;
+    }
+    count++;
+    users.emplace(user_id, typing);
+    return true;
+}
+
+void RoomSignals::presence(u64 user_id, bool online) {
+    utils::Metrics::get().signals_in.add();
+    std::lock_guard<std::mutex> lock(mtx_);
+    presence_[user_id] = online;
+}
+
+std::vector<RoomSignals::Batch> RoomSignals::collect() {
+    std::unordered_map<u64, std::unordered_map<u64, bool>> typing;
+    std::unordered_map<u64, bool> presence;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        typing.swap(typing_);
+        presence.swap(presence_);
+        counts_.clear();
+    }
+
+    std::unordered_map<u64, Batch> batches;
+    auto batch_of = [&batches](u64 room_id) -> Batch& {
+        auto [it, inserted] = batches.try_emplace(room_id);
+        if (inserted) {
+            it->second.room_id = room_id;
+        }
+        return it->second;
+    };
+    for (const auto& [room_id, users] : typing) {
+        Batch& batch = batch_of(room_id);
+        for (const auto& [user_id, is_typing] : users) {
+            (is_typing ? batch.typing : batch.stopped).push_back(user_id);
+        }
+    }
+    for (const auto& [user_id, online] : presence) {
+        // 同一窗口内断开又重连，或者还连在其他节点上
+        if (!online && (WSSessionMgr::get().has_session(user_id) ||
+                        (ClusterBus::enabled() &&
+                         !PresenceDirectory::get().nodes_of(user_id).empty()))) {
+            continue;
+        }
+        for (u64 room_id : rooms_of(user_id)) {
+            Batch& batch = batch_of(room_id);
+            (online ? batch.online : batch.offline).push_back(user_id);
+        }
+    }
+
+    std::vector<Batch> result;
+    result.reserve(batches.size());
+    for (auto& [room_id, batch] : batches) {
+        result.push_back(std::move(batch));
+    }
+    return result;
+}
+
+std::string RoomSignals::encode(const Batch& batch) {
+    std::string out;
+    out.reserve(64 + (batch.typing.size() + batch.stopped.size() + batch.online.size() +
+                      batch.offline.size()) *
+                         24);
+    out += "{\"type\":";
+    out += std::to_string(static_cast<int>(utils::ServerRespType::RoomSignals));
+    out += ",\"data\":{\"room_id\":\"";
+    out += std::to_string(batch.room_id);
+    out += '"';
+    auto put_ids = [&out](const char* name, const std::vector<u64>& ids) {
+        out += ",\"";
+        out += name;
+        out += "\":[";
+        for (std::size_t i = 0; i < ids.size(); i++) {
+            if (i > 0) {
+                out += ',';
+            }
+            out += '"';
+            out += std::to_string(ids[i]);
+            out += '"';
+        }
+        out += ']';
+    };
+    put_ids("typing", batch.typing);
+    put_ids("stopped", batch.stopped);
+    put_ids("online", batch.online);
+    put_ids("offline", batch.offline);
+    out += "}}";
+    return out;
+}
+
+void RoomSignals::run() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!cv_.wait_for(lock, window_, [this] { return stop_; })) {
+        lock.unlock();
+        try {
+            for (Batch& batch : collect()) {
+                std::vector<u64> members = members_of(batch.room_id);
+                // 输入状态只接受房间成员的，上下线本来就按成员所在的房间展开
+                std::unordered_set<u64> member_set(members.begin(), members.end());
+                std::erase_if(batch.typing, [&](u64 id) { return !member_set.contains(id); });
+                std::erase_if(batch.stopped, [&](u64 id) { return !member_set.contains(id); });
+                if (batch.typing.empty() && batch.stopped.empty() && batch.online.empty() &&
+                    batch.offline.empty()) {
+                    continue;
+                }
+                WSSessionMgr::get().fan_out(
+                    members, WsPayload{.json = std::make_shared<const std::string>(encode(batch))});
+                utils::Metrics::get().signal_fanouts.add();
+            }
+        } catch (const std::exception& e) {
+            spdlog::error("Exception in room signals: {}", e.what());
+        }
+        lock.lock();
+    }
+}
+
+std::vector<u64> RoomSignals::rooms_of(u64 user_id) {
+    if (auto cached = RoomSummaryCache::get().query(user_id)) {
+        std::vector<u64> room_ids;
+        room_ids.reserve(cached->size());
+        for (const auto& summary : *cached) {
+            room_ids.push_back(summary.room.id);
+        }
+        return room_ids;
+    }
+    // 未命中时只查房间id，不在信号线程上计算预览和未读数
+    return db::Storage::get().rooms_of(user_id);
+}
+
+std::vector<u64> RoomSignals::members_of(u64 room_id) {
+    if (auto cached = RoomCache::get().members(room_id)) {
+        return std::move(*cached);
+    }
+    std::vector<u64> members = db::Storage::get().room_members(room_id);
+    RoomCache::get().set_members(room_id, members);
+    return members;
+}
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 正在输入和上下线通知：不落库，按房间合并一个窗口内的变化，每个房间每个窗口只群发一次
+// 同一用户在同一房间的多次变化只保留最后一次；每个用户一个窗口内最多在user_limit个房间发出通知
+// 成员和上线用户所在的房间在窗口结束时按房间查一次，优先使用缓存
+class RoomSignals {
+public:
+    // 一个房间在一个窗口内的变化
+    struct Batch {
+        u64 room_id;
+        std::vector<u64> typing;
+        std::vector<u64> stopped;
+        std::vector<u64> online;
+        std::vector<u64> offline;
+    };
+
+    static bool enabled() { return instance_ptr_ != nullptr; }
+
+    static RoomSignals& get() {
+        if (!instance_ptr_) {
+            throw std::runtime_error("RoomSignals has not been initialized. Call init() first.");
+        }
+        return *instance_ptr_;
+    }
+
+    // 启动按窗口群发的线程
+    static void init(std::chrono::milliseconds window, unsigned int user_limit);
+
+    static void shutdown() { instance_ptr_.reset(); }
+
+    // 不启动线程，由调用者取出合并结果
+    RoomSignals(std::chrono::milliseconds window, unsigned int user_limit);
+    ~RoomSignals();
+
+    // 超过限速时丢弃并返回false
+    bool typing(u64 user_id, u64 room_id, bool typing);
+
+    // 本节点上的会话上线或下线
+    void presence(u64 user_id, bool online);
+
+    // 取出当前窗口的变化，上下线展开到用户所在的每个房间
+    // 下线时该用户仍有会话(本节点或其他节点)的不再通知
+    std::vector<Batch> collect();
+
+    // {"type":6,"data":{"room_id":"1","typing":["2"],"stopped":[],"online":[],"offline":[]}}
+    static std::string encode(const Batch& batch);
+
+private:
+    void run();
+    // 上线用户所在的房间
+    static std::vector<u64> rooms_of(u64 user_id);
+    static std::vector<u64> members_of(u64 room_id);
+
+    std::chrono::milliseconds window_;
+    unsigned int user_limit_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    // 房间到用户的最新输入状态
+    std::unordered_map<u64, std::unordered_map<u64, bool>> typing_;
+    // 用户的最新在线状态
+    std::unordered_map<u64, bool> presence_;
+    // 本窗口内每个用户发出通知的房间数
+    std::unordered_map<u64, unsigned int> counts_;
+
+    std::thread thread_;
+
+    static std::unique_ptr<RoomSignals> instance_ptr_;
+};
+}  // namespace core
+}  // namespace tcs
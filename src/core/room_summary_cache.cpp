@@ -0,0 +1,209 @@
+#include <algorithm>
+
+#include "core/room_summary_cache.hpp"
+
+namespace tcs {
+namespace core {
+void RoomSummaryCache::configure(std::size_t user_capacity) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    user_capacity_ = user_capacity;
+}
+
+std::string RoomSummaryCache::preview(std::string_view content) {
+    std::size_t chars = 0;
+    for (std::size_t i = 0; i < content.size(); i++) {
+        // UTF-8后续字节为10xxxxxx，不计为新字符
+        if ((static_cast<unsigned char>(content[i]) & 0xC0) != 0x80) {
+            if (chars == PREVIEW_CHARS) {
+                return std::string(content.substr(0, i));
+            }
+            ++chars;
+        }
+    }
+    return std::string(content);
+}
+
+std::optional<std::vector<model::RoomSummary>> RoomSummaryCache::query(u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = users_.find(user_id);
+    if (it == users_.end()) {
+        return std::nullopt;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+
+    std::vector<model::RoomSummary> rooms;
+    rooms.reserve(it->second.rooms.size());
+    for (const auto& [room_id, summary] : it->second.rooms) {
+        rooms.push_back(summary);
+    }
+    std::sort(rooms.begin(), rooms.end(),
+              [](const model::RoomSummary& a, const model::RoomSummary& b) {
+                  return a.room.last_message_id > b.room.last_message_id;
+              });
+    return rooms;
+}
+
+void RoomSummaryCache::begin_load(u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto [it, inserted] = loading_.try_emplace(user_id);
+    // 同一用户并发加载时，两次结果都不可信
+    if (!inserted) {
+        it->second.dirty = true;
+    }
+}
+
+void RoomSummaryCache::put(u64 user_id, const std::vector<model::RoomSummary>& rooms) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto pending = loading_.find(user_id);
+    if (pending == loading_.end()) {
+        return;
+    }
+    bool stale = pending->second.dirty;
+    for (const auto& summary : rooms) {
+        if (stale) {
+            break;
+        }
+        stale = pending->second.touched_rooms.contains(summary.room.id);
+    }
+    loading_.erase(pending);
+    if (stale) {
+        return;
+    }
+
+    erase_user(user_id);
+    lru_.push_front(user_id);
+    UserEntry& entry = users_[user_id];
+    entry.lru_it = lru_.begin();
+    for (const auto& summary : rooms) {
+        entry.rooms.emplace(summary.room.id, summary);
+        room_users_[summary.room.id].insert(user_id);
+    }
+
+    while (users_.size() > user_capacity_ && !lru_.empty()) {
+        erase_user(lru_.back());
+    }
+}
+
+void RoomSummaryCache::cancel_load(u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    loading_.erase(user_id);
+}
+
+void RoomSummaryCache::on_message(const model::Message& msg) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    touch_room(msg.room_id);
+
+    auto it = room_users_.find(msg.room_id);
+    if (it == room_users_.end()) {
+        return;
+    }
+    std::string text = preview(msg.content);
+    for (u64 user_id : it->second) {
+        model::RoomSummary& summary = users_[user_id].rooms[msg.room_id];
+        // 并发提交可能乱序到达，预览只保留id最大的一条
+        if (msg.id > summary.room.last_message_id) {
+            summary.room.last_message_id = msg.id;
+            summary.last_sender_id = msg.sender_id;
+            summary.last_preview = text;
+        }
+        // 与数据库查询一致，自己发送的消息不计入未读
+        if (msg.sender_id != user_id && msg.id > summary.last_read_message_id) {
+            ++summary.unread_count;
+        }
+    }
+}
+
+void RoomSummaryCache::mark_read(u64 user_id, u64 room_id, u64 message_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (auto pending = loading_.find(user_id); pending != loading_.end()) {
+        pending->second.dirty = true;
+    }
+
+    auto it = users_.find(user_id);
+    if (it == users_.end()) {
+        return;
+    }
+    auto room_it = it->second.rooms.find(room_id);
+    if (room_it == it->second.rooms.end()) {
+        return;
+    }
+    model::RoomSummary& summary = room_it->second;
+    if (message_id <= summary.last_read_message_id) {
+        return;
+    }
+    if (message_id >= summary.room.last_message_id) {
+        summary.last_read_message_id = message_id;
+        summary.unread_count = 0;
+    } else {
+        // 只读到中间某条时剩余未读数未知，重新加载
+        erase_user(user_id);
+    }
+}
+
+void RoomSummaryCache::invalidate_user(u64 user_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (auto pending = loading_.find(user_id); pending != loading_.end()) {
+        pending->second.dirty = true;
+    }
+    erase_user(user_id);
+}
+
+void RoomSummaryCache::invalidate_room(u64 room_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    touch_room(room_id);
+
+    auto it = room_users_.find(room_id);
+    if (it == room_users_.end()) {
+        return;
+    }
+    std::vector<u64> user_ids(it->second.begin(), it->second.end());
+    for (u64 user_id : user_ids) {
+        erase_user(user_id);
+    }
+}
+
+void RoomSummaryCache::clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& [user_id, pending] : loading_) {
+        pending.dirty = true;
+        pending.touched_rooms.clear();
+    }
+    users_.clear();
+    room_users_.clear();
+    lru_.clear();
+}
+
+void RoomSummaryCache::erase_user(u64 user_id) {
+    auto it = users_.find(user_id);
+    if (it == users_.end()) {
+        return;
+    }
+    for (const auto& [room_id, summary] : it->second.rooms) {
+        auto room_it = room_users_.find(room_id);
+        if (room_it == room_users_.end()) {
+            continue;
+        }
+        room_it->second.erase(user_id);
+        if (room_it->second.empty()) {
+            room_users_.erase(room_it);
+        }
+    }
+    lru_.erase(it->second.lru_it);
+    users_.erase(it);
+}
+
+void RoomSummaryCache::touch_room(u64 room_id) {
+    for (auto& [user_id, pending] : loading_) {
+        if (pending.dirty) {
+            continue;
+        }
+        pending.touched_rooms.insert(room_id);
+        if (pending.touched_rooms.size() > MAX_TOUCHED_ROOMS) {
+            pending.dirty = true;
+            pending.touched_rooms.clear();
+        }
+    }
+}
+
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "model/message.hpp"
+#include "model/room.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 每个用户的房间列表缓存(/users/me/rooms)
+// 首次查询从数据库整体加载，之后由WSHandler在新消息提交后增量更新预览和未读数
+class RoomSummaryCache {
+public:
+    static RoomSummaryCache& get() {
+        static RoomSummaryCache instance;
+        return instance;
+    }
+
+    void configure(std::size_t user_capacity);
+
+    // 按最后一条消息id降序返回，未缓存时返回nullopt
+    std::optional<std::vector<model::RoomSummary>> query(u64 user_id);
+
+    // 从数据库加载之前调用，加载期间的更新会让随后的put作废，避免写入过期数据
+    void begin_load(u64 user_id);
+    void put(u64 user_id, const std::vector<model::RoomSummary>& rooms);
+    void cancel_load(u64 user_id);
+
+    // 消息事务提交后调用
+    void on_message(const model::Message& msg);
+
+    void mark_read(u64 user_id, u64 room_id, u64 message_id);
+
+    // 成员或房间信息变化时调用，下次查询重新加载
+    void invalidate_user(u64 user_id);
+    void invalidate_room(u64 room_id);
+    // 丢掉全部缓存，正在进行的加载也作废
+    void clear();
+
+    // 与数据库查询中的LEFT(content, N)保持一致，按UTF-8字符截断
+    static std::string preview(std::string_view content);
+    static constexpr std::size_t PREVIEW_CHARS = 64;
+
+private:
+    RoomSummaryCache() {}
+
+    struct UserEntry {
+        std::unordered_map<u64, model::RoomSummary> rooms;
+        std::list<u64>::iterator lru_it;
+    };
+
+    // 正在加载的用户，记录加载期间发生变化的房间
+    struct PendingLoad {
+        std::unordered_set<u64> touched_rooms;
+        bool dirty = false;
+    };
+    // 加载期间变化的房间超过该数量时直接作废
+    static constexpr std::size_t MAX_TOUCHED_ROOMS = 64;
+
+    void erase_user(u64 user_id);
+    void touch_room(u64 room_id);
+
+    std::mutex mtx_;
+    std::unordered_map<u64, UserEntry> users_;
+    // room_id -> 已缓存该房间的用户
+    std::unordered_map<u64, std::unordered_set<u64>> room_users_;
+    std::unordered_map<u64, PendingLoad> loading_;
+    // 最近使用的用户在前
+    std::list<u64> lru_;
+    std::size_t user_capacity_ = 4096;
+};
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "utils/net_utils.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 路由匹配得到的路径参数
+// 固定大小，匹配过程中不分配内存
+struct RouteParams {
+    static constexpr std::size_t MAX_PARAMS = 4;
+
+    std::array<u64, MAX_PARAMS> ids{};
+    std::array<std::string_view, MAX_PARAMS> strs{};
+    std::size_t id_count = 0;
+    std::size_t str_count = 0;
+    // {*} 匹配到的剩余路径，不含开头的 '/'
+    std::string_view tail;
+    // '?' 之后的查询字符串
+    std::string_view query;
+
+    u64 id(std::size_t index) const { return ids[index]; }
+    std::string_view str(std::size_t index) const { return strs[index]; }
+};
+
+enum class RouteStatus {
+    Found,
+    NotFound,
+    MethodNotAllowed,
+};
+
+// 启动时构建一次的路由前缀树
+// 模式示例：
+//   /api/login
+//   /api/rooms/{id:u64}/messages   数字参数，直接解析为u64
+//   /api/users/{name}              字符串参数
+//   /assets/{*}                    匹配剩余全部路径
+// 同一层中静态段优先于参数段，参数段之间 u64 优先于字符串
+template <typename Handler>
+class Router {
+public:
+    struct Match {
+        RouteStatus status;
+        const Handler* handler;
+    };
+
+    // method 为 http::verb::unknown 时匹配任意方法
+    Router& add(http::verb method, std::string_view pattern, Handler handler) {
+        std::size_t node = ROOT;
+        std::size_t id_params = 0;
+        std::size_t str_params = 0;
+
+        std::string_view rest = pattern;
+        std::string_view segment;
+        while (next_segment(rest, segment)) {
+            if (segment == "{*}") {
+                if (!rest.empty()) {
+                    throw std::invalid_argument("Route wildcard must be the last segment: " +
+                                                std::string(pattern));
+                }
+                node = child(nodes_[node].tail_child);
+            } else if (segment.starts_with('{') && segment.ends_with(":u64}")) {
+                ++id_params;
+                node = child(nodes_[node].u64_child);
+            } else if (segment.starts_with('{') && segment.ends_with('}')) {
+                ++str_params;
+                node = child(nodes_[node].str_child);
+            } else {
+                node = static_child(node, segment);
+            }
+        }
+
+        if (id_params > RouteParams::MAX_PARAMS || str_params > RouteParams::MAX_PARAMS) {
+            throw std::invalid_argument("Too many route params: " + std::string(pattern));
+        }
+        for (const auto& [verb, existing] : nodes_[node].handlers) {
+            if (verb == method) {
+                throw std::invalid_argument("Duplicated route: " + std::string(pattern));
+            }
+        }
+        nodes_[node].handlers.emplace_back(method, std::move(handler));
+        return *this;
+    }
+
+    Match match(http::verb method, std::string_view target, RouteParams& params) const {
+        std::size_t query_pos = target.find('?');
+        if (query_pos != std::string_view::npos) {
+            params.query = target.substr(query_pos + 1);
+            target = target.substr(0, query_pos);
+        }
+
+        std::size_t node = ROOT;
+        // 最近一个可以兜底的 {*}
+        std::size_t tail_node = NONE;
+        std::string_view tail;
+
+        std::string_view rest = target;
+        std::string_view segment;
+        while (node != NONE && next_segment(rest, segment)) {
+            const Node& cur = nodes_[node];
+            if (cur.tail_child != NONE) {
+                tail_node = cur.tail_child;
+                // segment 与 rest 在原字符串中连续
+                tail = std::string_view(segment.data(), rest.data() + rest.size() - segment.data());
+            }
+
+            std::size_t next = find_static(cur, segment);
+            if (next == NONE && cur.u64_child != NONE) {
+                u64 value = 0;
+                auto [ptr, ec] =
+                    std::from_chars(segment.data(), segment.data() + segment.size(), value);
+                if (ec == std::errc() && ptr == segment.data() + segment.size()) {
+                    if (params.id_count < RouteParams::MAX_PARAMS) {
+                        params.ids[params.id_count++] = value;
+                    }
+                    next = cur.u64_child;
+                }
+            }
+            if (next == NONE && cur.str_child != NONE) {
+                if (params.str_count < RouteParams::MAX_PARAMS) {
+                    params.strs[params.str_count++] = segment;
+                }
+                next = cur.str_child;
+            }
+            node = next;
+        }
+
+        if (node == NONE || nodes_[node].handlers.empty()) {
+            if (tail_node == NONE) {
+                return Match{.status = RouteStatus::NotFound, .handler = nullptr};
+            }
+            node = tail_node;
+            params.tail = tail;
+        }
+
+        for (const auto& [verb, handler] : nodes_[node].handlers) {
+            if (verb == method || verb == http::verb::unknown) {
+                return Match{.status = RouteStatus::Found, .handler = &handler};
+            }
+        }
+        return Match{.status = RouteStatus::MethodNotAllowed, .handler = nullptr};
+    }
+
+    Router() : nodes_(1) {}
+
+private:
+    static constexpr std::size_t ROOT = 0;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+    static constexpr std::size_t LINEAR_SEARCH_LIMIT = 8;
+
+    struct Node {
+        std::vector<std::pair<std::string, std::size_t>> statics;
+        std::size_t u64_child = NONE;
+        std::size_t str_child = NONE;
+        std::size_t tail_child = NONE;
+        std::vector<std::pair<http::verb, Handler>> handlers;
+    };
+
+    std::vector<Node> nodes_;
+
+    // 取出下一段并跳过空段
+    static bool next_segment(std::string_view& rest, std::string_view& segment) {
+        while (!rest.empty() && rest.front() == '/') {
+            rest.remove_prefix(1);
+        }
+        if (rest.empty()) {
+            return false;
+        }
+        std::size_t end = rest.find('/');
+        if (end == std::string_view::npos) {
+            end = rest.size();
+        }
+        segment = rest.substr(0, end);
+        rest.remove_prefix(end);
+        return true;
+    }
+
+    // statics 按名字有序，子节点多时二分查找
+    static std::size_t find_static(const Node& node, std::string_view segment) {
+        const auto& statics = node.statics;
+        if (statics.size() <= LINEAR_SEARCH_LIMIT) {
+            for (const auto& [name, index] : statics) {
+                if (name == segment) {
+                    return index;
+                }
+            }
+            return NONE;
+        }
+        auto it = std::lower_bound(
+            statics.begin(), statics.end(), segment,
+            [](const auto& entry, std::string_view key) { return entry.first < key; });
+        if (it != statics.end() && it->first == segment) {
+            return it->second;
+        }
+        return NONE;
+    }
+
+    // 不能持有 nodes_ 元素的引用，push_back 可能使其失效
+    std::size_t child(std::size_t& slot) {
+        if (slot == NONE) {
+            std::size_t index = nodes_.size();
+            slot = index;
+            nodes_.emplace_back();
+            return index;
+        }
+        return slot;
+    }
+
+    std::size_t static_child(std::size_t node, std::string_view segment) {
+        std::size_t found = find_static(nodes_[node], segment);
+        if (found != NONE) {
+            return found;
+        }
+        std::size_t index = nodes_.size();
+        auto& statics = nodes_[node].statics;
+        auto pos = std::lower_bound(
+            statics.begin(), statics.end(), segment,
+            [](const auto& entry, std::string_view key) { return entry.first < key; });
+        statics.emplace(pos, std::string(segment), index);
+        nodes_.emplace_back();
+        return index;
+    }
+};
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/endian/conversion.hpp>
+#include <spdlog/spdlog.h>
+
+#include "core/tcp_cluster_bus.hpp"
+#include "utils/metrics.hpp"
+
+namespace tcs {
+namespace core {
+namespace {
+void put_u32(std::string& out, std::uint32_t value) {
+    value = boost::endian::native_to_little(value);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_u64(std::string& out, u64 value) {
+    value = boost::endian::native_to_little(value);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// 从frame头部取一个整数，长度不够时返回false
+template <typename T>
+bool take(std::string_view& frame, T& value) {
+    if (frame.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, frame.data(), sizeof(T));
+    value = boost::endian::little_to_native(value);
+    frame.remove_prefix(sizeof(T));
+    return true;
+}
+
+std::string to_string(const tcp::endpoint& endpoint) {
+    return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+}
+}  // namespace
+
+TcpClusterBus::TcpClusterBus(u64 node_id, const tcp::endpoint& listen,
+                             const std::vector<tcp::endpoint>& peers, Handlers handlers)
+    : node_id_(node_id), handlers_(std::move(handlers)), ioc_(1), acceptor_(ioc_) {
+    acceptor_.open(listen.protocol());
+    acceptor_.set_option(net::socket_base::reuse_address(true));
+    acceptor_.bind(listen);
+    acceptor_.listen();
+    net::co_spawn(ioc_, accept_loop(), net::detached);
+
+    for (const tcp::endpoint& endpoint : peers) {
+        auto peer = std::make_shared<Peer>(ioc_, endpoint);
+        peers_.push_back(peer);
+        net::co_spawn(ioc_, run_peer(peer), net::detached);
+    }
+    thread_ = std::thread([this] { ioc_.run(); });
+}
+
+TcpClusterBus::~TcpClusterBus() {
+    ioc_.stop();
+    thread_.join();
+}
+
+std::vector<tcp::endpoint> TcpClusterBus::parse_peers(const std::string& peers) {
+    std::vector<tcp::endpoint> endpoints;
+    std::size_t begin = 0;
+    while (begin < peers.size()) {
+        std::size_t end = peers.find(',', begin);
+        if (end == std::string::npos) {
+            end = peers.size();
+        }
+        std::string item = peers.substr(begin, end - begin);
+        begin = end + 1;
+
+        item.erase(0, item.find_first_not_of(' '));
+        item.erase(item.find_last_not_of(' ') + 1);
+        if (item.empty()) {
+            continue;
+        }
+        std::size_t colon = item.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("Invalid cluster peer (expected host:port): " + item);
+        }
+        int port = std::stoi(item.substr(colon + 1));
+        if (port <= 0 || port > 65535) {
+            throw std::invalid_argument("Invalid cluster peer port: " + item);
+        }
+        endpoints.emplace_back(net::ip::make_address(item.substr(0, colon)),
+                               static_cast<unsigned short>(port));
+    }
+    return endpoints;
+}
+
+std::size_t TcpClusterBus::connected_peers() {
+    std::size_t count = 0;
+    for (const auto& peer : peers_) {
+        std::lock_guard<std::mutex> lock(peer->mtx);
+        count += peer->connected;
+    }
+    return count;
+}
+
+std::size_t TcpClusterBus::known_nodes() {
+    std::lock_guard<std::mutex> lock(nodes_mtx_);
+    return nodes_.size();
+}
+
+bool TcpClusterBus::send(u64 node_id, const std::vector<u64>& user_ids, const WsPayload& payload,
+                         u64 msg_id) {
+    if (user_ids.empty()) {
+        return true;
+    }
+    std::shared_ptr<Peer> peer;
+    {
+        std::lock_guard<std::mutex> lock(nodes_mtx_);
+        auto it = nodes_.find(node_id);
+        if (it != nodes_.end()) {
+            peer = it->second;
+        }
+    }
+    if (!peer) {
+        utils::Metrics::get().cluster_dropped.add();
+        return false;
+    }
+
+    const std::string& json = *payload.json;
+    std::size_t binary_size = payload.binary ? payload.binary->size() : 0;
+    std::string frame;
+    frame.reserve(4 + 1 + 8 + 4 + user_ids.size() * 8 + 4 + json.size() + binary_size);
+    put_u32(frame, 0);
+    frame += static_cast<char>(DELIVER);
+    put_u64(frame, msg_id);
+    put_u32(frame, static_cast<std::uint32_t>(user_ids.size()));
+    for (u64 user_id : user_ids) {
+        put_u64(frame, user_id);
+    }
+    put_u32(frame, static_cast<std::uint32_t>(json.size()));
+    frame += json;
+    if (payload.binary) {
+        frame += *payload.binary;
+    }
+    std::uint32_t length =
+        boost::endian::native_to_little(static_cast<std::uint32_t>(frame.size() - 4));
+    std::memcpy(frame.data(), &length, sizeof(length));
+    return enqueue(peer, frame);
+}
+
+void TcpClusterBus::publish_presence(const std::vector<PresenceUpdate>& updates) {
+    if (updates.empty() || peers_.empty()) {
+        return;
+    }
+    // 所有对端共用同一份编码
+    std::string frame = presence_frame(updates, 0, updates.size(), false);
+    for (const auto& peer : peers_) {
+        enqueue(peer, frame);
+    }
+}
+
+void TcpClusterBus::publish_room_event(const RoomEvent& event) {
+    if (peers_.empty()) {
+        return;
+    }
+    std::string frame;
+    frame.reserve(4 + 1 + 1 + 3 * 8 + event.content.size());
+    put_u32(frame, static_cast<std::uint32_t>(1 + 1 + 3 * 8 + event.content.size()));
+    frame += static_cast<char>(ROOM);
+    frame += static_cast<char>(event.type);
+    put_u64(frame, event.room_id);
+    put_u64(frame, event.user_id);
+    put_u64(frame, event.message_id);
+    frame += event.content;
+    for (const auto& peer : peers_) {
+        enqueue(peer, frame);
+    }
+}
+
+bool TcpClusterBus::enqueue(const std::shared_ptr<Peer>& peer, const std::string& frame) {
+    utils::Metrics& metrics = utils::Metrics::get();
+    std::lock_guard<std::mutex> lock(peer->mtx);
+    if (!peer->connected || peer->overflowed) {
+        metrics.cluster_dropped.add();
+        return false;
+    }
+    if (peer->pending.size() + frame.size() > MAX_PENDING_BYTES) {
+        // 丢帧后对端的缓存不再可信，断开让它在重连时重置
+        metrics.cluster_dropped.add();
+        peer->overflowed = true;
+        if (!peer->wakeup_posted) {
+            peer->wakeup_posted = true;
+            net::post(ioc_, [peer] { peer->wakeup.cancel(); });
+        }
+        return false;
+    }
+    peer->pending += frame;
+    peer->pending_frames++;
+    metrics.cluster_frames_out.add();
+    // 写协程空闲时唤醒它，正在写时这一帧并入下一次写
+    if (!peer->wakeup_posted) {
+        peer->wakeup_posted = true;
+        net::post(ioc_, [peer] { peer->wakeup.cancel(); });
+    }
+    return true;
+}
+
+std::string TcpClusterBus::hello_frame() const {
+    std::string frame;
+    put_u32(frame, 1 + 8);
+    frame += static_cast<char>(HELLO);
+    put_u64(frame, node_id_);
+    return frame;
+}
+
+std::string TcpClusterBus::presence_frame(const std::vector<PresenceUpdate>& updates,
+                                          std::size_t begin, std::size_t end, bool replace) {
+    std::size_t count = end - begin;
+    std::string frame;
+    frame.reserve(4 + 1 + 1 + 4 + count * 17);
+    put_u32(frame, static_cast<std::uint32_t>(1 + 1 + 4 + count * 17));
+    frame += static_cast<char>(PRESENCE);
+    frame += static_cast<char>(replace);
+    put_u32(frame, static_cast<std::uint32_t>(count));
+    for (std::size_t i = begin; i < end; i++) {
+        put_u64(frame, updates[i].user_id);
+        put_u64(frame, updates[i].version);
+        frame += static_cast<char>(updates[i].online);
+    }
+    return frame;
+}
+
+net::awaitable<void> TcpClusterBus::run_peer(std::shared_ptr<Peer> peer) {
+    bool reported = false;
+    for (;;) {
+        boost::system::error_code ec;
+        co_await peer->socket.async_connect(peer->endpoint,
+                                            net::redirect_error(net::use_awaitable, ec));
+        if (!ec) {
+            peer->socket.set_option(tcp::no_delay(true), ec);
+            {
+                std::lock_guard<std::mutex> lock(peer->mtx);
+                peer->connected = true;
+            }
+            u64 generation = ++peer->generation;
+            spdlog::info("Cluster peer {} connected", to_string(peer->endpoint));
+            reported = false;
+
+            // 快照在connected置位之后取，之前因未连接而丢弃的变化都已包含在内
+            // 第一帧即使为空也要发，让对端替换掉上一次连接留下的条目
+            std::string writing = hello_frame();
+            if (handlers_.snapshot) {
+                std::vector<PresenceUpdate> snapshot = handlers_.snapshot();
+                std::size_t begin = 0;
+                do {
+                    std::size_t end = std::min(begin + SNAPSHOT_CHUNK, snapshot.size());
+                    writing += presence_frame(snapshot, begin, end, begin == 0);
+                    begin = end;
+                } while (begin < snapshot.size());
+            }
+            net::co_spawn(ioc_, read_reply(peer, generation), net::detached);
+
+            std::size_t frames = 0;
+            while (!ec) {
+                if (!writing.empty()) {
+                    co_await net::async_write(peer->socket, net::buffer(writing),
+                                              net::redirect_error(net::use_awaitable, ec));
+                    if (frames > 0) {
+                        utils::Metrics::get().cluster_batch.record(frames);
+                    }
+                    writing.clear();
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(peer->mtx);
+                    if (peer->overflowed) {
+                        ec = net::error::no_buffer_space;
+                        break;
+                    }
+                    writing.swap(peer->pending);
+                    frames = peer->pending_frames;
+                    peer->pending_frames = 0;
+                    peer->wakeup_posted = false;
+                }
+                if (writing.empty()) {
+                    // 入队投递的cancel也在总线线程上执行，只会发生在这次等待开始之后
+                    peer->wakeup.expires_at(net::steady_timer::time_point::max());
+                    boost::system::error_code wait_ec;
+                    co_await peer->wakeup.async_wait(
+                        net::redirect_error(net::use_awaitable, wait_ec));
+                    // 读协程发现连接断开时关闭socket
+                    if (!peer->socket.is_open()) {
+                        ec = net::error::not_connected;
+                    }
+                }
+            }
+            if (peer->node_id) {
+                std::lock_guard<std::mutex> lock(nodes_mtx_);
+                auto it = nodes_.find(*peer->node_id);
+                if (it != nodes_.end() && it->second == peer) {
+                    nodes_.erase(it);
+                }
+                peer->node_id.reset();
+            }
+            {
+                std::lock_guard<std::mutex> lock(peer->mtx);
+                peer->connected = false;
+                peer->overflowed = false;
+                peer->pending.clear();
+                peer->pending_frames = 0;
+            }
+            spdlog::warn("Cluster peer {} disconnected: {}", to_string(peer->endpoint),
+                         ec.message());
+        } else if (!reported) {
+            // 对端未启动时每秒重试，只报告一次
+            spdlog::warn("Failed to connect cluster peer {}: {}", to_string(peer->endpoint),
+                         ec.message());
+            reported = true;
+        }
+
+        peer->socket.close(ec);
+        peer->wakeup.expires_after(std::chrono::seconds(1));
+        co_await peer->wakeup.async_wait(net::redirect_error(net::use_awaitable, ec));
+    }
+}
+
+net::awaitable<void> TcpClusterBus::read_reply(std::shared_ptr<Peer> peer, u64 generation) {
+    std::string frame;
+    try {
+        if (co_await read_frame(peer->socket, frame) && frame.front() == HELLO) {
+            std::string_view view(frame);
+            view.remove_prefix(1);
+            u64 node_id = 0;
+            if (take(view, node_id) && generation == peer->generation) {
+                peer->node_id = node_id;
+                std::lock_guard<std::mutex> lock(nodes_mtx_);
+                nodes_[node_id] = peer;
+            }
+        }
+        // 对端之后不会在这条连接上发送，读只用来发现连接断开
+        while (co_await read_frame(peer->socket, frame)) {
+        }
+    } catch (const boost::system::system_error&) {
+    }
+    // 写协程已经关闭过socket时不再打扰它的重连等待
+    if (generation == peer->generation && peer->socket.is_open()) {
+        boost::system::error_code ec;
+        peer->socket.close(ec);
+        peer->wakeup.cancel();
+    }
+}
+
+net::awaitable<void> TcpClusterBus::accept_loop() {
+    for (;;) {
+        boost::system::error_code ec;
+        tcp::socket socket =
+            co_await acceptor_.async_accept(net::redirect_error(net::use_awaitable, ec));
+        if (ec) {
+            spdlog::error("Failed to accept cluster connection: {}", ec.message());
+            continue;
+        }
+        net::co_spawn(ioc_, read_loop(std::move(socket)), net::detached);
+    }
+}
+
+net::awaitable<bool> TcpClusterBus::read_frame(tcp::socket& socket, std::string& frame) {
+    std::uint32_t length = 0;
+    co_await net::async_read(socket, net::buffer(&length, sizeof(length)), net::use_awaitable);
+    length = boost::endian::little_to_native(length);
+    if (length == 0 || length > MAX_FRAME_BYTES) {
+        co_return false;
+    }
+    frame.resize(length);
+    co_await net::async_read(socket, net::buffer(frame), net::use_awaitable);
+    co_return true;
+}
+
+net::awaitable<void> TcpClusterBus::read_loop(tcp::socket socket) {
+    u64 inbound = ++next_inbound_;
+    u64 peer_node = 0;
+    bool joined = false;
+    std::string frame;
+    try {
+        // 第一帧必须是HELLO
+        if (co_await read_frame(socket, frame) && frame.front() == HELLO) {
+            std::string_view view(frame);
+            view.remove_prefix(1);
+            joined = take(view, peer_node);
+        }
+        if (!joined) {
+            spdlog::error("Cluster connection from {} did not start with HELLO",
+                          to_string(socket.remote_endpoint()));
+            co_return;
+        }
+        inbound_[peer_node] = inbound;
+        spdlog::info("Cluster node {} joined", peer_node);
+        if (handlers_.node_up) {
+            handlers_.node_up(peer_node);
+        }
+
+        std::string reply = hello_frame();
+        co_await net::async_write(socket, net::buffer(reply), net::use_awaitable);
+        while (co_await read_frame(socket, frame)) {
+            on_frame(frame, peer_node);
+        }
+        spdlog::error("Invalid cluster frame of {} bytes from node {}", frame.size(), peer_node);
+    } catch (const boost::system::system_error& e) {
+        spdlog::info("Cluster connection from node {} closed: {}", peer_node,
+                     e.code().message());
+    }
+
+    if (!joined) {
+        co_return;
+    }
+    auto it = inbound_.find(peer_node);
+    if (it == inbound_.end() || it->second != inbound) {
+        // 该节点已经重新连上
+        co_return;
+    }
+    inbound_.erase(it);
+    if (handlers_.node_down) {
+        try {
+            handlers_.node_down(peer_node);
+        } catch (const std::exception& e) {
+            spdlog::error("Exception in cluster node {} down: {}", peer_node, e.what());
+        }
+    }
+}
+
+void TcpClusterBus::on_frame(std::string_view frame, u64 peer_node) {
+    unsigned char type = static_cast<unsigned char>(frame.front());
+    frame.remove_prefix(1);
+    try {
+        if (type == DELIVER) {
+            on_deliver(frame, peer_node);
+        } else if (type == PRESENCE) {
+            on_presence(frame, peer_node);
+        } else if (type == ROOM) {
+            on_room_event(frame, peer_node);
+        } else if (type != HELLO) {
+            spdlog::warn("Unknown cluster frame type {} from node {}", type, peer_node);
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Exception in cluster frame {} from node {}: {}", type, peer_node,
+                      e.what());
+    }
+}
+
+void TcpClusterBus::on_deliver(std::string_view frame, u64 peer_node) {
+    u64 msg_id = 0;
+    std::uint32_t count = 0;
+    if (!take(frame, msg_id) || !take(frame, count) || frame.size() / 8 < count) {
+        spdlog::warn("Truncated cluster frame from node {}", peer_node);
+        return;
+    }
+    std::vector<u64> user_ids(count);
+    for (u64& user_id : user_ids) {
+        take(frame, user_id);
+    }
+    std::uint32_t json_size = 0;
+    if (!take(frame, json_size) || frame.size() < json_size) {
+        spdlog::warn("Truncated cluster frame from node {}", peer_node);
+        return;
+    }
+    WsPayload payload{.json = std::make_shared<const std::string>(frame.substr(0, json_size))};
+    frame.remove_prefix(json_size);
+    if (!frame.empty()) {
+        payload.binary = std::make_shared<const std::string>(frame);
+    }
+
+    utils::Metrics::get().cluster_frames_in.add();
+    if (handlers_.deliver) {
+        handlers_.deliver(user_ids, payload, msg_id);
+    }
+}
+
+void TcpClusterBus::on_presence(std::string_view frame, u64 peer_node) {
+    unsigned char replace = 0;
+    std::uint32_t count = 0;
+    if (!take(frame, replace) || !take(frame, count) || frame.size() / 17 < count) {
+        spdlog::warn("Truncated cluster presence frame from node {}", peer_node);
+        return;
+    }
+    std::vector<PresenceUpdate> updates(count);
+    for (PresenceUpdate& update : updates) {
+        unsigned char online = 0;
+        take(frame, update.user_id);
+        take(frame, update.version);
+        take(frame, online);
+        update.online = online != 0;
+    }
+
+    utils::Metrics::get().cluster_frames_in.add();
+    if (handlers_.presence) {
+        handlers_.presence(peer_node, updates, replace != 0);
+    }
+}
+
+void TcpClusterBus::on_room_event(std::string_view frame, u64 peer_node) {
+    unsigned char type = 0;
+    RoomEvent event;
+    if (!take(frame, type) || !take(frame, event.room_id) || !take(frame, event.user_id) ||
+        !take(frame, event.message_id)) {
+        spdlog::warn("Truncated cluster room frame from node {}", peer_node);
+        return;
+    }
+    if (type < static_cast<unsigned char>(RoomEvent::Type::Message) ||
+        type > static_cast<unsigned char>(RoomEvent::Type::MessageRetracted)) {
+        spdlog::warn("Unknown room event type {} from node {}", type, peer_node);
+        return;
+    }
+    event.type = static_cast<RoomEvent::Type>(type);
+    event.content = frame;
+
+    utils::Metrics::get().cluster_frames_in.add();
+    if (handlers_.room_event) {
+        handlers_.room_event(event);
+    }
+}
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "core/cluster_bus.hpp"
+#include "utils/net_utils.hpp"
+
+namespace tcs {
+namespace core {
+// 基于TCP的总线，节点两两互连，使用自己的io_context和线程
+// 对每个对端建一条出向连接用来发送，对端连进来的入向连接用来接收
+// 入向连接收到HELLO后回一个HELLO，出向连接由此得知对端的节点id
+// 帧格式(整数为小端)：u32 长度(不含自身) | u8 类型 | 内容
+//   1 HELLO     u64 node_id
+//   2 DELIVER   u64 msg_id | u32 用户数 | u64 user_id... | u32 JSON长度 | JSON | 二进制编码(剩余部分)
+//   3 PRESENCE  u8 replace | u32 条数 | (u64 user_id | u64 version | u8 online)...
+//   4 ROOM      u8 事件类型 | u64 room_id | u64 user_id | u64 message_id | content(剩余部分)
+// 对端积压过多而丢帧时断开重连，让对端知道这期间的变化可能缺失
+class TcpClusterBus : public ClusterBus {
+public:
+    TcpClusterBus(u64 node_id, const tcp::endpoint& listen, const std::vector<tcp::endpoint>& peers,
+                  Handlers handlers);
+    ~TcpClusterBus() override;
+
+    bool send(u64 node_id, const std::vector<u64>& user_ids, const WsPayload& payload,
+              u64 msg_id) override;
+    void publish_presence(const std::vector<PresenceUpdate>& updates) override;
+    void publish_room_event(const RoomEvent& event) override;
+
+    // 出向连接已建立的对端数
+    std::size_t connected_peers();
+    // 出向连接已收到HELLO回复、可以按节点id发送的对端数
+    std::size_t known_nodes();
+
+    // "host:port,host:port"，host必须是IP地址
+    static std::vector<tcp::endpoint> parse_peers(const std::string& peers);
+
+private:
+    enum FrameType : unsigned char { HELLO = 1, DELIVER = 2, PRESENCE = 3, ROOM = 4 };
+
+    struct Peer {
+        Peer(net::io_context& ioc, const tcp::endpoint& endpoint)
+            : endpoint(endpoint), socket(ioc), wakeup(ioc) {}
+
+        tcp::endpoint endpoint;
+        tcp::socket socket;
+        // 等待新数据或重连间隔，入队时通过cancel唤醒
+        net::steady_timer wakeup;
+        // 以下只在总线线程上访问
+        // 每次连上加一，旧连接的读协程据此判断自己是否过期
+        u64 generation = 0;
+        // 收到HELLO回复后才知道
+        std::optional<u64> node_id;
+
+        std::mutex mtx;
+        // 下一次写出的帧，写出期间到达的帧都追加在这里
+        std::string pending;
+        std::size_t pending_frames = 0;
+        bool connected = false;
+        bool wakeup_posted = false;
+        // 积压时丢过帧，写协程断开这次连接
+        bool overflowed = false;
+    };
+
+    net::awaitable<void> run_peer(std::shared_ptr<Peer> peer);
+    // 读出向连接上对端回复的HELLO，之后只用来发现连接断开
+    net::awaitable<void> read_reply(std::shared_ptr<Peer> peer, u64 generation);
+    net::awaitable<void> accept_loop();
+    net::awaitable<void> read_loop(tcp::socket socket);
+    // 读一帧到frame，长度非法时返回false
+    net::awaitable<bool> read_frame(tcp::socket& socket, std::string& frame);
+    void on_frame(std::string_view frame, u64 peer_node);
+    void on_deliver(std::string_view frame, u64 peer_node);
+    void on_presence(std::string_view frame, u64 peer_node);
+    void on_room_event(std::string_view frame, u64 peer_node);
+
+    bool enqueue(const std::shared_ptr<Peer>& peer, const std::string& frame);
+    std::string hello_frame() const;
+    // updates中[begin, end)的一帧
+    static std::string presence_frame(const std::vector<PresenceUpdate>& updates,
+                                      std::size_t begin, std::size_t end, bool replace);
+
+    // 单个对端积压超过该值时丢弃新的帧
+    static constexpr std::size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+    static constexpr std::size_t MAX_FRAME_BYTES = 64 * 1024 * 1024;
+    // 全量在线状态按这个条数分帧
+    static constexpr std::size_t SNAPSHOT_CHUNK = 64 * 1024;
+
+    u64 node_id_;
+    Handlers handlers_;
+    net::io_context ioc_;
+    tcp::acceptor acceptor_;
+    std::vector<std::shared_ptr<Peer>> peers_;
+
+    // 节点id到出向连接
+    std::mutex nodes_mtx_;
+    std::unordered_map<u64, std::shared_ptr<Peer>> nodes_;
+
+    // 每个节点当前的入向连接编号，同一节点重连后旧连接断开时不再报告node_down
+    // 只在总线线程上访问
+    u64 next_inbound_ = 0;
+    std::unordered_map<u64, u64> inbound_;
+
+    std::thread thread_;
+};
+}  // namespace core
+}  // namespace tcs
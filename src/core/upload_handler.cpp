@@ -0,0 +1,221 @@
+#include <array>
+#include <filesystem>
+#include <stdexcept>
+
+#include <boost/beast/version.hpp>
+#include <boost/json.hpp>
+#include "spdlog/spdlog.h"
+
+#include "core/upload_handler.hpp"
+#include "core/request_handler.hpp"
+#include "db/storage.hpp"
+#include "model/attachment.hpp"
+#include "utils/config.hpp"
+#include "utils/snowflake.hpp"
+
+namespace fs = std::filesystem;
+namespace json = boost::json;
+
+using AppConfig = tcs::utils::AppConfig;
+using SnowFlake = tcs::utils::SnowFlake;
+using Storage = tcs::db::Storage;
+using StatusCode = tcs::utils::StatusCode;
+
+namespace tcs {
+namespace core {
+// 允许保留类型的上传，其余一律按application/octet-stream保存，
+// 避免上传的html/svg以同源页面的身份被浏览器执行
+static constexpr std::array<std::pair<std::string_view, std::string_view>, 8> UPLOAD_TYPES = {{
+    {"image/png", ".png"},
+    {"image/jpeg", ".jpg"},
+    {"image/gif", ".gif"},
+    {"image/webp", ".webp"},
+    {"application/pdf", ".pdf"},
+    {"text/plain", ".txt"},
+    {"application/zip", ".zip"},
+    {"application/octet-stream", ""},
+}};
+
+static http::response<http::string_body> upload_response(unsigned version, bool keep_alive,
+                                                         const model::Attachment& attachment) {
+    http::response<http::string_body> res{http::status::ok, version};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, "application/json");
+    res.keep_alive(keep_alive);
+
+    json::object obj;
+    obj["code"] = static_cast<int>(StatusCode::Success);
+    obj["message"] = "Upload success";
+    obj["data"] = json::value_from(attachment);
+    res.body() = json::serialize(obj);
+
+    res.prepare_payload();
+    return res;
+}
+
+static std::pair<std::string_view, std::string_view> upload_type(std::string_view content_type) {
+    // 去掉 ; charset=... 之类的参数
+    content_type = content_type.substr(0, content_type.find(';'));
+    while (!content_type.empty() && content_type.back() == ' ') content_type.remove_suffix(1);
+    for (const auto& type : UPLOAD_TYPES) {
+        if (beast::iequals(beast::string_view(type.first.data(), type.first.size()),
+                           beast::string_view(content_type.data(), content_type.size()))) {
+            return type;
+        }
+    }
+    return UPLOAD_TYPES.back();
+}
+
+// 相对doc_root的保存路径，扩展名由归一化后的类型决定
+static std::string upload_path(const std::string& hash, std::string_view content_type) {
+    return std::string(UploadHandler::UPLOAD_DIR) + "/" + hash.substr(0, 2) + "/" + hash +
+           std::string(upload_type(content_type).second);
+}
+
+UploadSink::UploadSink(u64 user_id, std::string_view content_type, std::string doc_root)
+    : user_id_(user_id),
+      content_type_(upload_type(content_type).first),
+      doc_root_(std::move(doc_root)) {
+    fs::path tmp_dir = fs::path(doc_root_) / UploadHandler::TMP_DIR;
+    fs::create_directories(tmp_dir);
+    tmp_path_ = (tmp_dir / (std::to_string(SnowFlake::next_id()) + ".part")).string();
+
+    file_ = std::fopen(tmp_path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Failed to create upload temp file: " + tmp_path_);
+    }
+    crypto_generichash_init(&hash_state_, nullptr, 0, crypto_generichash_BYTES);
+}
+
+UploadSink::~UploadSink() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+    if (!committed_) {
+        std::error_code ec;
+        fs::remove(tmp_path_, ec);
+    }
+}
+
+void UploadSink::write(const char* data, std::size_t len) {
+    if (std::fwrite(data, 1, len, file_) != len) {
+        throw std::runtime_error("Failed to write upload temp file: " + tmp_path_);
+    }
+    crypto_generichash_update(&hash_state_, reinterpret_cast<const unsigned char*>(data), len);
+    size_ += len;
+}
+
+const std::string& UploadSink::finish() {
+    if (std::fclose(file_) != 0) {
+        file_ = nullptr;
+        throw std::runtime_error("Failed to flush upload temp file: " + tmp_path_);
+    }
+    file_ = nullptr;
+
+    unsigned char hash[crypto_generichash_BYTES];
+    crypto_generichash_final(&hash_state_, hash, sizeof(hash));
+    char hex[crypto_generichash_BYTES * 2 + 1];
+    sodium_bin2hex(hex, sizeof(hex), hash, sizeof(hash));
+    hash_ = hex;
+    return hash_;
+}
+
+void UploadSink::commit(const std::string& dst) {
+    fs::create_directories(fs::path(dst).parent_path());
+    // 临时目录和目标目录都在doc_root下，rename是原子的
+    fs::rename(tmp_path_, dst);
+    committed_ = true;
+}
+
+std::optional<model::UserClaims> UploadHandler::authenticate(std::string_view authorization) {
+    if (authorization.empty()) {
+        return std::nullopt;
+    }
+    try {
+        return RequestHandler::extract_user_claims(std::string(authorization));
+    } catch (const std::exception& e) {
+        spdlog::debug("Upload rejected, invalid token: {}", e.what());
+        return std::nullopt;
+    }
+}
+
+http::message_generator UploadHandler::finish(UploadSink& sink, unsigned version,
+                                              bool keep_alive) {
+    try {
+        u64 quota = AppConfig::get().server().upload_quota_mb() * 1024 * 1024;
+        std::optional<model::Attachment> attachment = store(sink, Storage::get(), quota);
+        if (!attachment) {
+            return error(version, keep_alive, http::status::payload_too_large,
+                         StatusCode::QuotaExceeded, " Upload quota exceeded");
+        }
+        return upload_response(version, keep_alive, *attachment);
+    } catch (const std::exception& e) {
+        spdlog::error("Exception in upload: {}", e.what());
+        return error(version, keep_alive, http::status::internal_server_error,
+                     StatusCode::UploadFailed, " Upload failed");
+    }
+}
+
+std::optional<model::Attachment> UploadHandler::store(UploadSink& sink, db::Storage& storage,
+                                                      u64 quota) {
+    const std::string& hash = sink.finish();
+
+    // 同一用户重复上传同一文件，直接返回已有记录，不重复计入配额
+    // 文件按第一次上传时的类型保存，url的扩展名也要按已有记录的类型
+    std::optional<model::Attachment> existing = storage.find_attachment(sink.user_id(), hash);
+    if (existing) {
+        existing->url = "/assets/" + upload_path(hash, existing->content_type);
+        spdlog::debug("User {} re-uploaded attachment {}", sink.user_id(), existing->id);
+        return existing;
+    }
+
+    u64 used = storage.attachment_usage(sink.user_id());
+    if (used + sink.size() > quota) {
+        spdlog::info("User {} exceeded upload quota: {} + {} > {}", sink.user_id(), used,
+                     sink.size(), quota);
+        return std::nullopt;
+    }
+
+    // 只保存允许的类型，其余记为application/octet-stream
+    std::string_view content_type = upload_type(sink.content_type()).first;
+    std::string rel_path = upload_path(hash, content_type);
+
+    // 内容相同的文件只保存一份，其他用户上传时只增加记录
+    fs::path dst = fs::path(sink.doc_root()) / rel_path;
+    std::error_code ec;
+    if (!fs::exists(dst, ec)) {
+        sink.commit(dst.string());
+    }
+
+    model::Attachment attachment{.id = SnowFlake::next_id(),
+                                 .url = "/assets/" + rel_path,
+                                 .hash = hash,
+                                 .size = sink.size(),
+                                 .content_type = std::string(content_type)};
+    storage.add_attachment(sink.user_id(), attachment);
+
+    spdlog::info("User {} uploaded attachment {} ({} bytes, {})", sink.user_id(), attachment.id,
+                 sink.size(), hash);
+    return attachment;
+}
+
+http::response<http::string_body> UploadHandler::error(unsigned version, bool keep_alive,
+                                                       http::status status, StatusCode code,
+                                                       const std::string& msg) {
+    http::response<http::string_body> res{status, version};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, "application/json");
+    res.keep_alive(keep_alive);
+
+    json::object obj;
+    obj["code"] = static_cast<int>(code);
+    obj["message"] = "Bad Request" + msg;
+    obj["data"] = nullptr;
+    res.body() = json::serialize(obj);
+
+    res.prepare_payload();
+    return res;
+}
+
+}  // namespace core
+}  // namespace tcs
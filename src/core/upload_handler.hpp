@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "sodium.h"
+
+#include "db/storage.hpp"
+#include "model/attachment.hpp"
+#include "model/auth_models.hpp"
+#include "utils/enums.hpp"
+#include "utils/net_utils.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 一次上传的落盘和哈希状态
+// 读循环每收到一块正文调用一次write，内存占用与上传大小无关
+class UploadSink {
+public:
+    // content_type按允许的类型归一化，临时文件建在doc_root下
+    UploadSink(u64 user_id, std::string_view content_type, std::string doc_root);
+    // 未被提交时删除临时文件
+    ~UploadSink();
+
+    UploadSink(const UploadSink&) = delete;
+    UploadSink& operator=(const UploadSink&) = delete;
+
+    void write(const char* data, std::size_t len);
+
+    // 写完最后一块后调用，关闭文件并返回内容哈希(hex)
+    const std::string& finish();
+
+    // 把临时文件移动到dst，之后析构不再删除
+    void commit(const std::string& dst);
+
+    u64 user_id() const { return user_id_; }
+    u64 size() const { return size_; }
+    const std::string& content_type() const { return content_type_; }
+    const std::string& doc_root() const { return doc_root_; }
+
+private:
+    u64 user_id_;
+    std::string content_type_;
+    std::string doc_root_;
+    std::string tmp_path_;
+    std::FILE* file_ = nullptr;
+    crypto_generichash_state hash_state_;
+    u64 size_ = 0;
+    std::string hash_;
+    bool committed_ = false;
+};
+
+// POST /api/uploads
+// 正文由HttpSession边读边写入UploadSink，读完后在工作线程调用finish
+class UploadHandler {
+public:
+    static bool is_upload(http::verb method, std::string_view target) {
+        return method == http::verb::post &&
+               target.substr(0, target.find('?')) == "/api/uploads";
+    }
+
+    // 上传正文读取之前完成鉴权，失败时返回空
+    static std::optional<model::UserClaims> authenticate(std::string_view authorization);
+
+    // 读完正文后在工作线程调用，失败时返回错误响应
+    static http::message_generator finish(UploadSink& sink, unsigned version, bool keep_alive);
+
+    // 按哈希去重、配额检查、移动到上传目录并写入attachments表
+    // 超出配额时返回空，临时文件随sink析构删除
+    static std::optional<model::Attachment> store(UploadSink& sink, db::Storage& storage,
+                                                  u64 quota);
+
+    static http::response<http::string_body> error(unsigned version, bool keep_alive,
+                                                   http::status status, utils::StatusCode code,
+                                                   const std::string& msg);
+
+    // 上传文件保存在doc_root下的该目录，可通过/assets/uploads/访问
+    static constexpr std::string_view UPLOAD_DIR = "uploads";
+    // 上传中的临时文件目录，'.'开头的路径不会被/assets访问到
+    static constexpr std::string_view TMP_DIR = ".upload_tmp";
+};
+}  // namespace core
+}  // namespace tcs
@@ -4,12 +4,11 @@
 #include "core/ws_session_mgr.hpp"
 #include "utils/net_utils.hpp"
 #include "core/ws_handler.hpp"
-#include "db/sql_conn_RAII.hpp"
+#include "core/arena.hpp"
 #include "model/auth_models.hpp"
 #include "pool/thread_pool.hpp"
 
 using UserClaims = tcs::model::UserClaims;
-using SqlConnRAII = tcs::db::SqlConnRAII;
 
 namespace tcs {
 namespace core {
@@ -36,22 +35,68 @@ void WebsocketSession::on_read(beast::error_code ec, std::size_t bytes_transferr
 
     // todo: 流量控制
 
-    pool::ThreadPool::get().addTask(WSHandler::handle_message,
-                                    beast::buffers_to_string(buffer_.data()), user_claims_);
-    // WSHandler::handle_message(beast::buffers_to_string(buffer_.data()), user_id_);
+    bool binary = ws_.got_binary();
+    if (binary && !binary_) {
+        spdlog::warn("User {} sent a binary frame without negotiating {}", user_claims_.id,
+                     WsCodec::BINARY_PROTOCOL);
+        buffer_.consume(buffer_.size());
+        return do_read();
+    }
+
+    MsgTrace trace{.received = MsgTrace::Clock::now()};
+
+    // 消息文本和解析出的JSON都放在这条消息独占的内存区上，处理完整体归还
+    ArenaPtr arena = ArenaPool::get().acquire();
+    std::string_view msg = arena->copy(buffer_.data());
+    buffer_.consume(buffer_.size());
+
+    pool::ThreadPool::get().addTask(
+        [arena = std::move(arena), msg, binary, trace, user_claims = user_claims_] {
+            if (binary) {
+                WSHandler::handle_binary(msg, user_claims, trace);
+            } else {
+                WSHandler::handle_message(msg, user_claims, *arena, trace);
+            }
+        });
 
     do_read();
 }
 
-void WebsocketSession::on_send(const std::shared_ptr<const std::string>& str_ptr) {
-    message_queue_.emplace(str_ptr);
+void WebsocketSession::on_send(const Frame& frame) {
+    message_queue_.push_back(frame);
+    i64 size = static_cast<i64>(frame.data->size());
+    queued_bytes_ += size;
+    utils::Metrics::get().ws_outbound_bytes.add(size);
 
-    if (message_queue_.size() == 1) {
-        ws_.async_write(net::buffer(*message_queue_.front()),
-                        beast::bind_front_handler(&WebsocketSession::on_write, shared_from_this()));
+    if (replayed_ && message_queue_.size() == 1) {
+        do_write();
     }
 }
 
+void WebsocketSession::on_replay(const std::shared_ptr<const std::string>& batch) {
+    if (replayed_) {
+        return;
+    }
+    replayed_ = true;
+    if (batch) {
+        // 补发的消息都早于队列中的消息，插到最前面
+        message_queue_.push_front(Frame{.data = batch, .binary = false});
+        i64 size = static_cast<i64>(batch->size());
+        queued_bytes_ += size;
+        utils::Metrics::get().ws_outbound_bytes.add(size);
+    }
+    if (!message_queue_.empty()) {
+        do_write();
+    }
+}
+
+void WebsocketSession::do_write() {
+    const Frame& frame = message_queue_.front();
+    ws_.binary(frame.binary);
+    ws_.async_write(net::buffer(*frame.data),
+                    beast::bind_front_handler(&WebsocketSession::on_write, shared_from_this()));
+}
+
 void WebsocketSession::on_write(beast::error_code ec, std::size_t bytes_transferred) {
     // boost::ignore_unused(bytes_transferred);
 
@@ -60,11 +105,19 @@ void WebsocketSession::on_write(beast::error_code ec, std::size_t bytes_transfer
         return;
     }
 
-    message_queue_.pop();
+    const Frame& frame = message_queue_.front();
+    if (frame.msg_id != 0) {
+        MsgTracer::get().delivered(frame.msg_id, user_claims_.id, frame.queued,
+                                   MsgTrace::Clock::now());
+    }
+
+    i64 size = static_cast<i64>(frame.data->size());
+    queued_bytes_ -= size;
+    utils::Metrics::get().ws_outbound_bytes.add(-size);
+    message_queue_.pop_front();
 
     if (!message_queue_.empty()) {
-        ws_.async_write(net::buffer(*message_queue_.front()),
-                        beast::bind_front_handler(&WebsocketSession::on_write, shared_from_this()));
+        do_write();
     }
 }
 }  // namespace core
@@ -3,14 +3,18 @@
 #include <memory>
 #include <boost/beast/websocket.hpp>
 #include <spdlog/spdlog.h>
-#include <queue>
+#include <deque>
 #include <string>
 
 #include "utils/net_utils.hpp"
 #include "utils/types.hpp"
 #include "core/request_handler.hpp"
+#include "core/msg_trace.hpp"
+#include "core/ws_codec.hpp"
 #include "core/ws_session_mgr.hpp"
 #include "model/auth_models.hpp"
+#include "pool/thread_pool.hpp"
+#include "utils/metrics.hpp"
 
 namespace websocket = boost::beast::websocket;
 
@@ -21,6 +25,7 @@ namespace core {
 class WebsocketSession : public std::enable_shared_from_this<WebsocketSession> {
 public:
     explicit WebsocketSession(tcp::socket&& socket) : ws_(std::move(socket)) {
+        utils::Metrics::get().ws_sessions.add(1);
         spdlog::debug("WebsocketSession created on {}:{}",
                       ws_.next_layer().socket().remote_endpoint().address().to_string(),
                       ws_.next_layer().socket().remote_endpoint().port());
@@ -28,6 +33,13 @@ public:
 
     template <typename Body, typename Allocator>
     void do_accept(http::request<Body, http::basic_fields<Allocator>> req) {
+        // 客户端在Sec-WebSocket-Protocol中声明支持二进制子协议时才发送二进制帧
+        // 必须在auth_user之前确定，注册会话后工作线程就会调用send读取binary_
+        auto offered = req[http::field::sec_websocket_protocol];
+        std::string_view protocol =
+            WsCodec::negotiate(std::string_view(offered.data(), offered.size()));
+        binary_ = protocol == WsCodec::BINARY_PROTOCOL;
+
         UserClaims user_claims;
         try {
             if (req.find(http::field::authorization) == req.end()) {
@@ -46,31 +58,76 @@ public:
         }
 
         ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
-        ws_.set_option(websocket::stream_base::decorator([](websocket::response_type& res) {
-            res.set(http::field::server,
-                    std::string(BOOST_BEAST_VERSION_STRING) + " tinychat_server");
-        }));
+        ws_.set_option(
+            websocket::stream_base::decorator([protocol](websocket::response_type& res) {
+                res.set(http::field::server,
+                        std::string(BOOST_BEAST_VERSION_STRING) + " tinychat_server");
+                if (!protocol.empty()) {
+                    res.set(http::field::sec_websocket_protocol,
+                            beast::string_view(protocol.data(), protocol.size()));
+                }
+            }));
         ws_.async_accept(
             req, beast::bind_front_handler(&WebsocketSession::on_accept, shared_from_this()));
     }
 
     // critical
+    // JSON文本帧
     void send(const std::shared_ptr<const std::string>& str_ptr) {
+        net::post(ws_.get_executor(),
+                  beast::bind_front_handler(&WebsocketSession::on_send, shared_from_this(),
+                                            Frame{.data = str_ptr, .binary = false}));
+    }
+
+    // 按协商的子协议选择编码
+    // msg_id非0时记录这一帧的投递耗时
+    void send(const WsPayload& payload, u64 msg_id = 0) {
+        Frame frame = binary_ && payload.binary ? Frame{.data = payload.binary, .binary = true}
+                                                : Frame{.data = payload.json, .binary = false};
+        if (msg_id != 0) {
+            frame.msg_id = msg_id;
+            frame.queued = MsgTrace::Clock::now();
+        }
         net::post(ws_.get_executor(), beast::bind_front_handler(&WebsocketSession::on_send,
-                                                                shared_from_this(), str_ptr));
+                                                                shared_from_this(), frame));
+    }
+
+    // 离线补发的批量帧，排在握手后收到的所有消息之前
+    // 在此之前到达的消息只入队不发送，batch为空时只是放行
+    void send_replay(std::shared_ptr<const std::string> batch) {
+        net::post(ws_.get_executor(), beast::bind_front_handler(&WebsocketSession::on_replay,
+                                                                shared_from_this(),
+                                                                std::move(batch)));
     }
 
     ~WebsocketSession() {
         spdlog::debug("WebsocketSession for user {} is being destroyed.", user_claims_.username);
         // 清理会话
         WSSessionMgr::get().remove_session(user_claims_.id);
+
+        utils::Metrics& metrics = utils::Metrics::get();
+        metrics.ws_sessions.add(-1);
+        metrics.ws_outbound_bytes.add(-queued_bytes_);
     };
 
 private:
+    struct Frame {
+        std::shared_ptr<const std::string> data;
+        bool binary;
+        u64 msg_id = 0;
+        MsgTrace::Clock::time_point queued{};
+    };
+
     websocket::stream<beast::tcp_stream> ws_;
     beast::flat_buffer buffer_;
-    std::queue<std::shared_ptr<const std::string>> message_queue_;
+    std::deque<Frame> message_queue_;
+    // 离线消息补发之前为false，期间的消息留在message_queue_中，只在IO线程上访问
+    bool replayed_ = false;
     UserClaims user_claims_;
+    // 握手时协商为tinychat.bin.v1，在会话注册到WSSessionMgr之前写入，之后只读
+    bool binary_ = false;
+    // message_queue_中还没写完的字节数，只在IO线程上访问
+    i64 queued_bytes_ = 0;
 
     void auth_user(const std::string& token);
 
@@ -80,6 +137,11 @@ private:
             return;
         }
 
+        // 离线消息可能在磁盘上，交给工作线程读取后一次性补发
+        pool::ThreadPool::get().addTask([self = shared_from_this()] {
+            WSSessionMgr::get().replay_offline(self->user_claims_.id, self);
+        });
+
         do_read();
     }
 
@@ -90,7 +152,11 @@ private:
 
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
 
-    void on_send(const std::shared_ptr<const std::string>& str_ptr);
+    void on_send(const Frame& frame);
+
+    void on_replay(const std::shared_ptr<const std::string>& batch);
+
+    void do_write();
 
     void on_write(beast::error_code ec, std::size_t bytes_transferred);
 };
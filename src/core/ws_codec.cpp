@@ -0,0 +1,163 @@
+#include <cstring>
+
+#include <boost/endian/conversion.hpp>
+
+#include "core/ws_codec.hpp"
+
+namespace tcs {
+namespace core {
+void WsCodec::put_u64(std::string& out, u64 value) {
+    value = boost::endian::native_to_little(value);
+    char buf[sizeof(u64)];
+    std::memcpy(buf, &value, sizeof(u64));
+    out.append(buf, sizeof(u64));
+}
+
+u64 WsCodec::get_u64(const char* p) {
+    u64 value;
+    std::memcpy(&value, p, sizeof(u64));
+    return boost::endian::little_to_native(value);
+}
+
+bool WsCodec::valid_utf8(std::string_view s) {
+    std::size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        std::size_t len;
+        u64 cp;
+        if ((c & 0xE0) == 0xC0) {
+            len = 2;
+            cp = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            len = 3;
+            cp = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            len = 4;
+            cp = c & 0x07;
+        } else {
+            return false;
+        }
+        if (i + len > s.size()) {
+            return false;
+        }
+        for (std::size_t k = 1; k < len; k++) {
+            unsigned char cc = static_cast<unsigned char>(s[i + k]);
+            if ((cc & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        // 拒绝超长编码、代理区和超出范围的码点
+        static constexpr u64 MIN_CP[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (cp < MIN_CP[len] || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+std::string_view WsCodec::negotiate(std::string_view offered) {
+    while (!offered.empty()) {
+        std::size_t comma = offered.find(',');
+        std::string_view item = offered.substr(0, comma);
+        offered = comma == std::string_view::npos ? std::string_view{} : offered.substr(comma + 1);
+
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (item == BINARY_PROTOCOL) {
+            return BINARY_PROTOCOL;
+        }
+        if (item == JSON_PROTOCOL) {
+            return JSON_PROTOCOL;
+        }
+    }
+    return {};
+}
+
+std::optional<WsCodec::ClientMsg> WsCodec::decode_client(std::string_view frame) {
+    if (frame.empty()) {
+        return std::nullopt;
+    }
+    auto type = static_cast<ClientMsgType>(frame[0]);
+    const char* p = frame.data() + 1;
+    std::size_t remaining = frame.size() - 1;
+
+    switch (type) {
+        case ClientMsgType::PrivateMessage: {
+            if (remaining < 2 * sizeof(u64)) {
+                return std::nullopt;
+            }
+            std::string_view content(p + 2 * sizeof(u64), remaining - 2 * sizeof(u64));
+            if (!valid_utf8(content)) {
+                return std::nullopt;
+            }
+            return model::ClientPrivateMsg{.room_id = get_u64(p),
+                                           .other_user_id = get_u64(p + sizeof(u64)),
+                                           .content = std::string(content)};
+        }
+        case ClientMsgType::GroupMessage: {
+            if (remaining < sizeof(u64)) {
+                return std::nullopt;
+            }
+            std::string_view content(p + sizeof(u64), remaining - sizeof(u64));
+            if (!valid_utf8(content)) {
+                return std::nullopt;
+            }
+            return model::ClientGroupMsg{.room_id = get_u64(p), .content = std::string(content)};
+        }
+        default:
+            return std::nullopt;
+    }
+}
+
+std::string WsCodec::encode(const model::PrivateMsgToSend& msg) {
+    std::string out;
+    out.reserve(1 + 2 * sizeof(u64) + msg.content.size());
+    out.push_back(static_cast<char>(utils::ServerRespType::PMsgToSend));
+    put_u64(out, msg.private_room_id);
+    put_u64(out, msg.message_id);
+    out += msg.content;
+    return out;
+}
+
+std::string WsCodec::encode(const model::GroupMsgToSend& msg) {
+    std::string out;
+    out.reserve(1 + 3 * sizeof(u64) + msg.content.size());
+    out.push_back(static_cast<char>(utils::ServerRespType::GMsgToSend));
+    put_u64(out, msg.room_id);
+    put_u64(out, msg.sender_id);
+    put_u64(out, msg.message_id);
+    out += msg.content;
+    return out;
+}
+
+std::string WsCodec::encode(utils::ServerRespType type) {
+    return std::string(1, static_cast<char>(type));
+}
+
+std::string WsCodec::encode_client(const model::ClientPrivateMsg& msg) {
+    std::string out;
+    out.reserve(1 + 2 * sizeof(u64) + msg.content.size());
+    out.push_back(static_cast<char>(ClientMsgType::PrivateMessage));
+    put_u64(out, msg.room_id);
+    put_u64(out, msg.other_user_id);
+    out += msg.content;
+    return out;
+}
+
+std::string WsCodec::encode_client(const model::ClientGroupMsg& msg) {
+    std::string out;
+    out.reserve(1 + sizeof(u64) + msg.content.size());
+    out.push_back(static_cast<char>(ClientMsgType::GroupMessage));
+    put_u64(out, msg.room_id);
+    out += msg.content;
+    return out;
+}
+
+}  // namespace core
+}  // namespace tcs
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "model/ws_models.hpp"
+#include "utils/enums.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace core {
+// 同一条服务器消息的两种编码，按会话协商的子协议选择
+struct WsPayload {
+    std::shared_ptr<const std::string> json;
+    // 为空时二进制会话也收到JSON文本帧
+    std::shared_ptr<const std::string> binary;
+};
+
+// 二进制子协议 tinychat.bin.v1，只覆盖收发消息的热路径
+// 帧首字节为类型，整数为小端u64，content占据帧的剩余部分(UTF-8)
+//   客户端 -> 服务器  1 私聊: room_id other_user_id content
+//                     2 群聊: room_id content
+//   服务器 -> 客户端  类型与ServerRespType相同
+//                     1 MsgSentInfo, 4 PermissionDenied: 只有类型
+//                     2 PMsgToSend: private_room_id message_id content
+//                     3 GMsgToSend: room_id sender_id message_id content
+// message_id即消息的snowflake id，客户端据此去重、排序和匹配撤回通知(MsgRetracted)
+// 其他消息(离线补发等)仍以JSON文本帧发送，客户端按帧的opcode区分
+class WsCodec {
+public:
+    static constexpr std::string_view BINARY_PROTOCOL = "tinychat.bin.v1";
+    static constexpr std::string_view JSON_PROTOCOL = "tinychat.json";
+
+    enum class ClientMsgType : std::uint8_t {
+        PrivateMessage = 1,
+        GroupMessage = 2,
+    };
+    using ClientMsg = std::variant<model::ClientPrivateMsg, model::ClientGroupMsg>;
+
+    // 从Sec-WebSocket-Protocol中按客户端给出的顺序选择第一个支持的子协议
+    // 都不支持(或没有该头)时返回空，按JSON处理且不回应子协议
+    static std::string_view negotiate(std::string_view offered);
+
+    // 帧格式错误或content不是合法UTF-8时返回nullopt
+    static std::optional<ClientMsg> decode_client(std::string_view frame);
+
+    static std::string encode(const model::PrivateMsgToSend& msg);
+    static std::string encode(const model::GroupMsgToSend& msg);
+    // 不带数据的通知
+    static std::string encode(utils::ServerRespType type);
+
+    // 客户端编码，供测试和压测工具使用
+    static std::string encode_client(const model::ClientPrivateMsg& msg);
+    static std::string encode_client(const model::ClientGroupMsg& msg);
+
+private:
+    static void put_u64(std::string& out, u64 value);
+    static u64 get_u64(const char* p);
+    static bool valid_utf8(std::string_view s);
+};
+}  // namespace core
+}  // namespace tcs
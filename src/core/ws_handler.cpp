@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <stdexcept>
+#include <variant>
 
 #include <boost/json.hpp>
 #include <spdlog/spdlog.h>
@@ -7,156 +9,224 @@
 #include "core/request_handler.hpp"
 #include "core/ws_handler.hpp"
 #include "core/ws_session_mgr.hpp"
-#include "db/sql_conn_RAII.hpp"
+#include "core/room_cache.hpp"
+#include "core/room_events.hpp"
+#include "core/room_signals.hpp"
+#include "db/message_journal.hpp"
+#include "db/storage.hpp"
 #include "utils/enums.hpp"
+#include "utils/json_writer.hpp"
 #include "utils/snowflake.hpp"
 
 namespace model = tcs::model;
 namespace json = boost::json;
 namespace utils = tcs::utils;
 
-using SqlConnRAII = tcs::db::SqlConnRAII;
+using Storage = tcs::db::Storage;
+using MessageJournal = tcs::db::MessageJournal;
 using SnowFlake = tcs::utils::SnowFlake;
 using UserClaims = tcs::model::UserClaims;
+using RoomCache = tcs::core::RoomCache;
+using RoomEvents = tcs::core::RoomEvents;
+using RoomSignals = tcs::core::RoomSignals;
 
 namespace tcs {
 namespace core {
-void WSHandler::handle_message(const std::string& msg, UserClaims user_claims) {
-    SqlConnRAII conn;
-    conn.begin_transaction();
+void WSHandler::handle_message(std::string_view msg, const UserClaims& user_claims,
+                               RequestArena& arena, MsgTrace trace) {
+    trace.dequeued = MsgTrace::Clock::now();
     try {
         // std::string user_id_str = std::to_string(user_claims.id);
-        json::value jv = json::parse(msg);
+        beast::error_code ec;
+        json::value jv = parse_json(msg, arena.json_storage(), ec);
+        if (ec) {
+            throw std::runtime_error("Failed to parse WebSocket message: " + ec.message());
+        }
 
         if (!jv.is_object()) {
             throw std::runtime_error("Invalid JSON format in WebSocket message");
             return;
         }
-        const json::object obj = jv.as_object();
+        const json::object& obj = jv.as_object();
 
         if (!obj.contains("type") || !obj.at("type").is_string()) {
             throw std::runtime_error("Missing or invalid 'type' field in WebSocket message");
         }
 
-        std::string type = obj.at("type").as_string().c_str();
+        std::string_view type = obj.at("type").as_string();
 
         if (type == "private_message") {
-            // todo: 好友检测
-
-            model::ClientPrivateMsg private_msg =
-                json::value_to<model::ClientPrivateMsg>(jv.at("data"));
-
-            // 权限检测，必须为房间成员才能发送消息
-            bool is_member_in_room =
-                conn.execute_query("SELECT 1 FROM room_members WHERE room_id = ? AND user_id = ?",
-                                   private_msg.room_id, user_claims.id)
-                    ->next();
-
-            if (!is_member_in_room) {
-                WSSessionMgr::get().write_to(
-                    user_claims.id,
-                    json::serialize(json::value_from(model::ServerRespMsg<std::nullptr_t>{
-                        .type = utils::ServerRespType::PermissionDenied, .data = nullptr})));
-                return;
-            }
-
-            u64 msg_id = SnowFlake::next_id();
-
-            int updated_row1 = conn.execute_update(
-                "INSERT INTO messages (id, room_id, sender_id, content) VALUES (?, ?, ?, ?)",
-                msg_id, private_msg.room_id, user_claims.id, private_msg.content);
-            if (updated_row1 != 1) {
-                throw std::runtime_error(
-                    std::string("Failed to insert private message sent by \"") +
-                    user_claims.username + "\"");
+            on_private_message(json::value_to<model::ClientPrivateMsg>(jv.at("data")),
+                               user_claims, trace);
+        } else if (type == "group_message") {
+            on_group_message(json::value_to<model::ClientGroupMsg>(jv.at("data")), user_claims,
+                             trace);
+        } else if (type == "typing") {
+            // 不落库，成员检查推迟到窗口结束时按房间进行
+            if (RoomSignals::enabled()) {
+                auto typing = json::value_to<model::ClientTyping>(jv.at("data"));
+                RoomSignals::get().typing(user_claims.id, typing.room_id, typing.typing);
             }
-            spdlog::debug("Inserted private messages {}", msg_id);
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Exception in handle websocket message:{}", e.what());
+    }
+}
 
-            int updated_row2 = conn.execute_update(
-                "UPDATE rooms set last_message_id = ? WHERE id = ?", msg_id, private_msg.room_id);
+void WSHandler::handle_binary(std::string_view frame, const UserClaims& user_claims,
+                              MsgTrace trace) {
+    trace.dequeued = MsgTrace::Clock::now();
+    std::optional<WsCodec::ClientMsg> msg = WsCodec::decode_client(frame);
+    if (!msg) {
+        spdlog::warn("Invalid binary websocket frame ({} bytes) from user {}", frame.size(),
+                     user_claims.id);
+        return;
+    }
 
-            if (updated_row2 != 1) {
-                throw std::runtime_error(
-                    std::string("Failed to update last message in private room, sent by \"") +
-                    user_claims.username + "\"");
-            }
-            spdlog::debug("Updated last message id {} in private room {}", msg_id,
-                          private_msg.room_id);
+    if (auto* private_msg = std::get_if<model::ClientPrivateMsg>(&*msg)) {
+        on_private_message(*private_msg, user_claims, trace);
+    } else {
+        on_group_message(std::get<model::ClientGroupMsg>(*msg), user_claims, trace);
+    }
+}
 
-            conn.commit();
-            spdlog::debug("Transaction committed for private message {}", msg_id);
+void WSHandler::on_private_message(const model::ClientPrivateMsg& private_msg,
+                                   const UserClaims& user_claims, MsgTrace& trace) {
+    try {
+        // todo: 好友检测
 
-            model::ServerRespMsg<model::PrivateMsgToSend> private_msg_to_send = {
-                .type = utils::ServerRespType::PMsgToSend,
-                .data = model::PrivateMsgToSend{.private_room_id = private_msg.room_id,
-                                                .content = private_msg.content}};
+        model::Message message{.id = SnowFlake::next_id(),
+                               .room_id = private_msg.room_id,
+                               .sender_id = user_claims.id,
+                               .content = private_msg.content};
 
-            model::ServerRespMsg<std::nullptr_t> msg_sent_info = {
-                .type = utils::ServerRespType::MsgSentInfo, .data = nullptr};
+        if (!store_message(message)) {
+            WSSessionMgr::get().write_to(user_claims.id,
+                                         notice(utils::ServerRespType::PermissionDenied));
+            return;
+        }
+        u64 msg_id = message.id;
+        spdlog::debug("Stored private message {} in room {}", msg_id, private_msg.room_id);
+        trace.msg_id = msg_id;
+        trace.committed = MsgTrace::Clock::now();
+
+        RoomEvents::on_message(message);
+
+        model::ServerRespMsg<model::PrivateMsgToSend> private_msg_to_send = {
+            .type = utils::ServerRespType::PMsgToSend,
+            .data = model::PrivateMsgToSend{.private_room_id = private_msg.room_id,
+                                            .message_id = msg_id,
+                                            .content = private_msg.content}};
+
+        WSSessionMgr::get().write_to(
+            private_msg.other_user_id,
+            WsPayload{.json = std::make_shared<const std::string>(
+                          utils::to_json(private_msg_to_send)),
+                      .binary = std::make_shared<const std::string>(
+                          WsCodec::encode(private_msg_to_send.data))},
+            msg_id);
+        trace.fanned_out = MsgTrace::Clock::now();
+        MsgTracer::get().finish(trace);
+
+        // 私聊消息单独回一条送达信息
+        WSSessionMgr::get().write_to(user_claims.id, notice(utils::ServerRespType::MsgSentInfo));
+    } catch (const std::exception& e) {
+        spdlog::error("Exception in handle private message:{}", e.what());
+    }
+}
 
-            WSSessionMgr::get().write_to(private_msg.other_user_id,
-                                         json::serialize(json::value_from(private_msg_to_send)));
+void WSHandler::on_group_message(const model::ClientGroupMsg& group_msg,
+                                 const UserClaims& user_claims, MsgTrace& trace) {
+    try {
+        model::Message message{.id = SnowFlake::next_id(),
+                               .room_id = group_msg.room_id,
+                               .sender_id = user_claims.id,
+                               .content = group_msg.content};
 
-            // 私聊消息单独回一条送达信息
+        if (!store_message(message)) {
             WSSessionMgr::get().write_to(user_claims.id,
-                                         json::serialize(json::value_from(msg_sent_info)));
+                                         notice(utils::ServerRespType::PermissionDenied));
+            return;
+        }
+        u64 msg_id = message.id;
+        spdlog::debug("Stored group message {} in room {}", msg_id, group_msg.room_id);
+        trace.msg_id = msg_id;
+        trace.committed = MsgTrace::Clock::now();
+
+        RoomEvents::on_message(message);
+
+        model::ServerRespMsg<model::GroupMsgToSend> group_msg_to_send = {
+            .type = utils::ServerRespType::GMsgToSend,
+            .data = model::GroupMsgToSend{.room_id = group_msg.room_id,
+                                          .sender_id = user_claims.id,
+                                          .message_id = msg_id,
+                                          .content = group_msg.content}};
+
+        // 群聊消息广播给所有群成员
+        // 包括发送者，所以不需要单独回送送达信息
+        // 两种编码各序列化一次，所有成员共享
+        WSSessionMgr::get().write_to_room(
+            group_msg.room_id,
+            WsPayload{.json = std::make_shared<const std::string>(
+                          utils::to_json(group_msg_to_send)),
+                      .binary = std::make_shared<const std::string>(
+                          WsCodec::encode(group_msg_to_send.data))},
+            msg_id);
+        trace.fanned_out = MsgTrace::Clock::now();
+        MsgTracer::get().finish(trace);
+    } catch (const std::exception& e) {
+        spdlog::error("Exception in handle group message:{}", e.what());
+    }
+}
 
-        } else if (type == "group_message") {
-            model::ClientGroupMsg group_msg = json::value_to<model::ClientGroupMsg>(jv.at("data"));
-
-            // 权限检测，必须为房间成员才能发送消息
-            bool is_member_in_room =
-                conn.execute_query("SELECT 1 FROM room_members WHERE room_id = ? AND user_id = ?",
-                                   group_msg.room_id, user_claims.id)
-                    ->next();
-
-            if (!is_member_in_room) {
-                WSSessionMgr::get().write_to(
-                    user_claims.id,
-                    json::serialize(json::value_from(model::ServerRespMsg<std::nullptr_t>{
-                        .type = utils::ServerRespType::PermissionDenied, .data = nullptr})));
-                return;
-            }
+bool WSHandler::store_message(const model::Message& message) {
+    if (!MessageJournal::enabled()) {
+        // 检查与写入在同一个事务中
+        return Storage::get().append_message(message);
+    }
 
-            u64 msg_id = SnowFlake::next_id();
-            int updated_row1 = conn.execute_update(
-                "INSERT INTO messages (id, room_id, sender_id, content) VALUES (?, ?, ?, ?)",
-                msg_id, group_msg.room_id, user_claims.id, group_msg.content);
+    // 使用日志时在追加前检查，成员缓存未命中时才访问存储
+    std::optional<bool> is_member = RoomCache::get().is_member(message.room_id, message.sender_id);
+    if (!is_member) {
+        std::vector<u64> members = Storage::get().room_members(message.room_id);
+        RoomCache::get().set_members(message.room_id, members);
+        is_member = std::find(members.begin(), members.end(), message.sender_id) != members.end();
+    }
+    if (!*is_member) {
+        return false;
+    }
+    MessageJournal::get().append(message);
+    return true;
+}
 
-            if (updated_row1 != 1) {
-                throw std::runtime_error(
-                    std::string("Failed to insert group message into group\"") +
-                    std::to_string(group_msg.room_id) + "\", sent by \"" + user_claims.username +
-                    "\"");
-            }
-            spdlog::debug("Inserted group message {}", msg_id);
-
-            int updated_row2 = conn.execute_update(
-                "UPDATE rooms set last_message_id = ? WHERE id = ?", msg_id, group_msg.room_id);
-            if (updated_row2 != 1) {
-                throw std::runtime_error(
-                    std::string("Failed to update last message in group room, sent by \"") +
-                    user_claims.username + "\"");
-            }
-            spdlog::debug("Updated last message id {} in group room {}", msg_id, group_msg.room_id);
-            conn.commit();
-            spdlog::debug("Transaction committed for group message {}", msg_id);
-
-            model::ServerRespMsg<model::GroupMsgToSend> group_msg_to_send = {
-                .type = utils::ServerRespType::GMsgToSend,
-                .data = model::GroupMsgToSend{.room_id = group_msg.room_id,
-                                              .sender_id = user_claims.id,
-                                              .content = group_msg.content}};
-
-            // 群聊消息广播给所有群成员
-            // 包括发送者，所以不需要单独回送送达信息
-            WSSessionMgr::get().write_to_room(group_msg.room_id,
-                                              json::serialize(json::value_from(group_msg_to_send)));
-        }
-    } catch (const std::exception& e) {
-        conn.rollback();
-        spdlog::error("Exception in handle websocket message:{}. Database rolled back", e.what());
+void WSHandler::on_rejected(const model::Message& message) {
+    // 缓存中已经有这条消息，也可能计入了房间列表的预览和未读数
+    RoomEvents::on_message_retracted(message.room_id);
+
+    model::ServerRespMsg<model::MsgRetracted> retracted = {
+        .type = utils::ServerRespType::MsgRetracted,
+        .data = model::MsgRetracted{.room_id = message.room_id, .message_id = message.id}};
+    std::vector<u64> user_ids = Storage::get().room_members(message.room_id);
+    if (std::find(user_ids.begin(), user_ids.end(), message.sender_id) == user_ids.end()) {
+        user_ids.push_back(message.sender_id);
     }
+    // 使用新的id，离线补发时排在原消息之后
+    WSSessionMgr::get().fan_out(
+        user_ids, WsPayload{.json = std::make_shared<const std::string>(utils::to_json(retracted))},
+        SnowFlake::next_id());
+    spdlog::info("Retracted message {} from user {} in room {}", message.id, message.sender_id,
+                 message.room_id);
+}
+
+const WsPayload& WSHandler::notice(utils::ServerRespType type) {
+    auto make = [](utils::ServerRespType type) {
+        return WsPayload{.json = std::make_shared<const std::string>(utils::to_json(
+                             model::ServerRespMsg<std::nullptr_t>{.type = type, .data = nullptr})),
+                         .binary = std::make_shared<const std::string>(WsCodec::encode(type))};
+    };
+    static const WsPayload permission_denied = make(utils::ServerRespType::PermissionDenied);
+    static const WsPayload msg_sent_info = make(utils::ServerRespType::MsgSentInfo);
+    return type == utils::ServerRespType::PermissionDenied ? permission_denied : msg_sent_info;
 }
 }  // namespace core
 }  // namespace tcs
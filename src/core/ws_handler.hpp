@@ -2,17 +2,45 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 
+#include "core/arena.hpp"
+#include "core/msg_trace.hpp"
+#include "core/ws_codec.hpp"
 #include "model/auth_models.hpp"
+#include "model/message.hpp"
+#include "model/ws_models.hpp"
 #include "utils/types.hpp"
 
 namespace tcs {
 namespace core {
 class WSHandler {
 public:
-    static void handle_message(const std::string& msg, tcs::model::UserClaims user_claims);
+    // msg和解析出的JSON都分配在arena上，调用期间有效
+    // trace中已记录读到帧的时间
+    static void handle_message(std::string_view msg, const tcs::model::UserClaims& user_claims,
+                               RequestArena& arena, MsgTrace trace);
+
+    // tinychat.bin.v1二进制帧，格式见WsCodec
+    static void handle_binary(std::string_view frame, const tcs::model::UserClaims& user_claims,
+                              MsgTrace trace);
+
+    // 日志中已确认的消息在重放时被存储拒绝，撤回它
+    // 通知发送者和房间现有成员，离线的用户重新连接后收到
+    static void on_rejected(const tcs::model::Message& message);
 
 private:
+    static void on_private_message(const tcs::model::ClientPrivateMsg& private_msg,
+                                   const tcs::model::UserClaims& user_claims, MsgTrace& trace);
+    static void on_group_message(const tcs::model::ClientGroupMsg& group_msg,
+                                 const tcs::model::UserClaims& user_claims, MsgTrace& trace);
+
+    // 必须为房间成员才能发送消息，不是成员时返回false
+    // 启用消息日志时追加到日志即返回，否则在一个事务中检查并写入存储
+    static bool store_message(const tcs::model::Message& message);
+
+    // 不带数据的通知两种编码都固定，只构造一次
+    static const WsPayload& notice(tcs::utils::ServerRespType type);
 };
 }  // namespace core
 }  // namespace tcs
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include <mutex>
 
 #include "core/ws_session_mgr.hpp"
+#include "core/cluster_bus.hpp"
 #include "core/websocket_session.hpp"
-#include "db/sql_conn_RAII.hpp"
+#include "core/offline_queue.hpp"
+#include "core/presence_directory.hpp"
+#include "core/room_signals.hpp"
+#include "db/storage.hpp"
+#include "utils/enums.hpp"
+#include "utils/metrics.hpp"
 
 namespace tcs {
 namespace core {
@@ -20,11 +26,52 @@ void WSSessionMgr::add_session(u64 session_id, const std::weak_ptr<WebsocketSess
         // 如果已经存在，则更新为新的 weak_ptr
         it->second = session;
     }
+    // 持锁发布，同一用户的上下线按版本号顺序到达对端
+    if (ClusterBus::enabled()) {
+        if (auto update = PresenceDirectory::get().set_local(session_id, true)) {
+            ClusterBus::get().publish_presence({*update});
+        }
+    }
+    if (RoomSignals::enabled()) {
+        RoomSignals::get().presence(session_id, true);
+    }
+}
+
+void WSSessionMgr::remove_session(u64 session_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = sessions_.find(session_id);
+    if (it != sessions_.end()) {
+        if (!it->second.expired()) {
+            return;
+        }
+        sessions_.erase(it);
+    }
+    // 过期会话可能已经被群发时清理掉，仍然要下线
+    if (ClusterBus::enabled()) {
+        if (auto update = PresenceDirectory::get().set_local(session_id, false)) {
+            ClusterBus::get().publish_presence({*update});
+        }
+    }
+    if (RoomSignals::enabled()) {
+        RoomSignals::get().presence(session_id, false);
+    }
+}
+
+bool WSSessionMgr::has_session(u64 session_id) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = sessions_.find(session_id);
+    return it != sessions_.end() && !it->second.expired();
 }
 
 // write to single session
-void WSSessionMgr::write_to(u64 session_id, const std::string& msg) {
+void WSSessionMgr::write_to(u64 session_id, const std::string& msg, u64 msg_id) {
+    write_to(session_id, WsPayload{.json = std::make_shared<const std::string>(msg)}, msg_id);
+}
+
+void WSSessionMgr::write_to(u64 session_id, const WsPayload& payload, u64 msg_id) {
     std::shared_ptr<WebsocketSession> session_ptr;
+    std::vector<u64> nodes;
+    const auto& str_ptr = payload.json;
     {
         std::lock_guard<std::mutex> lock(mtx_);
         auto it = sessions_.find(session_id);
@@ -33,46 +80,157 @@ void WSSessionMgr::write_to(u64 session_id, const std::string& msg) {
                 sessions_.erase(it);
             }
         }
+        if (!session_ptr && ClusterBus::enabled()) {
+            nodes = PresenceDirectory::get().nodes_of(session_id);
+        }
+        // 持锁入队，保证不会与add_session之后的补发交错而漏掉
+        if (!session_ptr && nodes.empty() && msg_id != 0) {
+            OfflineQueue::get().push(session_id, msg_id, str_ptr);
+        }
     }
     if (session_ptr) {
-        session_ptr->send(std::make_shared<const std::string>(msg));
+        session_ptr->send(payload, msg_id);
+        return;
+    }
+
+    // 用户连在其他节点上时直接发给该节点
+    bool sent = false;
+    for (u64 node_id : nodes) {
+        sent |= ClusterBus::get().send(node_id, {session_id}, payload, msg_id);
+    }
+    if (sent) {
+        return;
+    }
+    if (msg_id != 0) {
+        // 所在节点刚好断开
+        if (!nodes.empty()) {
+            OfflineQueue::get().push(session_id, msg_id, str_ptr);
+        }
+        spdlog::debug("Session {} offline, message {} queued", session_id, msg_id);
     } else {
         spdlog::warn("Session {} not found or expired", session_id);
     }
 }
 
-void WSSessionMgr::write_to_room(u64 room_id, const std::string& msg) {
-    std::vector<u64> users_in_group;
-    {
-        SqlConnRAII conn;
-        std::unique_ptr<sql::ResultSet> res(
-            conn.execute_query("SELECT user_id FROM room_members WHERE room_id = ?", room_id));
+void WSSessionMgr::write_to_room(u64 room_id, const std::string& msg, u64 msg_id) {
+    write_to_room(room_id, WsPayload{.json = std::make_shared<const std::string>(msg)}, msg_id);
+}
 
-        while (res->next()) {
-            u64 user_id = res->getUInt64("user_id");
-            users_in_group.push_back(user_id);
-        }
-    }
+void WSSessionMgr::write_to_room(u64 room_id, const WsPayload& payload, u64 msg_id) {
+    utils::Metrics& metrics = utils::Metrics::get();
+    utils::ScopedTimer timer(metrics.fanout_time);
 
+    fan_out(db::Storage::get().room_members(room_id), payload, msg_id);
+}
+
+void WSSessionMgr::fan_out(const std::vector<u64>& users_in_group, const WsPayload& payload,
+                           u64 msg_id) {
+    deliver(users_in_group, payload, msg_id, false);
+}
+
+void WSSessionMgr::deliver_local(const std::vector<u64>& user_ids, const WsPayload& payload,
+                                 u64 msg_id) {
+    deliver(user_ids, payload, msg_id, true);
+}
+
+void WSSessionMgr::deliver(const std::vector<u64>& users_in_group, const WsPayload& payload,
+                           u64 msg_id, bool from_peer) {
+    const auto& str_ptr = payload.json;
     std::vector<std::shared_ptr<WebsocketSession>> online_users;
+    std::vector<u64> missing_ids;
+    std::unordered_map<u64, std::vector<u64>> by_node;
     {
         std::lock_guard<std::mutex> lock(mtx_);
         for (const auto& user_id : users_in_group) {
+            std::shared_ptr<WebsocketSession> session_ptr;
             auto it = sessions_.find(user_id);
             if (it != sessions_.end()) {
-                if (auto session_ptr = it->second.lock()) {
-                    online_users.push_back(session_ptr);
-                } else {
+                if (!(session_ptr = it->second.lock())) {
                     sessions_.erase(it);  // 清理过期会话
                 }
             }
+            if (session_ptr) {
+                online_users.push_back(session_ptr);
+            } else {
+                missing_ids.push_back(user_id);
+            }
+        }
+        // 对端转来的用户刚好断开时不再转发，留在本节点的离线队列
+        std::vector<u64> offline_ids;
+        if (!from_peer && ClusterBus::enabled()) {
+            by_node = PresenceDirectory::get().route(missing_ids, offline_ids);
+        } else {
+            offline_ids.swap(missing_ids);
+        }
+        if (msg_id != 0) {
+            for (u64 user_id : offline_ids) {
+                OfflineQueue::get().push(user_id, msg_id, str_ptr);
+            }
+        }
+    }
+
+    for (const auto& [node_id, user_ids] : by_node) {
+        if (!ClusterBus::get().send(node_id, user_ids, payload, msg_id) && msg_id != 0) {
+            // 所在节点刚好断开
+            for (u64 user_id : user_ids) {
+                OfflineQueue::get().push(user_id, msg_id, str_ptr);
+            }
         }
     }
 
+    utils::Metrics::get().fanout_size.record(online_users.size());
     for (const auto& session_ptr : online_users) {
-        session_ptr->send(std::make_shared<const std::string>(msg));
+        session_ptr->send(payload, msg_id);
     }
 }
 
+void WSSessionMgr::replay_offline(u64 user_id,
+                                  const std::shared_ptr<WebsocketSession>& session) {
+    // add_session之后的消息都直接交给会话，在补发之前不会写出
+    std::vector<OfflineQueue::Entry> entries = OfflineQueue::get().drain(user_id);
+    if (entries.empty()) {
+        session->send_replay(nullptr);
+        return;
+    }
+
+    bool current = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = sessions_.find(user_id);
+        current = it != sessions_.end() && it->second.lock() == session;
+    }
+    if (!current) {
+        // 补发前又断开或被新连接取代，放回队列
+        for (const auto& entry : entries) {
+            OfflineQueue::get().push(user_id, entry.msg_id, entry.payload);
+        }
+        session->send_replay(nullptr);
+        return;
+    }
+
+    // {"type":5,"data":{"messages":[<原消息帧>...]}}
+    // 原消息已经是序列化好的JSON，直接拼接，不再解析
+    // 每条消息帧带有message_id，客户端按它去重和续接历史，服务器不另存投递游标
+    std::size_t total = 64;
+    for (const auto& entry : entries) {
+        total += entry.payload->size() + 1;
+    }
+    std::string batch;
+    batch.reserve(total);
+    batch += "{\"type\":";
+    batch += std::to_string(static_cast<int>(utils::ServerRespType::OfflineMsgs));
+    batch += ",\"data\":{\"messages\":[";
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        if (i > 0) {
+            batch += ',';
+        }
+        batch += *entries[i].payload;
+    }
+    batch += "]}}";
+
+    spdlog::debug("Replaying {} offline messages to user {}", entries.size(), user_id);
+    session->send_replay(std::make_shared<const std::string>(std::move(batch)));
+}
+
 }  // namespace core
 }  // namespace tcs
\ No newline at end of file
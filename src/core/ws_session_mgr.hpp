@@ -7,8 +7,10 @@
 #include <map>
 #include <string>
 #include <string_view>
+#include <vector>
 
 // #include "core/websocket_session.hpp" //circular denpendency
+#include "core/ws_codec.hpp"
 #include "utils/types.hpp"
 
 namespace tcs {
@@ -24,24 +26,41 @@ public:
 
     void broadcast(std::shared_ptr<const std::string> str_ptr);
 
+    // 启用集群总线时同时更新PresenceDirectory并通知对端
     void add_session(u64 session_id, const std::weak_ptr<WebsocketSession>& session);
 
-    void remove_session(u64 session_id) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto it = sessions_.find(session_id);
-        if (it != sessions_.end()) {
-            sessions_.erase(it);
-        }
-    }
+    // 会话析构时调用，同一用户已经换成新会话时不删除
+    void remove_session(u64 session_id);
+
+    bool has_session(u64 session_id);
 
     // Write to a single session
-    void write_to(u64 session_id, const std::string& msg);
+    // msg_id非0的消息在用户离线时进入OfflineQueue，重新连接后补发
+    void write_to(u64 session_id, const std::string& msg, u64 msg_id = 0);
+    // 带二进制编码的消息，离线队列只保存JSON编码
+    void write_to(u64 session_id, const WsPayload& payload, u64 msg_id = 0);
+
+    void write_to_room(u64 room_id, const std::string& msg, u64 msg_id = 0);
+    void write_to_room(u64 room_id, const WsPayload& payload, u64 msg_id = 0);
 
-    void write_to_room(u64 room_id, const std::string& msg);
+    // 发给一组已知的用户，write_to_room查出成员后调用
+    // 不在本节点的用户按PresenceDirectory分组，每个节点发一帧；哪个节点都不在的进入离线队列
+    void fan_out(const std::vector<u64>& user_ids, const WsPayload& payload, u64 msg_id = 0);
+
+    // 对端节点转来的投递，只发给本节点的会话，已经断开的用户进入本节点的离线队列
+    void deliver_local(const std::vector<u64>& user_ids, const WsPayload& payload, u64 msg_id);
+
+    // 把离线期间的消息合并成一帧发给刚连接的会话，之后该会话才开始发送其他消息
+    // 会话已被同一用户的新连接取代时放回队列，由新会话补发
+    void replay_offline(u64 user_id, const std::shared_ptr<WebsocketSession>& session);
 
 private:
     WSSessionMgr() {}
 
+    // from_peer为false时，把本节点找不到的用户转给所在节点
+    void deliver(const std::vector<u64>& user_ids, const WsPayload& payload, u64 msg_id,
+                 bool from_peer);
+
     std::mutex mtx_;
 
     std::unordered_map<u64, std::weak_ptr<WebsocketSession>> sessions_;
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <ctime>
+
+#include "db/memory_storage.hpp"
+
+namespace tcs {
+namespace db {
+namespace {
+// 前chars个UTF-8字符，与MySQL的LEFT()一致
+std::string left_chars(const std::string& content, std::size_t chars) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < content.size(); i++) {
+        if ((static_cast<unsigned char>(content[i]) & 0xC0) != 0x80) {
+            if (count == chars) {
+                return content.substr(0, i);
+            }
+            ++count;
+        }
+    }
+    return content;
+}
+
+bool id_less(const model::Message& msg, u64 id) { return msg.id < id; }
+}  // namespace
+
+std::string MemoryStorage::now_string() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+#ifdef PLATFORM_WINDOWS
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+}
+
+bool MemoryStorage::create_user(const model::User& user, const std::string& password_hash) {
+    UserRecord record{.user = user, .password_hash = password_hash};
+    record.user.created_at = now_string();
+    std::unique_lock<std::shared_mutex> lock(users_mtx_);
+    return users_.emplace(user.username, std::move(record)).second;
+}
+
+std::optional<Storage::UserRecord> MemoryStorage::find_user(const std::string& username) {
+    std::shared_lock<std::shared_mutex> lock(users_mtx_);
+    auto it = users_.find(username);
+    if (it == users_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::shared_ptr<MemoryStorage::RoomData> MemoryStorage::find_room(u64 room_id) {
+    std::shared_lock<std::shared_mutex> lock(rooms_mtx_);
+    auto it = rooms_.find(room_id);
+    return it == rooms_.end() ? nullptr : it->second;
+}
+
+void MemoryStorage::insert_room(u64 room_id, const std::string& name, utils::RoomType type,
+                                const std::vector<std::pair<u64, utils::GroupRole>>& members) {
+    auto room = std::make_shared<RoomData>();
+    room->room = model::Room{.id = room_id,
+                             .type = static_cast<i8>(type),
+                             .name = name,
+                             .last_message_id = 0,
+                             .created_at = now_string()};
+    for (const auto& [user_id, role] : members) {
+        room->members.emplace(user_id, Member{.role = role});
+    }
+
+    std::unique_lock<std::shared_mutex> lock(rooms_mtx_);
+    if (!rooms_.emplace(room_id, room).second) {
+        throw std::runtime_error("Duplicate room id " + std::to_string(room_id));
+    }
+    for (const auto& [user_id, role] : members) {
+        user_rooms_[user_id].insert(room_id);
+    }
+}
+
+void MemoryStorage::create_group_room(u64 room_id, const std::string& name, u64 owner_id) {
+    insert_room(room_id, name, utils::RoomType::GROUP, {{owner_id, utils::GroupRole::OWNER}});
+}
+
+void MemoryStorage::create_private_room(u64 room_id, u64 user_id, u64 other_id) {
+    if (user_id == other_id) {
+        throw std::runtime_error("Failed to add members to private room");
+    }
+    insert_room(room_id, "", utils::RoomType::PRIVATE,
+                {{user_id, utils::GroupRole::PRIVATE_MEMBER},
+                 {other_id, utils::GroupRole::PRIVATE_MEMBER}});
+}
+
+std::optional<utils::RoomType> MemoryStorage::room_type(u64 room_id) {
+    std::shared_ptr<RoomData> room = find_room(room_id);
+    if (!room) {
+        return std::nullopt;
+    }
+    // type创建后不变
+    return static_cast<utils::RoomType>(room->room.type);
+}
+
+bool MemoryStorage::delete_room(u64 room_id) {
+    std::unique_lock<std::shared_mutex> lock(rooms_mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return false;
+    }
+    std::shared_ptr<RoomData> room = it->second;
+    rooms_.erase(it);
+
+    std::unique_lock<std::shared_mutex> room_lock(room->mtx);
+    for (const auto& [user_id, member] : room->members) {
+        auto rooms_it = user_rooms_.find(user_id);
+        if (rooms_it != user_rooms_.end()) {
+            rooms_it->second.erase(room_id);
+            if (rooms_it->second.empty()) {
+                user_rooms_.erase(rooms_it);
+            }
+        }
+    }
+    room->members.clear();
+    return true;
+}
+
+std::optional<utils::GroupRole> MemoryStorage::member_role(u64 room_id, u64 user_id) {
+    std::shared_ptr<RoomData> room = find_room(room_id);
+    if (!room) {
+        return std::nullopt;
+    }
+    std::shared_lock<std::shared_mutex> lock(room->mtx);
+    auto it = room->members.find(user_id);
+    if (it == room->members.end()) {
+        return std::nullopt;
+    }
+    return it->second.role;
+}
+
+bool MemoryStorage::add_member(u64 room_id, u64 user_id, utils::GroupRole role) {
+    std::unique_lock<std::shared_mutex> lock(rooms_mtx_);
+    auto it = rooms_.find(room_id);
+    if (it == rooms_.end()) {
+        return false;
+    }
+    {
+        std::unique_lock<std::shared_mutex> room_lock(it->second->mtx);
+        if (!it->second->members.emplace(user_id, Member{.role = role}).second) {
+            return false;
+        }
+    }
+    user_rooms_[user_id].insert(room_id);
+    return true;
+}
+
+std::vector<u64> MemoryStorage::room_members(u64 room_id) {
+    std::vector<u64> members;
+    std::shared_ptr<RoomData> room = find_room(room_id);
+    if (!room) {
+        return members;
+    }
+    std::shared_lock<std::shared_mutex> lock(room->mtx);
+    members.reserve(room->members.size());
+    for (const auto& [user_id, member] : room->members) {
+        members.push_back(user_id);
+    }
+    return members;
+}
+
+std::vector<u64> MemoryStorage::rooms_of(u64 user_id) {
+    std::shared_lock<std::shared_mutex> lock(rooms_mtx_);
+    auto it = user_rooms_.find(user_id);
+    if (it == user_rooms_.end()) {
+        return {};
+    }
+    return std::vector<u64>(it->second.begin(), it->second.end());
+}
+
+bool MemoryStorage::mark_read(u64 room_id, u64 user_id, u64 message_id) {
+    std::shared_ptr<RoomData> room = find_room(room_id);
+    if (!room) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(room->mtx);
+    auto it = room->members.find(user_id);
+    if (it == room->members.end()) {
+        return false;
+    }
+    it->second.last_read_message_id = std::max(it->second.last_read_message_id, message_id);
+    return true;
+}
+
+std::vector<model::RoomSummary> MemoryStorage::room_summaries(u64 user_id,
+                                                              std::size_t preview_chars) {
+    std::vector<std::shared_ptr<RoomData>> joined;
+    {
+        std::shared_lock<std::shared_mutex> lock(rooms_mtx_);
+        auto it = user_rooms_.find(user_id);
+        if (it != user_rooms_.end()) {
+            joined.reserve(it->second.size());
+            for (u64 room_id : it->second) {
+                joined.push_back(rooms_.at(room_id));
+            }
+        }
+    }
+
+    std::vector<model::RoomSummary> rooms;
+    rooms.reserve(joined.size());
+    for (const auto& room : joined) {
+        std::shared_lock<std::shared_mutex> lock(room->mtx);
+        auto member = room->members.find(user_id);
+        if (member == room->members.end()) {
+            // 读取期间被删除
+            continue;
+        }
+        model::RoomSummary summary{.room = room->room,
+                                   .last_sender_id = 0,
+                                   .last_read_message_id = member->second.last_read_message_id,
+                                   .unread_count = 0};
+        summary.room.member_count = static_cast<i32>(room->members.size());
+        if (!room->messages.empty()) {
+            const model::Message& last = room->messages.back();
+            summary.last_sender_id = last.sender_id;
+            summary.last_preview = left_chars(last.content, preview_chars);
+        }
+        auto unread = std::lower_bound(room->messages.begin(), room->messages.end(),
+                                       summary.last_read_message_id + 1, id_less);
+        summary.unread_count = static_cast<u64>(
+            std::count_if(unread, room->messages.end(),
+                          [user_id](const model::Message& msg) { return msg.sender_id != user_id; }));
+        rooms.push_back(std::move(summary));
+    }
+    std::sort(rooms.begin(), rooms.end(),
+              [](const model::RoomSummary& a, const model::RoomSummary& b) {
+                  return a.room.last_message_id > b.room.last_message_id;
+              });
+    return rooms;
+}
+
+bool MemoryStorage::append_message(const model::Message& message) {
+    std::shared_ptr<RoomData> room = find_room(message.room_id);
+    if (!room) {
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(room->mtx);
+    if (!room->members.contains(message.sender_id)) {
+        return false;
+    }
+    // id基本递增，从尾部找插入位置
+    auto pos = room->messages.end();
+    while (pos != room->messages.begin() && std::prev(pos)->id > message.id) {
+        --pos;
+    }
+    room->messages.insert(pos, message);
+    room->room.last_message_id = room->messages.back().id;
+    return true;
+}
+
+std::vector<model::Message> MemoryStorage::messages_before(u64 room_id, u64 before,
+                                                           std::size_t limit) {
+    std::vector<model::Message> messages;
+    std::shared_ptr<RoomData> room = find_room(room_id);
+    if (!room) {
+        return messages;
+    }
+    std::shared_lock<std::shared_mutex> lock(room->mtx);
+    auto end = std::lower_bound(room->messages.begin(), room->messages.end(), before, id_less);
+    std::size_t count = std::min<std::size_t>(limit, end - room->messages.begin());
+    messages.reserve(count);
+    for (auto it = end; messages.size() < count;) {
+        messages.push_back(*--it);
+    }
+    return messages;
+}
+
+std::optional<model::Attachment> MemoryStorage::find_attachment(u64 user_id,
+                                                                const std::string& hash) {
+    std::lock_guard<std::mutex> lock(attachments_mtx_);
+    auto it = attachments_.find(user_id);
+    if (it == attachments_.end()) {
+        return std::nullopt;
+    }
+    for (const auto& attachment : it->second) {
+        if (attachment.hash == hash) {
+            return attachment;
+        }
+    }
+    return std::nullopt;
+}
+
+u64 MemoryStorage::attachment_usage(u64 user_id) {
+    std::lock_guard<std::mutex> lock(attachments_mtx_);
+    auto it = attachments_.find(user_id);
+    if (it == attachments_.end()) {
+        return 0;
+    }
+    u64 used = 0;
+    for (const auto& attachment : it->second) {
+        used += attachment.size;
+    }
+    return used;
+}
+
+void MemoryStorage::add_attachment(u64 user_id, const model::Attachment& attachment) {
+    std::lock_guard<std::mutex> lock(attachments_mtx_);
+    model::Attachment record = attachment;
+    record.url.clear();
+    attachments_[user_id].push_back(std::move(record));
+}
+}  // namespace db
+}  // namespace tcs
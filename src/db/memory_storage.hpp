@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "db/storage.hpp"
+
+namespace tcs {
+namespace db {
+// 进程内存储，语义与MySqlStorage相同，重启后数据丢失
+// 用于压测、本地测试和单机低延迟部署
+// 房间表用读写锁保护，每个房间的成员和消息各自加锁，不同房间的消息写入互不阻塞
+class MemoryStorage : public Storage {
+public:
+    bool create_user(const model::User& user, const std::string& password_hash) override;
+    std::optional<UserRecord> find_user(const std::string& username) override;
+
+    void create_group_room(u64 room_id, const std::string& name, u64 owner_id) override;
+    void create_private_room(u64 room_id, u64 user_id, u64 other_id) override;
+    std::optional<utils::RoomType> room_type(u64 room_id) override;
+    bool delete_room(u64 room_id) override;
+
+    std::optional<utils::GroupRole> member_role(u64 room_id, u64 user_id) override;
+    bool add_member(u64 room_id, u64 user_id, utils::GroupRole role) override;
+    std::vector<u64> room_members(u64 room_id) override;
+    std::vector<u64> rooms_of(u64 user_id) override;
+    bool mark_read(u64 room_id, u64 user_id, u64 message_id) override;
+    std::vector<model::RoomSummary> room_summaries(u64 user_id,
+                                                   std::size_t preview_chars) override;
+
+    bool append_message(const model::Message& message) override;
+    std::vector<model::Message> messages_before(u64 room_id, u64 before,
+                                                std::size_t limit) override;
+
+    std::optional<model::Attachment> find_attachment(u64 user_id,
+                                                     const std::string& hash) override;
+    u64 attachment_usage(u64 user_id) override;
+    void add_attachment(u64 user_id, const model::Attachment& attachment) override;
+
+private:
+    struct Member {
+        utils::GroupRole role;
+        u64 last_read_message_id = 0;
+    };
+
+    struct RoomData {
+        std::shared_mutex mtx;
+        model::Room room;
+        std::unordered_map<u64, Member> members;
+        // 按id升序
+        std::vector<model::Message> messages;
+    };
+
+    // 与MySQL的DATETIME格式一致
+    static std::string now_string();
+
+    std::shared_ptr<RoomData> find_room(u64 room_id);
+    void insert_room(u64 room_id, const std::string& name, utils::RoomType type,
+                     const std::vector<std::pair<u64, utils::GroupRole>>& members);
+
+    std::shared_mutex users_mtx_;
+    std::unordered_map<std::string, UserRecord> users_;
+
+    // 锁顺序：rooms_mtx_ 在 RoomData::mtx 之前
+    std::shared_mutex rooms_mtx_;
+    std::unordered_map<u64, std::shared_ptr<RoomData>> rooms_;
+    // 用户加入的房间
+    std::unordered_map<u64, std::unordered_set<u64>> user_rooms_;
+
+    std::mutex attachments_mtx_;
+    std::unordered_map<u64, std::vector<model::Attachment>> attachments_;
+};
+}  // namespace db
+}  // namespace tcs
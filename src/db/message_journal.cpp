@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+
+#ifdef PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "db/message_journal.hpp"
+#include "utils/metrics.hpp"
+
+namespace fs = std::filesystem;
+
+namespace tcs {
+namespace db {
+std::unique_ptr<MessageJournal> MessageJournal::instance_ptr_ = nullptr;
+
+void MessageJournal::init(const std::string& dir, u64 segment_bytes, RejectHandler on_reject) {
+    if (instance_ptr_) {
+        throw std::runtime_error("MessageJournal has already been initialized.");
+    }
+#ifdef PLATFORM_LINUX
+    instance_ptr_ = std::make_unique<MessageJournal>(dir, segment_bytes, Storage::get(),
+                                                     std::move(on_reject));
+    spdlog::info("Message journal opened: {}, {} records to replay", dir,
+                 instance_ptr_->pending());
+    // 重放完之前存储和RoomCache都缺少这些消息，不能开始接受连接
+    instance_ptr_->wait_recovered();
+#else
+    spdlog::warn("Message journal requires Linux, journal_dir {} is ignored", dir);
+#endif
+}
+
+#ifdef PLATFORM_LINUX
+namespace {
+// 记录格式：RecordHeader + 内容，按8字节对齐
+// 段文件预分配为全零，id为0的位置表示段内没有更多记录
+struct RecordHeader {
+    // 覆盖header其余字段和内容，校验失败视为写了一半的尾部
+    std::uint32_t crc;
+    std::uint32_t length;
+    u64 id;
+    u64 room_id;
+    u64 sender_id;
+};
+static_assert(sizeof(RecordHeader) == 32);
+
+constexpr u64 record_size(u64 length) { return (sizeof(RecordHeader) + length + 7) & ~u64(7); }
+
+std::uint32_t record_crc(const RecordHeader& header, const char* content) {
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(&header.length),
+                      sizeof(RecordHeader) - offsetof(RecordHeader, length));
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(content), header.length);
+    return static_cast<std::uint32_t>(crc);
+}
+
+std::string errno_string() { return std::strerror(errno); }
+
+// 新建或删除文件后同步目录项
+void sync_dir(const fs::path& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+}  // namespace
+
+MessageJournal::Segment::~Segment() {
+    if (data) {
+        munmap(data, size);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+MessageJournal::MessageJournal(const fs::path& dir, u64 segment_bytes, Storage& storage,
+                               RejectHandler on_reject)
+    : dir_(dir), segment_bytes_(segment_bytes), storage_(storage), on_reject_(std::move(on_reject)) {
+    recover();
+    syncer_ = std::thread([this] { sync_loop(); });
+    replayer_ = std::thread([this] { replay_loop(); });
+}
+
+MessageJournal::~MessageJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_sync_ = true;
+    }
+    append_cv_.notify_all();
+    syncer_.join();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_replay_ = true;
+    }
+    synced_cv_.notify_all();
+    replayer_.join();
+}
+
+fs::path MessageJournal::segment_path(u64 index) const {
+    std::string name = std::to_string(index);
+    // 补零到固定宽度，文件名顺序即段顺序
+    name.insert(0, 20 - std::min<std::size_t>(name.size(), 20), '0');
+    return dir_ / (name + ".journal");
+}
+
+std::shared_ptr<MessageJournal::Segment> MessageJournal::open_segment(u64 index, bool create) {
+    fs::path path = segment_path(index);
+    auto segment = std::make_shared<Segment>();
+    segment->index = index;
+    segment->fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (segment->fd < 0) {
+        throw std::runtime_error("Failed to open journal segment " + path.string() + ": " +
+                                 errno_string());
+    }
+    struct stat st;
+    if (::fstat(segment->fd, &st) != 0) {
+        throw std::runtime_error("Failed to stat journal segment " + path.string() + ": " +
+                                 errno_string());
+    }
+    segment->size = static_cast<u64>(st.st_size);
+    if (create && segment->size < segment_bytes_) {
+        // 预先分配磁盘块，写mmap时不会因为磁盘满而收到SIGBUS
+        int rc = ::posix_fallocate(segment->fd, 0, static_cast<off_t>(segment_bytes_));
+        if (rc != 0) {
+            throw std::runtime_error("Failed to allocate journal segment " + path.string() +
+                                     ": " + std::strerror(rc));
+        }
+        segment->size = segment_bytes_;
+        sync_dir(dir_);
+    }
+    if (segment->size == 0) {
+        return segment;
+    }
+    void* addr = mmap(nullptr, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Failed to mmap journal segment " + path.string() + ": " +
+                                 errno_string());
+    }
+    segment->data = static_cast<char*>(addr);
+    return segment;
+}
+
+u64 MessageJournal::record_at(const Segment& segment, u64 offset, model::Message* out) {
+    if (offset + sizeof(RecordHeader) > segment.size) {
+        return 0;
+    }
+    RecordHeader header;
+    std::memcpy(&header, segment.data + offset, sizeof(header));
+    if (header.id == 0) {
+        return 0;
+    }
+    u64 size = record_size(header.length);
+    if (size > segment.size - offset) {
+        return 0;
+    }
+    const char* content = segment.data + offset + sizeof(RecordHeader);
+    if (record_crc(header, content) != header.crc) {
+        return 0;
+    }
+    if (out) {
+        *out = model::Message{.id = header.id,
+                              .room_id = header.room_id,
+                              .sender_id = header.sender_id,
+                              .content = std::string(content, header.length)};
+    }
+    return size;
+}
+
+void MessageJournal::recover() {
+    fs::create_directories(dir_);
+
+    std::vector<u64> indexes;
+    for (const auto& entry : fs::directory_iterator(dir_)) {
+        const fs::path& path = entry.path();
+        if (path.extension() != ".journal") {
+            continue;
+        }
+        try {
+            indexes.push_back(std::stoull(path.stem().string()));
+        } catch (const std::exception&) {
+            spdlog::warn("Ignored unknown file in journal directory: {}", path.string());
+        }
+    }
+    std::sort(indexes.begin(), indexes.end());
+
+    // checkpoint：已写入存储的位置，<段序号> <段内偏移>
+    u64 checkpoint_segment = 0;
+    u64 checkpoint_offset = 0;
+    std::ifstream(dir_ / "checkpoint") >> checkpoint_segment >> checkpoint_offset;
+
+    // 整段都已写入存储
+    while (!indexes.empty() && indexes.front() < checkpoint_segment) {
+        fs::remove(segment_path(indexes.front()));
+        indexes.erase(indexes.begin());
+    }
+
+    if (indexes.empty()) {
+        active_ = open_segment(checkpoint_segment + 1, true);
+        segments_[active_->index] = active_;
+        replay_segment_ = active_->index;
+        return;
+    }
+
+    // checkpoint所在的段可能在更新checkpoint之前就被删除了
+    if (indexes.front() != checkpoint_segment) {
+        checkpoint_offset = 0;
+    }
+    replay_segment_ = indexes.front();
+    replay_offset_ = checkpoint_offset;
+
+    for (u64 index : indexes) {
+        bool last = index == indexes.back();
+        std::shared_ptr<Segment> segment = open_segment(index, last);
+        u64 offset = 0;
+        while (u64 size = record_at(*segment, offset, nullptr)) {
+            if (index != replay_segment_ || offset >= checkpoint_offset) {
+                recovered_++;
+            }
+            offset += size;
+        }
+        if (last) {
+            // 清掉写了一半的尾部，之后从这里继续追加
+            char* end = segment->data + segment->size;
+            char* dirty = std::find_if(segment->data + offset, end, [](char c) { return c != 0; });
+            if (dirty != end) {
+                spdlog::warn("Discarded torn journal tail in segment {} at offset {}", index,
+                             offset);
+                std::fill(segment->data + offset, end, 0);
+                msync(segment->data, segment->size, MS_SYNC);
+            }
+            write_offset_ = offset;
+        }
+        segments_[index] = segment;
+    }
+    active_ = segments_.rbegin()->second;
+    appended_ = synced_ = recovered_;
+    utils::Metrics::get().journal_pending.add(static_cast<i64>(recovered_));
+}
+
+void MessageJournal::append(const model::Message& msg) {
+    RecordHeader header{.crc = 0,
+                        .length = static_cast<std::uint32_t>(msg.content.size()),
+                        .id = msg.id,
+                        .room_id = msg.room_id,
+                        .sender_id = msg.sender_id};
+    u64 size = record_size(msg.content.size());
+    if (msg.content.size() > UINT32_MAX || size > segment_bytes_) {
+        throw std::invalid_argument("Message " + std::to_string(msg.id) +
+                                    " is larger than a journal segment");
+    }
+    header.crc = record_crc(header, msg.content.data());
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (failed_) {
+        throw std::runtime_error("Message journal is not writable");
+    }
+    if (write_offset_ + size > active_->size) {
+        // 段剩余空间保持全零，重放时读到零就转到下一段
+        std::shared_ptr<Segment> next = open_segment(active_->index + 1, true);
+        segments_[next->index] = next;
+        active_ = next;
+        write_offset_ = 0;
+    }
+    // 对齐填充的字节本来就是零
+    std::memcpy(active_->data + write_offset_, &header, sizeof(header));
+    std::memcpy(active_->data + write_offset_ + sizeof(header), msg.content.data(),
+                msg.content.size());
+    if (!dirty_.empty() && dirty_.back().segment == active_ &&
+        dirty_.back().end == write_offset_) {
+        dirty_.back().end += size;
+    } else {
+        dirty_.push_back(
+            DirtyRange{.segment = active_, .begin = write_offset_, .end = write_offset_ + size});
+    }
+    write_offset_ += size;
+    u64 seq = ++appended_;
+    append_cv_.notify_one();
+
+    synced_cv_.wait(lock, [&] { return synced_ >= seq || failed_; });
+    if (synced_ < seq) {
+        throw std::runtime_error("Failed to sync message journal");
+    }
+}
+
+u64 MessageJournal::pending() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return synced_ - replayed_;
+}
+
+void MessageJournal::wait_recovered() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!replayed_cv_.wait_for(lock, std::chrono::seconds(5),
+                                  [this] { return replayed_ >= recovered_; })) {
+        spdlog::warn("Waiting for message journal replay, {} records left",
+                     recovered_ - replayed_);
+    }
+}
+
+// 组提交：一次msync覆盖上次落盘之后的全部追加，落盘期间到达的追加由下一次覆盖
+void MessageJournal::sync_loop() {
+    static const u64 page_size = static_cast<u64>(sysconf(_SC_PAGESIZE));
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+        append_cv_.wait(lock, [this] { return stop_sync_ || appended_ > synced_; });
+        if (appended_ == synced_) {
+            return;
+        }
+        u64 target = appended_;
+        u64 batch = target - synced_;
+        std::vector<DirtyRange> ranges;
+        ranges.swap(dirty_);
+        lock.unlock();
+
+        bool ok = true;
+        {
+            utils::ScopedTimer timer(utils::Metrics::get().journal_sync);
+            for (const DirtyRange& range : ranges) {
+                u64 begin = range.begin & ~(page_size - 1);
+                if (msync(range.segment->data + begin, range.end - begin, MS_SYNC) != 0) {
+                    spdlog::error("Failed to sync journal segment {}: {}", range.segment->index,
+                                  errno_string());
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        utils::Metrics::get().journal_batch.record(batch);
+
+        lock.lock();
+        if (!ok) {
+            // 未确认的记录可能已经部分落盘，下次启动时仍会被重放
+            failed_ = true;
+            appended_ = synced_;
+            synced_cv_.notify_all();
+            return;
+        }
+        synced_ = target;
+        utils::Metrics::get().journal_pending.add(static_cast<i64>(batch));
+        synced_cv_.notify_all();
+    }
+}
+
+void MessageJournal::replay_loop() {
+    for (;;) {
+        u64 available = 0;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            synced_cv_.wait(lock, [this] { return stop_replay_ || synced_ > replayed_; });
+            if (synced_ == replayed_) {
+                return;
+            }
+            available = synced_ - replayed_;
+        }
+
+        u64 done = 0;
+        bool stalled = false;
+        while (done < available) {
+            std::shared_ptr<Segment> segment;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                segment = segments_.at(replay_segment_);
+            }
+            model::Message msg;
+            u64 size = record_at(*segment, replay_offset_, &msg);
+            if (size == 0) {
+                // 段内记录已全部写入存储，后面还有记录说明已经有下一段
+                save_checkpoint(replay_segment_ + 1, 0);
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    segments_.erase(replay_segment_);
+                }
+                std::error_code ec;
+                fs::remove(segment_path(replay_segment_), ec);
+                replay_segment_++;
+                replay_offset_ = 0;
+                continue;
+            }
+            if (!apply(msg, replayed_ + done < recovered_)) {
+                // 存储不可用时稍后重试，关闭时留给下次启动
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (synced_cv_.wait_for(lock, std::chrono::seconds(1),
+                                        [this] { return stop_replay_; })) {
+                    stalled = true;
+                    break;
+                }
+                continue;
+            }
+            replay_offset_ += size;
+            done++;
+        }
+        save_checkpoint(replay_segment_, replay_offset_);
+        utils::Metrics::get().journal_pending.add(-static_cast<i64>(done));
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            replayed_ += done;
+        }
+        replayed_cv_.notify_all();
+        if (stalled) {
+            spdlog::warn("Message journal closed with {} records not written to storage",
+                         available - done);
+            return;
+        }
+    }
+}
+
+bool MessageJournal::apply(const model::Message& msg, bool recovering) {
+    try {
+        if (recovering) {
+            // 崩溃前可能已经写入存储，只是没来得及更新checkpoint
+            std::vector<model::Message> last = storage_.messages_before(msg.room_id, msg.id + 1, 1);
+            if (!last.empty() && last.front().id == msg.id) {
+                return true;
+            }
+        }
+        if (storage_.append_message(msg)) {
+            return true;
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Failed to write journaled message {} to storage: {}", msg.id, e.what());
+        return false;
+    }
+
+    spdlog::warn("Storage rejected journaled message {} from user {} in room {}", msg.id,
+                 msg.sender_id, msg.room_id);
+    if (on_reject_) {
+        // 通知失败不影响重放，不重试
+        try {
+            on_reject_(msg);
+        } catch (const std::exception& e) {
+            spdlog::error("Exception in journal reject handler for message {}: {}", msg.id,
+                          e.what());
+        }
+    }
+    return true;
+}
+
+// checkpoint只决定从哪里开始重放，丢失或落后时多重放的记录会被去重，所以不需要fsync
+void MessageJournal::save_checkpoint(u64 segment, u64 offset) {
+    fs::path tmp = dir_ / "checkpoint.tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << segment << ' ' << offset << '\n';
+        if (!out) {
+            spdlog::error("Failed to write journal checkpoint {}", tmp.string());
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, dir_ / "checkpoint", ec);
+    if (ec) {
+        spdlog::error("Failed to update journal checkpoint: {}", ec.message());
+    }
+}
+#endif
+}  // namespace db
+}  // namespace tcs
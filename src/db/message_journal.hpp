@@ -0,0 +1,131 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/storage.hpp"
+#include "model/message.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace db {
+// 本地追加写的消息日志，是聊天消息的第一个持久化点(仅Linux)
+// 消息追加到日志并落盘后即可确认，后台线程再按顺序写入存储引擎
+// - 日志由固定大小的段文件组成，段文件预分配后整体mmap，追加只是一次memcpy
+// - 同时追加的多条消息由同步线程合并成一次msync(组提交)
+// - 已写入存储的位置保存在checkpoint文件中，启动时从这里重放，写完的段文件删除
+class MessageJournal {
+public:
+    // 重放时存储拒绝了一条已确认的消息，在重放线程上调用
+    using RejectHandler = std::function<void(const model::Message& msg)>;
+
+    static bool enabled() { return instance_ptr_ != nullptr; }
+
+    static MessageJournal& get() {
+        if (!instance_ptr_) {
+            throw std::runtime_error("MessageJournal has not been initialized. Call init() first.");
+        }
+        return *instance_ptr_;
+    }
+
+    // 在Storage::init之后调用，上次未写入存储的消息全部写入后才返回
+    static void init(const std::string& dir, u64 segment_bytes, RejectHandler on_reject);
+
+    // 把已落盘的消息全部写入存储后关闭，必须在存储关闭之前调用
+    static void shutdown() { instance_ptr_.reset(); }
+
+    // 打开日志目录，上次未写入storage的消息在后台重放，用wait_recovered等待完成
+    MessageJournal(const std::filesystem::path& dir, u64 segment_bytes, Storage& storage,
+                   RejectHandler on_reject = nullptr);
+    ~MessageJournal();
+
+    MessageJournal(const MessageJournal&) = delete;
+    MessageJournal& operator=(const MessageJournal&) = delete;
+
+    // 追加一条消息，落盘后返回；写盘失败时抛出异常
+    // 调用方负责成员检查，之后成员变化导致重放时被存储拒绝的消息交给on_reject
+    void append(const model::Message& msg);
+
+    // 已落盘但还没有写入存储的消息数
+    u64 pending();
+
+    // 等待启动时恢复出的消息全部写入存储，存储不可用时一直等待
+    void wait_recovered();
+
+private:
+    // 一个段文件，整体以MAP_SHARED映射
+    struct Segment {
+        u64 index = 0;
+        int fd = -1;
+        char* data = nullptr;
+        u64 size = 0;
+
+        ~Segment();
+    };
+
+    // 一段待msync的区间
+    struct DirtyRange {
+        std::shared_ptr<Segment> segment;
+        u64 begin;
+        u64 end;
+    };
+
+    std::filesystem::path segment_path(u64 index) const;
+    std::shared_ptr<Segment> open_segment(u64 index, bool create);
+    // 返回从offset开始的一条完整记录的长度，没有有效记录时返回0
+    static u64 record_at(const Segment& segment, u64 offset, model::Message* out);
+
+    void recover();
+    void sync_loop();
+    void replay_loop();
+    // 写入存储，成功或被存储拒绝时返回true，出错需要重试时返回false
+    bool apply(const model::Message& msg, bool recovering);
+    void save_checkpoint(u64 segment, u64 offset);
+
+    std::filesystem::path dir_;
+    u64 segment_bytes_;
+    Storage& storage_;
+    RejectHandler on_reject_;
+
+    std::mutex mtx_;
+    // 追加或落盘有进展时通知
+    std::condition_variable append_cv_;
+    std::condition_variable synced_cv_;
+    std::condition_variable replayed_cv_;
+    // 所有未删除的段，按序号排列
+    std::map<u64, std::shared_ptr<Segment>> segments_;
+    std::shared_ptr<Segment> active_;
+    u64 write_offset_ = 0;
+    std::vector<DirtyRange> dirty_;
+    // 记录数计数：已追加、已落盘、已写入存储
+    u64 appended_ = 0;
+    u64 synced_ = 0;
+    u64 replayed_ = 0;
+    // 启动时恢复出的记录数，这些记录可能已经写入过存储
+    u64 recovered_ = 0;
+    // 落盘失败后不再接受追加
+    bool failed_ = false;
+    // 先停同步线程，它落盘完所有追加后再停重放线程
+    bool stop_sync_ = false;
+    bool stop_replay_ = false;
+
+    // 重放位置，只由重放线程访问
+    u64 replay_segment_ = 0;
+    u64 replay_offset_ = 0;
+
+    std::thread syncer_;
+    std::thread replayer_;
+
+    static std::unique_ptr<MessageJournal> instance_ptr_;
+};
+}  // namespace db
+}  // namespace tcs
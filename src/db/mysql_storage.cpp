@@ -0,0 +1,298 @@
+#include <spdlog/spdlog.h>
+
+#include "db/mysql_storage.hpp"
+#include "db/sql_conn_RAII.hpp"
+
+namespace tcs {
+namespace db {
+namespace {
+// 主键或唯一索引冲突
+constexpr int ER_DUP_ENTRY = 1062;
+
+// 在事务中执行f，异常时回滚后继续抛出
+template <typename F>
+auto in_transaction(SqlConnRAII& conn, F&& f) {
+    conn.begin_transaction();
+    try {
+        if constexpr (std::is_void_v<decltype(f())>) {
+            f();
+            conn.commit();
+        } else {
+            auto result = f();
+            conn.commit();
+            return result;
+        }
+    } catch (...) {
+        conn.rollback();
+        throw;
+    }
+}
+}  // namespace
+
+bool MySqlStorage::create_user(const model::User& user, const std::string& password_hash) {
+    SqlConnRAII conn;
+    try {
+        return conn.execute_update(
+                   "INSERT INTO users (id, username, password_hash, email, nickname) "
+                   "VALUES (?, ?, ?, ?, ?)",
+                   user.id, user.username, password_hash, user.email, user.nickname) == 1;
+    } catch (const sql::SQLException& e) {
+        if (e.getErrorCode() == ER_DUP_ENTRY) {
+            return false;
+        }
+        throw;
+    }
+}
+
+std::optional<Storage::UserRecord> MySqlStorage::find_user(const std::string& username) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+        "SELECT id, password_hash, nickname, email, avatar_url, created_at FROM "
+        "users WHERE username = ?",
+        username));
+    if (!res->next()) {
+        return std::nullopt;
+    }
+    return UserRecord{.user = model::User{.id = res->getUInt64("id"),
+                                          .username = username,
+                                          .nickname = res->getString("nickname"),
+                                          .email = res->getString("email"),
+                                          .avatar_url = res->getString("avatar_url"),
+                                          .created_at = res->getString("created_at")},
+                      .password_hash = res->getString("password_hash")};
+}
+
+void MySqlStorage::create_group_room(u64 room_id, const std::string& name, u64 owner_id) {
+    SqlConnRAII conn;
+    in_transaction(conn, [&] {
+        if (conn.execute_update("INSERT INTO rooms (id, name, type, owner_id) VALUES (?, ?, ?, ?)",
+                                room_id, name, static_cast<int>(utils::RoomType::GROUP),
+                                owner_id) != 1) {
+            throw std::runtime_error("Failed to create group room");
+        }
+        if (conn.execute_update(
+                "INSERT INTO room_members (room_id, user_id, role) VALUES (?, ?, ?)", room_id,
+                owner_id, static_cast<int>(utils::GroupRole::OWNER)) != 1) {
+            throw std::runtime_error("Failed to add owner to group room");
+        }
+    });
+}
+
+void MySqlStorage::create_private_room(u64 room_id, u64 user_id, u64 other_id) {
+    SqlConnRAII conn;
+    in_transaction(conn, [&] {
+        if (conn.execute_update("INSERT INTO rooms (id, type) VALUES (?, ?)", room_id,
+                                static_cast<int>(utils::RoomType::PRIVATE)) != 1) {
+            throw std::runtime_error("Failed to create private room");
+        }
+        if (conn.execute_update("INSERT INTO room_members (room_id, user_id, role)"
+                                "VALUES (?, ?, ?), (?, ?, ?)",
+                                room_id, user_id,
+                                static_cast<int>(utils::GroupRole::PRIVATE_MEMBER), room_id,
+                                other_id,
+                                static_cast<int>(utils::GroupRole::PRIVATE_MEMBER)) != 2) {
+            throw std::runtime_error("Failed to add members to private room");
+        }
+    });
+}
+
+std::optional<utils::RoomType> MySqlStorage::room_type(u64 room_id) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(
+        conn.execute_query("SELECT type FROM rooms WHERE id = ?", room_id));
+    if (!res->next()) {
+        return std::nullopt;
+    }
+    return static_cast<utils::RoomType>(res->getInt("type"));
+}
+
+bool MySqlStorage::delete_room(u64 room_id) {
+    SqlConnRAII conn;
+    return in_transaction(conn, [&] {
+        int deleted_member =
+            conn.execute_update("DELETE FROM room_members WHERE room_id = ?", room_id);
+        spdlog::info("Deleted {} members from room {}", deleted_member, room_id);
+        return conn.execute_update("DELETE FROM rooms WHERE id = ?", room_id) == 1;
+    });
+}
+
+std::optional<utils::GroupRole> MySqlStorage::member_role(u64 room_id, u64 user_id) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+        "SELECT role FROM room_members WHERE room_id = ? AND user_id = ?", room_id, user_id));
+    if (!res->next()) {
+        return std::nullopt;
+    }
+    return static_cast<utils::GroupRole>(res->getInt("role"));
+}
+
+bool MySqlStorage::add_member(u64 room_id, u64 user_id, utils::GroupRole role) {
+    SqlConnRAII conn;
+    try {
+        return conn.execute_update(
+                   "INSERT INTO room_members (room_id, user_id, role) VALUE (?, ?, ?)", room_id,
+                   user_id, static_cast<int>(role)) == 1;
+    } catch (const sql::SQLException& e) {
+        if (e.getErrorCode() == ER_DUP_ENTRY) {
+            return false;
+        }
+        throw;
+    }
+}
+
+std::vector<u64> MySqlStorage::room_members(u64 room_id) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(
+        conn.execute_query("SELECT user_id FROM room_members WHERE room_id = ?", room_id));
+    std::vector<u64> members;
+    while (res->next()) {
+        members.push_back(res->getUInt64("user_id"));
+    }
+    return members;
+}
+
+std::vector<u64> MySqlStorage::rooms_of(u64 user_id) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(
+        conn.execute_query("SELECT room_id FROM room_members WHERE user_id = ?", user_id));
+    std::vector<u64> rooms;
+    while (res->next()) {
+        rooms.push_back(res->getUInt64("room_id"));
+    }
+    return rooms;
+}
+
+bool MySqlStorage::mark_read(u64 room_id, u64 user_id, u64 message_id) {
+    SqlConnRAII conn;
+    int updated_row = conn.execute_update(
+        "UPDATE room_members SET last_read_message_id = GREATEST(last_read_message_id, ?) "
+        "WHERE room_id = ? AND user_id = ?",
+        message_id, room_id, user_id);
+    if (updated_row != 0) {
+        return true;
+    }
+    // 已读位置未变化时同样返回0行，再确认一次是否为成员
+    return std::unique_ptr<sql::ResultSet>(
+               conn.execute_query("SELECT 1 FROM room_members WHERE room_id = ? AND user_id = ?",
+                                  room_id, user_id))
+        ->next();
+}
+
+std::vector<model::RoomSummary> MySqlStorage::room_summaries(u64 user_id,
+                                                             std::size_t preview_chars) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+        "SELECT r.id, r.type, r.name, r.description, r.avatar_url, r.last_message_id, "
+        "r.created_at, rm.last_read_message_id, "
+        "(SELECT COUNT(*) FROM room_members c WHERE c.room_id = r.id) AS member_count, "
+        "m.sender_id AS last_sender_id, LEFT(m.content, ?) AS last_preview, "
+        "COALESCE(u.unread, 0) AS unread_count "
+        "FROM room_members rm "
+        "JOIN rooms r ON r.id = rm.room_id "
+        "LEFT JOIN messages m ON m.id = r.last_message_id "
+        "LEFT JOIN (SELECT msg.room_id, COUNT(*) AS unread FROM room_members me "
+        "JOIN messages msg ON msg.room_id = me.room_id "
+        "AND msg.id > me.last_read_message_id "
+        "WHERE me.user_id = ? AND msg.sender_id <> ? GROUP BY msg.room_id) u "
+        "ON u.room_id = r.id "
+        "WHERE rm.user_id = ? "
+        "ORDER BY r.last_message_id DESC",
+        static_cast<int>(preview_chars), user_id, user_id, user_id));
+
+    std::vector<model::RoomSummary> rooms;
+    while (res->next()) {
+        rooms.push_back(model::RoomSummary{
+            .room = model::Room{.id = res->getUInt64("id"),
+                                .type = static_cast<i8>(res->getInt("type")),
+                                .name = res->getString("name"),
+                                .description = res->getString("description"),
+                                .avatar_url = res->getString("avatar_url"),
+                                .last_message_id = res->getUInt64("last_message_id"),
+                                .member_count = res->getInt("member_count"),
+                                .created_at = res->getString("created_at")},
+            .last_sender_id = res->getUInt64("last_sender_id"),
+            .last_preview = res->getString("last_preview"),
+            .last_read_message_id = res->getUInt64("last_read_message_id"),
+            .unread_count = res->getUInt64("unread_count")});
+    }
+    return rooms;
+}
+
+bool MySqlStorage::append_message(const model::Message& message) {
+    SqlConnRAII conn;
+    return in_transaction(conn, [&] {
+        // 权限检测，必须为房间成员才能发送消息
+        bool is_member =
+            std::unique_ptr<sql::ResultSet>(
+                conn.execute_query("SELECT 1 FROM room_members WHERE room_id = ? AND user_id = ?",
+                                   message.room_id, message.sender_id))
+                ->next();
+        if (!is_member) {
+            return false;
+        }
+        if (conn.execute_update(
+                "INSERT INTO messages (id, room_id, sender_id, content) VALUES (?, ?, ?, ?)",
+                message.id, message.room_id, message.sender_id, message.content) != 1) {
+            throw std::runtime_error("Failed to insert message " + std::to_string(message.id));
+        }
+        // 与SQLite的MAX和内存引擎一致，提交乱序时last_message_id也不后退
+        // 值未变化时影响行数为0，房间存在已由成员检查保证，不再检查行数
+        conn.execute_update(
+            "UPDATE rooms SET last_message_id = GREATEST(COALESCE(last_message_id, 0), ?) "
+            "WHERE id = ?",
+            message.id, message.room_id);
+        return true;
+    });
+}
+
+std::vector<model::Message> MySqlStorage::messages_before(u64 room_id, u64 before,
+                                                          std::size_t limit) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+        "SELECT id, sender_id, content FROM messages WHERE room_id = ? AND id < ? "
+        "ORDER BY id DESC LIMIT ?",
+        room_id, before, static_cast<int>(limit)));
+    std::vector<model::Message> messages;
+    while (res->next()) {
+        messages.push_back(model::Message{.id = res->getUInt64("id"),
+                                          .room_id = room_id,
+                                          .sender_id = res->getUInt64("sender_id"),
+                                          .content = res->getString("content")});
+    }
+    return messages;
+}
+
+std::optional<model::Attachment> MySqlStorage::find_attachment(u64 user_id,
+                                                               const std::string& hash) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(
+        conn.execute_query("SELECT id, size, content_type FROM attachments "
+                           "WHERE user_id = ? AND hash = ?",
+                           user_id, hash));
+    if (!res->next()) {
+        return std::nullopt;
+    }
+    return model::Attachment{.id = res->getUInt64("id"),
+                             .hash = hash,
+                             .size = res->getUInt64("size"),
+                             .content_type = res->getString("content_type")};
+}
+
+u64 MySqlStorage::attachment_usage(u64 user_id) {
+    SqlConnRAII conn;
+    std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+        "SELECT COALESCE(SUM(size), 0) AS used FROM attachments WHERE user_id = ?", user_id));
+    return res->next() ? res->getUInt64("used") : 0;
+}
+
+void MySqlStorage::add_attachment(u64 user_id, const model::Attachment& attachment) {
+    SqlConnRAII conn;
+    if (conn.execute_update("INSERT INTO attachments (id, user_id, hash, size, content_type) "
+                            "VALUES (?, ?, ?, ?, ?)",
+                            attachment.id, user_id, attachment.hash, attachment.size,
+                            attachment.content_type) != 1) {
+        throw std::runtime_error("Failed to insert attachment record");
+    }
+}
+}  // namespace db
+}  // namespace tcs
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "db/storage.hpp"
+
+namespace tcs {
+namespace db {
+// 原有的MySQL实现，连接从SqlConnPool获取
+class MySqlStorage : public Storage {
+public:
+    bool create_user(const model::User& user, const std::string& password_hash) override;
+    std::optional<UserRecord> find_user(const std::string& username) override;
+
+    void create_group_room(u64 room_id, const std::string& name, u64 owner_id) override;
+    void create_private_room(u64 room_id, u64 user_id, u64 other_id) override;
+    std::optional<utils::RoomType> room_type(u64 room_id) override;
+    bool delete_room(u64 room_id) override;
+
+    std::optional<utils::GroupRole> member_role(u64 room_id, u64 user_id) override;
+    bool add_member(u64 room_id, u64 user_id, utils::GroupRole role) override;
+    std::vector<u64> room_members(u64 room_id) override;
+    std::vector<u64> rooms_of(u64 user_id) override;
+    bool mark_read(u64 room_id, u64 user_id, u64 message_id) override;
+    std::vector<model::RoomSummary> room_summaries(u64 user_id,
+                                                   std::size_t preview_chars) override;
+
+    bool append_message(const model::Message& message) override;
+    std::vector<model::Message> messages_before(u64 room_id, u64 before,
+                                                std::size_t limit) override;
+
+    std::optional<model::Attachment> find_attachment(u64 user_id,
+                                                     const std::string& hash) override;
+    u64 attachment_usage(u64 user_id) override;
+    void add_attachment(u64 user_id, const model::Attachment& attachment) override;
+};
+}  // namespace db
+}  // namespace tcs
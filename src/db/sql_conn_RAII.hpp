@@ -7,6 +7,7 @@
 #include <optional>
 
 #include "db/sql_conn_pool.hpp"
+#include "utils/metrics.hpp"
 #include "utils/types.hpp"
 
 using result_type = std::vector<std::map<std::string, std::optional<std::string>>>;
@@ -49,6 +50,7 @@ public:
     template <typename... Args>
     sql::ResultSet* execute_query(const std::string& sql_template, const Args&... args) {
         sql_ = getSql();
+        utils::ScopedTimer timer(utils::Metrics::get().db_query);
         std::unique_ptr<PrepStmt> pstmt(sql_->prepareStatement(sql_template));
         int idx = 0;
         bind_all_param(pstmt.get(), ++idx, args...);
@@ -58,6 +60,7 @@ public:
     template <typename... Args>
     int execute_update(const std::string& sql_template, const Args&... args) {
         sql_ = getSql();
+        utils::ScopedTimer timer(utils::Metrics::get().db_query);
         std::unique_ptr<PrepStmt> pstmt(sql_->prepareStatement(sql_template));
         int idx = 0;
         bind_all_param(pstmt.get(), ++idx, args...);
@@ -4,6 +4,8 @@
 #include <memory>
 #include <mutex>
 
+#include "utils/metrics.hpp"
+
 using AppConfig = tcs::utils::AppConfig;
 
 namespace tcs {
@@ -19,13 +21,17 @@ SqlConnPool* SqlConnPool::instance() {
  * 会进行健康检查，如果连接不可用则重新初始化连接
  */
 Connection* SqlConnPool::getConn() {
+    utils::Metrics& metrics = utils::Metrics::get();
     if (smph_->try_acquire()) {
+        metrics.db_acquire.record(0);
         return getSql();
     }
-    // 通过日志判断连接池负载
-    std::cout << "Sql connect pool is busy..." << std::endl;
-
-    smph_->acquire();
+    // 连接池负载通过/metrics中的等待次数和等待时间观察
+    metrics.db_acquire_waits.add();
+    {
+        utils::ScopedTimer timer(metrics.db_acquire);
+        smph_->acquire();
+    }
     return getSql();
 }
 
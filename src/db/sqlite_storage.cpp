@@ -0,0 +1,550 @@
+#include <sqlite3.h>
+#include <spdlog/spdlog.h>
+
+#include "db/sqlite_storage.hpp"
+#include "utils/metrics.hpp"
+
+namespace tcs {
+namespace db {
+namespace {
+// 与MySQL表结构一致，类型换成SQLite的等价类型
+// id均为雪花id，小于2^63，可以直接存为INTEGER
+constexpr const char* SCHEMA = R"(
+CREATE TABLE IF NOT EXISTS users (
+    id            INTEGER PRIMARY KEY,
+    username      TEXT    NOT NULL UNIQUE,
+    password_hash TEXT    NOT NULL,
+    email         TEXT,
+    nickname      TEXT,
+    avatar_url    TEXT,
+    created_at    TEXT    NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+CREATE TABLE IF NOT EXISTS rooms (
+    id              INTEGER PRIMARY KEY,
+    name            TEXT,
+    type            INTEGER NOT NULL,
+    owner_id        INTEGER,
+    description     TEXT,
+    avatar_url      TEXT,
+    last_message_id INTEGER NOT NULL DEFAULT 0,
+    created_at      TEXT    NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+CREATE TABLE IF NOT EXISTS room_members (
+    room_id              INTEGER NOT NULL,
+    user_id              INTEGER NOT NULL,
+    role                 INTEGER NOT NULL,
+    last_read_message_id INTEGER NOT NULL DEFAULT 0,
+    PRIMARY KEY (room_id, user_id)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_room_members_user ON room_members (user_id);
+CREATE TABLE IF NOT EXISTS messages (
+    id         INTEGER PRIMARY KEY,
+    room_id    INTEGER NOT NULL,
+    sender_id  INTEGER NOT NULL,
+    content    TEXT    NOT NULL,
+    created_at TEXT    NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+CREATE INDEX IF NOT EXISTS idx_messages_room ON messages (room_id, id);
+CREATE TABLE IF NOT EXISTS attachments (
+    id           INTEGER PRIMARY KEY,
+    user_id      INTEGER NOT NULL,
+    hash         TEXT    NOT NULL,
+    size         INTEGER NOT NULL,
+    content_type TEXT    NOT NULL,
+    created_at   TEXT    NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    UNIQUE (user_id, hash)
+);
+CREATE INDEX IF NOT EXISTS idx_attachments_hash ON attachments (hash);
+)";
+
+constexpr const char* INSERT_USER =
+    "INSERT INTO users (id, username, password_hash, email, nickname) VALUES (?, ?, ?, ?, ?)";
+constexpr const char* SELECT_USER =
+    "SELECT id, password_hash, nickname, email, avatar_url, created_at FROM users "
+    "WHERE username = ?";
+constexpr const char* INSERT_ROOM =
+    "INSERT INTO rooms (id, name, type, owner_id) VALUES (?, ?, ?, ?)";
+constexpr const char* INSERT_MEMBER =
+    "INSERT INTO room_members (room_id, user_id, role) VALUES (?, ?, ?)";
+constexpr const char* SELECT_ROOM_TYPE = "SELECT type FROM rooms WHERE id = ?";
+constexpr const char* DELETE_MEMBERS = "DELETE FROM room_members WHERE room_id = ?";
+constexpr const char* DELETE_ROOM = "DELETE FROM rooms WHERE id = ?";
+constexpr const char* SELECT_ROLE =
+    "SELECT role FROM room_members WHERE room_id = ? AND user_id = ?";
+constexpr const char* SELECT_MEMBERS = "SELECT user_id FROM room_members WHERE room_id = ?";
+constexpr const char* SELECT_USER_ROOMS = "SELECT room_id FROM room_members WHERE user_id = ?";
+constexpr const char* UPDATE_READ =
+    "UPDATE room_members SET last_read_message_id = MAX(last_read_message_id, ?) "
+    "WHERE room_id = ? AND user_id = ?";
+// 未读数用相关子查询，走messages(room_id, id)索引
+constexpr const char* SELECT_SUMMARIES =
+    "SELECT r.id, r.type, r.name, r.description, r.avatar_url, r.last_message_id, "
+    "r.created_at, rm.last_read_message_id, "
+    "(SELECT COUNT(*) FROM room_members c WHERE c.room_id = r.id), "
+    "m.sender_id, substr(m.content, 1, ?), "
+    "(SELECT COUNT(*) FROM messages msg WHERE msg.room_id = r.id "
+    "AND msg.id > rm.last_read_message_id AND msg.sender_id <> rm.user_id) "
+    "FROM room_members rm "
+    "JOIN rooms r ON r.id = rm.room_id "
+    "LEFT JOIN messages m ON m.id = r.last_message_id "
+    "WHERE rm.user_id = ? "
+    "ORDER BY r.last_message_id DESC";
+constexpr const char* INSERT_MESSAGE =
+    "INSERT INTO messages (id, room_id, sender_id, content) VALUES (?, ?, ?, ?)";
+// 同一批次中的消息不保证按id顺序写入
+constexpr const char* UPDATE_LAST_MESSAGE =
+    "UPDATE rooms SET last_message_id = MAX(last_message_id, ?) WHERE id = ?";
+constexpr const char* SELECT_MESSAGES =
+    "SELECT id, sender_id, content FROM messages WHERE room_id = ? AND id < ? "
+    "ORDER BY id DESC LIMIT ?";
+constexpr const char* SELECT_ATTACHMENT =
+    "SELECT id, size, content_type FROM attachments WHERE user_id = ? AND hash = ?";
+constexpr const char* SELECT_USAGE =
+    "SELECT COALESCE(SUM(size), 0) FROM attachments WHERE user_id = ?";
+constexpr const char* INSERT_ATTACHMENT =
+    "INSERT INTO attachments (id, user_id, hash, size, content_type) VALUES (?, ?, ?, ?, ?)";
+
+constexpr const char* BEGIN = "BEGIN IMMEDIATE";
+constexpr const char* COMMIT = "COMMIT";
+constexpr const char* SAVEPOINT = "SAVEPOINT op";
+constexpr const char* RELEASE = "RELEASE op";
+constexpr const char* ROLLBACK_TO = "ROLLBACK TO op";
+
+// 主键或唯一索引冲突
+class ConstraintError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void fail(sqlite3* db, const std::string& what) {
+    throw std::runtime_error(what + ": " + sqlite3_errmsg(db));
+}
+
+// 绑定参数后逐行读取，析构时重置语句供下次复用
+class Stmt {
+public:
+    template <typename... Args>
+    Stmt(SqliteStorage::Conn& conn, const char* sql, const Args&... args)
+        : db_(conn.handle()), stmt_(conn.prepare(sql)) {
+        int idx = 0;
+        (bind(++idx, args), ...);
+    }
+
+    ~Stmt() {
+        sqlite3_reset(stmt_);
+        sqlite3_clear_bindings(stmt_);
+    }
+
+    // 有下一行时返回true
+    bool next() {
+        int rc = sqlite3_step(stmt_);
+        if (rc == SQLITE_ROW) {
+            return true;
+        }
+        if (rc == SQLITE_DONE) {
+            return false;
+        }
+        if ((rc & 0xFF) == SQLITE_CONSTRAINT) {
+            throw ConstraintError(sqlite3_errmsg(db_));
+        }
+        fail(db_, "sqlite3_step failed");
+    }
+
+    // 执行不返回结果的语句，返回影响的行数
+    int run() {
+        next();
+        return sqlite3_changes(db_);
+    }
+
+    u64 get_u64(int col) { return static_cast<u64>(sqlite3_column_int64(stmt_, col)); }
+    int get_int(int col) { return sqlite3_column_int(stmt_, col); }
+    // NULL读作空字符串，与JDBC的getString一致
+    std::string get_string(int col) {
+        const unsigned char* text = sqlite3_column_text(stmt_, col);
+        if (!text) {
+            return {};
+        }
+        return std::string(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt_, col));
+    }
+
+private:
+    void bind(int idx, const std::string& value) {
+        check(sqlite3_bind_text(stmt_, idx, value.data(), static_cast<int>(value.size()),
+                                SQLITE_STATIC));
+    }
+    void bind(int idx, int value) { check(sqlite3_bind_int(stmt_, idx, value)); }
+    void bind(int idx, u64 value) {
+        check(sqlite3_bind_int64(stmt_, idx, static_cast<sqlite3_int64>(value)));
+    }
+    void bind(int idx, i64 value) { check(sqlite3_bind_int64(stmt_, idx, value)); }
+
+    void check(int rc) {
+        if (rc != SQLITE_OK) {
+            fail(db_, "sqlite3_bind failed");
+        }
+    }
+
+    sqlite3* db_;
+    sqlite3_stmt* stmt_;
+};
+}  // namespace
+
+SqliteStorage::Conn::Conn(const std::string& file, bool read_only, u64 mmap_bytes) {
+    // 每个连接只在一个线程上使用，关闭SQLite内部的互斥锁
+    int flags = SQLITE_OPEN_NOMUTEX |
+                (read_only ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (sqlite3_open_v2(file.c_str(), &db_, flags, nullptr) != SQLITE_OK) {
+        std::string error = db_ ? sqlite3_errmsg(db_) : "out of memory";
+        sqlite3_close(db_);
+        throw std::runtime_error("Failed to open " + file + ": " + error);
+    }
+    // 写线程提交时检查点可能短暂持锁
+    sqlite3_busy_timeout(db_, 5000);
+    std::string pragmas = "PRAGMA mmap_size = " + std::to_string(mmap_bytes) + ";";
+    if (!read_only) {
+        // WAL下读不阻塞写；批量提交摊薄了每次提交的fsync，因此保留FULL
+        pragmas += "PRAGMA journal_mode = WAL; PRAGMA synchronous = FULL;";
+    }
+    if (sqlite3_exec(db_, pragmas.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::string error = sqlite3_errmsg(db_);
+        sqlite3_close(db_);
+        throw std::runtime_error("Failed to configure " + file + ": " + error);
+    }
+}
+
+SqliteStorage::Conn::~Conn() {
+    for (auto& [sql, stmt] : stmts_) {
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db_);
+}
+
+sqlite3_stmt* SqliteStorage::Conn::prepare(const char* sql) {
+    auto it = stmts_.find(sql);
+    if (it != stmts_.end()) {
+        return it->second;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db_, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) !=
+        SQLITE_OK) {
+        fail(db_, std::string("Failed to prepare \"") + sql + "\"");
+    }
+    stmts_.emplace(sql, stmt);
+    return stmt;
+}
+
+void SqliteStorage::Conn::exec(const char* sql) { Stmt(*this, sql).run(); }
+
+SqliteStorage::ReadConn::ReadConn(SqliteStorage& storage) : storage_(storage) {
+    {
+        std::lock_guard<std::mutex> lock(storage_.read_mtx_);
+        if (!storage_.read_pool_.empty()) {
+            conn_ = std::move(storage_.read_pool_.back());
+            storage_.read_pool_.pop_back();
+            return;
+        }
+    }
+    // 连接数最多等于同时读的线程数
+    conn_ = std::make_unique<Conn>(storage_.file_, true, storage_.mmap_bytes_);
+}
+
+SqliteStorage::ReadConn::~ReadConn() {
+    std::lock_guard<std::mutex> lock(storage_.read_mtx_);
+    storage_.read_pool_.push_back(std::move(conn_));
+}
+
+SqliteStorage::SqliteStorage(const std::string& file, std::size_t batch_size, u64 mmap_bytes)
+    : file_(file), batch_size_(batch_size), mmap_bytes_(mmap_bytes) {
+    writer_conn_ = std::make_unique<Conn>(file_, false, mmap_bytes_);
+    if (sqlite3_exec(writer_conn_->handle(), SCHEMA, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        fail(writer_conn_->handle(), "Failed to create schema");
+    }
+    writer_ = std::thread([this] { writer_loop(); });
+    spdlog::info("SQLite storage opened: {}, batch size {}", file_, batch_size_);
+}
+
+SqliteStorage::~SqliteStorage() {
+    {
+        std::lock_guard<std::mutex> lock(write_mtx_);
+        stop_ = true;
+    }
+    write_cv_.notify_one();
+    writer_.join();
+}
+
+template <typename F>
+auto SqliteStorage::write(F&& f) -> decltype(f(std::declval<Conn&>())) {
+    using R = decltype(f(std::declval<Conn&>()));
+    auto promise = std::make_shared<std::promise<R>>();
+    std::future<R> future = promise->get_future();
+
+    WriteOp op;
+    if constexpr (std::is_void_v<R>) {
+        op.run = std::forward<F>(f);
+        op.done = [promise](std::exception_ptr error) {
+            error ? promise->set_exception(error) : promise->set_value();
+        };
+    } else {
+        auto result = std::make_shared<std::optional<R>>();
+        op.run = [f = std::forward<F>(f), result](Conn& conn) { result->emplace(f(conn)); };
+        op.done = [promise, result](std::exception_ptr error) {
+            error ? promise->set_exception(error) : promise->set_value(std::move(**result));
+        };
+    }
+    {
+        std::lock_guard<std::mutex> lock(write_mtx_);
+        if (stop_) {
+            throw std::runtime_error("Write on a stopped SqliteStorage");
+        }
+        write_queue_.push_back(std::move(op));
+    }
+    write_cv_.notify_one();
+    return future.get();
+}
+
+void SqliteStorage::writer_loop() {
+    std::vector<WriteOp> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(write_mtx_);
+            write_cv_.wait(lock, [this] { return stop_ || !write_queue_.empty(); });
+            // 停止前先写完已排队的操作
+            if (write_queue_.empty()) {
+                return;
+            }
+            while (!write_queue_.empty() && batch.size() < batch_size_) {
+                batch.push_back(std::move(write_queue_.front()));
+                write_queue_.pop_front();
+            }
+        }
+        commit_batch(batch);
+        batch.clear();
+    }
+}
+
+void SqliteStorage::commit_batch(std::vector<WriteOp>& batch) {
+    utils::ScopedTimer timer(utils::Metrics::get().db_batch);
+    std::vector<std::exception_ptr> errors(batch.size());
+    std::exception_ptr commit_error;
+    Conn& conn = *writer_conn_;
+    try {
+        conn.exec(BEGIN);
+        for (std::size_t i = 0; i < batch.size(); i++) {
+            // 每个操作一个保存点，失败时只撤销它自己
+            conn.exec(SAVEPOINT);
+            try {
+                batch[i].run(conn);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                conn.exec(ROLLBACK_TO);
+            }
+            conn.exec(RELEASE);
+        }
+        conn.exec(COMMIT);
+    } catch (...) {
+        commit_error = std::current_exception();
+        sqlite3_exec(conn.handle(), "ROLLBACK", nullptr, nullptr, nullptr);
+        spdlog::error("SQLite batch of {} writes rolled back", batch.size());
+    }
+    // 提交之后才通知调用方
+    for (std::size_t i = 0; i < batch.size(); i++) {
+        batch[i].done(commit_error ? commit_error : errors[i]);
+    }
+}
+
+bool SqliteStorage::create_user(const model::User& user, const std::string& password_hash) {
+    return write([&](Conn& conn) {
+        try {
+            Stmt(conn, INSERT_USER, user.id, user.username, password_hash, user.email,
+                 user.nickname)
+                .run();
+            return true;
+        } catch (const ConstraintError&) {
+            return false;
+        }
+    });
+}
+
+std::optional<Storage::UserRecord> SqliteStorage::find_user(const std::string& username) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_USER, username);
+    if (!stmt.next()) {
+        return std::nullopt;
+    }
+    return UserRecord{.user = model::User{.id = stmt.get_u64(0),
+                                          .username = username,
+                                          .nickname = stmt.get_string(2),
+                                          .email = stmt.get_string(3),
+                                          .avatar_url = stmt.get_string(4),
+                                          .created_at = stmt.get_string(5)},
+                      .password_hash = stmt.get_string(1)};
+}
+
+void SqliteStorage::create_group_room(u64 room_id, const std::string& name, u64 owner_id) {
+    write([&](Conn& conn) {
+        Stmt(conn, INSERT_ROOM, room_id, name, static_cast<int>(utils::RoomType::GROUP), owner_id)
+            .run();
+        Stmt(conn, INSERT_MEMBER, room_id, owner_id, static_cast<int>(utils::GroupRole::OWNER))
+            .run();
+    });
+}
+
+void SqliteStorage::create_private_room(u64 room_id, u64 user_id, u64 other_id) {
+    write([&](Conn& conn) {
+        Stmt(conn, INSERT_ROOM, room_id, std::string(), static_cast<int>(utils::RoomType::PRIVATE),
+             u64(0))
+            .run();
+        for (u64 member : {user_id, other_id}) {
+            Stmt(conn, INSERT_MEMBER, room_id, member,
+                 static_cast<int>(utils::GroupRole::PRIVATE_MEMBER))
+                .run();
+        }
+    });
+}
+
+std::optional<utils::RoomType> SqliteStorage::room_type(u64 room_id) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_ROOM_TYPE, room_id);
+    if (!stmt.next()) {
+        return std::nullopt;
+    }
+    return static_cast<utils::RoomType>(stmt.get_int(0));
+}
+
+bool SqliteStorage::delete_room(u64 room_id) {
+    return write([&](Conn& conn) {
+        Stmt(conn, DELETE_MEMBERS, room_id).run();
+        return Stmt(conn, DELETE_ROOM, room_id).run() == 1;
+    });
+}
+
+std::optional<utils::GroupRole> SqliteStorage::member_role(u64 room_id, u64 user_id) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_ROLE, room_id, user_id);
+    if (!stmt.next()) {
+        return std::nullopt;
+    }
+    return static_cast<utils::GroupRole>(stmt.get_int(0));
+}
+
+bool SqliteStorage::add_member(u64 room_id, u64 user_id, utils::GroupRole role) {
+    return write([&](Conn& conn) {
+        try {
+            return Stmt(conn, INSERT_MEMBER, room_id, user_id, static_cast<int>(role)).run() == 1;
+        } catch (const ConstraintError&) {
+            return false;
+        }
+    });
+}
+
+std::vector<u64> SqliteStorage::room_members(u64 room_id) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_MEMBERS, room_id);
+    std::vector<u64> members;
+    while (stmt.next()) {
+        members.push_back(stmt.get_u64(0));
+    }
+    return members;
+}
+
+std::vector<u64> SqliteStorage::rooms_of(u64 user_id) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_USER_ROOMS, user_id);
+    std::vector<u64> rooms;
+    while (stmt.next()) {
+        rooms.push_back(stmt.get_u64(0));
+    }
+    return rooms;
+}
+
+bool SqliteStorage::mark_read(u64 room_id, u64 user_id, u64 message_id) {
+    // SQLite的changes按匹配的行计数，已读位置不变时仍为1
+    return write([&](Conn& conn) {
+        return Stmt(conn, UPDATE_READ, message_id, room_id, user_id).run() == 1;
+    });
+}
+
+std::vector<model::RoomSummary> SqliteStorage::room_summaries(u64 user_id,
+                                                              std::size_t preview_chars) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_SUMMARIES, static_cast<int>(preview_chars), user_id);
+    std::vector<model::RoomSummary> rooms;
+    while (stmt.next()) {
+        rooms.push_back(model::RoomSummary{
+            .room = model::Room{.id = stmt.get_u64(0),
+                                .type = static_cast<i8>(stmt.get_int(1)),
+                                .name = stmt.get_string(2),
+                                .description = stmt.get_string(3),
+                                .avatar_url = stmt.get_string(4),
+                                .last_message_id = stmt.get_u64(5),
+                                .member_count = stmt.get_int(8),
+                                .created_at = stmt.get_string(6)},
+            .last_sender_id = stmt.get_u64(9),
+            .last_preview = stmt.get_string(10),
+            .last_read_message_id = stmt.get_u64(7),
+            .unread_count = stmt.get_u64(11)});
+    }
+    return rooms;
+}
+
+bool SqliteStorage::append_message(const model::Message& message) {
+    return write([&](Conn& conn) {
+        // 权限检测，必须为房间成员才能发送消息
+        if (!Stmt(conn, SELECT_ROLE, message.room_id, message.sender_id).next()) {
+            return false;
+        }
+        Stmt(conn, INSERT_MESSAGE, message.id, message.room_id, message.sender_id,
+             message.content)
+            .run();
+        if (Stmt(conn, UPDATE_LAST_MESSAGE, message.id, message.room_id).run() != 1) {
+            throw std::runtime_error("Failed to update last message in room " +
+                                     std::to_string(message.room_id));
+        }
+        return true;
+    });
+}
+
+std::vector<model::Message> SqliteStorage::messages_before(u64 room_id, u64 before,
+                                                           std::size_t limit) {
+    ReadConn conn(*this);
+    // 超过INTEGER范围的before(如UINT64_MAX)表示不限
+    i64 upper = before > static_cast<u64>(INT64_MAX) ? INT64_MAX : static_cast<i64>(before);
+    Stmt stmt(*conn.operator->(), SELECT_MESSAGES, room_id, upper, static_cast<int>(limit));
+    std::vector<model::Message> messages;
+    while (stmt.next()) {
+        messages.push_back(model::Message{.id = stmt.get_u64(0),
+                                          .room_id = room_id,
+                                          .sender_id = stmt.get_u64(1),
+                                          .content = stmt.get_string(2)});
+    }
+    return messages;
+}
+
+std::optional<model::Attachment> SqliteStorage::find_attachment(u64 user_id,
+                                                                const std::string& hash) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_ATTACHMENT, user_id, hash);
+    if (!stmt.next()) {
+        return std::nullopt;
+    }
+    return model::Attachment{.id = stmt.get_u64(0),
+                             .hash = hash,
+                             .size = stmt.get_u64(1),
+                             .content_type = stmt.get_string(2)};
+}
+
+u64 SqliteStorage::attachment_usage(u64 user_id) {
+    ReadConn conn(*this);
+    Stmt stmt(*conn.operator->(), SELECT_USAGE, user_id);
+    return stmt.next() ? stmt.get_u64(0) : 0;
+}
+
+void SqliteStorage::add_attachment(u64 user_id, const model::Attachment& attachment) {
+    write([&](Conn& conn) {
+        Stmt(conn, INSERT_ATTACHMENT, attachment.id, user_id, attachment.hash, attachment.size,
+             attachment.content_type)
+            .run();
+    });
+}
+}  // namespace db
+}  // namespace tcs
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "db/storage.hpp"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace tcs {
+namespace db {
+// 嵌入式SQLite存储，用于不想部署MySQL的单机和边缘环境
+// 表结构与MySQL相同，数据库使用WAL模式：
+// - 写操作交给唯一的写线程，排队的多个操作合并到一个事务中提交，提交后调用方才返回
+// - 读操作在调用方线程上执行，每个线程从读连接池取一个只读连接，通过mmap读取
+class SqliteStorage : public Storage {
+public:
+    SqliteStorage(const std::string& file, std::size_t batch_size, u64 mmap_bytes);
+    ~SqliteStorage() override;
+
+    bool create_user(const model::User& user, const std::string& password_hash) override;
+    std::optional<UserRecord> find_user(const std::string& username) override;
+
+    void create_group_room(u64 room_id, const std::string& name, u64 owner_id) override;
+    void create_private_room(u64 room_id, u64 user_id, u64 other_id) override;
+    std::optional<utils::RoomType> room_type(u64 room_id) override;
+    bool delete_room(u64 room_id) override;
+
+    std::optional<utils::GroupRole> member_role(u64 room_id, u64 user_id) override;
+    bool add_member(u64 room_id, u64 user_id, utils::GroupRole role) override;
+    std::vector<u64> room_members(u64 room_id) override;
+    std::vector<u64> rooms_of(u64 user_id) override;
+    bool mark_read(u64 room_id, u64 user_id, u64 message_id) override;
+    std::vector<model::RoomSummary> room_summaries(u64 user_id,
+                                                   std::size_t preview_chars) override;
+
+    bool append_message(const model::Message& message) override;
+    std::vector<model::Message> messages_before(u64 room_id, u64 before,
+                                                std::size_t limit) override;
+
+    std::optional<model::Attachment> find_attachment(u64 user_id,
+                                                     const std::string& hash) override;
+    u64 attachment_usage(u64 user_id) override;
+    void add_attachment(u64 user_id, const model::Attachment& attachment) override;
+
+    // 一个连接及其预编译语句，只在一个线程上使用
+    class Conn {
+    public:
+        Conn(const std::string& file, bool read_only, u64 mmap_bytes);
+        ~Conn();
+        Conn(const Conn&) = delete;
+        Conn& operator=(const Conn&) = delete;
+
+        // 语句按SQL文本的地址缓存，调用方传入的必须是字符串常量
+        sqlite3_stmt* prepare(const char* sql);
+        void exec(const char* sql);
+
+        sqlite3* handle() const { return db_; }
+
+    private:
+        sqlite3* db_ = nullptr;
+        std::unordered_map<const char*, sqlite3_stmt*> stmts_;
+    };
+
+private:
+    // 写线程执行的一个操作
+    struct WriteOp {
+        // 在写线程的事务中执行，抛出异常时只回滚这一个操作
+        std::function<void(Conn&)> run;
+        // 事务提交或失败后调用，把结果交给等待的调用方
+        std::function<void(std::exception_ptr)> done;
+    };
+
+    // 把f交给写线程，等到所在的事务提交后返回f的结果
+    template <typename F>
+    auto write(F&& f) -> decltype(f(std::declval<Conn&>()));
+
+    void writer_loop();
+    void commit_batch(std::vector<WriteOp>& batch);
+
+    // 从读连接池取连接，析构时归还
+    class ReadConn {
+    public:
+        explicit ReadConn(SqliteStorage& storage);
+        ~ReadConn();
+        Conn* operator->() const { return conn_.get(); }
+
+    private:
+        SqliteStorage& storage_;
+        std::unique_ptr<Conn> conn_;
+    };
+
+    std::string file_;
+    std::size_t batch_size_;
+    u64 mmap_bytes_;
+
+    std::unique_ptr<Conn> writer_conn_;
+    std::mutex write_mtx_;
+    std::condition_variable write_cv_;
+    std::deque<WriteOp> write_queue_;
+    bool stop_ = false;
+    std::thread writer_;
+
+    std::mutex read_mtx_;
+    std::vector<std::unique_ptr<Conn>> read_pool_;
+};
+}  // namespace db
+}  // namespace tcs
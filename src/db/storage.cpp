@@ -0,0 +1,32 @@
+#include <spdlog/spdlog.h>
+
+#include "db/storage.hpp"
+#include "db/memory_storage.hpp"
+#include "db/mysql_storage.hpp"
+#include "db/sqlite_storage.hpp"
+#include "db/sql_conn_pool.hpp"
+
+namespace tcs {
+namespace db {
+std::unique_ptr<Storage> Storage::instance_ptr_ = nullptr;
+
+void Storage::init(const utils::AppConfig::Database& database) {
+    const std::string& engine = database.engine();
+    if (instance_ptr_) {
+        throw std::runtime_error("Storage has already been initialized.");
+    }
+    if (engine == "mysql") {
+        SqlConnPool::instance()->init();
+        instance_ptr_ = std::make_unique<MySqlStorage>();
+    } else if (engine == "memory") {
+        instance_ptr_ = std::make_unique<MemoryStorage>();
+    } else if (engine == "sqlite") {
+        instance_ptr_ = std::make_unique<SqliteStorage>(
+            database.sqlite_file(), database.sqlite_batch_size(), database.sqlite_mmap_mb() << 20);
+    } else {
+        throw std::invalid_argument("Unknown storage engine: " + engine);
+    }
+    spdlog::info("Storage engine: {}", engine);
+}
+}  // namespace db
+}  // namespace tcs
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "model/attachment.hpp"
+#include "model/message.hpp"
+#include "model/room.hpp"
+#include "model/user.hpp"
+#include "utils/config.hpp"
+#include "utils/enums.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace db {
+// 存储接口：用户、房间、房间成员、消息和附件记录
+// 每个方法是一个完整的事务，实现必须线程安全
+// 具体引擎由config.ini中的Database.engine选择
+class Storage {
+public:
+    // 登录时需要密码哈希，不放进返回给客户端的User
+    struct UserRecord {
+        model::User user;
+        std::string password_hash;
+    };
+
+    static Storage& get() {
+        if (!instance_ptr_) {
+            throw std::runtime_error("Storage has not been initialized. Call init() first.");
+        }
+        return *instance_ptr_;
+    }
+
+    // 按database.engine()选择引擎: mysql、memory 或 sqlite
+    static void init(const utils::AppConfig::Database& database);
+
+    static void shutdown() { instance_ptr_.reset(); }
+
+    virtual ~Storage() = default;
+
+    // ---- users ----
+
+    // 用户名已存在时返回false
+    virtual bool create_user(const model::User& user, const std::string& password_hash) = 0;
+    virtual std::optional<UserRecord> find_user(const std::string& username) = 0;
+
+    // ---- rooms / room_members ----
+
+    // 建房间并加入群主
+    virtual void create_group_room(u64 room_id, const std::string& name, u64 owner_id) = 0;
+    // 建房间并加入双方
+    virtual void create_private_room(u64 room_id, u64 user_id, u64 other_id) = 0;
+    // 房间不存在时返回空
+    virtual std::optional<utils::RoomType> room_type(u64 room_id) = 0;
+    // 删除房间及其全部成员，房间不存在时返回false
+    virtual bool delete_room(u64 room_id) = 0;
+
+    // 不是成员时返回空
+    virtual std::optional<utils::GroupRole> member_role(u64 room_id, u64 user_id) = 0;
+    // 已经是成员时返回false
+    virtual bool add_member(u64 room_id, u64 user_id, utils::GroupRole role) = 0;
+    virtual std::vector<u64> room_members(u64 room_id) = 0;
+    // 用户加入的房间id，不带预览和未读数
+    virtual std::vector<u64> rooms_of(u64 user_id) = 0;
+    // 已读位置只前进不后退，不是成员时返回false
+    virtual bool mark_read(u64 room_id, u64 user_id, u64 message_id) = 0;
+
+    // 用户加入的所有房间，带最后一条消息预览(前preview_chars个字符)和未读数
+    // 按最后一条消息id降序
+    virtual std::vector<model::RoomSummary> room_summaries(u64 user_id,
+                                                           std::size_t preview_chars) = 0;
+
+    // ---- messages ----
+
+    // 写入消息并更新房间的last_message_id
+    // 发送者不是房间成员时不写入，返回false
+    virtual bool append_message(const model::Message& message) = 0;
+    // id小于before的最多limit条消息，按id降序
+    virtual std::vector<model::Message> messages_before(u64 room_id, u64 before,
+                                                        std::size_t limit) = 0;
+
+    // ---- attachments ----
+
+    // 同一用户上传过相同内容的文件时返回已有记录，url由调用方填写
+    virtual std::optional<model::Attachment> find_attachment(u64 user_id,
+                                                             const std::string& hash) = 0;
+    // 用户已上传附件的总字节数
+    virtual u64 attachment_usage(u64 user_id) = 0;
+    virtual void add_attachment(u64 user_id, const model::Attachment& attachment) = 0;
+
+private:
+    static std::unique_ptr<Storage> instance_ptr_;
+};
+}  // namespace db
+}  // namespace tcs
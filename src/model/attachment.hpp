@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace model {
+// 上传成功后返回的附件信息，url可直接通过/assets访问
+struct Attachment {
+    u64 id;
+    std::string url;
+    std::string hash;
+    u64 size;
+    std::string content_type;
+};
+
+inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
+                       const Attachment& attachment) {
+    jv = boost::json::object{
+        {"id", std::to_string(attachment.id)},
+        {"url", attachment.url},
+        {"hash", attachment.hash},
+        {"size", std::to_string(attachment.size)},
+        {"content_type", attachment.content_type},
+    };
+}
+
+}  // namespace model
+}  // namespace tcs
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <string>
+#include <tuple>
 
 #include "boost/json.hpp"
 
 #include "model/user.hpp"
+#include "utils/json_writer.hpp"
 #include "utils/types.hpp"
 
 namespace json = boost::json;
@@ -35,6 +37,10 @@ inline void tag_invoke(json::value_from_tag, json::value& jv, const LoginResp& r
         {"user", json::value_from(resp.user)},
     };
 }
+constexpr auto json_fields(utils::JsonFieldsTag<LoginResp>) {
+    return std::make_tuple(utils::json_field("token", &LoginResp::token),
+                           utils::json_field("user", &LoginResp::user));
+}
 
 struct UserClaims {
     u64 id;
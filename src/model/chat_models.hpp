@@ -1,10 +1,15 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <tuple>
 #include <vector>
 
 #include <boost/json.hpp>
 
+#include "model/json_bind.hpp"
+#include "utils/json_writer.hpp"
+#include "utils/types.hpp"
+
 namespace tcs {
 namespace model {
 // Create group room request
@@ -14,8 +19,8 @@ struct CreateGRoomReq {
 
 inline CreateGRoomReq tag_invoke(boost::json::value_to_tag<CreateGRoomReq>,
                                  const boost::json::value& jv) {
-    const boost::json::object obj = jv.as_object();
-    return CreateGRoomReq{.name = json::value_to<std::string>(obj.at("name"))};
+    const boost::json::object& obj = jv.as_object();
+    return CreateGRoomReq{.name = json_to_string(obj.at("name"))};
 }
 
 struct CreateGRoomResp {
@@ -25,6 +30,9 @@ inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const CreateGRoomResp& resp) {
     jv = boost::json::object{{"room_id", std::to_string(resp.room_id)}};
 }
+constexpr auto json_fields(utils::JsonFieldsTag<CreateGRoomResp>) {
+    return std::make_tuple(utils::json_id("room_id", &CreateGRoomResp::room_id));
+}
 
 // Create private room Request
 struct CreatePRoomReq {
@@ -32,8 +40,8 @@ struct CreatePRoomReq {
 };
 inline CreatePRoomReq tag_invoke(boost::json::value_to_tag<CreatePRoomReq>,
                                  const boost::json::value& jv) {
-    const boost::json::object obj = jv.as_object();
-    return CreatePRoomReq{.other_id = std::stoull(json::value_to<std::string>(obj.at("other_id")))};
+    const boost::json::object& obj = jv.as_object();
+    return CreatePRoomReq{.other_id = json_to_u64(obj.at("other_id"))};
 }
 
 struct CreatePRoomResp {
@@ -43,6 +51,9 @@ inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const CreatePRoomResp& resp) {
     jv = boost::json::object{{"room_id", std::to_string(resp.room_id)}};
 }
+constexpr auto json_fields(utils::JsonFieldsTag<CreatePRoomResp>) {
+    return std::make_tuple(utils::json_id("room_id", &CreatePRoomResp::room_id));
+}
 
 // Group Room Invitation Request
 struct GRoomInvtReq {
@@ -50,11 +61,21 @@ struct GRoomInvtReq {
 };
 inline GRoomInvtReq tag_invoke(boost::json::value_to_tag<GRoomInvtReq>,
                                const boost::json::value& jv) {
-    const boost::json::object obj = jv.as_object();
+    const boost::json::object& obj = jv.as_object();
     return GRoomInvtReq{
-        .invitee_id = std::stoull(json::value_to<std::string>(obj.at("invitee_id"))),
+        .invitee_id = json_to_u64(obj.at("invitee_id")),
     };
 }
 
+// 标记已读到某条消息
+struct MarkReadReq {
+    u64 message_id;
+};
+inline MarkReadReq tag_invoke(boost::json::value_to_tag<MarkReadReq>,
+                              const boost::json::value& jv) {
+    const boost::json::object& obj = jv.as_object();
+    return MarkReadReq{.message_id = json_to_u64(obj.at("message_id"))};
+}
+
 }  // namespace model
 }  // namespace tcs
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+#include <boost/json.hpp>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace model {
+// 客户端以字符串传递u64 id(JS的number精度不够)，也兼容直接传数字
+// 直接在JSON字符串上解析，不构造临时std::string
+inline u64 json_to_u64(const boost::json::value& jv) {
+    if (jv.is_string()) {
+        const boost::json::string& str = jv.get_string();
+        u64 value = 0;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc() || ptr != str.data() + str.size()) {
+            throw std::invalid_argument("Invalid id: " + std::string(str));
+        }
+        return value;
+    }
+    if (jv.is_uint64()) {
+        return jv.get_uint64();
+    }
+    if (jv.is_int64() && jv.get_int64() >= 0) {
+        return static_cast<u64>(jv.get_int64());
+    }
+    throw std::invalid_argument("Expected an id as string or unsigned integer");
+}
+
+inline std::string json_to_string(const boost::json::value& jv) {
+    const boost::json::string& str = jv.as_string();
+    return std::string(str.data(), str.size());
+}
+
+}  // namespace model
+}  // namespace tcs
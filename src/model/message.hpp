@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "utils/json_writer.hpp"
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace model {
+struct Message {
+    u64 id;
+    u64 room_id;
+    u64 sender_id;
+    std::string content;
+};
+
+inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, const Message& msg) {
+    jv = boost::json::object{
+        {"id", std::to_string(msg.id)},
+        {"room_id", std::to_string(msg.room_id)},
+        {"sender_id", std::to_string(msg.sender_id)},
+        {"content", msg.content},
+    };
+}
+constexpr auto json_fields(utils::JsonFieldsTag<Message>) {
+    return std::make_tuple(utils::json_id("id", &Message::id),
+                           utils::json_id("room_id", &Message::room_id),
+                           utils::json_id("sender_id", &Message::sender_id),
+                           utils::json_field("content", &Message::content));
+}
+
+// 历史消息分页，messages按id降序
+// 下一页以最后一条的id作为before
+struct MessagePage {
+    std::vector<Message> messages;
+    bool has_more;
+};
+
+inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
+                       const MessagePage& page) {
+    jv = boost::json::object{
+        {"messages", boost::json::value_from(page.messages)},
+        {"has_more", page.has_more},
+    };
+}
+constexpr auto json_fields(utils::JsonFieldsTag<MessagePage>) {
+    return std::make_tuple(utils::json_field("messages", &MessagePage::messages),
+                           utils::json_field("has_more", &MessagePage::has_more));
+}
+
+}  // namespace model
+}  // namespace tcs
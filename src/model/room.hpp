@@ -1,9 +1,11 @@
 #pragma once
 
 #include <string>
+#include <tuple>
 
 #include <boost/json.hpp>
 
+#include "utils/json_writer.hpp"
 #include "utils/types.hpp"
 
 namespace tcs {
@@ -31,6 +33,51 @@ inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, cons
         {"created_at", room.created_at},
     };
 };
+constexpr auto json_fields(utils::JsonFieldsTag<Room>) {
+    return std::make_tuple(utils::json_id("id", &Room::id), utils::json_field("type", &Room::type),
+                           utils::json_field("name", &Room::name),
+                           utils::json_field("description", &Room::description),
+                           utils::json_field("avatar_url", &Room::avatar_url),
+                           utils::json_id("last_message_id", &Room::last_message_id),
+                           utils::json_field("member_count", &Room::member_count),
+                           utils::json_field("created_at", &Room::created_at));
+}
+
+// 房间列表中的一项，带最后一条消息预览和未读数
+struct RoomSummary {
+    Room room;
+    // 最后一条消息的发送者，房间没有消息时为0
+    u64 last_sender_id;
+    // 最后一条消息内容的前若干个字符
+    std::string last_preview;
+    u64 last_read_message_id;
+    u64 unread_count;
+};
+
+inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
+                       const RoomSummary& summary) {
+    const Room& room = summary.room;
+    boost::json::value last_message = nullptr;
+    if (room.last_message_id != 0) {
+        last_message = boost::json::object{
+            {"id", std::to_string(room.last_message_id)},
+            {"sender_id", std::to_string(summary.last_sender_id)},
+            {"content", summary.last_preview},
+        };
+    }
+    jv = boost::json::object{
+        {"id", std::to_string(room.id)},
+        {"type", room.type},
+        {"name", room.name},
+        {"description", room.description},
+        {"avatar_url", room.avatar_url},
+        {"member_count", room.member_count},
+        {"created_at", room.created_at},
+        {"last_message", std::move(last_message)},
+        {"last_read_message_id", std::to_string(summary.last_read_message_id)},
+        {"unread_count", summary.unread_count},
+    };
+}
 
 }  // namespace model
 }  // namespace tcs
\ No newline at end of file
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <string>
+#include <tuple>
 
 #include <boost/json.hpp>
 
+#include "utils/json_writer.hpp"
 #include "utils/types.hpp"
 
 namespace tcs {
@@ -24,6 +26,14 @@ inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, cons
         {"avatar_url", user.avatar_url}, {"created_at", user.created_at},
     };
 }
+constexpr auto json_fields(utils::JsonFieldsTag<User>) {
+    return std::make_tuple(utils::json_id("id", &User::id),
+                           utils::json_field("username", &User::username),
+                           utils::json_field("nickname", &User::nickname),
+                           utils::json_field("email", &User::email),
+                           utils::json_field("avatar_url", &User::avatar_url),
+                           utils::json_field("created_at", &User::created_at));
+}
 
 }  // namespace model
 }  // namespace tcs
\ No newline at end of file
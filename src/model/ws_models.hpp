@@ -2,9 +2,12 @@
 
 #include <string>
 #include <cstdint>
+#include <tuple>
 #include <boost/json.hpp>
 
+#include "model/json_bind.hpp"
 #include "utils/enums.hpp"
+#include "utils/json_writer.hpp"
 #include "utils/types.hpp"
 
 namespace json = boost::json;
@@ -23,9 +26,9 @@ struct ClientPrivateMsg {
 inline ClientPrivateMsg tag_invoke(json::value_to_tag<ClientPrivateMsg>, const json::value& jv) {
     const json::object& obj = jv.as_object();
     return ClientPrivateMsg{
-        .room_id = std::stoull(json::value_to<std::string>(obj.at("room_id"))),
-        .other_user_id = std::stoull(json::value_to<std::string>(obj.at("other_user_id"))),
-        .content = json::value_to<std::string>(obj.at("content"))};
+        .room_id = json_to_u64(obj.at("room_id")),
+        .other_user_id = json_to_u64(obj.at("other_user_id")),
+        .content = json_to_string(obj.at("content"))};
 }
 
 struct ClientGroupMsg {
@@ -34,8 +37,19 @@ struct ClientGroupMsg {
 };
 inline ClientGroupMsg tag_invoke(json::value_to_tag<ClientGroupMsg>, const json::value& jv) {
     const json::object& obj = jv.as_object();
-    return ClientGroupMsg{.room_id = std::stoull(json::value_to<std::string>(obj.at("room_id"))),
-                          .content = json::value_to<std::string>(obj.at("content"))};
+    return ClientGroupMsg{.room_id = json_to_u64(obj.at("room_id")),
+                          .content = json_to_string(obj.at("content"))};
+}
+
+// 正在输入，typing为false表示停止输入
+struct ClientTyping {
+    u64 room_id;
+    bool typing;
+};
+inline ClientTyping tag_invoke(json::value_to_tag<ClientTyping>, const json::value& jv) {
+    const json::object& obj = jv.as_object();
+    return ClientTyping{.room_id = json_to_u64(obj.at("room_id")),
+                        .typing = obj.at("typing").as_bool()};
 }
 
 template <typename T>
@@ -50,28 +64,62 @@ inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
     jv = boost::json::object{{"type", json::value_from(resp.type)},
                              {"data", json::value_from(resp.data)}};
 }
+template <typename T>
+constexpr auto json_fields(utils::JsonFieldsTag<ServerRespMsg<T>>) {
+    return std::make_tuple(utils::json_field("type", &ServerRespMsg<T>::type),
+                           utils::json_field("data", &ServerRespMsg<T>::data));
+}
 
 struct PrivateMsgToSend {
     u64 private_room_id;
+    u64 message_id;
     std::string content;
 };
 inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const PrivateMsgToSend& msg) {
     jv = boost::json::object{{"private_room_id", std::to_string(msg.private_room_id)},
+                             {"message_id", std::to_string(msg.message_id)},
                              {"content", msg.content}};
 }
+constexpr auto json_fields(utils::JsonFieldsTag<PrivateMsgToSend>) {
+    return std::make_tuple(utils::json_id("private_room_id", &PrivateMsgToSend::private_room_id),
+                           utils::json_id("message_id", &PrivateMsgToSend::message_id),
+                           utils::json_field("content", &PrivateMsgToSend::content));
+}
 
 struct GroupMsgToSend {
     u64 room_id;
     u64 sender_id;
+    u64 message_id;
     std::string content;
 };
 inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const GroupMsgToSend& msg) {
     jv = boost::json::object{{"room_id", std::to_string(msg.room_id)},
                              {"sender_id", std::to_string(msg.sender_id)},
+                             {"message_id", std::to_string(msg.message_id)},
                              {"content", msg.content}};
 }
+constexpr auto json_fields(utils::JsonFieldsTag<GroupMsgToSend>) {
+    return std::make_tuple(utils::json_id("room_id", &GroupMsgToSend::room_id),
+                           utils::json_id("sender_id", &GroupMsgToSend::sender_id),
+                           utils::json_id("message_id", &GroupMsgToSend::message_id),
+                           utils::json_field("content", &GroupMsgToSend::content));
+}
+
+struct MsgRetracted {
+    u64 room_id;
+    u64 message_id;
+};
+inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
+                       const MsgRetracted& msg) {
+    jv = boost::json::object{{"room_id", std::to_string(msg.room_id)},
+                             {"message_id", std::to_string(msg.message_id)}};
+}
+constexpr auto json_fields(utils::JsonFieldsTag<MsgRetracted>) {
+    return std::make_tuple(utils::json_id("room_id", &MsgRetracted::room_id),
+                           utils::json_id("message_id", &MsgRetracted::message_id));
+}
 
 }  // namespace model
 }  // namespace tcs
\ No newline at end of file
@@ -9,7 +9,7 @@ ThreadPool::ThreadPool(std::size_t thread_count) : stop(false) {
         workers.emplace_back([this] {
             while (true) {
                 // 需要释放锁后执行，所以提前声明
-                std::function<void()> task;
+                Task task;
                 {
                     std::unique_lock<std::mutex> lock(this->queue_mutex);
                     /*
@@ -29,7 +29,10 @@ ThreadPool::ThreadPool(std::size_t thread_count) : stop(false) {
                     task = std::move(this->tasks.front());
                     this->tasks.pop();
                 }
-                task();
+                utils::Metrics& metrics = utils::Metrics::get();
+                metrics.task_queue_depth.add(-1);
+                metrics.task_wait.record(std::chrono::steady_clock::now() - task.enqueued);
+                task.fn();
             }
         });
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <functional>
 #include <thread>
@@ -12,6 +13,8 @@
 #include <stdexcept>
 #include <memory>
 
+#include "utils/metrics.hpp"
+
 namespace tcs {
 namespace pool {
 
@@ -55,8 +58,9 @@ public:
                 if (stop) {
                     throw std::runtime_error("AddTask on a stopped ThreadPool");
                 }
-                tasks.emplace(std::move(task));
+                tasks.push(Task{std::move(task), std::chrono::steady_clock::now()});
             }
+            utils::Metrics::get().task_queue_depth.add(1);
             condition.notify_one();
 
             // 如果函数有返回值
@@ -79,8 +83,9 @@ public:
                 }
 
                 //???
-                tasks.emplace([task] { (*task)(); });
+                tasks.push(Task{[task] { (*task)(); }, std::chrono::steady_clock::now()});
             }
+            utils::Metrics::get().task_queue_depth.add(1);
             condition.notify_one();
             return res;
         }
@@ -104,18 +109,25 @@ public:
             if (stop) {
                 throw std::runtime_error("AddTask on a stopped ThreadPool");
             }
-            tasks.emplace(std::move(wrapper_task));
+            tasks.push(Task{std::move(wrapper_task), std::chrono::steady_clock::now()});
         }
+        utils::Metrics::get().task_queue_depth.add(1);
         condition.notify_one();
     }
 
     std::size_t getThreadCount() { return workers.size(); }
 
 private:
+    // 记录入队时间，用于统计排队等待时间
+    struct Task {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
     explicit ThreadPool(std::size_t thread_count);
     ~ThreadPool();
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::queue<Task> tasks;
     std::mutex queue_mutex;
     std::condition_variable condition;
     bool stop;
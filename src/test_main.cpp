@@ -4,16 +4,44 @@
 #include <vector>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <cstdio>
 
 #include "utils/config.hpp"
+#include "db/sql_conn_pool.hpp"
 #include "snowflake_test.hpp"
+#include "message_query_test.hpp"
+#include "router_test.hpp"
+#include "arena_test.hpp"
+#include "asset_cache_test.hpp"
+#include "compression_test.hpp"
+#include "room_summary_test.hpp"
+#include "ws_codec_test.hpp"
+#include "json_writer_test.hpp"
+#include "metrics_test.hpp"
+#include "msg_trace_test.hpp"
+#include "storage_test.hpp"
+#include "message_journal_test.hpp"
+#include "cluster_bus_test.hpp"
+#include "presence_directory_test.hpp"
+#include "room_signals_test.hpp"
+#include "upload_test.hpp"
+#include "offline_queue_test.hpp"
+#include "room_cache_test.hpp"
+#include "db/memory_storage.hpp"
+#include "db/sqlite_storage.hpp"
+#include "pool/thread_pool.hpp"
 
 using AppConfig = tcs::utils::AppConfig;
 
 void init() {
     AppConfig::init("../../doc/config.ini");
     SnowFlake::init(AppConfig::get().server().service_id(),
-                    AppConfig::get().server().custom_epoch());
+                    AppConfig::get().server().custom_epoch(),
+                    AppConfig::get().server().snowflake_clock() == "system"
+                        ? SnowFlake::ClockMode::System
+                        : SnowFlake::ClockMode::Monotonic,
+                    AppConfig::get().server().snowflake_max_borrow_ms());
 }
 
 int main(int argc, char *argv[]) {
@@ -21,6 +49,105 @@ int main(int argc, char *argv[]) {
         init();
         test::SnowFlakeTest snowflake(AppConfig::get().server().custom_epoch());
         snowflake.multi_thread_test();
+        snowflake.throughput_test();
+
+        test::RouterTest router;
+        router.match_test();
+        router.bench();
+
+        test::ArenaTest arena;
+        arena.alloc_test();
+
+        test::AssetCacheTest asset_cache;
+        asset_cache.cache_test();
+        asset_cache.range_test();
+        asset_cache.eviction_test();
+
+        test::CompressionTest compression;
+        compression.negotiate_test();
+        compression.round_trip_test();
+
+        test::RoomSummaryTest room_summary;
+        room_summary.update_test();
+
+        test::WsCodecTest ws_codec;
+        ws_codec.round_trip_test();
+
+        test::JsonWriterTest json_writer;
+        json_writer.escape_test();
+        json_writer.equal_test();
+        json_writer.bench();
+
+        test::MetricsTest metrics;
+        metrics.record_test();
+        metrics.bench();
+
+        test::MsgTraceTest msg_trace;
+        msg_trace.dump_test();
+
+        test::StorageTest storage_test;
+        {
+            tcs::db::MemoryStorage storage;
+            storage_test.semantics_test(storage, "Memory");
+        }
+        {
+            tcs::db::MemoryStorage storage;
+            storage_test.concurrency_test(storage, "Memory", 8, 5000);
+        }
+        // 每次提交都要fsync，SQLite的并发测试写入量小一些
+        for (bool concurrent : {false, true}) {
+            std::string file = "storage_test.db";
+            for (const char* suffix : {"", "-wal", "-shm"}) {
+                std::remove((file + suffix).c_str());
+            }
+            tcs::db::SqliteStorage storage(file, 64, 16 << 20);
+            if (concurrent) {
+                storage_test.concurrency_test(storage, "SQLite", 8, 500);
+            } else {
+                storage_test.semantics_test(storage, "SQLite");
+            }
+        }
+
+#ifdef PLATFORM_LINUX
+        test::MessageJournalTest message_journal;
+        message_journal.append_test();
+        message_journal.recovery_test();
+        message_journal.rejected_test();
+#endif
+
+        test::ClusterBusTest cluster_bus;
+        cluster_bus.parse_test();
+        cluster_bus.loopback_test();
+        cluster_bus.presence_test();
+
+        test::PresenceDirectoryTest presence_directory;
+        presence_directory.local_test();
+        presence_directory.remote_test();
+
+        test::RoomSignalsTest room_signals;
+        room_signals.coalesce_test();
+        room_signals.rate_limit_test();
+        room_signals.encode_test();
+
+        test::RoomCacheTest room_cache;
+        room_cache.order_test();
+        room_cache.budget_test();
+
+        test::UploadTest upload;
+        upload.store_test();
+
+        tcs::pool::ThreadPool::init(2);
+        test::OfflineQueueTest offline_queue;
+        offline_queue.order_test();
+        offline_queue.spill_limit_test();
+        tcs::pool::ThreadPool::shutdown();
+
+        // test_main --db <room_id>: 需要数据库的基准测试
+        if (argc >= 3 && std::string(argv[1]) == "--db") {
+            tcs::db::SqlConnPool::instance()->init();
+            test::MessageQueryBench bench;
+            bench.run(std::stoull(argv[2]));
+        }
     } catch (std::exception &e) {
         std::cerr << "Excpetion in main: " << e.what() << std::endl;
         return 1;
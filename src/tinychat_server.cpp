@@ -8,9 +8,20 @@
 
 #include "tinychat_server.hpp"
 #include "utils/config.hpp"
-#include "db/sql_conn_pool.hpp"
+#include "db/storage.hpp"
+#include "db/message_journal.hpp"
 #include "utils/net_utils.hpp"
 #include "utils/snowflake.hpp"
+#include "core/room_cache.hpp"
+#include "core/room_summary_cache.hpp"
+#include "core/room_events.hpp"
+#include "core/msg_trace.hpp"
+#include "core/offline_queue.hpp"
+#include "core/asset_cache.hpp"
+#include "core/cluster_bus.hpp"
+#include "core/presence_directory.hpp"
+#include "core/room_signals.hpp"
+#include "core/ws_handler.hpp"
 
 using AppConfig = tcs::utils::AppConfig;
 using SnowFlake = tcs::utils::SnowFlake;
@@ -59,12 +70,16 @@ TinychatServer::TinychatServer()
     init_log();
     sodium_init();
 
-    db::SqlConnPool::instance()->init();
+    db::Storage::init(AppConfig::get().database());
 
     pool::ThreadPool::init(AppConfig::get().server().worker_threads());
 
     SnowFlake::init(AppConfig::get().server().service_id(),
-                    AppConfig::get().server().custom_epoch());
+                    AppConfig::get().server().custom_epoch(),
+                    AppConfig::get().server().snowflake_clock() == "system"
+                        ? SnowFlake::ClockMode::System
+                        : SnowFlake::ClockMode::Monotonic,
+                    AppConfig::get().server().snowflake_max_borrow_ms());
 
     listener_ = std::make_shared<core::Listener>(
         ioc_,
@@ -74,6 +89,63 @@ TinychatServer::TinychatServer()
 
     // 初始化
     tcs::core::WSSessionMgr::get();
+    if (AppConfig::get().server().cluster_port() != 0) {
+        tcs::core::ClusterBus::init(
+            AppConfig::get().server().service_id(), AppConfig::get().server().host(),
+            AppConfig::get().server().cluster_port(), AppConfig::get().server().cluster_peers(),
+            core::ClusterBus::Handlers{
+                .deliver =
+                    [](const std::vector<u64>& user_ids, const core::WsPayload& payload,
+                       u64 msg_id) {
+                        tcs::core::WSSessionMgr::get().deliver_local(user_ids, payload, msg_id);
+                    },
+                .presence =
+                    [](u64 node_id, const std::vector<core::PresenceUpdate>& updates,
+                       bool replace) {
+                        tcs::core::PresenceDirectory::get().apply(node_id, updates, replace);
+                    },
+                .room_event =
+                    [](const core::RoomEvent& event) { tcs::core::RoomEvents::apply(event); },
+                // 断开期间该节点的房间变化收不到，缓存整体作废
+                .node_up = [](u64 node_id) { tcs::core::RoomEvents::reset(); },
+                .node_down =
+                    [](u64 node_id) {
+                        tcs::core::PresenceDirectory::get().drop_node(node_id);
+                        tcs::core::RoomEvents::reset();
+                    },
+                .snapshot = [] { return tcs::core::PresenceDirectory::get().snapshot(); },
+            });
+    }
+    tcs::core::RoomCache::get().configure(
+        AppConfig::get().server().room_cache_budget_mb() * 1024 * 1024,
+        AppConfig::get().server().room_cache_capacity());
+    tcs::core::RoomSummaryCache::get().configure(
+        AppConfig::get().server().room_summary_capacity());
+    if (AppConfig::get().server().signal_window_ms() != 0) {
+        tcs::core::RoomSignals::init(
+            std::chrono::milliseconds(AppConfig::get().server().signal_window_ms()),
+            AppConfig::get().server().signal_user_limit());
+    }
+    tcs::core::MsgTracer::get().configure(AppConfig::get().server().trace_file(),
+                                          AppConfig::get().server().trace_sample_rate(),
+                                          AppConfig::get().server().trace_slow_ms());
+    tcs::core::OfflineQueue::get().configure(AppConfig::get().server().offline_queue_limit(),
+                                             AppConfig::get().server().offline_spill_limit(),
+                                             AppConfig::get().server().offline_spill_dir());
+    tcs::core::AssetCache::get().configure(
+        AppConfig::get().server().doc_root(),
+        AppConfig::get().server().asset_cache_budget_mb() * 1024 * 1024,
+        AppConfig::get().server().asset_mmap_threshold_kb() * 1024,
+        AppConfig::get().server().asset_stream_threshold_mb() * 1024 * 1024);
+
+    // 重放时被拒绝的消息要撤回，所以在缓存、离线队列和集群总线都就绪之后打开
+    if (!AppConfig::get().database().journal_dir().empty()) {
+        db::MessageJournal::init(AppConfig::get().database().journal_dir(),
+                                 AppConfig::get().database().journal_segment_mb() * 1024 * 1024,
+                                 [](const model::Message& message) {
+                                     tcs::core::WSHandler::on_rejected(message);
+                                 });
+    }
 
     spdlog::info("Tinychat server started successfully on {}:{}. Document root: {}",
                  AppConfig::get().server().host(), AppConfig::get().server().port(),
@@ -111,6 +183,10 @@ void TinychatServer::run() {
 
 TinychatServer::~TinychatServer() {
     spdlog::info("Tinychat server is shutting down...");
+    // 日志关闭时把剩余的消息写入存储，撤回通知仍可能经过集群总线
+    db::MessageJournal::shutdown();
+    tcs::core::RoomSignals::shutdown();
+    tcs::core::ClusterBus::shutdown();
     spdlog::default_logger()->flush();
     spdlog::shutdown();
 }
@@ -2,7 +2,8 @@
 
 #include "utils/net_utils.hpp"
 #include "utils/config.hpp"
-#include "db/sql_conn_pool.hpp"
+#include "db/storage.hpp"
+#include "db/message_journal.hpp"
 #include "pool/thread_pool.hpp"
 #include "core/listener.hpp"
 #include "core/ws_session_mgr.hpp"
@@ -12,6 +13,8 @@ class TinychatServer {
 public:
     explicit TinychatServer();
     void run();
+    // 让run()返回，用于在其他程序中内嵌运行
+    void stop() { ioc_.stop(); }
     void init_log();
     ~TinychatServer();
 
@@ -0,0 +1,153 @@
+#include <zlib.h>
+#include <zstd.h>
+#include "spdlog/spdlog.h"
+
+#include "utils/compression.hpp"
+#include "utils/net_utils.hpp"
+
+namespace tcs {
+namespace utils {
+// 响应在工作线程上同步压缩，选择偏快的级别
+static constexpr int GZIP_LEVEL = 6;
+static constexpr int ZSTD_LEVEL = 3;
+
+// deflate状态约占几百KB，每个线程只初始化一次，之后用deflateReset复用
+struct DeflateContext {
+    z_stream zs{};
+    bool ok = false;
+
+    DeflateContext() {
+        // 15 + 16: 带gzip头
+        ok = deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~DeflateContext() {
+        if (ok) {
+            deflateEnd(&zs);
+        }
+    }
+};
+
+struct ZstdContext {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+
+    ZstdContext() {
+        if (cctx != nullptr) {
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ZSTD_LEVEL);
+        }
+    }
+    ~ZstdContext() { ZSTD_freeCCtx(cctx); }
+};
+
+static bool gzip(std::string_view in, std::string& out) {
+    thread_local DeflateContext ctx;
+    if (!ctx.ok || deflateReset(&ctx.zs) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&ctx.zs, static_cast<uLong>(in.size())));
+    ctx.zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    ctx.zs.avail_in = static_cast<uInt>(in.size());
+    ctx.zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    ctx.zs.avail_out = static_cast<uInt>(out.size());
+    if (deflate(&ctx.zs, Z_FINISH) != Z_STREAM_END) {
+        return false;
+    }
+    out.resize(ctx.zs.total_out);
+    return true;
+}
+
+static bool zstd(std::string_view in, std::string& out) {
+    thread_local ZstdContext ctx;
+    if (ctx.cctx == nullptr) {
+        return false;
+    }
+    ZSTD_CCtx_reset(ctx.cctx, ZSTD_reset_session_only);
+    out.resize(ZSTD_compressBound(in.size()));
+    std::size_t n = ZSTD_compress2(ctx.cctx, out.data(), out.size(), in.data(), in.size());
+    if (ZSTD_isError(n)) {
+        spdlog::warn("zstd compress failed: {}", ZSTD_getErrorName(n));
+        return false;
+    }
+    out.resize(n);
+    return true;
+}
+
+bool accepts_encoding(std::string_view accept_encoding, std::string_view name) {
+    while (!accept_encoding.empty()) {
+        std::size_t comma = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == std::string_view::npos ? std::string_view{}
+                                                          : accept_encoding.substr(comma + 1);
+
+        std::size_t semi = item.find(';');
+        std::string_view token = item.substr(0, semi);
+        while (!token.empty() && token.front() == ' ') token.remove_prefix(1);
+        while (!token.empty() && token.back() == ' ') token.remove_suffix(1);
+        if (!beast::iequals(beast::string_view(token.data(), token.size()),
+                            beast::string_view(name.data(), name.size()))) {
+            continue;
+        }
+        if (semi != std::string_view::npos) {
+            std::string_view params = item.substr(semi + 1);
+            std::size_t q = params.find("q=");
+            if (q != std::string_view::npos) {
+                std::string_view value = params.substr(q + 2);
+                value = value.substr(0, value.find_first_of(" ;"));
+                // q=0, q=0.0, q=0.000 均表示拒绝
+                if (!value.empty() && value.find_first_not_of("0.") == std::string_view::npos) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+ContentEncoding negotiate_encoding(std::string_view accept_encoding) {
+    if (accept_encoding.empty()) {
+        return ContentEncoding::Identity;
+    }
+    if (accepts_encoding(accept_encoding, "zstd")) {
+        return ContentEncoding::Zstd;
+    }
+    if (accepts_encoding(accept_encoding, "gzip")) {
+        return ContentEncoding::Gzip;
+    }
+    return ContentEncoding::Identity;
+}
+
+std::string_view encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            return "gzip";
+        case ContentEncoding::Zstd:
+            return "zstd";
+        default:
+            return {};
+    }
+}
+
+bool compress(ContentEncoding encoding, std::string& body) {
+    // 先压缩到线程自己的缓冲区，再拷回body原有的空间，两边都不需要重新分配
+    thread_local std::string scratch;
+
+    bool ok = false;
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            ok = gzip(body, scratch);
+            break;
+        case ContentEncoding::Zstd:
+            ok = zstd(body, scratch);
+            break;
+        default:
+            return false;
+    }
+    if (!ok || scratch.size() >= body.size()) {
+        return false;
+    }
+    body.assign(scratch.data(), scratch.size());
+    return true;
+}
+
+}  // namespace utils
+}  // namespace tcs
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace tcs {
+namespace utils {
+enum class ContentEncoding {
+    Identity,
+    Gzip,
+    Zstd,
+};
+
+// Accept-Encoding中是否接受name，忽略q=0
+bool accepts_encoding(std::string_view accept_encoding, std::string_view name);
+
+// 按客户端支持选择响应压缩格式，zstd优先
+ContentEncoding negotiate_encoding(std::string_view accept_encoding);
+
+// Content-Encoding头的取值
+std::string_view encoding_name(ContentEncoding encoding);
+
+// 原地压缩body，压缩上下文和输出缓冲区每个线程各一份，重复使用
+// 压缩后没有变小或压缩失败时body保持不变并返回false
+bool compress(ContentEncoding encoding, std::string& body);
+}  // namespace utils
+}  // namespace tcs
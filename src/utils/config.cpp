@@ -33,6 +33,24 @@ void AppConfig::init(const std::string& filename) {
         instance_ptr_->database_.user(config_tree.get<std::string>("Database.user"));
         instance_ptr_->database_.passwd(config_tree.get<std::string>("Database.passwd"));
         instance_ptr_->database_.db(config_tree.get<std::string>("Database.db"));
+        if (auto engine = get_value("Database.engine")) {
+            instance_ptr_->database_.engine(*engine);
+        }
+        if (auto file = get_value("Database.sqlite_file")) {
+            instance_ptr_->database_.sqlite_file(*file);
+        }
+        if (auto size = config_tree.get_optional<unsigned int>("Database.sqlite_batch_size")) {
+            instance_ptr_->database_.sqlite_batch_size(*size);
+        }
+        if (auto mb = config_tree.get_optional<u64>("Database.sqlite_mmap_mb")) {
+            instance_ptr_->database_.sqlite_mmap_mb(*mb);
+        }
+        if (auto dir = get_value("Database.journal_dir")) {
+            instance_ptr_->database_.journal_dir(*dir);
+        }
+        if (auto mb = config_tree.get_optional<u64>("Database.journal_segment_mb")) {
+            instance_ptr_->database_.journal_segment_mb(*mb);
+        }
 
         instance_ptr_->server_.host(config_tree.get<std::string>("Server.host"));
         instance_ptr_->server_.port(config_tree.get<unsigned short>("Server.port"));
@@ -49,6 +67,73 @@ void AppConfig::init(const std::string& filename) {
         instance_ptr_->server_.queue_limit(config_tree.get<unsigned int>("Server.queue_limit"));
         instance_ptr_->server_.custom_epoch(config_tree.get<u64>("Server.custom_epoch"));
         instance_ptr_->server_.service_id(config_tree.get<u64>("Server.service_id"));
+        if (auto clock = get_value("Server.snowflake_clock")) {
+            instance_ptr_->server_.snowflake_clock(*clock);
+        }
+        if (auto borrow = config_tree.get_optional<u64>("Server.snowflake_max_borrow_ms")) {
+            instance_ptr_->server_.snowflake_max_borrow_ms(*borrow);
+        }
+        if (auto budget = config_tree.get_optional<u64>("Server.room_cache_budget_mb")) {
+            instance_ptr_->server_.room_cache_budget_mb(*budget);
+        }
+        if (auto capacity = config_tree.get_optional<unsigned int>("Server.room_cache_capacity")) {
+            instance_ptr_->server_.room_cache_capacity(*capacity);
+        }
+        if (auto limit = config_tree.get_optional<unsigned int>("Server.offline_queue_limit")) {
+            instance_ptr_->server_.offline_queue_limit(*limit);
+        }
+        if (auto limit = config_tree.get_optional<unsigned int>("Server.offline_spill_limit")) {
+            instance_ptr_->server_.offline_spill_limit(*limit);
+        }
+        if (auto dir = get_value("Server.offline_spill_dir")) {
+            instance_ptr_->server_.offline_spill_dir(*dir);
+        }
+        if (auto budget = config_tree.get_optional<u64>("Server.asset_cache_budget_mb")) {
+            instance_ptr_->server_.asset_cache_budget_mb(*budget);
+        }
+        if (auto threshold = config_tree.get_optional<u64>("Server.asset_mmap_threshold_kb")) {
+            instance_ptr_->server_.asset_mmap_threshold_kb(*threshold);
+        }
+        if (auto threshold = config_tree.get_optional<u64>("Server.asset_stream_threshold_mb")) {
+            instance_ptr_->server_.asset_stream_threshold_mb(*threshold);
+        }
+        if (auto limit = config_tree.get_optional<u64>("Server.http_body_limit_kb")) {
+            instance_ptr_->server_.http_body_limit_kb(*limit);
+        }
+        if (auto limit = config_tree.get_optional<u64>("Server.upload_max_mb")) {
+            instance_ptr_->server_.upload_max_mb(*limit);
+        }
+        if (auto quota = config_tree.get_optional<u64>("Server.upload_quota_mb")) {
+            instance_ptr_->server_.upload_quota_mb(*quota);
+        }
+        if (auto bytes = config_tree.get_optional<u64>("Server.http_compress_min_bytes")) {
+            instance_ptr_->server_.http_compress_min_bytes(*bytes);
+        }
+        if (auto capacity =
+                config_tree.get_optional<unsigned int>("Server.room_summary_capacity")) {
+            instance_ptr_->server_.room_summary_capacity(*capacity);
+        }
+        if (auto file = config_tree.get_optional<std::string>("Server.trace_file")) {
+            instance_ptr_->server_.trace_file(*file);
+        }
+        if (auto rate = config_tree.get_optional<u64>("Server.trace_sample_rate")) {
+            instance_ptr_->server_.trace_sample_rate(*rate);
+        }
+        if (auto ms = config_tree.get_optional<u64>("Server.trace_slow_ms")) {
+            instance_ptr_->server_.trace_slow_ms(*ms);
+        }
+        if (auto port = config_tree.get_optional<unsigned short>("Server.cluster_port")) {
+            instance_ptr_->server_.cluster_port(*port);
+        }
+        if (auto peers = get_value("Server.cluster_peers")) {
+            instance_ptr_->server_.cluster_peers(*peers);
+        }
+        if (auto ms = config_tree.get_optional<u64>("Server.signal_window_ms")) {
+            instance_ptr_->server_.signal_window_ms(*ms);
+        }
+        if (auto limit = config_tree.get_optional<unsigned int>("Server.signal_user_limit")) {
+            instance_ptr_->server_.signal_user_limit(*limit);
+        }
 
     } catch (const pt::ptree_error& e) {
         // 捕获所有 property_tree 相关的错误
@@ -49,12 +49,45 @@ public:
             }
             db_ = db;
         }
+        void engine(const std::string& engine) {
+            if (engine != "mysql" && engine != "memory" && engine != "sqlite") {
+                throw std::invalid_argument(
+                    "Database engine must be \"mysql\", \"memory\" or \"sqlite\".");
+            }
+            engine_ = engine;
+        }
+        void sqlite_file(const std::string& file) {
+            if (file.empty()) {
+                throw std::invalid_argument("sqlite_file cannot be empty.");
+            }
+            sqlite_file_ = file;
+        }
+        void sqlite_batch_size(unsigned int size) {
+            if (size == 0) {
+                throw std::invalid_argument("sqlite_batch_size must be a positive integer.");
+            }
+            sqlite_batch_size_ = size;
+        }
+        void sqlite_mmap_mb(u64 mb) { sqlite_mmap_mb_ = mb; }
+        void journal_dir(const std::string& dir) { journal_dir_ = dir; }
+        void journal_segment_mb(u64 mb) {
+            if (mb == 0) {
+                throw std::invalid_argument("journal_segment_mb must be a positive integer.");
+            }
+            journal_segment_mb_ = mb;
+        }
 
         int sqlconnpool_max_size() const { return sqlconnpool_max_size_; }
         const std::string& server() const { return server_; }
         const std::string& user() const { return user_; }
         const std::string& passwd() const { return passwd_; }
         const std::string& db() const { return db_; }
+        const std::string& engine() const { return engine_; }
+        const std::string& sqlite_file() const { return sqlite_file_; }
+        unsigned int sqlite_batch_size() const { return sqlite_batch_size_; }
+        u64 sqlite_mmap_mb() const { return sqlite_mmap_mb_; }
+        const std::string& journal_dir() const { return journal_dir_; }
+        u64 journal_segment_mb() const { return journal_segment_mb_; }
 
     private:
         // 数据库连接池的最大连接数
@@ -67,6 +100,18 @@ public:
         std::string passwd_;
         // 数据库名称
         std::string db_;
+        // 存储引擎，mysql、memory 或 sqlite
+        std::string engine_ = "mysql";
+        // SQLite数据库文件
+        std::string sqlite_file_ = "tinychat.db";
+        // 写线程一个事务最多合并的写操作数
+        unsigned int sqlite_batch_size_ = 256;
+        // 每个连接mmap映射的最大字节数(MB)，0表示不使用mmap
+        u64 sqlite_mmap_mb_ = 256;
+        // 消息日志目录，为空时不使用日志，消息直接写入存储
+        std::string journal_dir_;
+        // 日志段文件大小(MB)
+        u64 journal_segment_mb_ = 64;
     };
 
     class Server {
@@ -131,6 +176,20 @@ public:
             }
             service_id_ = service_id;
         }
+        void snowflake_clock(const std::string& clock) {
+            if (clock != "monotonic" && clock != "system") {
+                throw std::invalid_argument("SnowFlake clock must be \"monotonic\" or \"system\".");
+            }
+            snowflake_clock_ = clock;
+        }
+        void snowflake_max_borrow_ms(u64 ms) { snowflake_max_borrow_ms_ = ms; }
+        void room_cache_budget_mb(u64 mb) { room_cache_budget_mb_ = mb; }
+        void room_cache_capacity(unsigned int capacity) {
+            if (capacity == 0) {
+                throw std::invalid_argument("Room cache capacity must be a positive integer.");
+            }
+            room_cache_capacity_ = capacity;
+        }
 
         const std::string& host() const { return host_; }
         unsigned short port() const { return port_; }
@@ -142,6 +201,96 @@ public:
         unsigned int queue_limit() const { return queue_limit_; }
         u64 custom_epoch() const { return custom_epoch_; }
         u64 service_id() const { return service_id_; }
+        const std::string& snowflake_clock() const { return snowflake_clock_; }
+        u64 snowflake_max_borrow_ms() const { return snowflake_max_borrow_ms_; }
+        void offline_queue_limit(unsigned int limit) {
+            if (limit == 0) {
+                throw std::invalid_argument("Offline queue limit must be a positive integer.");
+            }
+            offline_queue_limit_ = limit;
+        }
+        void offline_spill_limit(unsigned int limit) {
+            if (limit == 0) {
+                throw std::invalid_argument("Offline spill limit must be a positive integer.");
+            }
+            offline_spill_limit_ = limit;
+        }
+        void offline_spill_dir(const std::string& dir) {
+            if (dir.empty()) {
+                throw std::invalid_argument("Offline spill directory cannot be empty.");
+            }
+            offline_spill_dir_ = dir;
+        }
+        void asset_cache_budget_mb(u64 mb) { asset_cache_budget_mb_ = mb; }
+        void asset_mmap_threshold_kb(u64 kb) {
+            if (kb == 0) {
+                throw std::invalid_argument("Asset mmap threshold must be a positive integer.");
+            }
+            asset_mmap_threshold_kb_ = kb;
+        }
+        void asset_stream_threshold_mb(u64 mb) {
+            if (mb == 0) {
+                throw std::invalid_argument("Asset stream threshold must be a positive integer.");
+            }
+            asset_stream_threshold_mb_ = mb;
+        }
+        void http_body_limit_kb(u64 kb) {
+            if (kb == 0) {
+                throw std::invalid_argument("HTTP body limit must be a positive integer.");
+            }
+            http_body_limit_kb_ = kb;
+        }
+        void upload_max_mb(u64 mb) {
+            if (mb == 0) {
+                throw std::invalid_argument("Upload max size must be a positive integer.");
+            }
+            upload_max_mb_ = mb;
+        }
+        void upload_quota_mb(u64 mb) { upload_quota_mb_ = mb; }
+        void http_compress_min_bytes(u64 bytes) { http_compress_min_bytes_ = bytes; }
+        void room_summary_capacity(unsigned int capacity) {
+            if (capacity == 0) {
+                throw std::invalid_argument("Room summary capacity must be a positive integer.");
+            }
+            room_summary_capacity_ = capacity;
+        }
+        void trace_file(const std::string& file) {
+            if (file.empty()) {
+                throw std::invalid_argument("Trace file cannot be empty.");
+            }
+            trace_file_ = file;
+        }
+        void trace_sample_rate(u64 rate) { trace_sample_rate_ = rate; }
+        void trace_slow_ms(u64 ms) { trace_slow_ms_ = ms; }
+        void cluster_port(unsigned short port) { cluster_port_ = port; }
+        void cluster_peers(const std::string& peers) { cluster_peers_ = peers; }
+        void signal_window_ms(u64 ms) { signal_window_ms_ = ms; }
+        void signal_user_limit(unsigned int limit) {
+            if (limit == 0) {
+                throw std::invalid_argument("Signal user limit must be a positive integer.");
+            }
+            signal_user_limit_ = limit;
+        }
+        unsigned int offline_queue_limit() const { return offline_queue_limit_; }
+        unsigned int offline_spill_limit() const { return offline_spill_limit_; }
+        const std::string& offline_spill_dir() const { return offline_spill_dir_; }
+        u64 room_cache_budget_mb() const { return room_cache_budget_mb_; }
+        unsigned int room_cache_capacity() const { return room_cache_capacity_; }
+        u64 asset_cache_budget_mb() const { return asset_cache_budget_mb_; }
+        u64 asset_mmap_threshold_kb() const { return asset_mmap_threshold_kb_; }
+        u64 asset_stream_threshold_mb() const { return asset_stream_threshold_mb_; }
+        u64 http_body_limit_kb() const { return http_body_limit_kb_; }
+        u64 upload_max_mb() const { return upload_max_mb_; }
+        u64 upload_quota_mb() const { return upload_quota_mb_; }
+        u64 http_compress_min_bytes() const { return http_compress_min_bytes_; }
+        unsigned int room_summary_capacity() const { return room_summary_capacity_; }
+        const std::string& trace_file() const { return trace_file_; }
+        u64 trace_sample_rate() const { return trace_sample_rate_; }
+        u64 trace_slow_ms() const { return trace_slow_ms_; }
+        unsigned short cluster_port() const { return cluster_port_; }
+        const std::string& cluster_peers() const { return cluster_peers_; }
+        u64 signal_window_ms() const { return signal_window_ms_; }
+        unsigned int signal_user_limit() const { return signal_user_limit_; }
 
     private:
         // 服务器监听地址
@@ -164,6 +313,50 @@ public:
         u64 custom_epoch_ = 0;
         // 用于雪花id生成
         u64 service_id_;
+        // 雪花id的时钟源
+        std::string snowflake_clock_ = "monotonic";
+        // 序列号用尽时最多预借的毫秒数
+        u64 snowflake_max_borrow_ms_ = 5;
+        // 房间消息缓存的内存上限(MB)
+        u64 room_cache_budget_mb_ = 64;
+        // 每个房间缓存的最近消息条数
+        unsigned int room_cache_capacity_ = 256;
+        // 每个离线用户在内存中暂存的消息数，超过后溢写到磁盘
+        unsigned int offline_queue_limit_ = 256;
+        // 每个离线用户溢写文件中最多保存的消息数，超过后丢弃最旧的
+        unsigned int offline_spill_limit_ = 10000;
+        // 离线消息溢写目录
+        std::string offline_spill_dir_ = "offline";
+        // 静态文件缓存的内存上限(MB)
+        u64 asset_cache_budget_mb_ = 32;
+        // 不小于该值(KB)的静态文件使用mmap
+        u64 asset_mmap_threshold_kb_ = 256;
+        // 不小于该值(MB)的静态文件不缓存内容，每次从磁盘发送(Linux上使用sendfile)
+        u64 asset_stream_threshold_mb_ = 8;
+        // 普通接口请求体的上限(KB)，整个请求体会读入内存
+        u64 http_body_limit_kb_ = 64;
+        // 单个上传文件的上限(MB)，上传正文边读边写入磁盘
+        u64 upload_max_mb_ = 100;
+        // 每个用户的上传总量上限(MB)
+        u64 upload_quota_mb_ = 1024;
+        // 不小于该值(字节)的JSON响应按Accept-Encoding压缩
+        u64 http_compress_min_bytes_ = 1024;
+        // 缓存房间列表的用户数
+        unsigned int room_summary_capacity_ = 4096;
+        // 消息阶段追踪的输出文件(Chrome trace格式)
+        std::string trace_file_ = "msg_trace.json";
+        // 每N条消息采样一条写入trace_file，0为不采样
+        u64 trace_sample_rate_ = 0;
+        // 超过该耗时(ms)的消息总是写入trace_file，0为关闭
+        u64 trace_slow_ms_ = 0;
+        // 集群总线监听端口，0为单节点运行
+        unsigned short cluster_port_ = 0;
+        // 其他节点的集群总线地址，host:port以逗号分隔
+        std::string cluster_peers_;
+        // 正在输入、上下线通知按房间合并的窗口(ms)，0为关闭
+        u64 signal_window_ms_ = 200;
+        // 每个用户一个窗口内最多在多少个房间发出通知
+        unsigned int signal_user_limit_ = 8;
     };
 
     static void init(const std::string& filename);
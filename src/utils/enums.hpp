@@ -11,7 +11,9 @@ enum class StatusCode : int {
     // 通用错误
     Forbidden = 403,
     BadRequest = 400,
+    Unauthorized = 401,
     NotFound = 404,
+    PayloadTooLarge = 413,
     InternalServerError = 500,
 
     // 用户相关
@@ -22,6 +24,10 @@ enum class StatusCode : int {
 
     // 聊天房间相关
     CreateRoomFailed = 2001,
+
+    // 附件相关
+    UploadFailed = 3001,
+    QuotaExceeded = 3002,
 };
 inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const StatusCode& code) {
@@ -52,6 +58,15 @@ enum class ServerRespType : int {
     GMsgToSend = 3,
 
     PermissionDenied = 4,
+
+    // 离线期间的消息，重新连接后合并为一帧补发
+    OfflineMsgs = 5,
+
+    // 一个房间在一个合并窗口内的正在输入和上下线变化，不落库
+    RoomSignals = 6,
+
+    // 已确认的消息写入存储时被拒绝(发送者已不是成员或房间已删除)，客户端应删除这条消息
+    MsgRetracted = 7,
 };
 inline void tag_invoke(boost::json::value_from_tag, boost::json::value& jv,
                        const ServerRespType& type) {
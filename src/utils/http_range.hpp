@@ -0,0 +1,83 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace utils {
+// 解析后的单个Range区间，闭区间 [first, last]
+struct ByteRange {
+    enum class Kind {
+        // 没有Range头，或者不支持的格式(多区间等)，按完整内容返回
+        None,
+        Satisfiable,
+        // 416 Range Not Satisfiable
+        Unsatisfiable,
+    };
+
+    Kind kind = Kind::None;
+    u64 first = 0;
+    u64 last = 0;
+
+    u64 length() const { return last - first + 1; }
+};
+
+// 支持 bytes=a-b, bytes=a-, bytes=-n 三种单区间格式
+inline ByteRange parse_byte_range(std::string_view header, u64 size) {
+    constexpr std::string_view PREFIX = "bytes=";
+    if (!header.starts_with(PREFIX)) {
+        return {};
+    }
+    header.remove_prefix(PREFIX.size());
+    if (header.find(',') != std::string_view::npos) {
+        return {};
+    }
+
+    std::size_t dash = header.find('-');
+    if (dash == std::string_view::npos) {
+        return {};
+    }
+    std::string_view first_str = header.substr(0, dash);
+    std::string_view last_str = header.substr(dash + 1);
+
+    auto parse = [](std::string_view str, u64& value) {
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        return ec == std::errc() && ptr == str.data() + str.size();
+    };
+
+    ByteRange range;
+    if (first_str.empty()) {
+        // 最后n个字节
+        u64 suffix = 0;
+        if (!parse(last_str, suffix)) {
+            return {};
+        }
+        if (suffix == 0 || size == 0) {
+            return ByteRange{.kind = ByteRange::Kind::Unsatisfiable};
+        }
+        range.first = suffix >= size ? 0 : size - suffix;
+        range.last = size - 1;
+    } else {
+        if (!parse(first_str, range.first)) {
+            return {};
+        }
+        if (last_str.empty()) {
+            range.last = size == 0 ? 0 : size - 1;
+        } else if (!parse(last_str, range.last) || range.last < range.first) {
+            return {};
+        }
+        if (range.first >= size) {
+            return ByteRange{.kind = ByteRange::Kind::Unsatisfiable};
+        }
+        if (range.last >= size) {
+            range.last = size - 1;
+        }
+    }
+    range.kind = ByteRange::Kind::Satisfiable;
+    return range;
+}
+
+}  // namespace utils
+}  // namespace tcs
@@ -0,0 +1,81 @@
+#include <cstring>
+
+#include "utils/json_writer.hpp"
+
+namespace tcs {
+namespace utils {
+namespace {
+constexpr u64 ONES = 0x0101010101010101ULL;
+constexpr u64 HIGHS = 0x8080808080808080ULL;
+
+// 8个字节中是否有需要转义的：控制字符、'"'、'\\'
+// 0x80以上的字节最高位为1，~word把它屏蔽掉，UTF-8不会误判
+inline bool needs_escape(u64 word) {
+    u64 control = (word - ONES * 0x20) & ~word;
+    u64 quote = word ^ (ONES * '"');
+    u64 backslash = word ^ (ONES * '\\');
+    quote = (quote - ONES) & ~quote;
+    backslash = (backslash - ONES) & ~backslash;
+    return ((control | quote | backslash) & HIGHS) != 0;
+}
+}  // namespace
+
+void JsonWriter::write_string(std::string_view s) {
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    out_.reserve(out_.size() + s.size() + 2);
+    out_ += '"';
+    const char* p = s.data();
+    const char* end = p + s.size();
+    // [run, p)是还没写出的不需转义的部分
+    const char* run = p;
+    while (p < end) {
+        if (end - p >= 8) {
+            u64 word;
+            std::memcpy(&word, p, sizeof(word));
+            if (!needs_escape(word)) {
+                p += 8;
+                continue;
+            }
+        }
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            ++p;
+            continue;
+        }
+
+        out_.append(run, p);
+        switch (c) {
+            case '"':
+                out_ += "\\\"";
+                break;
+            case '\\':
+                out_ += "\\\\";
+                break;
+            case '\b':
+                out_ += "\\b";
+                break;
+            case '\f':
+                out_ += "\\f";
+                break;
+            case '\n':
+                out_ += "\\n";
+                break;
+            case '\r':
+                out_ += "\\r";
+                break;
+            case '\t':
+                out_ += "\\t";
+                break;
+            default: {
+                char esc[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                out_.append(esc, sizeof(esc));
+            }
+        }
+        run = ++p;
+    }
+    out_.append(run, p);
+    out_ += '"';
+}
+}  // namespace utils
+}  // namespace tcs
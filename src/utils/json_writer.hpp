@@ -0,0 +1,132 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace utils {
+// 模型在自己的命名空间里定义 json_fields(JsonFieldsTag<T>)，通过ADL找到
+// 返回字段描述的tuple，字段顺序与tag_invoke(value_from)一致
+template <typename T>
+struct JsonFieldsTag {};
+
+template <typename C, typename M, bool AsId>
+struct JsonField {
+    std::string_view name;
+    M C::* member;
+};
+
+template <typename C, typename M>
+constexpr JsonField<C, M, false> json_field(std::string_view name, M C::* member) {
+    return {name, member};
+}
+
+// u64 id以字符串输出，JS的number精度不够
+template <typename C>
+constexpr JsonField<C, u64, true> json_id(std::string_view name, u64 C::* member) {
+    return {name, member};
+}
+
+template <typename T>
+concept JsonDescribed = requires { json_fields(JsonFieldsTag<T>{}); };
+
+template <typename T>
+struct IsVector : std::false_type {};
+template <typename T, typename A>
+struct IsVector<std::vector<T, A>> : std::true_type {};
+
+// 不经过json::value直接把模型序列化到out末尾
+// 输出与json::serialize(json::value_from(v))逐字节相同
+// 没有json_fields的类型退回value_from
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    template <typename T>
+    void write(const T& value) {
+        if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            out_ += "null";
+        } else if constexpr (std::is_same_v<T, bool>) {
+            out_ += value ? "true" : "false";
+        } else if constexpr (std::is_enum_v<T>) {
+            write(static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_integral_v<T>) {
+            char buf[24];
+            auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+            out_.append(buf, ptr);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            write_string(value);
+        } else if constexpr (IsVector<T>::value) {
+            out_ += '[';
+            for (std::size_t i = 0; i < value.size(); i++) {
+                if (i != 0) {
+                    out_ += ',';
+                }
+                write(value[i]);
+            }
+            out_ += ']';
+        } else if constexpr (JsonDescribed<T>) {
+            static constexpr auto fields = json_fields(JsonFieldsTag<T>{});
+            out_ += '{';
+            std::apply(
+                [&](const auto&... field) {
+                    std::size_t index = 0;
+                    (write_field(value, field, index++), ...);
+                },
+                fields);
+            out_ += '}';
+        } else {
+            out_ += boost::json::serialize(boost::json::value_from(value));
+        }
+    }
+
+    void write_id(u64 id) {
+        out_ += '"';
+        write(id);
+        out_ += '"';
+    }
+
+    // 按JSON规则转义，非ASCII字节原样输出
+    void write_string(std::string_view s);
+
+private:
+    template <typename C, typename M, bool AsId>
+    void write_field(const C& obj, const JsonField<C, M, AsId>& field, std::size_t index) {
+        if (index != 0) {
+            out_ += ',';
+        }
+        // 字段名是代码里的标识符，不需要转义
+        out_ += '"';
+        out_ += field.name;
+        out_ += "\":";
+        if constexpr (AsId) {
+            write_id(obj.*field.member);
+        } else {
+            write(obj.*field.member);
+        }
+    }
+
+    std::string& out_;
+};
+
+// 按本线程上次同类型输出的长度预留空间，一般一次分配就够
+template <typename T>
+std::string to_json(const T& value) {
+    thread_local std::size_t size_hint = 128;
+    std::string out;
+    out.reserve(size_hint);
+    JsonWriter(out).write(value);
+    size_hint = out.size();
+    return out;
+}
+}  // namespace utils
+}  // namespace tcs
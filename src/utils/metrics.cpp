@@ -0,0 +1,206 @@
+#include <bit>
+#include <cstdio>
+
+#include "utils/metrics.hpp"
+
+namespace tcs {
+namespace utils {
+std::size_t metric_shard() {
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+u64 Counter::value() const {
+    u64 total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+i64 Gauge::value() const {
+    i64 total = 0;
+    for (const auto& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::size_t Histogram::bucket_of(u64 value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<std::size_t>(value);
+    }
+    u64 exponent = std::bit_width(value) - 1;
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+    u64 sub = (value >> (exponent - 3)) & (SUB_BUCKETS - 1);
+    return static_cast<std::size_t>((exponent - 2) * SUB_BUCKETS + sub);
+}
+
+u64 Histogram::bucket_upper(std::size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    u64 exponent = index / SUB_BUCKETS + 2;
+    u64 sub = index % SUB_BUCKETS;
+    u64 width = u64{1} << (exponent - 3);
+    return (SUB_BUCKETS + sub) * width + width - 1;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    snap.buckets.assign(BUCKETS, 0);
+    for (const auto& shard : shards_) {
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            u64 n = shard.buckets[i].load(std::memory_order_relaxed);
+            snap.buckets[i] += n;
+            snap.count += n;
+        }
+        snap.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+u64 Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    // 第rank个样本(从1开始)所在的桶
+    u64 rank = static_cast<u64>(q * static_cast<double>(count - 1)) + 1;
+    u64 seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucket_upper(i);
+        }
+    }
+    return bucket_upper(buckets.size() - 1);
+}
+
+namespace {
+void header(std::string& out, std::string_view name, std::string_view type,
+            std::string_view help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(std::string& out, std::string_view name, std::string_view labels, double value) {
+    char buf[32];
+    int len = std::snprintf(buf, sizeof(buf), "%.9g", value);
+    out += name;
+    out += labels;
+    out += ' ';
+    out.append(buf, static_cast<std::size_t>(len));
+    out += '\n';
+}
+
+void render(std::string& out, std::string_view name, std::string_view help,
+            const Counter& counter) {
+    header(out, name, "counter", help);
+    sample(out, name, "", static_cast<double>(counter.value()));
+}
+
+void render(std::string& out, std::string_view name, std::string_view help, const Gauge& gauge) {
+    header(out, name, "gauge", help);
+    sample(out, name, "", static_cast<double>(gauge.value()));
+}
+
+// 以summary导出分位数，scale把纳秒换算成秒
+void render(std::string& out, std::string_view name, std::string_view help,
+            const Histogram& histogram, double scale) {
+    static constexpr std::pair<double, std::string_view> QUANTILES[] = {
+        {0.5, "{quantile=\"0.5\"}"},
+        {0.9, "{quantile=\"0.9\"}"},
+        {0.99, "{quantile=\"0.99\"}"},
+        {0.999, "{quantile=\"0.999\"}"},
+    };
+
+    Histogram::Snapshot snap = histogram.snapshot();
+    header(out, name, "summary", help);
+    for (const auto& [q, labels] : QUANTILES) {
+        sample(out, name, labels, static_cast<double>(snap.quantile(q)) * scale);
+    }
+    std::string suffixed(name);
+    sample(out, suffixed + "_sum", "", static_cast<double>(snap.sum) * scale);
+    sample(out, suffixed + "_count", "", static_cast<double>(snap.count));
+}
+}  // namespace
+
+std::string Metrics::render() const {
+    static constexpr double NS = 1e-9;
+
+    std::string out;
+    out.reserve(4096);
+    utils::render(out, "tinychat_accepted_connections_total", "Accepted TCP connections.",
+                  accepted_connections);
+    utils::render(out, "tinychat_http_sessions", "Open HTTP sessions.", http_sessions);
+    utils::render(out, "tinychat_ws_sessions", "Open WebSocket sessions.", ws_sessions);
+    utils::render(out, "tinychat_http_bytes_in_total", "Bytes read on HTTP connections.",
+                  http_bytes_in);
+    utils::render(out, "tinychat_http_bytes_out_total", "Bytes written on HTTP connections.",
+                  http_bytes_out);
+    utils::render(out, "tinychat_http_bytes_sendfile_total",
+                  "Bytes of HTTP responses sent with sendfile.", http_bytes_sendfile);
+    utils::render(out, "tinychat_task_queue_depth", "Tasks waiting in the worker thread pool.",
+                  task_queue_depth);
+    utils::render(out, "tinychat_task_wait_seconds",
+                  "Time a task spends queued before a worker picks it up.", task_wait, NS);
+    utils::render(out, "tinychat_db_acquire_seconds",
+                  "Time spent waiting for a pooled MySQL connection.", db_acquire, NS);
+    utils::render(out, "tinychat_db_acquire_waits_total",
+                  "Connection requests that found the pool empty.", db_acquire_waits);
+    utils::render(out, "tinychat_db_query_seconds", "MySQL statement execution time.", db_query,
+                  NS);
+    utils::render(out, "tinychat_db_batch_seconds",
+                  "Time of one SQLite write batch from BEGIN to COMMIT.", db_batch, NS);
+    utils::render(out, "tinychat_journal_sync_seconds",
+                  "Time of one group msync of the message journal.", journal_sync, NS);
+    utils::render(out, "tinychat_journal_sync_records", "Journal records covered by one msync.",
+                  journal_batch, 1.0);
+    utils::render(out, "tinychat_journal_pending",
+                  "Journaled messages not yet written to storage.", journal_pending);
+    utils::render(out, "tinychat_fanout_recipients", "Online recipients per room broadcast.",
+                  fanout_size, 1.0);
+    utils::render(out, "tinychat_fanout_seconds",
+                  "Time to resolve members and enqueue one room broadcast.", fanout_time, NS);
+    utils::render(out, "tinychat_cluster_frames_out_total",
+                  "Delivery and presence frames queued for peer nodes.", cluster_frames_out);
+    utils::render(out, "tinychat_cluster_frames_in_total",
+                  "Delivery and presence frames received from peer nodes.", cluster_frames_in);
+    utils::render(out, "tinychat_cluster_dropped_total",
+                  "Frames dropped for disconnected, unknown or backlogged peers.",
+                  cluster_dropped);
+    utils::render(out, "tinychat_cluster_batch_frames", "Frames per write to a peer.",
+                  cluster_batch, 1.0);
+    utils::render(out, "tinychat_presence_remote_sessions",
+                  "Sessions on peer nodes known to the presence directory.", presence_remote);
+    utils::render(out, "tinychat_signals_total", "Typing and presence signals received.",
+                  signals_in);
+    utils::render(out, "tinychat_signals_dropped_total",
+                  "Signals dropped by the per-user rate limit.", signals_dropped);
+    utils::render(out, "tinychat_signal_fanouts_total",
+                  "Room broadcasts of coalesced signals.", signal_fanouts);
+    utils::render(out, "tinychat_ws_outbound_bytes",
+                  "Bytes queued for sending on all WebSocket sessions.", ws_outbound_bytes);
+    utils::render(out, "tinychat_msg_queue_seconds",
+                  "Chat message time from frame read to worker pickup.", msg_queue, NS);
+    utils::render(out, "tinychat_msg_handle_seconds",
+                  "Chat message parsing, permission check and transaction time.", msg_handle, NS);
+    utils::render(out, "tinychat_msg_fanout_seconds",
+                  "Chat message time from commit to enqueue on all recipients.", msg_fanout, NS);
+    utils::render(out, "tinychat_msg_deliver_seconds",
+                  "Chat message time in a recipient's send queue until written.", msg_deliver,
+                  NS);
+    return out;
+}
+}  // namespace utils
+}  // namespace tcs
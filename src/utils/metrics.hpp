@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/types.hpp"
+
+namespace tcs {
+namespace utils {
+// 热路径上的计数按线程分片，每个分片独占一条缓存行
+// 记录时只有一次relaxed原子加，读取(/metrics)时再把分片加起来
+inline constexpr std::size_t METRIC_SHARDS = 16;
+
+// 线程第一次记录时轮流分配分片
+std::size_t metric_shard();
+
+class Counter {
+public:
+    void add(u64 n = 1) {
+        shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    u64 value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<u64> value{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// 可增可减，加减可以发生在不同线程上
+class Gauge {
+public:
+    void add(i64 n) { shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    i64 value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<i64> value{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// HDR风格的对数线性直方图：每个2的幂区间再分8个桶，相对误差不超过12.5%
+// 延迟以纳秒记录，超过2^40ns(约18分钟)的值计入最后一个桶
+class Histogram {
+public:
+    static constexpr u64 SUB_BUCKETS = 8;
+    static constexpr u64 MAX_EXPONENT = 40;
+    static constexpr std::size_t BUCKETS = (MAX_EXPONENT - 2) * SUB_BUCKETS;
+
+    void record(u64 value) {
+        Shard& shard = shards_[metric_shard()];
+        shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        record(static_cast<u64>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    struct Snapshot {
+        std::vector<u64> buckets;
+        u64 count = 0;
+        u64 sum = 0;
+
+        // 返回分位点所在桶的上界，没有数据时为0
+        u64 quantile(double q) const;
+    };
+    Snapshot snapshot() const;
+
+    static std::size_t bucket_of(u64 value);
+    // 桶内最大值
+    static u64 bucket_upper(std::size_t index);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<u64>, BUCKETS> buckets{};
+        std::atomic<u64> sum{0};
+    };
+    std::array<Shard, METRIC_SHARDS> shards_;
+};
+
+// 作用域计时，析构时记录到直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.record(std::chrono::steady_clock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 全部指标，按Prometheus文本格式导出
+class Metrics {
+public:
+    static Metrics& get() {
+        static Metrics instance;
+        return instance;
+    }
+
+    Counter accepted_connections;
+    Gauge http_sessions;
+    Gauge ws_sessions;
+
+    // HTTP连接读入和写出的字节数，写出中经sendfile发送的部分单独计数
+    Counter http_bytes_in;
+    Counter http_bytes_out;
+    Counter http_bytes_sendfile;
+
+    // ThreadPool中排队的任务数和任务从入队到开始执行的时间
+    Gauge task_queue_depth;
+    Histogram task_wait;
+
+    // 从连接池取连接的等待时间，池中有空闲连接时记0
+    Histogram db_acquire;
+    Counter db_acquire_waits;
+    Histogram db_query;
+    // SQLite写线程一次批量提交(BEGIN到COMMIT)的耗时
+    Histogram db_batch;
+
+    // 消息日志一次组提交的耗时和包含的记录数，以及已落盘但还没写入存储的记录数
+    Histogram journal_sync;
+    Histogram journal_batch;
+    Gauge journal_pending;
+
+    // 一次群发的在线接收者数和耗时
+    Histogram fanout_size;
+    Histogram fanout_time;
+
+    // 集群总线收发的帧、因对端未连接或积压丢弃的帧，以及一次写出合并的帧数
+    Counter cluster_frames_out;
+    Counter cluster_frames_in;
+    Counter cluster_dropped;
+    Histogram cluster_batch;
+    // 在线状态表中其他节点上的会话数
+    Gauge presence_remote;
+
+    // 收到的正在输入、上下线通知，因限速丢弃的通知，以及合并后的房间群发次数
+    Counter signals_in;
+    Counter signals_dropped;
+    Counter signal_fanouts;
+
+    // 所有WebSocket会话待发送的字节数
+    Gauge ws_outbound_bytes;
+
+    // 聊天消息各阶段的耗时，阶段划分见core::MsgTrace
+    Histogram msg_queue;
+    Histogram msg_handle;
+    Histogram msg_fanout;
+    Histogram msg_deliver;
+
+    std::string render() const;
+
+private:
+    Metrics() = default;
+};
+}  // namespace utils
+}  // namespace tcs
@@ -1,41 +1,105 @@
-
 #include "utils/snowflake.hpp"
 
+#include <algorithm>
+#include <string>
+
 namespace tcs {
 namespace utils {
 u64 SnowFlake::service_id_ = INIT_SERVICE_BITS;
-u64 SnowFlake::sequence_id_ = 0;
-i64 SnowFlake::last_timestamp_ = 0;
 u64 SnowFlake::custom_epoch_ = 0;
-std::mutex SnowFlake::mtx_;
-u64 SnowFlake::next_id() {
-    std::lock_guard<std::mutex> lock(mtx_);
+SnowFlake::ClockMode SnowFlake::clock_mode_ = SnowFlake::ClockMode::Monotonic;
+u64 SnowFlake::max_borrow_ms_ = SnowFlake::DEFAULT_MAX_BORROW_MS;
+u64 SnowFlake::wall_anchor_ms_ = 0;
+u64 SnowFlake::mono_anchor_ms_ = 0;
+std::atomic<u64> SnowFlake::state_{0};
+std::atomic<u64> SnowFlake::stalls_{0};
+std::atomic<u64> SnowFlake::skew_events_{0};
+std::atomic<u64> SnowFlake::skew_reported_{0};
+std::atomic<u64> SnowFlake::borrowed_ms_{0};
 
+SnowFlake::Block SnowFlake::claim(u64 n) {
     if (service_id_ == INIT_SERVICE_BITS) {
         throw std::runtime_error("SnowFlake need to be initialized first!");
     }
 
-    u64 time_stamp = time_gen();
-    if (time_stamp < last_timestamp_) {
-        throw std::runtime_error("Clock moved backwards. Refusing to generate id for " +
-                                 std::to_string(time_stamp) + " milliseconds");
-    }
-    if (time_stamp == last_timestamp_) {
-        sequence_id_++;
-        if (sequence_id_ >= (1 << (SEQUENCE_BITS - 1))) {
-            time_stamp = wait_till_next_ms();
-            // throw std::runtime_error("Sequence overflow, please try again later.");
+    u64 cur = state_.load(std::memory_order_acquire);
+    while (true) {
+        u64 last_timestamp = cur >> STATE_SEQ_BITS;
+        u64 next_seq = cur & STATE_SEQ_MASK;
+        // 必须在读取state之后读时钟，否则其他线程推进的时间戳会被误判为回拨
+        u64 time_stamp = time_gen() - custom_epoch_;
+        bool borrowed = false;
+
+        if (time_stamp > last_timestamp) {
+            next_seq = 0;
+        } else {
+            u64 lag = last_timestamp - time_stamp;
+            if (lag > max_borrow_ms_) {
+                // 落后超过借用额度，只可能是系统时钟回拨
+                // 回拨期间last_timestamp不会推进，每次回拨只由第一个发现它的线程计数
+                u64 reported = skew_reported_.load(std::memory_order_relaxed);
+                while (reported < last_timestamp &&
+                       !skew_reported_.compare_exchange_weak(reported, last_timestamp,
+                                                             std::memory_order_relaxed)) {
+                }
+                if (reported < last_timestamp) {
+                    skew_events_.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (clock_mode_ == ClockMode::System && lag > MAX_SKEW_MS) {
+                    throw std::runtime_error("Clock moved backwards. Refusing to generate id for " +
+                                             std::to_string(lag) + " milliseconds");
+                }
+                stalls_.fetch_add(1, std::memory_order_relaxed);
+                wait_until(last_timestamp - max_borrow_ms_);
+                cur = state_.load(std::memory_order_acquire);
+                continue;
+            }
+
+            time_stamp = last_timestamp;
+            if (next_seq > MAX_SEQUENCE) {
+                if (lag + 1 <= max_borrow_ms_) {
+                    // 当前毫秒已用尽，预借下一毫秒
+                    time_stamp = last_timestamp + 1;
+                    next_seq = 0;
+                    borrowed = true;
+                } else {
+                    // 借用额度用完，在锁外等待时钟追上后重试
+                    stalls_.fetch_add(1, std::memory_order_relaxed);
+                    wait_until(last_timestamp + 1 - max_borrow_ms_);
+                    cur = state_.load(std::memory_order_acquire);
+                    continue;
+                }
+            }
+        }
+
+        u64 count = std::min(n, MAX_SEQUENCE + 1 - next_seq);
+        u64 desired = pack_state(time_stamp, next_seq + count);
+        if (state_.compare_exchange_weak(cur, desired, std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+            if (borrowed) {
+                borrowed_ms_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return Block{.timestamp = time_stamp, .first_seq = next_seq, .count = count};
         }
-    } else {
-        sequence_id_ = 0;
+        // CAS失败时cur已被更新为最新状态
     }
-    last_timestamp_ = time_stamp;
-    time_stamp -= custom_epoch_;
-    time_stamp <<= (SERVICE_BITS + SEQUENCE_BITS);
-    u64 service_id = service_id_ << SEQUENCE_BITS;
+}
 
-    // 序列id用递增前的
-    return u64(time_stamp | service_id | sequence_id_);
+u64 SnowFlake::next_id() {
+    Block block = claim(1);
+    return make_id(block.timestamp, block.first_seq);
+}
+
+std::vector<u64> SnowFlake::reserve(std::size_t n) {
+    std::vector<u64> ids;
+    ids.reserve(n);
+    while (ids.size() < n) {
+        Block block = claim(n - ids.size());
+        for (u64 i = 0; i < block.count; ++i) {
+            ids.push_back(make_id(block.timestamp, block.first_seq + i));
+        }
+    }
+    return ids;
 }
 }  // namespace utils
-}  // namespace tcs
\ No newline at end of file
+}  // namespace tcs
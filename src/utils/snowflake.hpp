@@ -1,10 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <stdexcept>
 #include <thread>
 #include <iostream>
-#include <mutex>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+#include <time.h>
+#endif
 
 #include "utils/types.hpp"
 
@@ -12,7 +18,41 @@ namespace tcs {
 namespace utils {
 class SnowFlake {
 public:
-    static void init(u64 service_id, u64 custom_epoch) {
+    enum class ClockMode {
+        // 直接读取系统时钟，可容忍小幅回拨
+        System,
+        // init时用系统时钟校准，之后只读单调时钟，不受NTP跳变影响
+        Monotonic,
+    };
+
+    struct Stats {
+        // 序列号用尽或时钟回拨导致的等待次数
+        u64 stalls;
+        // 系统时钟回拨次数
+        u64 skew_events;
+        // 预借的毫秒数
+        u64 borrowed_ms;
+    };
+
+    // 解析后的id，timestamp为unix毫秒
+    struct IdParts {
+        u64 timestamp;
+        u64 service_id;
+        u64 sequence;
+    };
+
+    // 闭区间 [min_id, max_id]，min_id > max_id 表示空区间
+    struct IdRange {
+        u64 min_id;
+        u64 max_id;
+
+        constexpr bool empty() const { return min_id > max_id; }
+    };
+
+    static constexpr u64 DEFAULT_MAX_BORROW_MS = 5;
+
+    static void init(u64 service_id, u64 custom_epoch, ClockMode clock_mode = ClockMode::Monotonic,
+                     u64 max_borrow_ms = DEFAULT_MAX_BORROW_MS) {
         if (service_id_ != INIT_SERVICE_BITS) {
             throw std::runtime_error("SnowFlake has already been initialized. ");
         }
@@ -20,77 +60,141 @@ public:
             throw std::runtime_error("SnowFlake must be inited with service bits <= 1023 and >= 0");
         }
         service_id_ = service_id;
-        last_timestamp_ = time_gen();
         custom_epoch_ = custom_epoch;
+        clock_mode_ = clock_mode;
+        max_borrow_ms_ = max_borrow_ms;
+        // 校准：单调时钟的零点对应init时的系统时间
+        wall_anchor_ms_ = system_ms();
+        mono_anchor_ms_ = coarse_monotonic_ms();
+        state_.store(pack_state(time_gen() - custom_epoch_, 0), std::memory_order_release);
     }
 
     static u64 next_id();
 
-    // static void parse_id(u64 id) {
-    //     std::cout << "Parsed ID: " << id << std::endl;
-    //     u64 sequence_id = id & ((1 << SEQUENCE_BITS) - 1);
-
-    //    std::cout << "Sequence ID: " << sequence_id << std::endl;
-
-    //    id >>= SEQUENCE_BITS;
-    //    u64 service_id = id & ((1 << SERVICE_BITS) - 1);
-
-    //    std::cout << "Service ID: " << service_id << std::endl;
+    // 批量预留id，用于批量插入
+    // 返回的id严格递增，跨毫秒时会分多次CAS领取
+    static std::vector<u64> reserve(std::size_t n);
 
-    //    id >>= SERVICE_BITS;
-    //    u64 timestamp = id + own_epoch_;
-    //    print_time_in_ms(timestamp);
-    //}
+    static constexpr IdParts decode(u64 id, u64 custom_epoch) {
+        return IdParts{.timestamp = (id >> (SERVICE_BITS + SEQUENCE_BITS)) + custom_epoch,
+                       .service_id = (id >> SEQUENCE_BITS) & (INIT_SERVICE_BITS - 1),
+                       .sequence = id & MAX_SEQUENCE};
+    }
 
-    // static void print_time_in_ms(u64 ms_since_epoch) {
-    //     // 1. 将毫秒数转换为一个 chrono::milliseconds 的 duration 对象
-    //     std::chrono::milliseconds duration(ms_since_epoch);
+    // 时间戳不早于unix_ms的最小id
+    static constexpr u64 min_id_at(u64 unix_ms, u64 custom_epoch) {
+        if (unix_ms <= custom_epoch) {
+            return 0;
+        }
+        return (unix_ms - custom_epoch) << (SERVICE_BITS + SEQUENCE_BITS);
+    }
 
-    //    // 2. 将这个 duration 转换为一个 system_clock 的 time_point 对象 (它本质上是UTC)
-    //    std::chrono::system_clock::time_point time_point_utc(duration);
+    // 时间窗口 [from_ms, to_ms) 对应的id范围，可直接用于 messages.id 主键范围扫描
+    // 注意：预借毫秒时id的时间戳最多超前 max_borrow_ms
+    static constexpr IdRange id_range(u64 from_ms, u64 to_ms, u64 custom_epoch) {
+        u64 min_id = min_id_at(from_ms, custom_epoch);
+        u64 end_id = min_id_at(to_ms, custom_epoch);
+        if (end_id <= min_id) {
+            return IdRange{.min_id = 1, .max_id = 0};
+        }
+        return IdRange{.min_id = min_id, .max_id = end_id - 1};
+    }
 
-    //    // 3. 定义目标时区。使用标准的 IANA 时区名称是最稳妥的。
-    //    //    "Asia/Shanghai", "Asia/Taipei", "Asia/Hong_Kong" 都是 UTC+8。
-    //    const std::chrono::time_zone* target_zone = std::chrono::locate_zone("Asia/Shanghai");
+    static IdParts parse_id(u64 id) { return decode(id, custom_epoch_); }
 
-    //    // 4. 使用 zoned_time 将 UTC 时间点与目标时区关联起来
-    //    std::chrono::zoned_time zoned_time_utc8(target_zone, time_point_utc);
+    static u64 min_id_at(u64 unix_ms) { return min_id_at(unix_ms, custom_epoch_); }
 
-    //    // 5. 使用 std::format 格式化 zoned_time 对象
-    //    //    %Z 会自动输出时区简称 (例如 CST)
-    //    //    %z 会输出时区偏移 (例如 +0800)
-    //    std::string formatted_time = std::format("{:%Y-%m-%d %H:%M:%S %Z}", zoned_time_utc8);
+    static IdRange id_range(u64 from_ms, u64 to_ms) {
+        return id_range(from_ms, to_ms, custom_epoch_);
+    }
 
-    //    std::cout << "Formatted (UTC+8): " << formatted_time << std::endl;
-    //}
+    static Stats stats() {
+        return Stats{.stalls = stalls_.load(std::memory_order_relaxed),
+                     .skew_events = skew_events_.load(std::memory_order_relaxed),
+                     .borrowed_ms = borrowed_ms_.load(std::memory_order_relaxed)};
+    }
 
 private:
     static constexpr u64 INIT_SERVICE_BITS = 1024;
     static constexpr u64 SERVICE_BITS = 10;
     static constexpr u64 SEQUENCE_BITS = 12;
+    static constexpr u64 MAX_SEQUENCE = (u64(1) << SEQUENCE_BITS) - 1;
+
+    // state_ 低位保存当前毫秒内下一个可用的序列号(0..MAX_SEQUENCE+1)，
+    // 比 SEQUENCE_BITS 多一位，这样序列号用尽时不会进位到时间戳
+    static constexpr u64 STATE_SEQ_BITS = SEQUENCE_BITS + 1;
+    static constexpr u64 STATE_SEQ_MASK = (u64(1) << STATE_SEQ_BITS) - 1;
+
+    // System模式下超过该值的回拨不再等待，直接报错
+    static constexpr u64 MAX_SKEW_MS = 1000;
+
+    // 一次CAS领取到的连续序列号
+    struct Block {
+        u64 timestamp;
+        u64 first_seq;
+        u64 count;
+    };
 
     // 当前服务的id
     static u64 service_id_;
-    // 上一个生成id的时间戳
-    static i64 last_timestamp_;
     static u64 custom_epoch_;
-    // 序列号
-    static u64 sequence_id_;
-    static std::mutex mtx_;
+    static ClockMode clock_mode_;
+    // 序列号用尽时最多可以超前真实时间的毫秒数
+    static u64 max_borrow_ms_;
+    static u64 wall_anchor_ms_;
+    static u64 mono_anchor_ms_;
+    // 相对custom_epoch的时间戳和下一个序列号
+    static std::atomic<u64> state_;
+
+    static std::atomic<u64> stalls_;
+    static std::atomic<u64> skew_events_;
+    // 已计入skew_events_的回拨所对应的最大last_timestamp
+    static std::atomic<u64> skew_reported_;
+    static std::atomic<u64> borrowed_ms_;
+
+    static constexpr u64 pack_state(u64 timestamp, u64 next_seq) {
+        return (timestamp << STATE_SEQ_BITS) | next_seq;
+    }
 
-    static u64 time_gen() {
+    static u64 make_id(u64 timestamp, u64 sequence) {
+        return (timestamp << (SERVICE_BITS + SEQUENCE_BITS)) | (service_id_ << SEQUENCE_BITS) |
+               sequence;
+    }
+
+    // 领取当前毫秒内最多n个序列号
+    static Block claim(u64 n);
+
+    static u64 system_ms() {
         auto duration = std::chrono::system_clock::now().time_since_epoch();
         return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
     }
 
-    static u64 wait_till_next_ms() {
-        auto now = time_gen();
-        while (time_gen() <= now) {
+    // Linux上使用CLOCK_MONOTONIC_COARSE，读取的是内核每个tick更新一次的缓存值，
+    // 不需要读TSC，代价远低于system_clock::now()
+    static u64 coarse_monotonic_ms() {
+#ifdef PLATFORM_LINUX
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return u64(ts.tv_sec) * 1000 + u64(ts.tv_nsec) / 1000000;
+#else
+        auto duration = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+#endif
+    }
+
+    static u64 time_gen() {
+        if (clock_mode_ == ClockMode::Monotonic) {
+            return wall_anchor_ms_ + (coarse_monotonic_ms() - mono_anchor_ms_);
+        }
+        return system_ms();
+    }
+
+    // 不持有任何锁，等待时钟到达target(相对custom_epoch)
+    static void wait_until(u64 target) {
+        while (time_gen() - custom_epoch_ < target) {
             std::this_thread::yield();
-            now = time_gen();
         }
-        return now;
     }
 };
 }  // namespace utils
-}  // namespace tcs
\ No newline at end of file
+}  // namespace tcs
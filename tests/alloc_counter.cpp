@@ -0,0 +1,22 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// 统计全局堆分配次数，只链接进test_main
+// 替换全局operator new/delete必须在唯一的翻译单元中定义
+namespace test {
+std::atomic<std::size_t> heap_allocs{0};
+}
+
+void* operator new(std::size_t size) {
+    test::heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "core/arena.hpp"
+#include "core/request_handler.hpp"
+#include "utils/net_utils.hpp"
+#include "test_utils.hpp"
+
+namespace test {
+// 定义在alloc_counter.cpp中，test_main替换了全局operator new
+extern std::atomic<std::size_t> heap_allocs;
+
+class ArenaTest {
+public:
+    ArenaTest() {
+        // 不带令牌，邀请接口绑定请求体后直接返回错误，不访问存储
+        std::string body = R"({"invitee_id":"1234567890123456789"})";
+        raw_ =
+            "POST /api/rooms/42/member HTTP/1.1\r\n"
+            "Host: localhost:8080\r\n"
+            "User-Agent: tinychat-test\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " +
+            std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+
+    // 对比默认分配器与RequestArena下，一个请求经RequestHandler::handle_request
+    // 解析请求头、路由、解析绑定JSON请求体、构造并序列化响应的堆分配次数
+    void alloc_test(int rounds = 1000) {
+        // 预热：路由表和线程池里的内存区第一次使用时才创建
+        for (int i = 0; i < 10; i++) {
+            handle_with_arena();
+            handle_with_heap();
+        }
+
+        double heap_per_req = count(rounds, [this] { handle_with_heap(); });
+        double arena_per_req = count(rounds, [this] { handle_with_arena(); });
+
+        std::cout << "Heap allocations per request: default " << heap_per_req << ", arena "
+                  << arena_per_req << std::endl;
+
+        // 只有请求一侧(请求头、JSON DOM)在内存区上，响应体、响应头和message_generator
+        // 仍使用默认分配器，所以这里比较的是相对减少量，不是接近零的绝对值
+        check(arena_per_req < heap_per_req, "arena path should allocate less");
+        check(tcs::core::ArenaPool::get().idle() > 0, "arena returned to pool");
+
+        std::cout << "Arena alloc test passed" << std::endl;
+    }
+
+private:
+    std::string raw_;
+
+    template <typename F>
+    static double count(int rounds, F&& f) {
+        std::size_t before = heap_allocs.load(std::memory_order_relaxed);
+        for (int i = 0; i < rounds; i++) {
+            f();
+        }
+        return double(heap_allocs.load(std::memory_order_relaxed) - before) / rounds;
+    }
+
+    void handle_with_heap() {
+        http::request_parser<http::string_body> parser;
+        parser.eager(true);
+        beast::error_code ec;
+        parser.put(net::buffer(raw_), ec);
+        check(!ec && parser.is_done(), "parse request");
+
+        respond(tcs::core::RequestHandler::handle_request("", parser.release()));
+    }
+
+    void handle_with_arena() {
+        // 声明在最前，保证请求和DOM先于内存区析构
+        tcs::core::ArenaPtr arena = tcs::core::ArenaPool::get().acquire();
+
+        http::request_parser<http::string_body, tcs::core::ArenaAllocator> parser(
+            std::piecewise_construct, std::make_tuple(), std::make_tuple(arena->allocator()));
+        parser.eager(true);
+        beast::error_code ec;
+        parser.put(net::buffer(raw_), ec);
+        check(!ec && parser.is_done(), "parse request");
+
+        respond(tcs::core::RequestHandler::handle_request("", parser.release()));
+    }
+
+    // 与HttpSession写出响应时相同，逐段取出序列化后的缓冲区
+    static void respond(tcs::core::HttpResponse response) {
+        check(!response.file, "no file transfer");
+        std::size_t bytes = 0;
+        beast::error_code ec;
+        while (!response.msg.is_done()) {
+            auto buffers = response.msg.prepare(ec);
+            check(!ec, "serialize response");
+            std::size_t size = net::buffer_size(buffers);
+            bytes += size;
+            response.msg.consume(size);
+        }
+        check(bytes > 0, "response written");
+    }
+};
+}  // namespace test
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "core/asset_cache.hpp"
+#include "utils/http_range.hpp"
+#include "test_utils.hpp"
+
+using AssetCache = tcs::core::AssetCache;
+
+namespace test {
+class AssetCacheTest {
+public:
+    AssetCacheTest() : root_(std::filesystem::temp_directory_path() / "tinychat_asset_test") {
+        std::filesystem::remove_all(root_);
+        std::filesystem::create_directories(root_ / "js");
+        write("js/app.js", repeat("console.log('tinychat');\n", 200));
+        write("logo.png", "not really a png");
+        write("video.bin", std::string(128 * 1024, 'v'));
+        AssetCache::get().configure(root_.string(), 1024 * 1024, 4096, 64 * 1024);
+    }
+
+    ~AssetCacheTest() { std::filesystem::remove_all(root_); }
+
+    void cache_test() {
+        auto js = AssetCache::get().find("js/app.js");
+        check(js != nullptr, "load asset");
+        check(js->mime == "application/javascript", "mime type");
+        check(!js->etag.empty() && js->last_modified.ends_with("GMT"), "validators");
+        check(!js->gzip.empty() && js->gzip.size() < js->data.size(), "gzip variant");
+        check(AssetCache::get().find("js/app.js") == js, "cache hit returns same asset");
+        check(AssetCache::get().find("missing.js") == nullptr, "missing asset");
+
+        std::string_view encoding;
+        AssetCache::select(*js, "deflate, gzip;q=0.8", encoding);
+        check(encoding == "gzip", "select gzip");
+        AssetCache::select(*js, "gzip;q=0", encoding);
+        check(encoding.empty(), "gzip refused with q=0");
+
+        auto png = AssetCache::get().find("logo.png");
+        check(png != nullptr && png->gzip.empty(), "images are not compressed");
+
+        auto video = AssetCache::get().find("video.bin");
+        check(video != nullptr && video->streamed && video->data.empty() &&
+                  video->size == 128 * 1024,
+              "large files keep only metadata");
+
+#ifdef PLATFORM_LINUX
+        write("js/app.js", "changed");
+        // 等待inotify线程处理事件
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        std::shared_ptr<const tcs::core::Asset> reloaded;
+        do {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            reloaded = AssetCache::get().find("js/app.js");
+        } while (reloaded == js && std::chrono::steady_clock::now() < deadline);
+        check(reloaded != js && reloaded->data == "changed", "inotify invalidation");
+#endif
+
+        std::cout << "Asset cache test passed" << std::endl;
+    }
+
+    void eviction_test() {
+        // 8KB预算，图片不压缩，每个文件按原始大小计入
+        AssetCache::get().configure(root_.string(), 8 * 1024, 64 * 1024, 64 * 1024);
+        for (const char* name : {"a.png", "b.png", "c.png"}) {
+            write(name, std::string(3000, name[0]));
+        }
+        write("big.png", std::string(16 * 1024, 'g'));
+
+        auto a = AssetCache::get().find("a.png");
+        auto b = AssetCache::get().find("b.png");
+        auto c = AssetCache::get().find("c.png");
+        check(AssetCache::get().find("c.png") == c, "new asset cached after eviction");
+        int kept = (AssetCache::get().find("a.png") == a) + (AssetCache::get().find("b.png") == b);
+        check(kept == 1, "least recently used asset evicted");
+
+        // 上面重新加载被淘汰的文件时又会淘汰一个，这里取当前缓存的版本
+        c = AssetCache::get().find("c.png");
+        auto big = AssetCache::get().find("big.png");
+        check(big != nullptr && big->streamed && big->data.empty() && big->size == 16 * 1024,
+              "over-budget asset streamed");
+        check(AssetCache::get().find("big.png") == big, "over-budget metadata cached");
+        check(AssetCache::get().find("c.png") == c, "streamed asset takes no budget");
+
+        std::cout << "Asset cache eviction test passed" << std::endl;
+    }
+
+    void range_test() {
+        using tcs::utils::ByteRange;
+        using tcs::utils::parse_byte_range;
+
+        ByteRange r = parse_byte_range("bytes=0-99", 1000);
+        check(r.kind == ByteRange::Kind::Satisfiable && r.first == 0 && r.length() == 100,
+              "closed range");
+        r = parse_byte_range("bytes=900-", 1000);
+        check(r.kind == ByteRange::Kind::Satisfiable && r.first == 900 && r.last == 999,
+              "open range");
+        r = parse_byte_range("bytes=-100", 1000);
+        check(r.kind == ByteRange::Kind::Satisfiable && r.first == 900 && r.last == 999,
+              "suffix range");
+        r = parse_byte_range("bytes=500-5000", 1000);
+        check(r.kind == ByteRange::Kind::Satisfiable && r.last == 999, "range clamped to size");
+        check(parse_byte_range("bytes=1000-", 1000).kind == ByteRange::Kind::Unsatisfiable,
+              "range past end");
+        check(parse_byte_range("bytes=0-1,5-9", 1000).kind == ByteRange::Kind::None,
+              "multiple ranges ignored");
+        check(parse_byte_range("items=0-1", 1000).kind == ByteRange::Kind::None,
+              "unknown unit ignored");
+        check(parse_byte_range("bytes=9-1", 1000).kind == ByteRange::Kind::None,
+              "reversed range ignored");
+
+        std::cout << "Byte range test passed" << std::endl;
+    }
+
+private:
+    std::filesystem::path root_;
+
+    void write(const std::string& rel_path, const std::string& content) {
+        std::ofstream out(root_ / rel_path, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    static std::string repeat(const std::string& s, int n) {
+        std::string out;
+        for (int i = 0; i < n; i++) {
+            out += s;
+        }
+        return out;
+    }
+};
+}  // namespace test
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/tcp_cluster_bus.hpp"
+#include "test_utils.hpp"
+
+using TcpClusterBus = tcs::core::TcpClusterBus;
+using WsPayload = tcs::core::WsPayload;
+using PresenceUpdate = tcs::core::PresenceUpdate;
+using RoomEvent = tcs::core::RoomEvent;
+
+namespace test {
+class ClusterBusTest {
+public:
+    void parse_test() {
+        auto peers = TcpClusterBus::parse_peers(" 127.0.0.1:9081, 10.0.0.2:9082,");
+        check(peers.size() == 2 && peers[1].port() == 9082 &&
+                  peers[1].address().to_string() == "10.0.0.2",
+              "parse peers");
+        check(TcpClusterBus::parse_peers("").empty(), "no peers");
+        bool thrown = false;
+        try {
+            TcpClusterBus::parse_peers("127.0.0.1");
+        } catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        check(thrown, "peer without port");
+
+        std::cout << "Cluster bus parse test passed" << std::endl;
+    }
+
+    // 两个节点在回环地址上互连，A发给B的投递按顺序到达
+    void loopback_test(int count = 2000) {
+        std::mutex mtx;
+        std::vector<std::pair<std::vector<u64>, u64>> received;
+        std::vector<WsPayload> payloads;
+        std::atomic<int> received_by_a = 0;
+
+        TcpClusterBus a(NODE_A, endpoint(PORT_A), {endpoint(PORT_B)},
+                        {.deliver = [&](const std::vector<u64>&, const WsPayload&,
+                                        u64) { received_by_a++; }});
+        TcpClusterBus b(NODE_B, endpoint(PORT_B), {endpoint(PORT_A)},
+                        {.deliver = [&](const std::vector<u64>& user_ids,
+                                        const WsPayload& payload, u64 msg_id) {
+                            std::lock_guard<std::mutex> lock(mtx);
+                            received.emplace_back(user_ids, msg_id);
+                            payloads.push_back(payload);
+                        }});
+        check(wait_until([&] { return a.known_nodes() == 1 && b.known_nodes() == 1; }),
+              "peers connected");
+        check(!a.send(NODE_A + 100, {1}, WsPayload{.json = std::make_shared<const std::string>()},
+                      1),
+              "unknown node rejected");
+
+        auto json = std::make_shared<const std::string>("{\"type\":3}");
+        auto binary = std::make_shared<const std::string>(std::string("\x03\0bin", 5));
+        for (int i = 1; i <= count; i++) {
+            std::vector<u64> users{u64(i), u64(i) + 1000000};
+            check(a.send(NODE_B, users,
+                         i % 2 ? WsPayload{.json = json, .binary = binary} : WsPayload{.json = json},
+                         u64(i)),
+                  "send queued");
+        }
+        check(wait_until([&] {
+                  std::lock_guard<std::mutex> lock(mtx);
+                  return received.size() == std::size_t(count);
+              }),
+              "all deliveries received");
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (int i = 1; i <= count; i++) {
+            const auto& [users, msg_id] = received[i - 1];
+            check(msg_id == u64(i) && users.size() == 2 && users[1] == u64(i) + 1000000,
+                  "delivery in order");
+            const WsPayload& payload = payloads[i - 1];
+            check(*payload.json == *json, "json payload");
+            check(i % 2 ? payload.binary && *payload.binary == *binary : !payload.binary,
+                  "binary payload");
+        }
+        check(received_by_a == 0, "no echo to sender");
+
+        std::cout << "Cluster bus loopback test passed" << std::endl;
+    }
+
+    // 连上时报告node_up并先收到全量快照，之后收到增量变化和房间变化，对端关闭时报告node_down
+    void presence_test() {
+        std::mutex mtx;
+        std::vector<std::pair<PresenceUpdate, bool>> received;
+        std::vector<RoomEvent> events;
+        std::atomic<int> replaced = 0;
+        std::atomic<u64> up_node = 0;
+        std::atomic<u64> down_node = 0;
+
+        TcpClusterBus b(NODE_B, endpoint(PORT_B), {},
+                        {.presence =
+                             [&](u64 node_id, const std::vector<PresenceUpdate>& updates,
+                                 bool replace) {
+                                 std::lock_guard<std::mutex> lock(mtx);
+                                 check(node_id == NODE_A, "presence from node A");
+                                 replaced += replace;
+                                 for (const auto& update : updates) {
+                                     received.emplace_back(update, replace);
+                                 }
+                             },
+                         .room_event =
+                             [&](const RoomEvent& event) {
+                                 std::lock_guard<std::mutex> lock(mtx);
+                                 events.push_back(event);
+                             },
+                         .node_up = [&](u64 node_id) { up_node = node_id; },
+                         .node_down = [&](u64 node_id) { down_node = node_id; }});
+        {
+            TcpClusterBus a(NODE_A, endpoint(PORT_A), {endpoint(PORT_B)},
+                            {.snapshot = [] {
+                                return std::vector<PresenceUpdate>{
+                                    {.user_id = 1, .version = 10, .online = true},
+                                    {.user_id = 2, .version = 11, .online = true}};
+                            }});
+            check(wait_until([&] { return a.known_nodes() == 1; }), "peer connected");
+            check(up_node == NODE_A, "node up reported");
+            a.publish_presence({{.user_id = 1, .version = 12, .online = false}});
+            a.publish_room_event({.type = RoomEvent::Type::Message,
+                                  .room_id = 7,
+                                  .user_id = 1,
+                                  .message_id = 100,
+                                  .content = "hi"});
+            a.publish_room_event({.type = RoomEvent::Type::RoomDeleted, .room_id = 8});
+            check(wait_until([&] {
+                      std::lock_guard<std::mutex> lock(mtx);
+                      return received.size() == 3 && events.size() == 2;
+                  }),
+                  "snapshot and updates received");
+        }
+        check(wait_until([&] { return down_node == NODE_A; }), "node down reported");
+
+        std::lock_guard<std::mutex> lock(mtx);
+        check(replaced == 1 && received[0].second && received[1].second, "snapshot replaces");
+        check(received[1].first.user_id == 2 && received[1].first.version == 11 &&
+                  received[1].first.online,
+              "snapshot entry");
+        check(!received[2].second && received[2].first.user_id == 1 && !received[2].first.online,
+              "incremental update");
+        check(events[0].type == RoomEvent::Type::Message && events[0].room_id == 7 &&
+                  events[0].user_id == 1 && events[0].message_id == 100 &&
+                  events[0].content == "hi",
+              "message event");
+        check(events[1].type == RoomEvent::Type::RoomDeleted && events[1].room_id == 8 &&
+                  events[1].content.empty(),
+              "room deleted event");
+
+        std::cout << "Cluster bus presence test passed" << std::endl;
+    }
+
+private:
+    static constexpr unsigned short PORT_A = 39401;
+    static constexpr unsigned short PORT_B = 39402;
+    static constexpr u64 NODE_A = 1;
+    static constexpr u64 NODE_B = 2;
+
+    static tcp::endpoint endpoint(unsigned short port) {
+        return tcp::endpoint(net::ip::make_address("127.0.0.1"), port);
+    }
+
+    template <typename F>
+    static bool wait_until(F done) {
+        for (int i = 0; i < 500; i++) {
+            if (done()) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+};
+}  // namespace test
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include "utils/compression.hpp"
+#include "test_utils.hpp"
+
+namespace test {
+class CompressionTest {
+public:
+    void negotiate_test() {
+        using tcs::utils::ContentEncoding;
+        using tcs::utils::negotiate_encoding;
+
+        check(negotiate_encoding("") == ContentEncoding::Identity, "no header");
+        check(negotiate_encoding("gzip, deflate, br") == ContentEncoding::Gzip, "gzip");
+        check(negotiate_encoding("gzip, deflate, br, zstd") == ContentEncoding::Zstd,
+              "zstd preferred");
+        check(negotiate_encoding("zstd;q=0, gzip") == ContentEncoding::Gzip, "zstd refused");
+        check(negotiate_encoding("identity") == ContentEncoding::Identity, "identity");
+
+        std::cout << "Encoding negotiation test passed" << std::endl;
+    }
+
+    void round_trip_test() {
+        using tcs::utils::ContentEncoding;
+
+        std::string json = payload(500);
+
+        std::string body = json;
+        check(tcs::utils::compress(ContentEncoding::Gzip, body), "gzip compress");
+        check(body.size() < json.size() / 4, "gzip ratio");
+        check(gunzip(body, json.size()) == json, "gzip round trip");
+
+        body = json;
+        check(tcs::utils::compress(ContentEncoding::Zstd, body), "zstd compress");
+        check(body.size() < json.size() / 4, "zstd ratio");
+        std::string plain(json.size(), '\0');
+        std::size_t n = ZSTD_decompress(plain.data(), plain.size(), body.data(), body.size());
+        check(!ZSTD_isError(n) && n == json.size() && plain == json, "zstd round trip");
+
+        // 压缩后变大时保持原样
+        body = "{}";
+        check(!tcs::utils::compress(ContentEncoding::Gzip, body) && body == "{}",
+              "tiny body untouched");
+
+        // 同一线程的上下文被重复使用，连续压缩结果一致
+        std::string a = json, b = json;
+        tcs::utils::compress(ContentEncoding::Gzip, a);
+        tcs::utils::compress(ContentEncoding::Gzip, b);
+        check(a == b, "context reuse");
+
+        // 其他线程有各自的上下文
+        std::string other = json;
+        std::thread t([&other] { tcs::utils::compress(ContentEncoding::Zstd, other); });
+        t.join();
+        check(other.size() < json.size(), "compress on another thread");
+
+        std::cout << "Compression round trip test passed" << std::endl;
+    }
+
+private:
+    static std::string payload(int n) {
+        std::string out = "{\"code\":0,\"message\":\"Query messages success\",\"data\":[";
+        for (int i = 0; i < n; i++) {
+            out += "{\"id\":\"" + std::to_string(1000000 + i) +
+                   "\",\"sender_id\":\"42\",\"content\":\"hello tinychat\"},";
+        }
+        out.back() = ']';
+        out += "}";
+        return out;
+    }
+
+    static std::string gunzip(const std::string& in, std::size_t size) {
+        z_stream zs{};
+        inflateInit2(&zs, 15 + 16);
+        std::string out(size, '\0');
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs.avail_in = static_cast<uInt>(in.size());
+        zs.next_out = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        int ret = inflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        inflateEnd(&zs);
+        return ret == Z_STREAM_END ? out : std::string();
+    }
+};
+}  // namespace test
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "core/request_handler.hpp"
+#include "model/ws_models.hpp"
+#include "utils/json_writer.hpp"
+#include "test_utils.hpp"
+
+namespace test {
+class JsonWriterTest {
+public:
+    void escape_test() {
+        check(write(std::string("plain ascii text, longer than one word")) ==
+                  "\"plain ascii text, longer than one word\"",
+              "no escape");
+        check(write(std::string("你好，世界")) == "\"你好，世界\"", "utf-8 passthrough");
+        check(write(std::string("12345678\"quote\\slash\n")) ==
+                  "\"12345678\\\"quote\\\\slash\\n\"",
+              "escape after clean word");
+        check(write(std::string("\x01\x1f\t\x7f", 4)) == "\"\\u0001\\u001f\\t\x7f\"",
+              "control characters");
+        check(write(std::string("")) == "\"\"", "empty");
+
+        std::cout << "JSON writer escape test passed" << std::endl;
+    }
+
+    // 与原来的 json::serialize(json::value_from(v)) 逐字节一致
+    void equal_test() {
+        expect_same(group_msg());
+        expect_same(private_msg());
+        expect_same(login_resp());
+        expect_same(room_list());
+        expect_same(tcs::core::ApiResponse<std::nullptr_t>{tcs::utils::StatusCode::Success,
+                                                           "Room deleted successfully", nullptr});
+
+        std::cout << "JSON writer equal test passed" << std::endl;
+    }
+
+    void bench(int rounds = 200000) {
+        run_bench("GroupMsgToSend", group_msg(), rounds);
+        run_bench("ApiResponse<LoginResp>", login_resp(), rounds);
+        run_bench("ApiResponse<vector<Room>>(50)", room_list(), rounds / 50);
+    }
+
+private:
+    static tcs::model::ServerRespMsg<tcs::model::GroupMsgToSend> group_msg() {
+        return {.type = tcs::utils::ServerRespType::GMsgToSend,
+                .data = {.room_id = 1234567890123456789,
+                         .sender_id = 987654321,
+                         .message_id = 1234567890123456790,
+                         .content = "周末一起去爬山吗？\"带上水\"\n地点：西湖"}};
+    }
+
+    static tcs::model::ServerRespMsg<tcs::model::PrivateMsgToSend> private_msg() {
+        return {.type = tcs::utils::ServerRespType::PMsgToSend,
+                .data = {.private_room_id = 42, .message_id = 43, .content = "hello\tworld\\"}};
+    }
+
+    static tcs::core::ApiResponse<tcs::model::LoginResp> login_resp() {
+        return {tcs::utils::StatusCode::Success, "Login successful",
+                tcs::model::LoginResp{
+                    .token = std::string(180, 'a'),
+                    .user = {.id = 1234567890123456789,
+                             .username = "alice",
+                             .nickname = "爱丽丝",
+                             .email = "alice@example.com",
+                             .avatar_url = "/assets/avatars/alice.png",
+                             .created_at = "2025-01-01 12:00:00"}}};
+    }
+
+    static tcs::core::ApiResponse<std::vector<tcs::model::Room>> room_list() {
+        std::vector<tcs::model::Room> rooms;
+        for (int i = 0; i < 50; i++) {
+            rooms.push_back(tcs::model::Room{.id = 1000000000000ULL + i,
+                                             .type = static_cast<i8>(i % 2 + 1),
+                                             .name = "Room " + std::to_string(i),
+                                             .description = "讨论组 #" + std::to_string(i),
+                                             .avatar_url = "",
+                                             .last_message_id = 2000000000000ULL + i,
+                                             .member_count = i,
+                                             .created_at = "2025-01-01 12:00:00"});
+        }
+        return {tcs::utils::StatusCode::Success, "Query rooms success", std::move(rooms)};
+    }
+
+    template <typename T>
+    static std::string write(const T& value) {
+        std::string out;
+        tcs::utils::JsonWriter(out).write(value);
+        return out;
+    }
+
+    template <typename T>
+    static void expect_same(const T& value) {
+        std::string dom = boost::json::serialize(boost::json::value_from(value));
+        std::string direct = tcs::utils::to_json(value);
+        if (dom != direct) {
+            throw std::runtime_error("JSON writer test failed:\n  dom:    " + dom +
+                                     "\n  direct: " + direct);
+        }
+    }
+
+    template <typename T>
+    static void run_bench(const char* name, const T& value, int rounds) {
+        std::size_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            sink += boost::json::serialize(boost::json::value_from(value)).size();
+        }
+        std::chrono::duration<double, std::nano> dom = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            sink += tcs::utils::to_json(value).size();
+        }
+        std::chrono::duration<double, std::nano> direct = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Serialize " << name << ": dom " << dom.count() / rounds << " ns/op, direct "
+                  << direct.count() / rounds << " ns/op (checksum " << sink << ")" << std::endl;
+    }
+};
+}  // namespace test
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/memory_storage.hpp"
+#include "db/message_journal.hpp"
+#include "test_utils.hpp"
+
+using MemoryStorage = tcs::db::MemoryStorage;
+using MessageJournal = tcs::db::MessageJournal;
+
+namespace test {
+class MessageJournalTest {
+public:
+    // 多线程追加，跨越多个段，关闭后全部写入存储
+    void append_test(int thread_count = 4, int per_thread = 500) {
+        std::filesystem::remove_all(DIR);
+        MemoryStorage storage;
+        prepare(storage);
+        {
+            MessageJournal journal(DIR, SEGMENT_BYTES, storage);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < thread_count; t++) {
+                threads.emplace_back([&journal, t, per_thread] {
+                    for (int i = 0; i < per_thread; i++) {
+                        journal.append(message(u64(i) * 64 + t + 1, std::string(40 + i % 50, 'x')));
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        check(stored(storage).size() == std::size_t(thread_count) * per_thread,
+              "all records replayed");
+        // 写完的段已删除，只留下最后一段
+        check(segment_count() == 1, "replayed segments removed");
+
+        std::cout << "Message journal append test passed" << std::endl;
+    }
+
+    // 丢失checkpoint、尾部写了一半时重新打开
+    void recovery_test() {
+        std::filesystem::remove_all(DIR);
+        MemoryStorage storage;
+        prepare(storage);
+        {
+            MessageJournal journal(DIR, SEGMENT_BYTES, storage);
+            for (u64 id = 1; id <= 100; id++) {
+                journal.append(message(id, "first"));
+            }
+        }
+        std::filesystem::remove(DIR + "/checkpoint");
+        tear_tail();
+
+        // 已经写入过的记录不会重复写入
+        {
+            MessageJournal journal(DIR, SEGMENT_BYTES, storage);
+            for (u64 id = 101; id <= 110; id++) {
+                journal.append(message(id, "second"));
+            }
+        }
+        std::vector<u64> ids = stored(storage);
+        check(ids.size() == 110 && std::set<u64>(ids.begin(), ids.end()).size() == 110,
+              "no duplicates after recovery");
+
+        // 重放到空的存储：恢复出最后一段的记录，以及尾部之后追加的记录
+        std::filesystem::remove(DIR + "/checkpoint");
+        MemoryStorage fresh;
+        prepare(fresh);
+        {
+            MessageJournal journal(DIR, SEGMENT_BYTES, fresh);
+            journal.wait_recovered();
+            check(journal.pending() == 0, "recovered records replayed before returning");
+            ids = stored(fresh);
+        }
+        check(!ids.empty() && ids.front() == 110, "recovered after torn tail");
+        for (std::size_t i = 1; i < ids.size(); i++) {
+            check(ids[i - 1] == ids[i] + 1, "recovered records contiguous");
+        }
+
+        std::cout << "Message journal recovery test passed" << std::endl;
+    }
+
+    // 不是房间成员的消息在重放时被存储拒绝并交给on_reject，不影响后面的记录
+    void rejected_test() {
+        std::filesystem::remove_all(DIR);
+        MemoryStorage storage;
+        prepare(storage);
+        std::vector<u64> rejected;
+        {
+            MessageJournal journal(DIR, SEGMENT_BYTES, storage,
+                                   [&rejected](const tcs::model::Message& msg) {
+                                       rejected.push_back(msg.id);
+                                   });
+            journal.append(message(1, "ok"));
+            journal.append(tcs::model::Message{
+                .id = 2, .room_id = ROOM, .sender_id = SENDER + 1, .content = "rejected"});
+            journal.append(message(3, "ok"));
+        }
+        std::vector<u64> ids = stored(storage);
+        check(ids == std::vector<u64>{3, 1}, "rejected record skipped");
+        check(rejected == std::vector<u64>{2}, "rejected record reported");
+
+        std::filesystem::remove_all(DIR);
+        std::cout << "Message journal rejected test passed" << std::endl;
+    }
+
+private:
+    inline static const std::string DIR = "journal_test";
+    static constexpr u64 SEGMENT_BYTES = 16 * 1024;
+    static constexpr u64 ROOM = 100;
+    static constexpr u64 SENDER = 1;
+
+    static void prepare(MemoryStorage& storage) { storage.create_group_room(ROOM, "room", SENDER); }
+
+    static tcs::model::Message message(u64 id, const std::string& content) {
+        return tcs::model::Message{
+            .id = id, .room_id = ROOM, .sender_id = SENDER, .content = content};
+    }
+
+    // id降序
+    static std::vector<u64> stored(MemoryStorage& storage) {
+        std::vector<u64> ids;
+        for (const auto& msg : storage.messages_before(ROOM, UINT64_MAX, 100000)) {
+            ids.push_back(msg.id);
+        }
+        return ids;
+    }
+
+    static std::vector<std::filesystem::path> segments() {
+        std::vector<std::filesystem::path> paths;
+        for (const auto& entry : std::filesystem::directory_iterator(DIR)) {
+            if (entry.path().extension() == ".journal") {
+                paths.push_back(entry.path());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    static std::size_t segment_count() { return segments().size(); }
+
+    // 在最后一段的有效记录之后写入半条记录
+    static void tear_tail() {
+        std::filesystem::path path = segments().back();
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::size_t end = data.find_last_not_of('\0') + 1;
+        end = (end + 7) & ~std::size_t(7);
+        file.seekp(static_cast<std::streamoff>(end));
+        file.write("\x12\x34\x56\x78\x20\x00\x00\x00\x99", 9);
+    }
+};
+}  // namespace test
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "db/sql_conn_RAII.hpp"
+#include "utils/snowflake.hpp"
+
+using SnowFlake = tcs::utils::SnowFlake;
+using SqlConnRAII = tcs::db::SqlConnRAII;
+
+namespace test {
+// 对比历史消息查询：created_at 过滤 vs messages.id 主键范围扫描
+// 需要可用的MySQL，由 test_main --db <room_id> 触发
+class MessageQueryBench {
+public:
+    void run(u64 room_id, u64 window_ms = 24ull * 3600 * 1000, int rounds = 200) {
+        u64 now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+        SnowFlake::IdRange range = SnowFlake::id_range(now - window_ms, now + 1);
+
+        u64 ts_rows = 0;
+        double ts_cost = time_rounds(rounds, [&](SqlConnRAII& conn) {
+            std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+                "SELECT id, sender_id, content FROM messages WHERE room_id = ? AND "
+                "created_at >= FROM_UNIXTIME(? / 1000) ORDER BY created_at DESC LIMIT 50",
+                room_id, now - window_ms));
+            ts_rows = count_rows(res.get());
+        });
+
+        u64 id_rows = 0;
+        double id_cost = time_rounds(rounds, [&](SqlConnRAII& conn) {
+            std::unique_ptr<sql::ResultSet> res(conn.execute_query(
+                "SELECT id, sender_id, content FROM messages WHERE room_id = ? AND "
+                "id BETWEEN ? AND ? ORDER BY id DESC LIMIT 50",
+                room_id, range.min_id, range.max_id));
+            id_rows = count_rows(res.get());
+        });
+
+        std::cout << "History query on room " << room_id << " over " << rounds
+                  << " rounds: created_at " << ts_cost << " ms/query (" << ts_rows
+                  << " rows), id range " << id_cost << " ms/query (" << id_rows << " rows)"
+                  << std::endl;
+    }
+
+private:
+    template <typename F>
+    static double time_rounds(int rounds, F&& query) {
+        SqlConnRAII conn;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            query(conn);
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count() / rounds;
+    }
+
+    static u64 count_rows(sql::ResultSet* res) {
+        u64 rows = 0;
+        while (res->next()) {
+            ++rows;
+        }
+        return rows;
+    }
+};
+}  // namespace test
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/metrics.hpp"
+#include "test_utils.hpp"
+
+using Counter = tcs::utils::Counter;
+using Gauge = tcs::utils::Gauge;
+using Histogram = tcs::utils::Histogram;
+
+namespace test {
+class MetricsTest {
+public:
+    void record_test() {
+        Counter counter;
+        Gauge gauge;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < 100000; i++) {
+                    counter.add();
+                    gauge.add(1);
+                }
+                // 减少可以发生在另一个分片上
+                std::thread([&] { gauge.add(-50000); }).join();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        check(counter.value() == 800000, "sharded counter");
+        check(gauge.value() == 400000, "sharded gauge");
+
+        for (u64 v : {0ULL, 7ULL, 8ULL, 9ULL, 1000ULL, 123456789ULL, 1ULL << 39}) {
+            std::size_t bucket = Histogram::bucket_of(v);
+            check(v <= Histogram::bucket_upper(bucket), "value within bucket");
+            check(bucket == 0 || v > Histogram::bucket_upper(bucket - 1), "tight bucket");
+            check(Histogram::bucket_upper(bucket) - v <= v / 8, "bucket precision");
+        }
+        check(Histogram::bucket_of(~0ULL) == Histogram::BUCKETS - 1, "overflow bucket");
+
+        Histogram histogram;
+        for (u64 v = 1; v <= 1000; v++) {
+            histogram.record(v * 1000);
+        }
+        Histogram::Snapshot snap = histogram.snapshot();
+        check(snap.count == 1000 && snap.sum == 500500000, "histogram count and sum");
+        check(near(snap.quantile(0.5), 500000) && near(snap.quantile(0.99), 990000),
+              "histogram quantiles");
+
+        tcs::utils::Metrics::get().accepted_connections.add();
+        std::string text = tcs::utils::Metrics::get().render();
+        check(text.find("# TYPE tinychat_accepted_connections_total counter\n") !=
+                      std::string::npos &&
+                  text.find("tinychat_db_query_seconds{quantile=\"0.99\"}") != std::string::npos &&
+                  text.find("# TYPE tinychat_db_batch_seconds summary\n") != std::string::npos,
+              "render");
+
+        std::cout << "Metrics test passed" << std::endl;
+    }
+
+    // 记录一次的耗时，多线程同时记录时不应互相拖慢
+    void bench(int rounds = 10000000) {
+        for (int thread_count : {1, 4}) {
+            Counter counter;
+            Histogram histogram;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < thread_count; t++) {
+                threads.emplace_back([&] {
+                    for (int i = 0; i < rounds; i++) {
+                        counter.add();
+                        histogram.record(static_cast<u64>(i));
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            std::chrono::duration<double, std::nano> elapsed =
+                std::chrono::steady_clock::now() - start;
+            std::cout << "Metrics with " << thread_count << " threads: "
+                      << elapsed.count() / rounds << " ns per counter+histogram record (checksum "
+                      << counter.value() << ")" << std::endl;
+        }
+    }
+
+private:
+    static bool near(u64 actual, u64 expected) {
+        return actual >= expected && actual - expected <= expected / 8;
+    }
+};
+}  // namespace test
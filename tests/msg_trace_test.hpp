@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "core/msg_trace.hpp"
+#include "test_utils.hpp"
+
+using MsgTrace = tcs::core::MsgTrace;
+using MsgTracer = tcs::core::MsgTracer;
+
+namespace test {
+class MsgTraceTest {
+public:
+    void dump_test() {
+        const std::string file = "msg_trace_test.json";
+        std::remove(file.c_str());
+
+        MsgTracer& tracer = MsgTracer::get();
+        tracer.configure(file, 1, 0);
+
+        auto t0 = MsgTrace::Clock::now();
+        MsgTrace trace{.msg_id = 1234567890123456789ULL,
+                       .received = t0,
+                       .dequeued = t0 + std::chrono::microseconds(20),
+                       .committed = t0 + std::chrono::microseconds(1500),
+                       .fanned_out = t0 + std::chrono::microseconds(1600)};
+        tracer.finish(trace);
+        tracer.delivered(trace.msg_id, 42, trace.fanned_out,
+                         trace.fanned_out + std::chrono::microseconds(300));
+        tracer.flush();
+
+        std::ifstream in(file);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        std::string text = ss.str();
+        check(text.starts_with("[\n"), "json array");
+        for (const char* span : {"\"queue\"", "\"handle\"", "\"fanout\"", "\"deliver\""}) {
+            check(text.find(span) != std::string::npos, span);
+        }
+        check(text.find("\"dur\":1480.000") != std::string::npos, "handle duration");
+        check(text.find("\"msg_id\":\"1234567890123456789\"") != std::string::npos, "msg id");
+        check(text.find("\"pid\":2,\"tid\":42") != std::string::npos, "delivery row");
+
+        std::remove(file.c_str());
+        std::cout << "Message trace test passed" << std::endl;
+    }
+
+};
+}  // namespace test
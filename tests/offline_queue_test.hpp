@@ -0,0 +1,93 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/offline_queue.hpp"
+#include "test_utils.hpp"
+
+using OfflineQueue = tcs::core::OfflineQueue;
+
+namespace test {
+class OfflineQueueTest {
+public:
+    OfflineQueueTest() : root_(std::filesystem::temp_directory_path() / "tinychat_offline_test") {
+        std::filesystem::remove_all(root_);
+    }
+
+    ~OfflineQueueTest() { std::filesystem::remove_all(root_); }
+
+    // 需要ThreadPool已初始化，溢写在线程池中执行
+    void order_test() {
+        OfflineQueue& queue = OfflineQueue::get();
+        queue.configure(4, 1000, root_.string());
+
+        // 乱序、重复入队，每满4条溢写到文件，最后一条留在内存中
+        for (u64 id : {5, 3, 9, 1, 7, 3, 2, 8, 6, 4, 10, 9, 11}) {
+            queue.push(USER, id, payload(id));
+        }
+        wait_spilled();
+        check(std::filesystem::exists(spill_file()), "spilled to disk");
+
+        std::vector<OfflineQueue::Entry> entries = queue.drain(USER);
+        check(entries.size() == 11, "duplicates removed");
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            check(entries[i].msg_id == i + 1 && *entries[i].payload == *payload(i + 1),
+                  "ascending order across file and memory");
+        }
+        check(!std::filesystem::exists(spill_file()), "spill file removed after drain");
+        check(queue.drain(USER).empty(), "drain empties the queue");
+
+        std::cout << "Offline queue order test passed" << std::endl;
+    }
+
+    void spill_limit_test() {
+        OfflineQueue& queue = OfflineQueue::get();
+        queue.configure(4, 10, root_.string());
+
+        for (u64 id = 1; id <= 40; id++) {
+            queue.push(USER, id, payload(id));
+            // 每批溢写完成后再推下一批，文件中的条数才确定
+            if (id % 4 == 0) {
+                wait_spilled();
+            }
+        }
+
+        // 文件中只剩最新的10条
+        std::vector<OfflineQueue::Entry> entries = queue.drain(USER);
+        check(entries.size() == 10 && entries.front().msg_id == 31 && entries.back().msg_id == 40,
+              "oldest spilled messages dropped");
+
+        std::cout << "Offline queue spill limit test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 USER = 42;
+    std::filesystem::path root_;
+
+    static std::shared_ptr<const std::string> payload(u64 id) {
+        return std::make_shared<const std::string>("{\"id\":" + std::to_string(id) + "}");
+    }
+
+    std::filesystem::path spill_file() const { return root_ / (std::to_string(USER) + ".queue"); }
+
+    // 溢写任务在线程池中执行，等到文件大小不再变化
+    void wait_spilled() {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        std::uintmax_t last = 0;
+        while (std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            std::error_code ec;
+            std::uintmax_t size = std::filesystem::file_size(spill_file(), ec);
+            if (!ec && size > 0 && size == last) {
+                return;
+            }
+            last = ec ? 0 : size;
+        }
+    }
+};
+}  // namespace test
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/presence_directory.hpp"
+#include "test_utils.hpp"
+
+using PresenceDirectory = tcs::core::PresenceDirectory;
+
+namespace test {
+class PresenceDirectoryTest {
+public:
+    void local_test() {
+        PresenceDirectory& directory = PresenceDirectory::get();
+        auto online = directory.set_local(LOCAL_USER, true);
+        check(online && online->online, "local online");
+        auto offline = directory.set_local(LOCAL_USER, false);
+        check(offline && !offline->online && offline->version > online->version,
+              "offline version newer");
+        check(!directory.set_local(LOCAL_USER, false), "offline twice");
+
+        directory.set_local(LOCAL_USER, true);
+        auto snapshot = directory.snapshot();
+        check(std::any_of(snapshot.begin(), snapshot.end(),
+                          [](const auto& update) { return update.user_id == LOCAL_USER; }),
+              "snapshot contains local user");
+        directory.set_local(LOCAL_USER, false);
+
+        std::cout << "Presence directory local test passed" << std::endl;
+    }
+
+    void remote_test() {
+        PresenceDirectory& directory = PresenceDirectory::get();
+        directory.apply(NODE_A, {{.user_id = 1, .version = 10, .online = true},
+                                 {.user_id = 2, .version = 10, .online = true}},
+                        true);
+        directory.apply(NODE_B, {{.user_id = 2, .version = 5, .online = true}}, true);
+        check(directory.nodes_of(1) == std::vector<u64>{NODE_A}, "user on node A");
+        check(directory.nodes_of(2).size() == 2, "user on both nodes");
+
+        // 过期的下线被忽略，较新的下线生效
+        directory.apply(NODE_A, {{.user_id = 1, .version = 9, .online = false}}, false);
+        check(directory.nodes_of(1).size() == 1, "stale offline ignored");
+        directory.apply(NODE_A, {{.user_id = 1, .version = 11, .online = false}}, false);
+        check(directory.nodes_of(1).empty(), "offline applied");
+
+        // 按节点分组
+        std::vector<u64> offline;
+        auto by_node = directory.route({1, 2, 3}, offline);
+        check(offline == std::vector<u64>{1, 3}, "offline users");
+        check(by_node.size() == 2 && by_node[NODE_A] == std::vector<u64>{2} &&
+                  by_node[NODE_B] == std::vector<u64>{2},
+              "grouped by node");
+
+        // 快照替换该节点的全部条目
+        directory.apply(NODE_A, {{.user_id = 4, .version = 20, .online = true}}, true);
+        check(directory.nodes_of(2) == std::vector<u64>{NODE_B}, "replaced by snapshot");
+        check(directory.nodes_of(4) == std::vector<u64>{NODE_A}, "snapshot entry");
+
+        directory.drop_node(NODE_A);
+        directory.drop_node(NODE_B);
+        check(directory.nodes_of(2).empty() && directory.nodes_of(4).empty(), "nodes dropped");
+
+        std::cout << "Presence directory remote test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 LOCAL_USER = 1000;
+    static constexpr u64 NODE_A = 901;
+    static constexpr u64 NODE_B = 902;
+
+};
+}  // namespace test
@@ -0,0 +1,115 @@
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/room_cache.hpp"
+#include "test_utils.hpp"
+
+using RoomCache = tcs::core::RoomCache;
+
+namespace test {
+class RoomCacheTest {
+public:
+    void order_test() {
+        RoomCache& cache = RoomCache::get();
+        cache.clear();
+        cache.configure(1 << 20, 8);
+
+        // 空缓存只接受最新一页
+        cache.fill(ROOM, 100, {msg(ROOM, 10)}, true);
+        check(!cache.query(ROOM, LATEST, 1), "older page not filled into empty cache");
+        cache.fill(ROOM, LATEST, {msg(ROOM, 10), msg(ROOM, 8), msg(ROOM, 6)}, false);
+
+        // 乱序到达的提交插到对应位置，重复和比最旧一条更早的忽略
+        cache.append(msg(ROOM, 12));
+        cache.append(msg(ROOM, 9));
+        cache.append(msg(ROOM, 8));
+        cache.append(msg(ROOM, 3));
+        check(ids(cache.query(ROOM, LATEST, 3)) == std::vector<u64>{12, 10, 9},
+              "late append inserted in order");
+        check(ids(cache.query(ROOM, 12, 4)) == std::vector<u64>{10, 9, 8, 6}, "page before id");
+        check(cache.query(ROOM, 7, 1)->has_more, "incomplete room has more");
+        check(!cache.query(ROOM, LATEST, 10), "short incomplete page misses");
+
+        // 与缓存最旧一条不衔接的页不回填
+        cache.fill(ROOM, 5, {msg(ROOM, 4), msg(ROOM, 2)}, true);
+        check(!cache.query(ROOM, 6, 1), "gap not filled");
+
+        // 衔接的页回填到前面，并标记为完整
+        cache.fill(ROOM, 6, {msg(ROOM, 5), msg(ROOM, 4)}, true);
+        auto page = cache.query(ROOM, LATEST, 100);
+        check(page && ids(page) == std::vector<u64>{12, 10, 9, 8, 6, 5, 4} && !page->has_more,
+              "complete room answers any page");
+        check(ids(cache.query(ROOM, 4, 10)).empty(), "nothing before the first message");
+
+        // 超出房间容量时丢掉最旧的消息，不再完整
+        cache.append(msg(ROOM, 13));
+        cache.append(msg(ROOM, 14));
+        check(!cache.query(ROOM, LATEST, 100), "capacity drops completeness");
+        check(ids(cache.query(ROOM, LATEST, 8)) ==
+                  std::vector<u64>{14, 13, 12, 10, 9, 8, 6, 5},
+              "oldest popped");
+
+        cache.clear();
+        std::cout << "Room cache order test passed" << std::endl;
+    }
+
+    void budget_test() {
+        RoomCache& cache = RoomCache::get();
+        cache.clear();
+        // 恰好容纳3个房间各一条消息
+        constexpr std::size_t CONTENT = 1000;
+        cache.configure(3 * (sizeof(tcs::model::Message) + CONTENT), 256);
+
+        for (u64 room : {1, 2, 3}) {
+            cache.fill(room, LATEST, {msg(room, room * 10, CONTENT)}, true);
+        }
+        check(cache.query(1, LATEST, 1) && cache.query(2, LATEST, 1) && cache.query(3, LATEST, 1),
+              "all rooms fit");
+
+        // 房间1刚被访问，超出预算时淘汰最久未用的房间2
+        cache.query(1, LATEST, 1);
+        cache.fill(4, LATEST, {msg(4, 40, CONTENT)}, true);
+        check(!cache.query(2, LATEST, 1), "least recently used room evicted");
+        check(cache.query(1, LATEST, 1) && cache.query(3, LATEST, 1) && cache.query(4, LATEST, 1),
+              "other rooms kept");
+
+        // 删除房间释放的空间可以再用
+        cache.erase_room(3);
+        cache.fill(5, LATEST, {msg(5, 50, CONTENT)}, true);
+        check(cache.query(1, LATEST, 1) && cache.query(4, LATEST, 1) && cache.query(5, LATEST, 1),
+              "erased room frees budget");
+
+        // 单个房间超出预算时保留正在写入的房间
+        cache.append(msg(5, 51, 4 * CONTENT));
+        check(ids(cache.query(5, LATEST, 2)) == std::vector<u64>{51, 50}, "writing room kept");
+        check(!cache.query(1, LATEST, 1) && !cache.query(4, LATEST, 1), "others evicted");
+
+        cache.clear();
+        cache.configure(64 * 1024 * 1024, 256);
+        std::cout << "Room cache budget test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 ROOM = 1;
+    static constexpr u64 LATEST = std::numeric_limits<u64>::max();
+
+    static tcs::model::Message msg(u64 room_id, u64 id, std::size_t size = 0) {
+        return tcs::model::Message{
+            .id = id, .room_id = room_id, .sender_id = 7, .content = std::string(size, 'x')};
+    }
+
+    static std::vector<u64> ids(const std::optional<tcs::model::MessagePage>& page) {
+        check(page.has_value(), "cache hit");
+        std::vector<u64> result;
+        for (const auto& m : page->messages) {
+            result.push_back(m.id);
+        }
+        return result;
+    }
+};
+}  // namespace test
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/room_signals.hpp"
+#include "test_utils.hpp"
+
+using RoomSignals = tcs::core::RoomSignals;
+
+namespace test {
+class RoomSignalsTest {
+public:
+    // 同一房间的多次变化只保留最后一次，按房间分组
+    void coalesce_test() {
+        RoomSignals signals(std::chrono::milliseconds(200), 2);
+        for (int i = 0; i < 100; i++) {
+            check(signals.typing(ALICE, ROOM_A, true), "repeated typing accepted");
+        }
+        signals.typing(BOB, ROOM_A, true);
+        signals.typing(BOB, ROOM_A, false);
+        signals.typing(ALICE, ROOM_B, true);
+
+        auto batches = sorted(signals.collect());
+        check(batches.size() == 2, "one batch per room");
+        check(batches[0].room_id == ROOM_A && batches[0].typing == std::vector<u64>{ALICE} &&
+                  batches[0].stopped == std::vector<u64>{BOB},
+              "last state wins");
+        check(batches[1].room_id == ROOM_B && batches[1].typing == std::vector<u64>{ALICE},
+              "second room");
+        check(signals.collect().empty(), "window drained");
+
+        std::cout << "Room signals coalesce test passed" << std::endl;
+    }
+
+    // 每个用户一个窗口内最多在user_limit个房间发出通知
+    void rate_limit_test() {
+        RoomSignals signals(std::chrono::milliseconds(200), 2);
+        check(signals.typing(ALICE, 1, true) && signals.typing(ALICE, 2, true), "within limit");
+        check(!signals.typing(ALICE, 3, true), "third room dropped");
+        check(signals.typing(ALICE, 1, false), "known room still updated");
+        check(signals.typing(BOB, 3, true), "limit is per user");
+        check(signals.collect().size() == 3, "dropped room not collected");
+        check(signals.typing(ALICE, 3, true), "limit resets each window");
+
+        std::cout << "Room signals rate limit test passed" << std::endl;
+    }
+
+    void encode_test() {
+        std::string json = RoomSignals::encode(RoomSignals::Batch{
+            .room_id = 7, .typing = {1, 2}, .stopped = {}, .online = {3}, .offline = {}});
+        check(json == "{\"type\":6,\"data\":{\"room_id\":\"7\",\"typing\":[\"1\",\"2\"],"
+                      "\"stopped\":[],\"online\":[\"3\"],\"offline\":[]}}",
+              "encoded batch");
+
+        std::cout << "Room signals encode test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 ALICE = 1;
+    static constexpr u64 BOB = 2;
+    static constexpr u64 ROOM_A = 100;
+    static constexpr u64 ROOM_B = 200;
+
+    static std::vector<RoomSignals::Batch> sorted(std::vector<RoomSignals::Batch> batches) {
+        std::sort(batches.begin(), batches.end(),
+                  [](const auto& a, const auto& b) { return a.room_id < b.room_id; });
+        return batches;
+    }
+};
+}  // namespace test
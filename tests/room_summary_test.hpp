@@ -0,0 +1,95 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/room_summary_cache.hpp"
+#include "test_utils.hpp"
+
+using RoomSummaryCache = tcs::core::RoomSummaryCache;
+
+namespace test {
+class RoomSummaryTest {
+public:
+    void update_test() {
+        RoomSummaryCache& cache = RoomSummaryCache::get();
+        cache.configure(2);
+
+        check(!cache.query(ALICE), "miss before load");
+
+        cache.begin_load(ALICE);
+        cache.put(ALICE, {summary(1, 100, 100), summary(2, 200, 150)});
+        cache.begin_load(BOB);
+        cache.put(BOB, {summary(1, 100, 100)});
+
+        auto rooms = cache.query(ALICE);
+        check(rooms && rooms->size() == 2 && rooms->front().room.id == 2,
+              "sorted by last message");
+        check(rooms->front().unread_count == 1, "loaded unread count");
+
+        // 鲍勃在房间1发消息：爱丽丝未读+1，鲍勃自己不变
+        cache.on_message(tcs::model::Message{
+            .id = 300, .room_id = 1, .sender_id = BOB, .content = std::string(100, 'x')});
+        rooms = cache.query(ALICE);
+        check(rooms->front().room.id == 1 && rooms->front().unread_count == 1 &&
+                  rooms->front().last_sender_id == BOB,
+              "message moves room to top");
+        check(rooms->front().last_preview.size() == RoomSummaryCache::PREVIEW_CHARS,
+              "preview truncated");
+        check(cache.query(BOB)->front().unread_count == 0, "own message not unread");
+
+        cache.mark_read(ALICE, 1, 300);
+        check(cache.query(ALICE)->front().unread_count == 0, "mark read");
+
+        // 只读到中间某条时需要重新加载
+        cache.mark_read(ALICE, 2, 160);
+        check(!cache.query(ALICE), "partial read invalidates");
+
+        // 加载期间房间有新消息，加载结果作废
+        cache.begin_load(ALICE);
+        cache.on_message(tcs::model::Message{.id = 400, .room_id = 2, .sender_id = BOB});
+        cache.put(ALICE, {summary(1, 300, 300), summary(2, 200, 150)});
+        check(!cache.query(ALICE), "stale load dropped");
+
+        cache.invalidate_room(1);
+        check(!cache.query(BOB), "room invalidation");
+
+        // 容量为2，第三个用户挤掉最久未使用的
+        for (u64 user : {ALICE, BOB, CAROL}) {
+            cache.begin_load(user);
+            cache.put(user, {summary(1, 100, 100)});
+        }
+        check(!cache.query(ALICE) && cache.query(BOB) && cache.query(CAROL), "lru eviction");
+
+        check(RoomSummaryCache::preview("你好世界") == "你好世界", "short preview");
+        check(RoomSummaryCache::preview(repeat("你", 70)) == repeat("你", 64), "utf-8 preview");
+
+        std::cout << "Room summary test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 ALICE = 1;
+    static constexpr u64 BOB = 2;
+    static constexpr u64 CAROL = 3;
+
+    static tcs::model::RoomSummary summary(u64 room_id, u64 last_message_id, u64 last_read) {
+        return tcs::model::RoomSummary{
+            .room = tcs::model::Room{.id = room_id,
+                                     .type = 1,
+                                     .last_message_id = last_message_id,
+                                     .member_count = 2},
+            .last_sender_id = BOB,
+            .last_preview = "hello",
+            .last_read_message_id = last_read,
+            .unread_count = last_message_id > last_read ? 1u : 0u};
+    }
+
+    static std::string repeat(const std::string& s, int n) {
+        std::string out;
+        for (int i = 0; i < n; i++) {
+            out += s;
+        }
+        return out;
+    }
+};
+}  // namespace test
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/router.hpp"
+#include "test_utils.hpp"
+
+using Router = tcs::core::Router<int>;
+using RouteParams = tcs::core::RouteParams;
+
+namespace test {
+class RouterTest {
+public:
+    void match_test() {
+        Router router;
+        router.add(http::verb::post, "/api/login", 1)
+            .add(http::verb::delete_, "/api/rooms/{id:u64}", 2)
+            .add(http::verb::post, "/api/rooms/{id:u64}/member", 3)
+            .add(http::verb::get, "/api/rooms/{id:u64}/messages", 4)
+            .add(http::verb::get, "/users/me/rooms", 5)
+            .add(http::verb::get, "/assets/{*}", 6);
+
+        expect(router, http::verb::post, "/api/login", 1);
+        expect(router, http::verb::get, "/api/rooms/42/messages?before=7&limit=20", 4);
+        expect(router, http::verb::delete_, "/api/rooms/42", 2);
+        expect(router, http::verb::get, "/assets/img/a.png", 6);
+
+        RouteParams params;
+        router.match(http::verb::get, "/api/rooms/42/messages?before=7", params);
+        check(params.id_count == 1 && params.id(0) == 42, "u64 capture");
+        check(params.query == "before=7", "query string");
+
+        RouteParams tail_params;
+        router.match(http::verb::get, "/assets/img/a.png", tail_params);
+        check(tail_params.tail == "img/a.png", "wildcard tail");
+
+        RouteParams miss;
+        check(router.match(http::verb::get, "/api/rooms/abc/messages", miss).status ==
+                  tcs::core::RouteStatus::NotFound,
+              "non-numeric id rejected");
+        check(router.match(http::verb::get, "/api/login", miss).status ==
+                  tcs::core::RouteStatus::MethodNotAllowed,
+              "method not allowed");
+
+        std::cout << "Router match test passed" << std::endl;
+    }
+
+    // 路由数增长时，对比逐条比较的if链与前缀树
+    void bench(int rounds = 200000) {
+        for (int route_count : {8, 32, 128, 512}) {
+            std::vector<std::string> prefixes;
+            Router router;
+            for (int i = 0; i < route_count; i++) {
+                prefixes.push_back("/api/resource" + std::to_string(i) + "/");
+                router.add(http::verb::get, "/api/resource" + std::to_string(i) + "/{id:u64}/items",
+                           i);
+            }
+            // 最后一条路由是if链的最坏情况
+            std::string target = "/api/resource" + std::to_string(route_count - 1) + "/123/items";
+
+            int sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r++) {
+                // 原实现：逐条 == 比较，命中后再按 '/' 重新切分并 stoull 解析参数
+                std::string_view t = target;
+                for (int i = 0; i < route_count; i++) {
+                    if (t.starts_with(prefixes[i]) && t.ends_with("/items")) {
+                        std::string_view id = t.substr(prefixes[i].size());
+                        id = id.substr(0, id.find('/'));
+                        sink += i + static_cast<int>(std::stoull(std::string(id)));
+                        break;
+                    }
+                }
+            }
+            std::chrono::duration<double, std::nano> chain = std::chrono::steady_clock::now() - start;
+
+            start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r++) {
+                RouteParams params;
+                auto match = router.match(http::verb::get, target, params);
+                sink += *match.handler + static_cast<int>(params.id(0));
+            }
+            std::chrono::duration<double, std::nano> trie = std::chrono::steady_clock::now() - start;
+
+            std::cout << "Router with " << route_count << " routes: if-chain "
+                      << chain.count() / rounds << " ns/req, trie " << trie.count() / rounds
+                      << " ns/req (checksum " << sink << ")" << std::endl;
+        }
+    }
+
+private:
+    static void expect(const Router& router, http::verb method, std::string_view target,
+                       int handler) {
+        RouteParams params;
+        auto match = router.match(method, target, params);
+        if (match.status != tcs::core::RouteStatus::Found || *match.handler != handler) {
+            throw std::runtime_error("Router test failed for " + std::string(target));
+        }
+    }
+};
+}  // namespace test
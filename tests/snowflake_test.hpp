@@ -3,6 +3,8 @@
 #include <chrono>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <unordered_set>
 
 #include "utils/snowflake.hpp"
 #include "utils/config.hpp"
@@ -25,38 +27,51 @@ public:
                 }
             });
         }
+        // 批量预留
+        vv_id[4] = SnowFlake::reserve(5000);
 
         for (auto &t : threads) {
             t.join();
         }
 
+        check_ids(vv_id);
+
+        for (const auto &id : vv_id[0]) {
+            parse_id(id);
+            std::cout << "-----" << std::endl;
+        }
+    }
+
+    // 对比旧的互斥锁实现，测量多线程下的吞吐量
+    void throughput_test(int thread_count = 8, int ids_per_thread = 200000) {
+        std::vector<std::vector<u64>> vv_id(thread_count);
         for (auto &ids : vv_id) {
-            for (const auto &id : ids) {
-                u64 sequence_id = parse_id(id);
-                std::cout << "-----" << std::endl;
-            }
+            ids.reserve(ids_per_thread);
         }
 
-        // std::map<u64, u64> ans_map;
-        // for (const auto &ids : vv_id) {
-        //     for (const auto &id : ids) {
-        //         u64 sequence_id = parse_id(id);
-        //         if (ans_map.find(sequence_id) == ans_map.end()) {
-        //             ans_map[sequence_id] = 1;
-        //         } else {
-        //             ans_map[sequence_id]++;
-        //         }
-        //         // print_time_in_ms(id);
-        //     }
-        // }
-
-        // u64 v_sum = 0;
-        // std::cout << "In ans_map:" << std::endl;
-        // for (auto const &[k, v] : ans_map) {
-        //     std::cout << k << ": " << v << std::endl;
-        //     v_sum += v;
-        // }
-        // std::cout << "v_sum=" << v_sum << std::endl;
+        double total = double(thread_count) * ids_per_thread;
+        double lock_free_rate = total / run_threads(thread_count, [&](int i) {
+            for (int j = 0; j < ids_per_thread; j++) {
+                vv_id[i].push_back(SnowFlake::next_id());
+            }
+        });
+        check_ids(vv_id);
+
+        MutexSnowFlake baseline(own_epoch_);
+        double mutex_rate = total / run_threads(thread_count, [&](int) {
+            for (int j = 0; j < ids_per_thread; j++) {
+                baseline.next_id();
+            }
+        });
+
+        std::cout << "SnowFlake throughput with " << thread_count << " threads: lock-free "
+                  << static_cast<u64>(lock_free_rate) << " ids/s, mutex "
+                  << static_cast<u64>(mutex_rate) << " ids/s" << std::endl;
+
+        SnowFlake::Stats stats = SnowFlake::stats();
+        std::cout << "SnowFlake stats: stalls=" << stats.stalls
+                  << ", skew_events=" << stats.skew_events << ", borrowed_ms=" << stats.borrowed_ms
+                  << std::endl;
     }
 
 private:
@@ -64,22 +79,96 @@ private:
     static constexpr u64 SERVICE_BITS = 10;
     static constexpr u64 SEQUENCE_BITS = 12;
 
-    u64 parse_id(u64 id) {
-        std::cout << "Parsed ID: " << id << std::endl;
-        u64 sequence_id = id & ((1 << SEQUENCE_BITS) - 1);
+    // 解析与时间范围在编译期即可验证
+    static_assert(SnowFlake::decode((u64(5) << 22) | (u64(7) << 12) | 9, 1000).timestamp == 1005);
+    static_assert(SnowFlake::decode((u64(5) << 22) | (u64(7) << 12) | 9, 1000).service_id == 7);
+    static_assert(SnowFlake::decode((u64(5) << 22) | (u64(7) << 12) | 9, 1000).sequence == 9);
+    static_assert(SnowFlake::id_range(1005, 1006, 1000).min_id == u64(5) << 22);
+    static_assert(SnowFlake::id_range(1005, 1006, 1000).max_id == (u64(6) << 22) - 1);
+    static_assert(SnowFlake::id_range(1006, 1005, 1000).empty());
+
+    // 旧实现：全局互斥锁，持锁自旋等待下一毫秒
+    class MutexSnowFlake {
+    public:
+        explicit MutexSnowFlake(u64 epoch) : epoch_(epoch) {}
+
+        u64 next_id() {
+            std::lock_guard<std::mutex> lock(mtx_);
+            u64 time_stamp = now_ms();
+            if (time_stamp == last_timestamp_) {
+                sequence_id_++;
+                if (sequence_id_ >= (1 << SEQUENCE_BITS)) {
+                    while (time_stamp <= last_timestamp_) {
+                        time_stamp = now_ms();
+                    }
+                    sequence_id_ = 0;
+                }
+            } else {
+                sequence_id_ = 0;
+            }
+            last_timestamp_ = time_stamp;
+            return ((time_stamp - epoch_) << (SERVICE_BITS + SEQUENCE_BITS)) | sequence_id_;
+        }
+
+    private:
+        u64 epoch_;
+        u64 last_timestamp_ = 0;
+        u64 sequence_id_ = 0;
+        std::mutex mtx_;
 
-        std::cout << "Sequence ID: " << sequence_id << std::endl;
+        static u64 now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+    };
+
+    // 返回耗时(秒)
+    template <typename F>
+    static double run_threads(int thread_count, F &&work) {
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < thread_count; i++) {
+            threads.emplace_back([&work, i]() { work(i); });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
 
-        id >>= SEQUENCE_BITS;
-        u64 service_id = id & ((1 << SERVICE_BITS) - 1);
+    // 每个线程内严格递增，全局不重复，且能落回自身时间戳对应的id范围
+    void check_ids(const std::vector<std::vector<u64>> &vv_id) {
+        std::unordered_set<u64> seen;
+        for (const auto &ids : vv_id) {
+            for (std::size_t i = 0; i < ids.size(); i++) {
+                if (i > 0 && ids[i] <= ids[i - 1]) {
+                    throw std::runtime_error("SnowFlake ids are not monotonic within a thread");
+                }
+                if (!seen.insert(ids[i]).second) {
+                    throw std::runtime_error("Duplicated SnowFlake id: " + std::to_string(ids[i]));
+                }
+                u64 ts = SnowFlake::decode(ids[i], own_epoch_).timestamp;
+                SnowFlake::IdRange range = SnowFlake::id_range(ts, ts + 1, own_epoch_);
+                if (ids[i] < range.min_id || ids[i] > range.max_id) {
+                    throw std::runtime_error("SnowFlake id out of its time range: " +
+                                             std::to_string(ids[i]));
+                }
+            }
+        }
+        std::cout << "SnowFlake check passed, " << seen.size() << " unique ids" << std::endl;
+    }
 
-        std::cout << "Service ID: " << service_id << std::endl;
+    u64 parse_id(u64 id) {
+        std::cout << "Parsed ID: " << id << std::endl;
+        SnowFlake::IdParts parts = SnowFlake::decode(id, own_epoch_);
 
-        id >>= SERVICE_BITS;
-        u64 timestamp = id + own_epoch_;
-        print_time_in_ms(timestamp);
+        std::cout << "Sequence ID: " << parts.sequence << std::endl;
+        std::cout << "Service ID: " << parts.service_id << std::endl;
+        print_time_in_ms(parts.timestamp);
 
-        return sequence_id;
+        return parts.sequence;
     }
 
     void print_time_in_ms(u64 ms_since_epoch) {
@@ -104,4 +193,4 @@ private:
         std::cout << "Formatted (UTC+8): " << formatted_time << std::endl;
     }
 };
-}  // namespace test
\ No newline at end of file
+}  // namespace test
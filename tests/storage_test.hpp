@@ -0,0 +1,141 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db/storage.hpp"
+#include "test_utils.hpp"
+
+using Storage = tcs::db::Storage;
+using GroupRole = tcs::utils::GroupRole;
+using RoomType = tcs::utils::RoomType;
+
+namespace test {
+// 各存储引擎共用的测试，storage必须是空的
+class StorageTest {
+public:
+    void semantics_test(Storage& storage, const std::string& engine) {
+        check(storage.create_user(user(ALICE, "alice"), "hash"), "create user");
+        check(!storage.create_user(user(99, "alice"), "other"), "duplicate username");
+        auto record = storage.find_user("alice");
+        check(record && record->user.id == ALICE && record->password_hash == "hash",
+              "find user");
+        check(!storage.find_user("nobody"), "missing user");
+
+        storage.create_group_room(GROUP, "group", ALICE);
+        storage.create_private_room(PRIVATE, ALICE, BOB);
+        check(storage.room_type(GROUP) == RoomType::GROUP, "group type");
+        check(storage.room_type(PRIVATE) == RoomType::PRIVATE, "private type");
+        check(!storage.room_type(12345), "missing room");
+        check(storage.member_role(GROUP, ALICE) == GroupRole::OWNER, "owner role");
+        check(!storage.member_role(GROUP, BOB), "not a member");
+
+        check(storage.add_member(GROUP, BOB, GroupRole::MEMBER), "add member");
+        check(!storage.add_member(GROUP, BOB, GroupRole::MEMBER), "duplicate member");
+        check(storage.room_members(GROUP).size() == 2, "room members");
+        check(storage.rooms_of(BOB).size() == 2 && storage.rooms_of(CAROL).empty(), "rooms of user");
+
+        // 非成员不能发消息
+        check(!storage.append_message(message(1, GROUP, CAROL, "x")), "non-member message");
+        // 乱序到达的id仍然按顺序保存
+        for (u64 id : {10, 30, 20, 40}) {
+            check(storage.append_message(message(id, GROUP, BOB, "msg" + std::to_string(id))),
+                  "append message");
+        }
+        check(storage.append_message(message(50, GROUP, ALICE, repeat("你", 70))),
+              "append own message");
+
+        auto page = storage.messages_before(GROUP, 40, 2);
+        check(page.size() == 2 && page[0].id == 30 && page[1].id == 20, "page before");
+        page = storage.messages_before(GROUP, UINT64_MAX, 100);
+        check(page.size() == 5 && page.front().id == 50 && page.back().id == 10, "whole room");
+
+        auto rooms = storage.room_summaries(ALICE, 64);
+        check(rooms.size() == 2 && rooms[0].room.id == GROUP, "summaries sorted");
+        check(rooms[0].room.last_message_id == 50 && rooms[0].room.member_count == 2,
+              "summary room");
+        check(rooms[0].last_sender_id == ALICE && rooms[0].last_preview == repeat("你", 64),
+              "summary preview");
+        check(rooms[0].unread_count == 4, "own messages not unread");
+
+        check(storage.mark_read(GROUP, ALICE, 30), "mark read");
+        check(storage.mark_read(GROUP, ALICE, 20), "mark read backwards");
+        check(storage.room_summaries(ALICE, 64)[0].unread_count == 1, "read position kept");
+        check(!storage.mark_read(GROUP, CAROL, 30), "mark read non-member");
+
+        check(storage.delete_room(GROUP), "delete room");
+        check(!storage.delete_room(GROUP), "delete twice");
+        check(!storage.member_role(GROUP, ALICE) && storage.room_summaries(BOB, 64).size() == 1,
+              "members removed");
+        check(storage.rooms_of(ALICE) == std::vector<u64>{PRIVATE}, "rooms after delete");
+
+        tcs::model::Attachment attachment{.id = 7, .hash = "abc", .size = 100};
+        storage.add_attachment(ALICE, attachment);
+        check(storage.find_attachment(ALICE, "abc")->id == 7, "find attachment");
+        check(!storage.find_attachment(BOB, "abc"), "attachment per user");
+        check(storage.attachment_usage(ALICE) == 100, "attachment usage");
+
+        std::cout << engine << " storage test passed" << std::endl;
+    }
+
+    // 多个线程同时向不同房间和同一房间写入
+    void concurrency_test(Storage& storage, const std::string& engine, int thread_count,
+                          int per_thread) {
+        storage.create_group_room(GROUP, "shared", ALICE);
+        for (int t = 0; t < thread_count; t++) {
+            storage.add_member(GROUP, 1000 + t, GroupRole::MEMBER);
+            storage.create_group_room(2000 + t, "own", 1000 + t);
+        }
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < thread_count; t++) {
+            threads.emplace_back([&storage, t, per_thread] {
+                u64 sender = 1000 + t;
+                for (int i = 0; i < per_thread; i++) {
+                    u64 id = u64(i) * 64 + t + 1;
+                    storage.append_message(message(id, i % 2 ? GROUP : 2000 + t, sender, "m"));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto page = storage.messages_before(GROUP, UINT64_MAX, thread_count * per_thread);
+        check(page.size() == std::size_t(thread_count) * (per_thread / 2), "all stored");
+        for (std::size_t i = 1; i < page.size(); i++) {
+            check(page[i - 1].id > page[i].id, "ordered under contention");
+        }
+        check(storage.room_summaries(ALICE, 64)[0].unread_count == page.size(),
+              "unread under contention");
+
+        std::cout << engine << " storage concurrency test passed" << std::endl;
+    }
+
+private:
+    static constexpr u64 ALICE = 1;
+    static constexpr u64 BOB = 2;
+    static constexpr u64 CAROL = 3;
+    static constexpr u64 GROUP = 100;
+    static constexpr u64 PRIVATE = 200;
+
+    static tcs::model::User user(u64 id, const std::string& username) {
+        return tcs::model::User{.id = id, .username = username};
+    }
+
+    static tcs::model::Message message(u64 id, u64 room_id, u64 sender_id,
+                                       const std::string& content) {
+        return tcs::model::Message{
+            .id = id, .room_id = room_id, .sender_id = sender_id, .content = content};
+    }
+
+    static std::string repeat(const std::string& s, int n) {
+        std::string out;
+        for (int i = 0; i < n; i++) {
+            out += s;
+        }
+        return out;
+    }
+};
+}  // namespace test
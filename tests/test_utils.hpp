@@ -0,0 +1,16 @@
+#pragma once
+
+#include <source_location>
+#include <stdexcept>
+#include <string>
+
+namespace test {
+// 条件不成立时抛出异常，信息里带上失败检查所在的文件和行号
+inline void check(bool ok, const char* what,
+                  std::source_location loc = std::source_location::current()) {
+    if (!ok) {
+        throw std::runtime_error(std::string("Test failed at ") + loc.file_name() + ":" +
+                                 std::to_string(loc.line()) + ": " + what);
+    }
+}
+}  // namespace test
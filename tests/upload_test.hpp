@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "sodium.h"
+
+#include "core/upload_handler.hpp"
+#include "db/memory_storage.hpp"
+#include "test_utils.hpp"
+
+using UploadHandler = tcs::core::UploadHandler;
+using UploadSink = tcs::core::UploadSink;
+
+namespace test {
+class UploadTest {
+public:
+    UploadTest() : root_(std::filesystem::temp_directory_path() / "tinychat_upload_test") {
+        sodium_init();
+        std::filesystem::remove_all(root_);
+        std::filesystem::create_directories(root_);
+    }
+
+    ~UploadTest() { std::filesystem::remove_all(root_); }
+
+    void store_test() {
+        tcs::db::MemoryStorage storage;
+        constexpr u64 QUOTA = 1024 * 1024;
+
+        // 分块写入，结果与一次性计算的哈希相同
+        std::string body;
+        for (int i = 0; i < 1000; i++) {
+            body += "chunk " + std::to_string(i) + "\n";
+        }
+        auto png = upload(storage, 1, "image/PNG; charset=binary", body, QUOTA);
+        check(png.has_value(), "store upload");
+        check(png->hash == hash_of(body) && png->size == body.size(), "streamed hash and size");
+        check(png->content_type == "image/png" && png->url.ends_with(png->hash + ".png"),
+              "normalized type and extension");
+        check(read(png->url) == body, "file moved to upload dir");
+        check(std::filesystem::is_empty(root_ / UploadHandler::TMP_DIR), "temp file removed");
+
+        // 同一用户换类型重复上传，返回已保存文件的记录和url
+        auto again = upload(storage, 1, "application/octet-stream", body, QUOTA);
+        check(again && again->id == png->id && again->url == png->url, "dedupe keeps first url");
+        check(storage.attachment_usage(1) == body.size(), "dedupe not counted twice");
+
+        // 其他用户上传相同内容，新增记录但共用文件
+        auto other = upload(storage, 2, "image/png", body, QUOTA);
+        check(other && other->id != png->id && other->url == png->url, "shared file");
+
+        auto html = upload(storage, 1, "text/html", "<script></script>", QUOTA);
+        check(html && html->content_type == "application/octet-stream" &&
+                  html->url.ends_with(html->hash),
+              "disallowed type stored as octet-stream");
+
+        // 超出配额时不保存
+        std::string big(QUOTA, 'x');
+        check(!upload(storage, 1, "application/zip", big, QUOTA), "quota exceeded");
+        check(storage.attachment_usage(1) == body.size() + html->size, "usage after rejection");
+        check(!std::filesystem::exists(root_ / path_of(hash_of(big), ".zip")),
+              "rejected upload not saved");
+        check(std::filesystem::is_empty(root_ / UploadHandler::TMP_DIR),
+              "rejected temp file removed");
+
+        std::cout << "Upload test passed" << std::endl;
+    }
+
+private:
+    std::filesystem::path root_;
+
+    std::optional<tcs::model::Attachment> upload(tcs::db::MemoryStorage& storage, u64 user_id,
+                                                 std::string_view content_type,
+                                                 const std::string& body, u64 quota) {
+        UploadSink sink(user_id, content_type, root_.string());
+        for (std::size_t i = 0; i < body.size(); i += 1000) {
+            std::size_t len = std::min<std::size_t>(1000, body.size() - i);
+            sink.write(body.data() + i, len);
+        }
+        return UploadHandler::store(sink, storage, quota);
+    }
+
+    std::string read(const std::string& url) {
+        std::ifstream in(root_ / url.substr(std::string_view("/assets/").size()),
+                         std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    static std::string path_of(const std::string& hash, std::string_view ext) {
+        return std::string(UploadHandler::UPLOAD_DIR) + "/" + hash.substr(0, 2) + "/" + hash +
+               std::string(ext);
+    }
+
+    static std::string hash_of(const std::string& data) {
+        unsigned char hash[crypto_generichash_BYTES];
+        crypto_generichash(hash, sizeof(hash), reinterpret_cast<const unsigned char*>(data.data()),
+                           data.size(), nullptr, 0);
+        char hex[crypto_generichash_BYTES * 2 + 1];
+        sodium_bin2hex(hex, sizeof(hex), hash, sizeof(hash));
+        return hex;
+    }
+};
+}  // namespace test
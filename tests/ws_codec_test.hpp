@@ -0,0 +1,53 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "core/ws_codec.hpp"
+#include "test_utils.hpp"
+
+using WsCodec = tcs::core::WsCodec;
+
+namespace test {
+class WsCodecTest {
+public:
+    void round_trip_test() {
+        check(WsCodec::negotiate("") == "", "no protocol");
+        check(WsCodec::negotiate("foo, tinychat.bin.v1") == WsCodec::BINARY_PROTOCOL,
+              "binary protocol");
+        check(WsCodec::negotiate("tinychat.json , tinychat.bin.v1") == WsCodec::JSON_PROTOCOL,
+              "client order");
+
+        auto private_msg = WsCodec::decode_client(WsCodec::encode_client(tcs::model::ClientPrivateMsg{
+            .room_id = 0x0102030405060708, .other_user_id = 42, .content = "你好"}));
+        check(private_msg && std::holds_alternative<tcs::model::ClientPrivateMsg>(*private_msg),
+              "private message type");
+        const auto& pm = std::get<tcs::model::ClientPrivateMsg>(*private_msg);
+        check(pm.room_id == 0x0102030405060708 && pm.other_user_id == 42 && pm.content == "你好",
+              "private message fields");
+
+        auto group_msg = WsCodec::decode_client(
+            WsCodec::encode_client(tcs::model::ClientGroupMsg{.room_id = 7, .content = ""}));
+        check(group_msg && std::get<tcs::model::ClientGroupMsg>(*group_msg).room_id == 7,
+              "empty group message");
+
+        std::string frame = WsCodec::encode_client(tcs::model::ClientGroupMsg{.room_id = 7});
+        check(!WsCodec::decode_client(frame.substr(0, 5)), "truncated frame");
+        check(!WsCodec::decode_client(frame + "\xC0\x80"), "overlong utf-8");
+        check(!WsCodec::decode_client(frame + "\xED\xA0\x80"), "surrogate");
+        check(!WsCodec::decode_client(std::string("\x09") + frame.substr(1)), "unknown type");
+
+        std::string out = WsCodec::encode(tcs::model::GroupMsgToSend{
+            .room_id = 1, .sender_id = 2, .message_id = 3, .content = "hi"});
+        check(out.size() == 1 + 24 + 2 && out[0] == 3 && out[1] == 1 && out[9] == 2 &&
+                  out[17] == 3 && out.substr(25) == "hi",
+              "group message layout");
+        out = WsCodec::encode(
+            tcs::model::PrivateMsgToSend{.private_room_id = 1, .message_id = 2, .content = "hi"});
+        check(out.size() == 1 + 16 + 2 && out[0] == 2 && out[1] == 1 && out[9] == 2 &&
+                  out.substr(17) == "hi",
+              "private message layout");
+
+        std::cout << "WebSocket codec test passed" << std::endl;
+    }
+};
+}  // namespace test